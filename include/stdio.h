@@ -54,6 +54,8 @@ int fseek(FILE *fp, long offset, int origin);
 long ftell(FILE *fp);
 int feof(FILE *fp);
 int remove(const char *fn);
+int rename(const char *oldpath, const char *newpath);
+int renameat(int olddirfd, const char *oldpath, int newdirfd, const char *newpath);
 
 int fgetc(FILE *fp);
 int fputc(int c, FILE *fp);
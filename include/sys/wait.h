@@ -2,6 +2,8 @@
 
 #include <sys/types.h>  // pid_t
 
+#define WNOHANG  1
+
 #define _WSTOPPED       0x7f
 #define WTERMSIG(x)     ((x) & 0x7f)
 #define WEXITSTATUS(x)  ((x) >> 8)
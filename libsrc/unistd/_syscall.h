@@ -46,7 +46,10 @@
 #define __NR_stat    4
 #define __NR_fstat   5
 #define __NR_lstat   6
+#define __NR_poll    7
 #define __NR_lseek   8
+#define __NR_mmap    9
+#define __NR_munmap  11
 #define __NR_brk     12
 #define __NR_ioctl   16
 #define __NR_pipe    22
@@ -58,6 +61,7 @@
 #define __NR_kill    62
 #define __NR_getcwd  79
 #define __NR_chdir   80
+#define __NR_rename  82
 #define __NR_mkdir   83
 #define __NR_rmdir   84
 #define __NR_unlink  87
@@ -117,8 +121,11 @@
 #define __NR_fstat   80
 #define __NR_lseek   62
 #define __NR_brk     214
+#define __NR_munmap  215
+#define __NR_mmap    222
 //#define __NR_ioctl   16
 #define __NR_pipe2    59
+#define __NR_ppoll    73
 #define __NR_dup     23
 //#define __NR_clone    220
 #define __NR_clone3    435
@@ -130,6 +137,7 @@
 #define __NR_getcwd  17
 #define __NR_chdir   49
 #define __NR_unlinkat  35
+#define __NR_renameat  38
 #define __NR_fchmodat   53
 #define __NR_clock_gettime  113
 #define __NR_mkdirat     34
@@ -160,15 +168,19 @@
 #define __NR_lseek     62
 #define __NR_read      63
 #define __NR_write     64
+#define __NR_ppoll     73
 #define __NR_exit      93
 #define __NR_kill      129
 #define __NR_brk       214
+#define __NR_munmap    215
+#define __NR_mmap      222
 #define __NR_execve    221
 #define __NR_wait4     260
 #define __NR_fstat     80
 #define __NR_fstatat   79
 #define __NR_mkdirat   34
 #define __NR_unlinkat  35
+#define __NR_renameat  38
 
 #else
 #error unknown
@@ -0,0 +1,13 @@
+#include "sys/mman.h"
+#include "_syscall.h"
+
+void *mmap(void *addr, size_t length, int prot, int flags, int fd, off_t offset) {
+  long ret;
+#if defined(__x86_64__)
+  SYSCALL_ARGCOUNT(6);
+#endif
+  SYSCALL_RET(__NR_mmap, ret, "r"(addr), "r"(length), "r"(prot), "r"(flags), "r"(fd),
+              "r"(offset));
+  SET_ERRNO(ret);
+  return (void*)ret;
+}
@@ -0,0 +1,9 @@
+#include "sys/mman.h"
+#include "_syscall.h"
+
+int munmap(void *addr, size_t length) {
+  int ret;
+  SYSCALL_RET(__NR_munmap, ret, "r"(addr), "r"(length));
+  SET_ERRNO(ret);
+  return ret;
+}
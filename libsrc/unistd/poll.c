@@ -0,0 +1,32 @@
+#include "poll.h"
+#include "stddef.h"  // NULL
+#include "time.h"  // struct timespec
+#include "_syscall.h"
+
+#if defined(__NR_poll)
+int poll(struct pollfd *fds, nfds_t nfds, int timeout) {
+  int ret;
+  SYSCALL_RET(__NR_poll, ret, "r"(fds), "r"(nfds), "r"(timeout));
+  SET_ERRNO(ret);
+  return ret;
+}
+#elif defined(__NR_ppoll)
+// Parameters are passed to the system call as they are in registers.
+static int ppoll_(struct pollfd *fds, nfds_t nfds, const struct timespec *timeout,
+                  const void *sigmask, size_t sigsetsize) {
+  int ret;
+  SYSCALL_RET(__NR_ppoll, ret, "r"(fds), "r"(nfds), "r"(timeout), "r"(sigmask), "r"(sigsetsize));
+  SET_ERRNO(ret);
+  return ret;
+}
+
+int poll(struct pollfd *fds, nfds_t nfds, int timeout) {
+  struct timespec ts, *pts = NULL;
+  if (timeout >= 0) {
+    ts.tv_sec = timeout / 1000;
+    ts.tv_nsec = (timeout % 1000) * 1000000L;
+    pts = &ts;
+  }
+  return ppoll_(fds, nfds, pts, NULL, 8);
+}
+#endif
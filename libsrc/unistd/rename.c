@@ -0,0 +1,18 @@
+#include "stdio.h"
+#include "_syscall.h"
+
+#if defined(__NR_rename)
+int rename(const char *oldpath, const char *newpath) {
+  int ret;
+  SYSCALL_RET(__NR_rename, ret, "r"(oldpath), "r"(newpath));
+  SET_ERRNO(ret);
+  return ret;
+}
+
+#elif defined(__NR_renameat)
+#include "fcntl.h"  // AT_FDCWD
+
+int rename(const char *oldpath, const char *newpath) {
+  return renameat(AT_FDCWD, oldpath, AT_FDCWD, newpath);
+}
+#endif
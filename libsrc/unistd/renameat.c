@@ -0,0 +1,11 @@
+#include "stdio.h"
+#include "_syscall.h"
+
+#if defined(__NR_renameat)
+int renameat(int olddirfd, const char *oldpath, int newdirfd, const char *newpath) {
+  int ret;
+  SYSCALL_RET(__NR_renameat, ret, "r"(olddirfd), "r"(oldpath), "r"(newdirfd), "r"(newpath));
+  SET_ERRNO(ret);
+  return ret;
+}
+#endif
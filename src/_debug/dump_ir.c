@@ -337,6 +337,7 @@ void do_dump_ir(Vector *decls) {
     FuncBackend *fnbe = func->extra;
     curfunc = func;
     curra = fnbe->ra;
+    func_arena = &fnbe->arena;
 
     optimize(fnbe->ra, fnbe->bbcon);
 
@@ -357,6 +358,8 @@ void do_dump_ir(Vector *decls) {
     curra = NULL;
 
     dump_func_ir(func);
+    func_arena = NULL;
+    release_defun(func);
   }
 }
 
@@ -375,7 +378,7 @@ static void init_compiler(Vector *decls) {
 }
 
 static void compile1(FILE *ifp, const char *filename, Vector *decls) {
-  set_source_file(ifp, filename);
+  set_source_whole_file(ifp, filename);
   parse(decls);
 }
 
@@ -407,10 +410,7 @@ int main(int argc, char *argv[]) {
       break;
 
     case OPT_SSA:
-      {
-        extern bool apply_ssa;
-        apply_ssa = true;
-      }
+      set_optimize_level(1);
       break;
 
     case '?':
@@ -272,14 +272,14 @@ static int find_aarch_label_flag(const char **pp) {
 static ExprWithFlag parse_expr_with_flag(ParseInfo *info) {
   // expr = label + nn
 #if XCC_TARGET_PLATFORM == XCC_PLATFORM_APPLE
-  Expr *expr = parse_expr(info);
+  Expr *expr = asm_parse_expr(info);
   int flag = parse_label_postfix(info);
 #else
   const char *p = info->p;
   int flag = find_aarch_label_flag(&p);
   if (flag != 0)
     parse_set_p(info, p);
-  Expr *expr = parse_expr(info);
+  Expr *expr = asm_parse_expr(info);
 #endif
   return (ExprWithFlag){expr, flag};
 }
@@ -290,7 +290,7 @@ static unsigned int parse_indirect_register(ParseInfo *info, Operand *operand) {
   int extend = 0;
   enum RegType reg = find_register(&p, R64);
   if (reg == NOREG) {
-    parse_error(info, "Base register expected");
+    asm_parse_error(info, "Base register expected");
     return 0;
   }
   if (reg == SP) {
@@ -300,7 +300,7 @@ static unsigned int parse_indirect_register(ParseInfo *info, Operand *operand) {
     operand->indirect.reg.size = REG64;
     operand->indirect.reg.no = reg - X0;
   } else {
-    parse_error(info, "Base register expected");
+    asm_parse_error(info, "Base register expected");
   }
 
   ExprWithFlag offset_with_flag = {NULL, 0};
@@ -313,7 +313,7 @@ static unsigned int parse_indirect_register(ParseInfo *info, Operand *operand) {
       ++p;
       int64_t imm;
       if (immediate(&p, &imm)) {
-        offset_with_flag.expr = new_expr(EX_FIXNUM);
+        offset_with_flag.expr = asm_new_expr(EX_FIXNUM);
         offset_with_flag.expr->fixnum = imm;
       } else {
         parse_set_p(info, p);
@@ -321,7 +321,7 @@ static unsigned int parse_indirect_register(ParseInfo *info, Operand *operand) {
         if (offset_with_flag.expr != NULL) {
           p = info->p;
         } else {
-          parse_error(info, "Offset expected");
+          asm_parse_error(info, "Offset expected");
         }
       }
     } else {
@@ -343,10 +343,10 @@ static unsigned int parse_indirect_register(ParseInfo *info, Operand *operand) {
               p = p + 1;
               int64_t imm;
               if (immediate(&p, &imm)) {
-                scale = new_expr(EX_FIXNUM);
+                scale = asm_new_expr(EX_FIXNUM);
                 scale->fixnum = imm;
               } else {
-                // parse_error(info, "Offset expected");
+                // asm_parse_error(info, "Offset expected");
                 return 0;  // Error
               }
             }
@@ -360,7 +360,7 @@ static unsigned int parse_indirect_register(ParseInfo *info, Operand *operand) {
   }
 
   if (*p != ']')
-    // parse_error(info, "`]' expected");
+    // asm_parse_error(info, "`]' expected");
     return 0;  // Error
 
   p = skip_whitespaces(p + 1);
@@ -376,11 +376,11 @@ static unsigned int parse_indirect_register(ParseInfo *info, Operand *operand) {
         p = q + 1;
         int64_t imm;
         if (immediate(&p, &imm)) {
-          offset_with_flag.expr = new_expr(EX_FIXNUM);
+          offset_with_flag.expr = asm_new_expr(EX_FIXNUM);
           offset_with_flag.expr->fixnum = imm;
           prepost = 2;
         } else {
-          // parse_error(info, "Offset expected");
+          // asm_parse_error(info, "Offset expected");
           return 0;  // Error
         }
       }
@@ -437,9 +437,9 @@ static bool parse_extend(ParseInfo *info, Operand *operand) {
       if (isspace(*p) && (p = skip_whitespaces(p), *p == '#')) {
         ++p;
         if (!immediate(&p, &imm))
-          parse_error(info, "immediate value expected");
+          asm_parse_error(info, "immediate value expected");
       } else if (i >= 8) {
-        parse_error(info, "immediate value for shift expected");
+        asm_parse_error(info, "immediate value for shift expected");
       }
       operand->extend.imm = imm;
       info->p = p;
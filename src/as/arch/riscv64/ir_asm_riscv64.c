@@ -304,7 +304,7 @@ bool resolve_relative_address(Vector *sections, Table *label_table, Vector *unre
                     enum Opcode inv = ((inst->op - BEQ) ^ 1) + BEQ;  // BEQ <=> BNE, BLT <=> BGE, BLTU <=> BGEU
                     inst->op = inv;
 
-                    Expr *skip = new_expr(EX_FIXNUM);
+                    Expr *skip = asm_new_expr(EX_FIXNUM);
                     inst->opr[2].direct.expr = skip;
                     ir->code.flag &= ~INST_LONG_OFFSET;
                     ir->code.len = 0;
@@ -222,7 +222,7 @@ static unsigned int parse_direct_register(ParseInfo *info, Operand *operand) {
     Expr *offset = NULL;
     if (*info->p == ':') {
       ++info->p;
-      offset = parse_expr(info);
+      offset = asm_parse_expr(info);
     }
     operand->type = SEGMENT_OFFSET;
     operand->segment.reg = reg;
@@ -245,7 +245,7 @@ static unsigned int parse_direct_register(ParseInfo *info, Operand *operand) {
     size = REG64;
     no = reg - RAX;
   } else {
-    parse_error(info, "Illegal register");
+    asm_parse_error(info, "Illegal register");
     return false;
   }
 
@@ -284,11 +284,11 @@ static ExprWithFlag parse_expr_with_flag(ParseInfo *info) {
   // expr@pageoff
   // expr@gotpage
   // expr@gotpageoff
-  Expr *expr = parse_expr(info);
+  Expr *expr = asm_parse_expr(info);
   int flag = parse_label_postfix(info);
 #else
   int flag = 0;
-  Expr *expr = parse_expr(info);
+  Expr *expr = asm_parse_expr(info);
 #endif
   return (ExprWithFlag){expr, flag};
 }
@@ -305,23 +305,23 @@ static unsigned int parse_indirect_register(ParseInfo *info, ExprWithFlag *offse
     info->p = skip_whitespaces(info->p + 1);
     if (*info->p != '%' ||
         (++info->p, index_reg = find_register(&info->p), !is_reg64(index_reg)))
-      parse_error(info, "Register expected");
+      asm_parse_error(info, "Register expected");
     info->p = skip_whitespaces(info->p);
     if (*info->p == ',') {
       info->p = skip_whitespaces(info->p + 1);
-      scale = parse_expr(info);
+      scale = asm_parse_expr(info);
       if (scale->kind != EX_FIXNUM)
-        parse_error(info, "constant value expected");
+        asm_parse_error(info, "constant value expected");
       info->p = skip_whitespaces(info->p);
     }
   }
   if (*info->p != ')')
-    parse_error(info, "`)' expected");
+    asm_parse_error(info, "`)' expected");
   else
     ++info->p;
 
   if (!(is_reg64(base_reg) || (base_reg == RIP && index_reg == NOREG)))
-    parse_error(info, "Register expected");
+    asm_parse_error(info, "Register expected");
 
   if (index_reg == NOREG) {
     char no = base_reg - RAX;
@@ -333,7 +333,7 @@ static unsigned int parse_indirect_register(ParseInfo *info, ExprWithFlag *offse
     return IND;
   } else {
     if (!is_reg64(index_reg))
-      parse_error(info, "Register expected");
+      asm_parse_error(info, "Register expected");
 
     operand->type = INDIRECT_WITH_INDEX;
     operand->indirect_with_index.offset = offset->expr;
@@ -353,7 +353,7 @@ static unsigned int parse_indirect_register(ParseInfo *info, ExprWithFlag *offse
 static enum RegType parse_deref_register(ParseInfo *info, Operand *operand) {
   enum RegType reg = find_register(&info->p);
   if (!is_reg64(reg))
-    parse_error(info, "Illegal register");
+    asm_parse_error(info, "Illegal register");
 
   char no = reg - RAX;
   operand->type = DEREF_REG;
@@ -364,14 +364,14 @@ static enum RegType parse_deref_register(ParseInfo *info, Operand *operand) {
 }
 
 static unsigned int parse_deref_indirect(ParseInfo *info, Operand *operand) {
-  Expr *offset = parse_expr(info);
+  Expr *offset = asm_parse_expr(info);
   info->p = skip_whitespaces(info->p);
   if (*info->p != '(') {
-    parse_error(info, "direct number not implemented");
+    asm_parse_error(info, "direct number not implemented");
     return false;
   }
   if (info->p[1] != '%') {
-    parse_error(info, "Register expected");
+    asm_parse_error(info, "Register expected");
     return false;
   }
   info->p += 2;
@@ -386,23 +386,23 @@ static unsigned int parse_deref_indirect(ParseInfo *info, Operand *operand) {
     info->p = skip_whitespaces(info->p + 1);
     if (*info->p != '%' ||
         (++info->p, index_reg = find_register(&info->p), !is_reg64(index_reg)))
-      parse_error(info, "Register expected");
+      asm_parse_error(info, "Register expected");
     info->p = skip_whitespaces(info->p);
     if (*info->p == ',') {
       info->p = skip_whitespaces(info->p + 1);
-      scale = parse_expr(info);
+      scale = asm_parse_expr(info);
       if (scale->kind != EX_FIXNUM)
-        parse_error(info, "constant value expected");
+        asm_parse_error(info, "constant value expected");
       info->p = skip_whitespaces(info->p);
     }
   }
   if (*info->p != ')')
-    parse_error(info, "`)' expected");
+    asm_parse_error(info, "`)' expected");
   else
     ++info->p;
 
   if (!is_reg64(base_reg) || (index_reg != NOREG && !is_reg64(index_reg)))
-    parse_error(info, "Register expected");
+    asm_parse_error(info, "Register expected");
 
   if (index_reg == NOREG) {
     operand->type = DEREF_INDIRECT;
@@ -459,7 +459,7 @@ unsigned int parse_operand(ParseInfo *info, unsigned int opr_flag, Operand *oper
     if (*p == '$') {
       info->p = p + 1;
       if (!immediate(&info->p, &operand->immediate))
-        parse_error(info, "Syntax error");
+        asm_parse_error(info, "Syntax error");
       operand->type = IMMEDIATE;
       return IMM;
     }
@@ -474,7 +474,7 @@ unsigned int parse_operand(ParseInfo *info, unsigned int opr_flag, Operand *oper
         operand->direct.expr = expr_with_flag.expr;
         return EXP;
       }
-      parse_error(info, "direct number not implemented");
+      asm_parse_error(info, "direct number not implemented");
     }
   } else {
     if (info->p[1] == '%') {
@@ -29,7 +29,7 @@ static bool read_line_comment_skip(FILE *fp, ParseInfo *info) {
       if (len == -1) {  // EOF
         info->rawline = info->p = NULL;
         if (block_comment)
-          parse_error(info, "Block comment not closed");
+          asm_parse_error(info, "Block comment not closed");
         return false;
       }
       info->rawline = p = rawline;
@@ -59,7 +59,7 @@ static bool read_line_comment_skip(FILE *fp, ParseInfo *info) {
 
     if (wait_line_end) {
       if (*p != '\0')
-        parse_error(info, "Line end expected");
+        asm_parse_error(info, "Line end expected");
       p = NULL;
       continue;
     }
@@ -184,13 +184,14 @@ static void usage(FILE *fp) {
   );
 }
 
-int main(int argc, char *argv[]) {
+int as_main(int argc, char *argv[], FILE *ifp) {
   enum {
     OPT_HELP = 128,
     OPT_VERSION,
   };
   static const struct option options[] = {
     {"o", required_argument},  // Specify output filename
+    {"f", required_argument},  // -ftime-report, -fmem-report
     {"-help", no_argument, OPT_HELP},
     {"v", no_argument, OPT_VERSION},
     {"-version", no_argument, OPT_VERSION},
@@ -211,6 +212,10 @@ int main(int argc, char *argv[]) {
     case 'o':
       ofn = optarg;
       break;
+    case 'f':
+      if (!parse_report_option(optarg))
+        fprintf(stderr, "Warning: unknown option: %s\n", argv[optind - 1]);
+      break;
     case '?':
       fprintf(stderr, "Warning: unknown option: %s\n", argv[optind - 1]);
       break;
@@ -221,6 +226,7 @@ int main(int argc, char *argv[]) {
   // ================================================
   // Run own assembler
 
+  reset_parse_asm();
   Table section_infos;
   table_init(&section_infos);
   Table label_table;
@@ -234,26 +240,31 @@ int main(int argc, char *argv[]) {
   if (iarg >= argc)
     error("No input files");
 
+  report_begin("parse");
   for (int i = iarg; i < argc; ++i) {
     const char *filename = argv[i];
     FILE *fp;
     if (strcmp(filename, "-") == 0) {
-      fp = stdin;
+      fp = ifp;
     } else if (!is_file(filename) || (fp = fopen(filename, "r")) == NULL) {
       error("Cannot open %s\n", argv[i]);
     }
 
     info.filename = filename;
     parse_file(fp, &info);
-    fclose(fp);
+    if (fp != ifp)
+      fclose(fp);
     if (info.error_count != 0)
       break;
   }
+  report_end();
 
   if (info.error_count != 0) {
+    report_discard();
     return 1;
   }
 
+  report_begin("layout");
   Vector *sections = sort_sections(&section_infos);
   Vector *unresolved = new_vector();
   bool settle1, settle2;
@@ -266,7 +277,9 @@ int main(int argc, char *argv[]) {
     UnresolvedInfo *u = unresolved->data[i];
     make_label_referred(&label_table, u->label, true);
   }
+  report_end();
 
+  report_begin("emit");
   emit_irs(sections);
 
   fix_section_size(sections, LOAD_ADDRESS);
@@ -281,9 +294,19 @@ int main(int argc, char *argv[]) {
 # define EMIT_OBJ emit_elf_obj
 #endif
   int result = EMIT_OBJ(ofn, sections, &label_table, unresolved);
+  report_end();
   if (result != 0) {
-    if (ofn == NULL && !isatty(STDIN_FILENO))
-      drop_all(stdin);
+    if (ofn == NULL && !isatty(fileno(ifp)))
+      drop_all(ifp);
+    report_discard();
+  } else {
+    report_output("as");
   }
   return result;
 }
+
+#if !defined(XCC_INTEGRATED)
+int main(int argc, char *argv[]) {
+  return as_main(argc, argv, stdin);
+}
+#endif
@@ -575,6 +575,8 @@ int emit_elf_obj(const char *ofn, Vector *sections, Table *label_table, Vector *
   put_padding(ofp, sh_ofs);
   fwrite(section_headers.buf, section_headers.len, 1, ofp);
 
+  if (ofp != stdout)
+    fclose(ofp);
   return 0;
 }
 #endif
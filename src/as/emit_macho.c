@@ -429,6 +429,8 @@ int emit_macho_obj(const char *ofn, Vector *sections, Table *label_table, Vector
   fwrite(symtab.buf, sizeof(*symtab.buf), symtab.count, ofp);
   fwrite(strtab_dump(&symtab.strtab), symtab.strtab.size, 1, ofp);
 
+  if (ofp != stdout)
+    fclose(ofp);
   return 0;
 }
 #endif
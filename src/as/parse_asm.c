@@ -144,7 +144,7 @@ LabelInfo *add_label_table(Table *label_table, const Name *label, SectionInfo *s
   return info;
 }
 
-bool parse_error(ParseInfo *info, const char *message) {
+bool asm_parse_error(ParseInfo *info, const char *message) {
   fprintf(stderr, "%s(%d): %s\n", info->filename, info->lineno, message);
   fprintf(stderr, "%s\n", info->rawline);
   ++info->error_count;
@@ -211,7 +211,7 @@ static const char *get_label_end(ParseInfo *info) {
     for (;;) {
       char c = *p;
       if (c == '\0') {
-        parse_error(info, "String not closed");
+        asm_parse_error(info, "String not closed");
         break;
       }
 
@@ -229,7 +229,7 @@ static const char *get_label_end(ParseInfo *info) {
       int uc = *++q;
       if (ucc > 0) {
         if (!isutf8follow(uc)) {
-          parse_error(info, "Illegal byte sequence");
+          asm_parse_error(info, "Illegal byte sequence");
           return NULL;
         }
         --ucc;
@@ -243,7 +243,7 @@ static const char *get_label_end(ParseInfo *info) {
     p = (const char*)q;
   }
   if (p <= start)
-    parse_error(info, "Empty label");
+    asm_parse_error(info, "Empty label");
   return p;
 }
 
@@ -334,7 +334,7 @@ static Token *read_flonum(ParseInfo *info, int base) {
         break;
     }
     if (q >= next) {
-      parse_error(info, "Hex float literal must have exponent part");
+      asm_parse_error(info, "Hex float literal must have exponent part");
     }
   }
 
@@ -438,7 +438,7 @@ static const Token *match(ParseInfo *info, enum TokenKind kind) {
   return token;
 }
 
-Expr *new_expr(enum ExprKind kind) {
+Expr *asm_new_expr(enum ExprKind kind) {
   Expr *expr = calloc_or_die(sizeof(*expr));
   expr->kind = kind;
   return expr;
@@ -448,14 +448,14 @@ static Expr *prim(ParseInfo *info) {
   Expr *expr = NULL;
   const Token *tok;
   if ((tok = match(info, TK_LABEL)) != NULL) {
-    expr = new_expr(EX_LABEL);
+    expr = asm_new_expr(EX_LABEL);
     expr->label.name = tok->label.name;
   } else if ((tok = match(info, TK_FIXNUM)) != NULL) {
-    expr = new_expr(EX_FIXNUM);
+    expr = asm_new_expr(EX_FIXNUM);
     expr->fixnum = tok->fixnum;
 #ifndef __NO_FLONUM
   } else if ((tok = match(info, TK_FLONUM)) != NULL) {
-    expr = new_expr(EX_FLONUM);
+    expr = asm_new_expr(EX_FLONUM);
     expr->flonum = tok->flonum;
 #endif
   }
@@ -474,7 +474,7 @@ static Expr *unary(ParseInfo *info) {
       return expr;
     default:
       {
-        Expr *op = new_expr(EX_POS);
+        Expr *op = asm_new_expr(EX_POS);
         op->unary.sub = expr;
         return op;
       }
@@ -496,7 +496,7 @@ static Expr *unary(ParseInfo *info) {
 #endif
     default:
       {
-        Expr *op = new_expr(EX_NEG);
+        Expr *op = asm_new_expr(EX_NEG);
         op->unary.sub = expr;
         return op;
       }
@@ -516,7 +516,7 @@ static Expr *parse_mul(ParseInfo *info) {
          (tok = match(info, TK_DIV)) != NULL) {
     Expr *rhs = unary(info);
     if (rhs == NULL) {
-      parse_error(info, "expression error");
+      asm_parse_error(info, "expression error");
       break;
     }
 
@@ -528,7 +528,7 @@ static Expr *parse_mul(ParseInfo *info) {
       default:  assert(false); break;
       }
     } else {
-      expr = new_expr((enum ExprKind)(tok->kind + (EX_MUL - TK_MUL)));  // Assume ExprKind is same order with TokenKind.
+      expr = asm_new_expr((enum ExprKind)(tok->kind + (EX_MUL - TK_MUL)));  // Assume ExprKind is same order with TokenKind.
       expr->bop.lhs = lhs;
       expr->bop.rhs = rhs;
     }
@@ -546,7 +546,7 @@ static Expr *parse_add(ParseInfo *info) {
          (tok = match(info, TK_SUB)) != NULL) {
     Expr *rhs = parse_mul(info);
     if (rhs == NULL) {
-      parse_error(info, "expression error");
+      asm_parse_error(info, "expression error");
       break;
     }
 
@@ -559,7 +559,7 @@ static Expr *parse_add(ParseInfo *info) {
       }
     } else {
       // Assume ExprKind is same order with TokenKind.
-      expr = new_expr((enum ExprKind)(tok->kind + (EX_ADD - TK_ADD)));
+      expr = asm_new_expr((enum ExprKind)(tok->kind + (EX_ADD - TK_ADD)));
       expr->bop.lhs = lhs;
       expr->bop.rhs = rhs;
     }
@@ -567,7 +567,7 @@ static Expr *parse_add(ParseInfo *info) {
   return expr;
 }
 
-Expr *parse_expr(ParseInfo *info) {
+Expr *asm_parse_expr(ParseInfo *info) {
   info->prefetched = NULL;
   return parse_add(info);
 }
@@ -575,16 +575,23 @@ Expr *parse_expr(ParseInfo *info) {
 #define R_NOOP  0
 
 #if XCC_TARGET_ARCH == XCC_ARCH_RISCV64
+static int dummy_label_no;
+
 static const Name *alloc_dummy_label(void) {
   // TODO: Ensure label is unique.
-  static int label_no;
-  ++label_no;
+  ++dummy_label_no;
   char buf[2 + sizeof(int) * 3 + 1];
-  snprintf(buf, sizeof(buf), "._%d", label_no);
+  snprintf(buf, sizeof(buf), "._%d", dummy_label_no);
   return alloc_name(buf, NULL, true);
 }
 #endif
 
+void reset_parse_asm(void) {
+#if XCC_TARGET_ARCH == XCC_ARCH_RISCV64
+  dummy_label_no = 0;
+#endif
+}
+
 static /*enum RawOpcode*/int find_raw_opcode(ParseInfo *info) {
   const char *p = info->p;
   const char *start = p;
@@ -635,7 +642,7 @@ static bool parse_inst(ParseInfo *info, Line *line) {
         if (*info->p != ',') {
           if (candidates[0]->opr_flags[i] == 0)
             break;
-          parse_error(info, "comma expected");
+          asm_parse_error(info, "comma expected");
           return false;  // Error
         }
         info->p = skip_whitespaces(info->p + 1);
@@ -645,7 +652,7 @@ static bool parse_inst(ParseInfo *info, Line *line) {
       const char *before = info->p;
       unsigned int result = parse_operand(info, opr_flags, opr);
       if (result == 0) {
-        parse_error(info, "illegal operand");
+        asm_parse_error(info, "illegal operand");
         info->p = before;
         return false;  // Error
       }
@@ -675,7 +682,7 @@ static bool parse_inst(ParseInfo *info, Line *line) {
           line->label = label;
         }
         if (inst.opr[2].type == NOOPERAND) {
-          Expr *expr = new_expr(EX_LABEL);
+          Expr *expr = asm_new_expr(EX_LABEL);
           expr->label.name = line->label;
 
           Operand *opr = &inst.opr[2];
@@ -728,7 +735,7 @@ static char unescape_char(ParseInfo *info) {
   case 'v':  return '\v';
 
   default:
-    parse_error(info, "Illegal escape");
+    asm_parse_error(info, "Illegal escape");
     // Fallthrough
   case '\'': case '"': case '\\':
     return c;
@@ -740,7 +747,7 @@ static size_t unescape_string(ParseInfo *info, char *dst) {
   for (; *info->p != '"'; ++info->p, ++len) {
     char c = *info->p;
     if (c == '\0')
-      parse_error(info, "string not closed");
+      asm_parse_error(info, "string not closed");
     if (c == '\\') {
       ++info->p;
       c = unescape_char(info);
@@ -773,7 +780,7 @@ static uint32_t parse_section_flag(ParseInfo *info) {
   uint32_t flag = 0;
   char *flag_str = parse_string(info);
   if (flag_str == NULL) {
-    parse_error(info, ".section: flag string expected");
+    asm_parse_error(info, ".section: flag string expected");
   } else {
     for (char *p = flag_str; *p != '\0'; ++p) {
       switch (*p) {
@@ -781,7 +788,7 @@ static uint32_t parse_section_flag(ParseInfo *info) {
       case 'w':  flag |= SF_WRITABLE; break;
       case 'x':  flag |= SF_EXECUTABLE; break;
       default:
-        parse_error(info, ".section: illegal flag character");
+        asm_parse_error(info, ".section: illegal flag character");
         break;
       }
     }
@@ -801,7 +808,7 @@ static bool handle_directive(ParseInfo *info, enum DirectiveType dir) {
   case DT_STRING:
     {
       if (*info->p != '"')
-        return parse_error(info, "`\"' expected");
+        return asm_parse_error(info, "`\"' expected");
       ++info->p;
       const char *p = info->p;
       size_t len = unescape_string(info, NULL);
@@ -819,14 +826,14 @@ static bool handle_directive(ParseInfo *info, enum DirectiveType dir) {
     {
       const Name *name = parse_label(info);
       if (name == NULL)
-        return parse_error(info, ".comm: label expected");
+        return asm_parse_error(info, ".comm: label expected");
       info->p = skip_whitespaces(info->p);
       if (*info->p != ',')
-        return parse_error(info, ".comm: `,' expected");
+        return asm_parse_error(info, ".comm: `,' expected");
       info->p = skip_whitespaces(info->p + 1);
       int64_t size;
       if (!immediate(&info->p, &size) || size <= 0)
-        return parse_error(info, ".comm: size expected");
+        return asm_parse_error(info, ".comm: size expected");
 
       int64_t align = 0;
       if (*info->p == ',') {
@@ -838,7 +845,7 @@ static bool handle_directive(ParseInfo *info, enum DirectiveType dir) {
             align < 1
 #endif
         ) {
-          return parse_error(info, ".comm: optional alignment expected");
+          return asm_parse_error(info, ".comm: optional alignment expected");
         }
 #if XCC_TARGET_PLATFORM == XCC_PLATFORM_APPLE
         // p2align on macOS.
@@ -866,7 +873,7 @@ static bool handle_directive(ParseInfo *info, enum DirectiveType dir) {
     {
       int64_t num;
       if (!immediate(&info->p, &num))
-        return parse_error(info, ".zero: number expected");
+        return asm_parse_error(info, ".zero: number expected");
       vec_push(irs, new_ir_zero(num));
     }
     break;
@@ -887,7 +894,7 @@ static bool handle_directive(ParseInfo *info, enum DirectiveType dir) {
     {
       int64_t align;
       if (!immediate(&info->p, &align))
-        return parse_error(info, ".align: number expected");
+        return asm_parse_error(info, ".align: number expected");
       vec_push(irs, new_ir_align(align));
     }
     break;
@@ -895,7 +902,7 @@ static bool handle_directive(ParseInfo *info, enum DirectiveType dir) {
     {
       int64_t align;
       if (!immediate(&info->p, &align))
-        return parse_error(info, ".align: number expected");
+        return asm_parse_error(info, ".align: number expected");
       vec_push(irs, new_ir_align(1 << align));
     }
     break;
@@ -904,9 +911,9 @@ static bool handle_directive(ParseInfo *info, enum DirectiveType dir) {
     {
       const Name *name = parse_label(info);
       if (name == NULL)
-        return parse_error(info, ".type: label expected");
+        return asm_parse_error(info, ".type: label expected");
       if (*info->p != ',')
-        return parse_error(info, ".type: `,' expected");
+        return asm_parse_error(info, ".type: `,' expected");
       info->p = skip_whitespaces(info->p + 1);
       enum LabelKind kind = LK_NONE;
       if (strcmp(info->p, "@function") == 0) {
@@ -916,7 +923,7 @@ static bool handle_directive(ParseInfo *info, enum DirectiveType dir) {
         kind = LK_OBJECT;
         info->p += 7;
       } else {
-        return parse_error(info, "illegal .type");
+        return asm_parse_error(info, "illegal .type");
       }
 
       LabelInfo *label = add_label_table(info->label_table, name, section, false, false);
@@ -931,9 +938,9 @@ static bool handle_directive(ParseInfo *info, enum DirectiveType dir) {
   case DT_LONG:
   case DT_QUAD:
     {
-      Expr *expr = parse_expr(info);
+      Expr *expr = asm_parse_expr(info);
       if (expr == NULL)
-        return parse_error(info, "expression expected");
+        return asm_parse_error(info, "expression expected");
 
       assert(expr->kind != EX_FLONUM);
       if (expr->kind == EX_FIXNUM) {
@@ -954,9 +961,9 @@ static bool handle_directive(ParseInfo *info, enum DirectiveType dir) {
   case DT_FLOAT:
   case DT_DOUBLE:
     {
-      Expr *expr = parse_expr(info);
+      Expr *expr = asm_parse_expr(info);
       if (expr == NULL)
-        return parse_error(info, "expression expected");
+        return asm_parse_error(info, "expression expected");
 
       Flonum value;
       switch (expr->kind) {
@@ -994,7 +1001,7 @@ static bool handle_directive(ParseInfo *info, enum DirectiveType dir) {
       if (name == NULL) {
         char buf[32];
         snprintf(buf, sizeof(buf), "%s: label expected", dir == DT_GLOBL ? ".globl" : ".local");
-        return parse_error(info, buf);
+        return asm_parse_error(info, buf);
       }
 
       LabelInfo *label = add_label_table(info->label_table, name, section, false, dir == DT_GLOBL);
@@ -1011,7 +1018,7 @@ static bool handle_directive(ParseInfo *info, enum DirectiveType dir) {
     {
       const Name *name = parse_section_name(info);
       if (name == NULL)
-        return parse_error(info, ".section: section name expected");
+        return asm_parse_error(info, ".section: section name expected");
 #if XCC_TARGET_PLATFORM != XCC_PLATFORM_APPLE
       int flag = 0;
       const char *p = skip_whitespaces(info->p);
@@ -1025,11 +1032,11 @@ static bool handle_directive(ParseInfo *info, enum DirectiveType dir) {
 #else
       const char *p = skip_whitespaces(info->p);
       if (*p != ',')
-        return parse_error(info, "`,' expected");
+        return asm_parse_error(info, "`,' expected");
       info->p = skip_whitespaces(p + 1);
       const Name *name2 = parse_section_name(info);
       if (name2 == NULL)
-        return parse_error(info, ".section: section name expected");
+        return asm_parse_error(info, ".section: section name expected");
 
       int flag = 0;
       p = skip_whitespaces(info->p);
@@ -1044,7 +1051,7 @@ static bool handle_directive(ParseInfo *info, enum DirectiveType dir) {
           }
         }
         if (flag == 0)
-          return parse_error(info, ".section: section name expected");
+          return asm_parse_error(info, ".section: section name expected");
       }
 
       char *segname = strndup(name->chars, name->bytes);
@@ -1080,13 +1087,13 @@ bool parse_line(Line *line, ParseInfo *info) {
   if (*r == ':') {
     const Name *label = unquote_label(p, q);
     if (label == NULL)
-      return parse_error(info, "Illegal label");
+      return asm_parse_error(info, "Illegal label");
     line->label = label;
     info->p = p = skip_whitespaces(r + 1);
   } else if (*p == '.') {
     enum DirectiveType dir = find_directive(p + 1, q - p - 1);
     if (dir == NODIRECTIVE) {
-      parse_error(info, "Unknown directive");
+      asm_parse_error(info, "Unknown directive");
       return false;
     }
     line->dir = dir;
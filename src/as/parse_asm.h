@@ -144,9 +144,10 @@ typedef struct Expr {
   };
 } Expr;
 
+void reset_parse_asm(void);  // Clear the states left by the previous run.
 bool parse_line(Line *line, ParseInfo *info);
 void parse_set_p(ParseInfo *info, const char *p);
-bool parse_error(ParseInfo *info, const char *message);
+bool asm_parse_error(ParseInfo *info, const char *message);
 
 typedef struct {
   /*enum Opcode*/ int op;
@@ -165,8 +166,8 @@ unsigned int parse_operand(ParseInfo *info, unsigned int opr_flag, Operand *oper
 
 bool immediate(const char **pp, int64_t *value);
 const Name *unquote_label(const char *p, const char *q);
-Expr *parse_expr(ParseInfo *info);
-Expr *new_expr(enum ExprKind kind);
+Expr *asm_parse_expr(ParseInfo *info);
+Expr *asm_new_expr(enum ExprKind kind);
 
 typedef struct {
   const Name *label;
@@ -888,7 +888,7 @@ static void ei_tjmp(IR *ir) {
 
   assert(ir->opr2 != NULL);
   const char *dst = kRegSizeTable[3][ir->opr2->phys];
-  const Name *table_label = alloc_label();
+  const Name *table_label = alloc_emit_label();
   char *label = fmt_name(table_label);
   ADRP(dst, LABEL_AT_PAGE(label, 0));
   ADD(dst, dst, LABEL_AT_PAGEOFF(label, 0));
@@ -858,7 +858,7 @@ static void ei_tjmp(IR *ir) {
   assert(!(ir->opr1->flag & VRF_CONST));
   assert(ir->opr2 != NULL);
   const char *opr2 = kReg64s[ir->opr2->phys];
-  const Name *table_label = alloc_label();
+  const Name *table_label = alloc_emit_label();
   char *label = fmt_name(table_label);
   LA(opr2, label);
   // dst = label + (opr1 << 3)
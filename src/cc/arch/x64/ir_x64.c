@@ -608,7 +608,7 @@ static void ei_neg(IR *ir) {
     case SZ_DOUBLE:
       {
         bool single = opr1->vsize == SZ_FLOAT;
-        const Name *signbit_label = alloc_label();
+        const Name *signbit_label = alloc_emit_label();
         const char *dreg = kFReg64s[dst->phys];
         // TODO: MOVSD(LABEL_INDIRECT(fmt_name(signbit_label), 0, RIP), dreg);
         PUSH(RAX);
@@ -694,8 +694,8 @@ static void ei_cast(IR *ir) {
       } else {
         // x64 support signed 64bit-signed-int to double only, so pass half value
         // (precision is lost anyway).
-        const Name *neglabel = alloc_label();
-        const Name *skiplabel = alloc_label();
+        const Name *neglabel = alloc_emit_label();
+        const Name *skiplabel = alloc_emit_label();
         TEST(s, s);
         JS(fmt_name(neglabel));
         switch (ir->dst->vsize) {
@@ -817,7 +817,7 @@ static void ei_cond(IR *ir) {
         if (cond == COND_EQ)  SETNP(dst);
         else                  SETP(dst);
 
-        const Name *skip_label = alloc_label();
+        const Name *skip_label = alloc_emit_label();
         cmp_vregs(opr1, opr2, cond);
         JE(fmt_name(skip_label));
         MOV(IM(cond != COND_EQ ? 1 : 0), dst);
@@ -869,7 +869,7 @@ static void ei_jmp(IR *ir) {
     switch (cond) {
     case COND_EQ:
       {
-        const Name *skip_label = alloc_label();
+        const Name *skip_label = alloc_emit_label();
         cmp_vregs(ir->opr1, ir->opr2, cond);
         JP(fmt_name(skip_label));
         JE(label);
@@ -942,7 +942,7 @@ static void ei_tjmp(IR *ir) {
   assert(ir->opr2 != NULL);
   const char *opr2 = kReg64s[ir->opr2->phys];
 
-  const Name *table_label = alloc_label();
+  const Name *table_label = alloc_emit_label();
   LEA(LABEL_INDIRECT(fmt_name(table_label), 0, RIP), opr2);
   JMP(fmt("*%s", OFFSET_INDIRECT(0, opr2, kReg64s[phys], 8)));
 
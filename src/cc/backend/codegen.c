@@ -5,7 +5,7 @@
 #include <inttypes.h>
 #include <limits.h>  // CHAR_BIT
 #include <stdbool.h>
-#include <stdlib.h>  // qsort
+#include <stdlib.h>  // free, qsort
 #include <string.h>
 
 #include "ast.h"
@@ -56,6 +56,11 @@ static BB *push_break_bb(BB **save) {
   return bb;
 }
 
+void reset_codegen(void) {
+  s_break_bb = s_continue_bb = NULL;
+  curbb = NULL;
+}
+
 static inline VarInfo *prepare_retvar(Function *func) {
   // Insert vreg for return value pointer into top of the function scope.
   Type *rettype = func->type->func.ret;
@@ -100,7 +105,7 @@ static void alloc_variable_registers(Function *func) {
       }
 #endif
       if (!is_prim_type(type)) {
-        FrameInfo *fi = calloc_or_die(sizeof(*fi));
+        FrameInfo *fi = arena_alloc(func_arena, sizeof(*fi));
         fi->size = type_size(type);
         fi->offset = 0;
         varinfo->local.frameinfo = fi;
@@ -927,6 +932,7 @@ bool gen_defun(Function *func) {
   curfunc = func;
   static_vars = func->static_vars;
   FuncBackend *fnbe = func->extra = calloc_or_die(sizeof(FuncBackend));
+  func_arena = &fnbe->arena;
   fnbe->ra = NULL;
   fnbe->bbcon = NULL;
   fnbe->ret_bb = NULL;
@@ -968,16 +974,21 @@ bool gen_defun(Function *func) {
   curfunc = NULL;
   static_vars = NULL;
   curra = NULL;
+  func_arena = NULL;
   return true;
 }
 
-static inline void gen_defun_after(Function *func) {
+void gen_defun_after(Function *func) {
   FuncBackend *fnbe = func->extra;
   curfunc = func;
   curra = fnbe->ra;
+  func_arena = &fnbe->arena;
 
+  report_begin("optimize");
   optimize(fnbe->ra, fnbe->bbcon);
+  report_end();
 
+  report_begin("regalloc");
   prepare_register_allocation(func);
   tweak_irs(fnbe);
   analyze_reg_flow(fnbe->bbcon);
@@ -987,36 +998,35 @@ static inline void gen_defun_after(Function *func) {
   detect_living_registers(fnbe->ra, fnbe->bbcon);
 
   alloc_stack_variables_onto_stack_frame(func);
+  report_end();
 
   curfunc = NULL;
   curra = NULL;
+  func_arena = NULL;
 }
 
-static void gen_decl(Declaration *decl) {
-  if (decl == NULL)
-    return;
-
-  switch (decl->kind) {
-  case DCL_DEFUN:
-    {
-      Function *func = decl->defun.func;
-      if (gen_defun(func))
-        gen_defun_after(func);
-    }
-    break;
-  case DCL_ASM:
-    break;
-  }
-}
-
-void gen(Vector *decls) {
-  if (decls == NULL)
+void release_defun(Function *func) {
+  FuncBackend *fnbe = func->extra;
+  if (fnbe == NULL)
     return;
 
-  for (int i = 0, len = decls->len; i < len; ++i) {
-    Declaration *decl = decls->data[i];
-    if (decl == NULL)
-      continue;
-    gen_decl(decl);
+  // Vectors are allocated on heap, and objects holding them are in the arena.
+  BBContainer *bbcon = fnbe->bbcon;
+  for (int i = 0; i < bbcon->len; ++i) {
+    BB *bb = bbcon->data[i];
+    free_vector(bb->from_bbs);
+    free_vector(bb->irs);
+    free_vector(bb->in_regs);
+    free_vector(bb->out_regs);
+    free_vector(bb->assigned_regs);
   }
+  free_vector(bbcon);
+  free_vector(fnbe->ra->vregs);
+  free_vector(fnbe->ra->consts);
+  if (fnbe->funcalls != NULL)
+    free_vector(fnbe->funcalls);
+
+  arena_release(&fnbe->arena);
+  free(fnbe);
+  func->extra = NULL;
 }
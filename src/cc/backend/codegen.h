@@ -19,7 +19,12 @@ typedef struct Vector Vector;
 
 // Public
 
-void gen(Vector *decls);
+void reset_codegen(void);  // Clear the states left by the previous run.
+
+// Each function is generated, emitted and released in turn.
+bool gen_defun(Function *func);
+void gen_defun_after(Function *func);  // Optimize and allocate registers.
+void release_defun(Function *func);  // Free backend data, after its code is emitted.
 
 // Private
 
@@ -55,7 +60,6 @@ typedef struct {
 
 int enumerate_register_params(Function *func, const int max_reg[2], RegParamInfo *args);
 
-bool gen_defun(Function *func);
 void prepare_register_allocation(Function *func);
 void map_virtual_to_physical_registers(RegAlloc *ra);
 void detect_living_registers(RegAlloc *ra, BBContainer *bbcon);
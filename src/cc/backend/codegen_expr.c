@@ -523,7 +523,7 @@ static inline void gen_funargs(Expr *expr, FuncallWork *work) {
     const Token *token = alloc_dummy_ident();
     Type *type = expr->type;
     ret_varinfo = scope_add(curscope, token, type, 0);
-    FrameInfo *fi = calloc_or_die(sizeof(*fi));
+    FrameInfo *fi = arena_alloc(func_arena, sizeof(*fi));
     fi->size = type_size(type);
     fi->offset = 0;
     ret_varinfo->local.frameinfo = fi;
@@ -579,7 +579,7 @@ static inline VReg *gen_funcall_sub(Expr *expr, FuncallWork *work) {
       global = !(varinfo->storage & VS_STATIC);
   }
 
-  IrCallInfo *callinfo = calloc_or_die(sizeof(*callinfo));
+  IrCallInfo *callinfo = arena_alloc(func_arena, sizeof(*callinfo));
   callinfo->stack_args_size = work->offset;
   callinfo->arg_count = arg_count - stack_arg_count;
   callinfo->living_pregs = 0;
@@ -614,7 +614,7 @@ static inline VReg *gen_funcall_sub(Expr *expr, FuncallWork *work) {
                 work->arg_vregs, vaarg_start);
   IR *call = new_ir_call(callinfo, dst, freg);
 
-  FuncallInfo *funcall_info = calloc_or_die(sizeof(*funcall_info));
+  FuncallInfo *funcall_info = arena_alloc(func_arena, sizeof(*funcall_info));
   funcall_info->call = call;
   assert(expr->funcall.info == NULL);
   expr->funcall.info = funcall_info;
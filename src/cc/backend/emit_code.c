@@ -10,6 +10,7 @@
 #include "ast.h"
 #include "be_aux.h"
 #include "cc_misc.h"
+#include "codegen.h"
 #include "fe_misc.h"
 #include "ir.h"
 #include "regalloc.h"
@@ -504,28 +505,35 @@ static inline void emit_const_floats(Function *func) {
 }
 
 static void emit_defun(Function *func) {
-  bool emit = !(func->scopes == NULL ||  // Prototype definition.
-                func->extra == NULL);    // Code emission is omitted.
-
+  // Generate and emit the function at once, and release its backend data,
+  // so that only one function holds it at a time.
+  report_begin("gen");
+  bool emit = gen_defun(func);  // False: Prototype definition, or code emission is omitted.
+  report_end();
   if (emit) {
+    gen_defun_after(func);
+
+    report_begin("emit");
     emit_defun_body(func);
     emit_const_floats(func);
+    release_defun(func);
+    report_end();
   }
 
   VarInfo *funcvi = scope_find(global_scope, func->ident->ident, NULL);
   assert(funcvi != NULL);
-  if (emit || (funcvi->storage & VS_USED)) {
+  Vector *vars = func->static_vars;
+  if ((emit || (funcvi->storage & VS_USED)) && vars != NULL && vars->len > 0) {
     // Static inline function is not emitted, but it must output its static variables.
     // Static variables.
-    Vector *vars = func->static_vars;
-    if (vars != NULL && vars->len > 0) {
-      emit_comment(NULL);
-      for (int i = 0; i < vars->len; ++i) {
-        VarInfo *varinfo = vars->data[i];
-        assert(!((varinfo->storage & (VS_EXTERN | VS_ENUM_MEMBER)) || varinfo->type->kind == TY_FUNC));
-        emit_varinfo(varinfo, varinfo->global.init);
-      }
+    report_begin("emit");
+    emit_comment(NULL);
+    for (int i = 0; i < vars->len; ++i) {
+      VarInfo *varinfo = vars->data[i];
+      assert(!((varinfo->storage & (VS_EXTERN | VS_ENUM_MEMBER)) || varinfo->type->kind == TY_FUNC));
+      emit_varinfo(varinfo, varinfo->global.init);
     }
+    report_end();
   }
 }
 
@@ -540,11 +548,14 @@ void emit_code(Vector *decls) {
       emit_defun(decl->defun.func);
       break;
     case DCL_ASM:
+      report_begin("emit");
       emit_asm(decl->asm_.asm_);
+      report_end();
       break;
     }
   }
 
+  report_begin("emit");
   emit_decls_ctor_dtor(decls);
 
   emit_comment(NULL);
@@ -561,4 +572,5 @@ void emit_code(Vector *decls) {
 #if XCC_TARGET_PLATFORM == XCC_PLATFORM_APPLE
   _SUBSECTIONS_VIA_SYMBOLS();
 #endif
+  report_end();
 }
@@ -3,6 +3,7 @@
 
 #include <assert.h>
 #include <stdlib.h>  // malloc
+#include <string.h>  // memcpy
 
 #include "regalloc.h"
 #include "table.h"
@@ -12,7 +13,7 @@ static const enum VRegSize vtVoidPtr = VRegSize8;
 static const enum VRegSize vtBool = VRegSize4;
 
 Phi *new_phi(VReg *dst, Vector *params) {
-  Phi *phi = malloc_or_die(sizeof(*phi));
+  Phi *phi = arena_alloc(func_arena, sizeof(*phi));
   phi->dst = dst;
   phi->params = params;
   return phi;
@@ -43,11 +44,12 @@ void spill_vreg(VReg *vreg) {
 
 //
 RegAlloc *curra;
+Arena *func_arena;
 
 // Intermediate Representation
 
 static IR *new_ir(enum IrKind kind) {
-  IR *ir = calloc_or_die(sizeof(*ir));
+  IR *ir = arena_alloc(func_arena, sizeof(*ir));
   ir->kind = kind;
   ir->flag = 0;
   ir->dst = ir->opr1 = ir->opr2 = NULL;
@@ -392,7 +394,7 @@ IR *new_ir_store_spilled(VReg *dst, VReg *vreg) {
 BB *curbb;
 
 BB *new_bb(void) {
-  BB *bb = malloc_or_die(sizeof(*bb));
+  BB *bb = arena_alloc(func_arena, sizeof(*bb));
   bb->next = NULL;
   bb->from_bbs = new_vector();
   bb->label = alloc_label();
@@ -401,6 +403,8 @@ BB *new_bb(void) {
   bb->out_regs = new_vector();
   bb->assigned_regs = new_vector();
   bb->phis = NULL;
+  bb->idom = NULL;
+  bb->rpo = -1;
   return bb;
 }
 
@@ -464,40 +468,198 @@ void detect_from_bbs(BBContainer *bbcon) {
   } while (unchecked.len > 0);
 }
 
-static bool insert_vreg_into_vec(Vector *vregs, VReg *vreg) {
-  int lo = -1, hi = vregs->len;
-  while (hi - lo > 1) {
-    int m = lo + (hi - lo) / 2;
-    VReg *mid = vregs->data[m];
-    if      (mid->virt < vreg->virt)  lo = m;
-    else if (mid->virt > vreg->virt)  hi = m;
-    else                              return false;
+BB *bb_successor(BB *bb, int index) {
+  Vector *irs = bb->irs;
+  if (irs->len > 0) {
+    IR *ir = irs->data[irs->len - 1];  // JMP must be the last IR.
+    switch (ir->kind) {
+    case IR_JMP:
+      if (index == 0)
+        return ir->jmp.bb;
+      if (ir->jmp.cond == COND_ANY)
+        return NULL;  // Next BB is not reachable.
+      --index;
+      break;
+    case IR_TJMP:
+      return (size_t)index < ir->tjmp.len ? ir->tjmp.bbs[index] : NULL;
+    default: break;
+    }
   }
-  assert(0 <= hi && hi <= vregs->len);
-  assert(hi == vregs->len || ((VReg*)vregs->data[hi])->virt != vreg->virt);
-  vec_insert(vregs, hi, vreg);
-  return true;
+  return index == 0 ? bb->next : NULL;
 }
 
-static void propagate_out_regs(VReg *vreg, Vector *froms) {
-  for (BB *bb; (bb = vec_pop(froms)) != NULL; ) {
-    insert_vreg_into_vec(bb->out_regs, vreg);
-    if (vec_contains(bb->assigned_regs, vreg) ||
-        !insert_vreg_into_vec(bb->in_regs, vreg))
-      continue;
-    vec_concat(froms, bb->from_bbs);
+static BB *intersect_dominators(BB *bb1, BB *bb2) {
+  while (bb1 != bb2) {
+    while (bb1->rpo > bb2->rpo)
+      bb1 = bb1->idom;
+    while (bb2->rpo > bb1->rpo)
+      bb2 = bb2->idom;
+  }
+  return bb1;
+}
+
+// Sets `rpo` for each BB, and returns reachable BBs in reverse postorder.
+Vector *order_bbs(BBContainer *bbcon) {
+  for (int i = 0; i < bbcon->len; ++i) {
+    BB *bb = bbcon->data[i];
+    bb->rpo = -1;
+  }
+
+  // Depth first search for postorder, `rpo` is used as visited mark temporarily.
+  Vector *order = new_vector();
+  Vector stack;  // <BB*>, with next successor index in `rpo`.
+  vec_init(&stack);
+  BB *entry = bbcon->data[0];
+  entry->rpo = 0;
+  vec_push(&stack, entry);
+  while (stack.len > 0) {
+    BB *bb = stack.data[stack.len - 1];
+    BB *succ = bb_successor(bb, bb->rpo++);
+    if (succ == NULL) {
+      vec_pop(&stack);
+      vec_push(order, bb);
+    } else if (succ->rpo < 0) {
+      succ->rpo = 0;
+      vec_push(&stack, succ);
+    }
+  }
+  free(stack.data);
+
+  // Reverse.
+  int n = order->len;
+  for (int i = 0; i < n / 2; ++i) {
+    void *tmp = order->data[i];
+    order->data[i] = order->data[n - 1 - i];
+    order->data[n - 1 - i] = tmp;
+  }
+  for (int i = 0; i < n; ++i) {
+    BB *bb = order->data[i];
+    bb->rpo = i;
   }
+  return order;
 }
 
+// Cooper, Harvey and Kennedy, "A Simple, Fast Dominance Algorithm".
+Vector *analyze_dominators(BBContainer *bbcon) {
+  for (int i = 0; i < bbcon->len; ++i) {
+    BB *bb = bbcon->data[i];
+    bb->idom = NULL;
+  }
+
+  Vector *order = order_bbs(bbcon);
+  int n = order->len;
+  BB *entry = bbcon->data[0];
+  assert(entry->rpo == 0);
+  entry->idom = entry;
+  for (bool changed = true; changed; ) {
+    changed = false;
+    for (int i = 1; i < n; ++i) {
+      BB *bb = order->data[i];
+      BB *idom = NULL;
+      for (int j = 0; j < bb->from_bbs->len; ++j) {
+        BB *from = bb->from_bbs->data[j];
+        if (from->idom != NULL)
+          idom = idom == NULL ? from : intersect_dominators(from, idom);
+      }
+      if (idom != bb->idom) {
+        bb->idom = idom;
+        changed = true;
+      }
+    }
+  }
+  entry->idom = NULL;
+  return order;
+}
+
+bool dominates(BB *dominator, BB *bb) {
+  for (; bb != NULL; bb = bb->idom) {
+    if (bb == dominator)
+      return true;
+  }
+  return false;
+}
+
+// Dense bit set, indexed by `virt`.
+typedef uint64_t BitWord;
+#define BITWORD_BITS  (64)
+
+static inline void bits_set(BitWord *bits, int index) {
+  bits[index / BITWORD_BITS] |= (BitWord)1 << (index % BITWORD_BITS);
+}
+
+static inline bool bits_test(const BitWord *bits, int index) {
+  return (bits[index / BITWORD_BITS] >> (index % BITWORD_BITS)) & 1;
+}
+
+static void bits_to_vregs(const BitWord *bits, int nwords, VReg **vregs, Vector *dst) {
+  vec_clear(dst);
+  for (int i = 0; i < nwords; ++i) {
+    int index = i * BITWORD_BITS;
+    for (BitWord w = bits[i]; w != 0; w >>= 1, ++index) {
+      if (w & 1)
+        vec_push(dst, vregs[index]);
+    }
+  }
+}
+
+static void register_vreg(Vector *vregs, VReg *vreg) {
+  if (vreg == NULL || vreg->flag & VRF_CONST)
+    return;
+  while (vregs->len <= vreg->virt)
+    vec_push(vregs, NULL);
+  vregs->data[vreg->virt] = vreg;
+}
+
+// Liveness by iterative dataflow on bit sets, in postorder.
+// Results are stored into `in_regs`, `out_regs` and `assigned_regs` of each BB, sorted by `virt`.
 void analyze_reg_flow(BBContainer *bbcon) {
-  // Enumerate in and assigned regsiters for each BB.
+  Vector vregs;  // <VReg*>, indexed by `virt`.
+  vec_init(&vregs);
+  for (int i = 0; i < bbcon->len; ++i) {
+    BB *bb = bbcon->data[i];
+    Vector *phis = bb->phis;
+    if (phis != NULL) {
+      for (int j = 0; j < phis->len; ++j) {
+        Phi *phi = phis->data[j];
+        register_vreg(&vregs, phi->dst);
+        for (int k = 0; k < phi->params->len; ++k)
+          register_vreg(&vregs, phi->params->data[k]);
+      }
+    }
+    for (int j = 0; j < bb->irs->len; ++j) {
+      IR *ir = bb->irs->data[j];
+      register_vreg(&vregs, ir->dst);
+      register_vreg(&vregs, ir->opr1);
+      register_vreg(&vregs, ir->opr2);
+      Vector *additional = ir->additional_operands;
+      if (additional != NULL) {
+        for (int k = 0; k < additional->len; ++k)
+          register_vreg(&vregs, additional->data[k]);
+      }
+    }
+  }
+
+  // Reachable BBs come first in reverse postorder, then unreachable ones.
+  Vector *order = order_bbs(bbcon);
+  int reachable_count = order->len;
   for (int i = 0; i < bbcon->len; ++i) {
     BB *bb = bbcon->data[i];
-    Vector *in_regs = bb->in_regs;
-    Vector *assigned_regs = bb->assigned_regs;
-    vec_clear(in_regs);
-    vec_clear(assigned_regs);
-    vec_clear(bb->out_regs);
+    if (bb->rpo < 0)
+      vec_push(order, bb);
+  }
+
+  int n = order->len;
+  int nwords = (vregs.len + BITWORD_BITS - 1) / BITWORD_BITS;
+  BitWord *bits = calloc_or_die(sizeof(*bits) * nwords * n * 4);
+#define USE_BITS(i)  (&bits[((i) * 4 + 0) * nwords])
+#define DEF_BITS(i)  (&bits[((i) * 4 + 1) * nwords])
+#define IN_BITS(i)   (&bits[((i) * 4 + 2) * nwords])
+#define OUT_BITS(i)  (&bits[((i) * 4 + 3) * nwords])
+
+  // Enumerate upward exposed (used) and assigned registers for each BB.
+  for (int i = 0; i < n; ++i) {
+    BB *bb = order->data[i];
+    BitWord *use = USE_BITS(i), *def = DEF_BITS(i);
 
     Vector *phis = bb->phis;
     if (phis != NULL) {
@@ -508,45 +670,176 @@ void analyze_reg_flow(BBContainer *bbcon) {
           assert(vreg != NULL);
           if (vreg->flag & VRF_CONST)
             continue;
-          assert(!vec_contains(assigned_regs, vreg));
-          insert_vreg_into_vec(in_regs, vreg);
+          assert(!bits_test(def, vreg->virt));
+          bits_set(use, vreg->virt);
         }
-        insert_vreg_into_vec(assigned_regs, phi->dst);
+        bits_set(def, phi->dst->virt);
       }
     }
 
     Vector *irs = bb->irs;
     for (int j = 0; j < irs->len; ++j) {
       IR *ir = irs->data[j];
-      VReg *vregs[] = {ir->opr1, ir->opr2};
-      const int N = ARRAY_SIZE(vregs);
-      int n = N;
+      VReg *operands[] = {ir->opr1, ir->opr2};
+      const int N = ARRAY_SIZE(operands);
+      int m = N;
       Vector *additional = ir->additional_operands;
       if (additional != NULL)
-        n += additional->len;
-      for (int k = 0; k < n; ++k) {
-        VReg *vreg = k < N ? vregs[k] : additional->data[k - N];
+        m += additional->len;
+      for (int k = 0; k < m; ++k) {
+        VReg *vreg = k < N ? operands[k] : additional->data[k - N];
         if (vreg == NULL || vreg->flag & VRF_CONST)
           continue;
-        if (!vec_contains(assigned_regs, vreg))
-          insert_vreg_into_vec(in_regs, vreg);
+        if (!bits_test(def, vreg->virt))
+          bits_set(use, vreg->virt);
       }
       if (ir->dst != NULL)
-        insert_vreg_into_vec(assigned_regs, ir->dst);
+        bits_set(def, ir->dst->virt);
     }
+    memcpy(IN_BITS(i), use, sizeof(*bits) * nwords);
   }
 
-  // Propagate in_regs to out_regs to from_bbs recursively.
-  Vector *dstbbs = new_vector();
-  for (int i = bbcon->len; --i >= 0; ) {
+  // in = use | (out & ~def), and out of predecessors |= in, until nothing changes.
+  for (bool changed = true; changed; ) {
+    changed = false;
+    for (int i = reachable_count; --i >= 0; ) {
+      BB *bb = order->data[i];
+      BitWord *use = USE_BITS(i), *def = DEF_BITS(i), *in = IN_BITS(i), *out = OUT_BITS(i);
+      for (int w = 0; w < nwords; ++w) {
+        BitWord x = use[w] | (out[w] & ~def[w]);
+        if (x != in[w]) {
+          in[w] = x;
+          changed = true;
+        }
+      }
+      for (int j = 0; j < bb->from_bbs->len; ++j) {
+        BB *from = bb->from_bbs->data[j];
+        assert(from->rpo >= 0);
+        BitWord *fout = OUT_BITS(from->rpo);
+        for (int w = 0; w < nwords; ++w) {
+          BitWord x = fout[w] | in[w];
+          if (x != fout[w]) {
+            fout[w] = x;
+            changed = true;
+          }
+        }
+      }
+    }
+  }
+
+  // Adapter for vreg lists.
+  VReg **vregarray = (VReg**)vregs.data;
+  for (int i = 0; i < n; ++i) {
+    BB *bb = order->data[i];
+    bits_to_vregs(IN_BITS(i), nwords, vregarray, bb->in_regs);
+    bits_to_vregs(OUT_BITS(i), nwords, vregarray, bb->out_regs);
+    bits_to_vregs(DEF_BITS(i), nwords, vregarray, bb->assigned_regs);
+  }
+#undef USE_BITS
+#undef DEF_BITS
+#undef IN_BITS
+#undef OUT_BITS
+
+  free(bits);
+  free_vector(order);
+  free(vregs.data);
+}
+
+// Def-use chains
+
+static DefUseSite *add_site(DefUse *du, BB *bb, IR *ir, Phi *phi, VReg *dst) {
+  DefUseSite *site = &du->sites[du->site_count++];
+  site->bb = bb;
+  site->ir = ir;
+  site->phi = phi;
+  site->next_def = NULL;
+  site->queued = false;
+  if (dst != NULL) {
+    assert(dst->virt < du->vreg_count);
+    site->next_def = du->defs[dst->virt];
+    du->defs[dst->virt] = site;
+  }
+  return site;
+}
+
+static void add_use(DefUse *du, VReg *vreg, DefUseSite *site) {
+  if (vreg == NULL || vreg->flag & VRF_CONST)
+    return;
+  assert(vreg->virt < du->vreg_count);
+  DefUseLink *link = &du->links[du->link_count++];
+  link->site = site;
+  link->next = du->uses[vreg->virt];
+  du->uses[vreg->virt] = link;
+}
+
+// Collects definitions and uses of registers, in linear time of IRs.
+// Arguments of IR_CALL are also counted as uses.
+void build_def_use(BBContainer *bbcon, int vreg_count, DefUse *du) {
+  // Count sites, and operands as upper bound of links.
+  int site_count = 0, link_count = 0;
+  for (int i = 0; i < bbcon->len; ++i) {
     BB *bb = bbcon->data[i];
-    Vector *from_bbs = bb->from_bbs;
-    Vector *in_regs = bb->in_regs;
-    for (int j = 0; j < in_regs->len; ++j) {
-      assert(dstbbs->len == 0);
-      vec_concat(dstbbs, from_bbs);
-      VReg *vreg = in_regs->data[j];
-      propagate_out_regs(vreg, dstbbs);
+    Vector *phis = bb->phis;
+    if (phis != NULL) {
+      site_count += phis->len;
+      for (int j = 0; j < phis->len; ++j) {
+        Phi *phi = phis->data[j];
+        link_count += phi->params->len;
+      }
+    }
+    site_count += bb->irs->len;
+    for (int j = 0; j < bb->irs->len; ++j) {
+      IR *ir = bb->irs->data[j];
+      link_count += 2;
+      if (ir->additional_operands != NULL)
+        link_count += ir->additional_operands->len;
+      if (ir->kind == IR_CALL)
+        link_count += ir->call->total_arg_count;
+    }
+  }
+  du->defs = calloc_or_die(sizeof(*du->defs) * vreg_count);
+  du->uses = calloc_or_die(sizeof(*du->uses) * vreg_count);
+  du->sites = malloc_or_die(sizeof(*du->sites) * site_count);
+  du->links = malloc_or_die(sizeof(*du->links) * link_count);
+  du->site_count = du->link_count = 0;
+  du->vreg_count = vreg_count;
+
+  for (int i = 0; i < bbcon->len; ++i) {
+    BB *bb = bbcon->data[i];
+    Vector *phis = bb->phis;
+    if (phis != NULL) {
+      for (int j = 0; j < phis->len; ++j) {
+        Phi *phi = phis->data[j];
+        DefUseSite *site = add_site(du, bb, NULL, phi, phi->dst);
+        for (int k = 0; k < phi->params->len; ++k)
+          add_use(du, phi->params->data[k], site);
+      }
+    }
+
+    for (int j = 0; j < bb->irs->len; ++j) {
+      IR *ir = bb->irs->data[j];
+      DefUseSite *site = add_site(du, bb, ir, NULL, ir->dst);
+      add_use(du, ir->opr1, site);
+      add_use(du, ir->opr2, site);
+      Vector *additional = ir->additional_operands;
+      if (additional != NULL) {
+        for (int k = 0; k < additional->len; ++k)
+          add_use(du, additional->data[k], site);
+      }
+      if (ir->kind == IR_CALL) {
+        VReg **args = ir->call->args;
+        for (int k = 0, n = ir->call->total_arg_count; k < n; ++k)
+          add_use(du, args[k], site);
+      }
     }
   }
+  assert(du->site_count == site_count);
+  assert(du->link_count <= link_count);
+}
+
+void free_def_use(DefUse *du) {
+  free(du->links);
+  free(du->sites);
+  free(du->uses);
+  free(du->defs);
 }
@@ -6,6 +6,8 @@
 #include <stddef.h>  // size_t
 #include <stdint.h>  // int64_t
 
+#include "util.h"  // Arena
+
 typedef struct BB BB;
 typedef struct Name Name;
 typedef struct RegAlloc RegAlloc;
@@ -239,6 +241,9 @@ IR *new_ir_store_spilled(VReg *dst, VReg *vreg);
 
 extern RegAlloc *curra;
 
+// Arena for the function being generated: IRs, BBs, VRegs and register allocation data.
+extern Arena *func_arena;
+
 // Basci Block:
 //   Chunk of IR codes without branching in the middle (except at the bottom).
 
@@ -252,6 +257,10 @@ typedef struct BB {
   Vector *out_regs;  // <VReg*>
   Vector *assigned_regs;  // <VReg*>
   Vector *phis;
+
+  // Set by `analyze_dominators`, valid until the control flow changes.
+  struct BB *idom;  // Immediate dominator, NULL for the entry and unreachable BBs.
+  int rpo;          // Index in reverse postorder, -1 for unreachable. Set by `order_bbs`, too.
 } BB;
 
 extern BB *curbb;
@@ -264,6 +273,38 @@ typedef struct Vector BBContainer;  // <BB*>
 BBContainer *new_func_blocks(void);
 void detect_from_bbs(BBContainer *bbcon);
 void analyze_reg_flow(BBContainer *bbcon);
+BB *bb_successor(BB *bb, int index);  // NULL if `index` is out of range.
+Vector *order_bbs(BBContainer *bbcon);  // Returns reachable BBs in reverse postorder.
+Vector *analyze_dominators(BBContainer *bbcon);  // Returns reachable BBs in reverse postorder.
+bool dominates(BB *dominator, BB *bb);
+
+// Def-use chains
+
+typedef struct DefUseSite {
+  BB *bb;
+  IR *ir;    // Either `ir` or `phi` is set, both are NULL if removed.
+  Phi *phi;
+  struct DefUseSite *next_def;  // Another definition of the same register (non SSA).
+  bool queued;  // For worklist.
+} DefUseSite;
+
+typedef struct DefUseLink {
+  DefUseSite *site;
+  struct DefUseLink *next;
+} DefUseLink;
+
+typedef struct {
+  DefUseSite **defs;  // [vreg_count]: Definitions, linked with `next_def`.
+  DefUseLink **uses;  // [vreg_count]: A link for each operand, NULL if unused.
+  DefUseSite *sites;  // [site_count]: All phis and IRs, in order.
+  DefUseLink *links;  // [link_count]: Storage for `uses`.
+  int site_count;
+  int link_count;
+  int vreg_count;
+} DefUse;
+
+void build_def_use(BBContainer *bbcon, int vreg_count, DefUse *du);
+void free_def_use(DefUse *du);
 
 void emit_bb_irs(BBContainer *bbcon);
 
@@ -287,4 +328,5 @@ typedef struct FuncBackend {
   FrameInfo vaarg_frame_info;  // Used for va_start.
   size_t stack_work_size;
   VReg *stack_work_size_vreg;
+  Arena arena;  // Released after the code is emitted.
 } FuncBackend;
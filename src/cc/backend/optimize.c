@@ -2,8 +2,8 @@
 #include "optimize.h"
 
 #include <assert.h>
-#include <limits.h>
 #include <stdlib.h>  // free
+#include <string.h>  // strcmp
 
 #include "ir.h"
 #include "regalloc.h"
@@ -12,7 +12,6 @@
 #include "util.h"
 
 bool keep_phi;
-bool apply_ssa;
 
 static IR *is_last_jmp(BB *bb) {
   int len;
@@ -122,147 +121,114 @@ static void remove_unnecessary_bb(BBContainer *bbcon) {
 
 //
 
+static void unuse_vreg(VReg *vreg, int *use_counts, Vector *worklist) {
+  if (vreg == NULL || vreg->flag & VRF_CONST || --use_counts[vreg->virt] > 0)
+    return;
+  // Must keep function parameter and `&` taken one.
+  if (!(vreg->flag & (VRF_PARAM | VRF_REF))) {
+    vreg->flag |= VRF_UNUSED;
+    vec_push(worklist, vreg);
+  }
+}
+
 static void remove_unused_vregs(RegAlloc *ra, BBContainer *bbcon) {
   int vreg_count = ra->vregs->len;
-  unsigned char *vreg_read = malloc_or_die(vreg_count);
-  for (;;) {
-    for (int i = 0; i < vreg_count; ++i) {
-      VReg *vreg = ra->vregs->data[i];
-      // Must keep function parameter and `&` taken one.
-      vreg_read[i] = vreg != NULL && (vreg->flag & (VRF_PARAM | VRF_REF)) != 0;
+  DefUse du;
+  build_def_use(bbcon, vreg_count, &du);
+
+  // Registers without any use are removed together with their definitions,
+  // and the operands of those definitions are revisited.
+  int *use_counts = malloc_or_die(sizeof(*use_counts) * vreg_count);
+  Vector worklist;  // <VReg*>
+  vec_init(&worklist);
+  for (int i = 0; i < vreg_count; ++i) {
+    VReg *vreg = ra->vregs->data[i];
+    int count = 0;
+    for (DefUseLink *link = du.uses[i]; link != NULL; link = link->next)
+      ++count;
+    use_counts[i] = count;
+    if (vreg != NULL && use_counts[i] == 0 && !(vreg->flag & (VRF_PARAM | VRF_REF))) {
+      vreg->flag |= VRF_UNUSED;
+      vec_push(&worklist, vreg);
     }
+  }
 
-    // Check VReg usage.
-    for (int i = 0; i < bbcon->len; ++i) {
-      BB *bb = bbcon->data[i];
-      Vector *phis = bb->phis;
-      if (phis != NULL) {
-        for (int j = 0; j < phis->len; ++j) {
-          Phi *phi = phis->data[j];
-          for (int k = 0; k < phi->params->len; ++k) {
-            VReg *vreg = phi->params->data[k];
-            assert(vreg != NULL);
-            if (!(vreg->flag & VRF_CONST))
-              vreg_read[vreg->virt] = true;
-          }
-        }
+  while (worklist.len > 0) {
+    VReg *vreg = vec_pop(&worklist);
+    for (DefUseSite *site = du.defs[vreg->virt]; site != NULL; site = site->next_def) {
+      Phi *phi = site->phi;
+      if (phi != NULL) {
+        for (int i = 0; i < phi->params->len; ++i)
+          unuse_vreg(phi->params->data[i], use_counts, &worklist);
+        continue;
       }
 
-      for (int j = 0; j < bb->irs->len; ++j) {
-        IR *ir = bb->irs->data[j];
-        VReg *operands[] = {ir->opr1, ir->opr2};
-        const int N = ARRAY_SIZE(operands);
-        int n = N;
-        Vector *additional = ir->additional_operands;
-        if (additional != NULL)
-          n += additional->len;
-        for (int k = 0; k < n; ++k) {
-          VReg *vreg = k < N ? operands[k] : additional->data[k - N];
-          if (vreg != NULL && !(vreg->flag & VRF_CONST))
-            vreg_read[vreg->virt] = true;
-        }
+      IR *ir = site->ir;
+      if (ir->kind == IR_CALL) {
+        // Function must be CALLed even if the result is unused.
+        ir->dst = NULL;
+        continue;
+      }
+      unuse_vreg(ir->opr1, use_counts, &worklist);
+      unuse_vreg(ir->opr2, use_counts, &worklist);
+      Vector *additional = ir->additional_operands;
+      if (additional != NULL) {
+        for (int i = 0; i < additional->len; ++i)
+          unuse_vreg(additional->data[i], use_counts, &worklist);
       }
     }
+  }
 
-    // Remove instruction if the destination is unread.
-    for (int i = 0; i < bbcon->len; ++i) {
-      BB *bb = bbcon->data[i];
-      Vector *phis = bb->phis;
-      if (phis != NULL) {
-        for (int j = 0; j < phis->len; ++j) {
-          Phi *phi = phis->data[j];
-          if (vreg_read[phi->dst->virt])
-            continue;
-          vec_remove_at(phis, j);
-          --j;
-        }
+  // Remove instruction if the destination is unused.
+  for (int i = 0; i < bbcon->len; ++i) {
+    BB *bb = bbcon->data[i];
+    Vector *phis = bb->phis;
+    if (phis != NULL) {
+      int n = 0;
+      for (int j = 0; j < phis->len; ++j) {
+        Phi *phi = phis->data[j];
+        if (!(phi->dst->flag & VRF_UNUSED))
+          phis->data[n++] = phi;
       }
+      phis->len = n;
+    }
 
-      for (int j = 0; j < bb->irs->len; ++j) {
-        IR *ir = bb->irs->data[j];
-        if (ir->dst == NULL || vreg_read[ir->dst->virt])
-          continue;
-        if (ir->kind == IR_CALL) {
-          // Function must be CALLed even if the result is unused.
-          ir->dst = NULL;
-        } else {
-          vec_remove_at(bb->irs, j);
-          --j;
-        }
-      }
+    Vector *irs = bb->irs;
+    int n = 0;
+    for (int j = 0; j < irs->len; ++j) {
+      IR *ir = irs->data[j];
+      if (ir->dst == NULL || !(ir->dst->flag & VRF_UNUSED))
+        irs->data[n++] = ir;
     }
+    irs->len = n;
+  }
 
-    // Mark unused VRegs.
-    bool again = false;
-    for (int i = 0; i < vreg_count; ++i) {
-      VReg *vreg;
-      if (!vreg_read[i] && (vreg = ra->vregs->data[i]) != NULL) {
-        ra->vregs->data[i] = NULL;
-        if (vreg->original != vreg) {
-          assert(vreg->original->virt < ra->original_vreg_count);
-          Vector *vt = ra->vreg_table[vreg->original->virt];
-          int j;
-          for (j = 0; j < vt->len; ++j) {
-            if (vt->data[j] == vreg)
-              break;
-          }
-          assert(j < vt->len);
-          vec_remove_at(vt, j);
-        }
-        vreg->flag |= VRF_UNUSED;
-        again = true;
+  // Mark unused VRegs.
+  for (int i = 0; i < vreg_count; ++i) {
+    VReg *vreg = ra->vregs->data[i];
+    if (vreg != NULL && vreg->flag & VRF_UNUSED)
+      ra->vregs->data[i] = NULL;
+  }
+  if (ra->vreg_table != NULL) {
+    for (int i = 0; i < ra->original_vreg_count; ++i) {
+      Vector *vt = ra->vreg_table[i];
+      int n = 0;
+      for (int j = 0; j < vt->len; ++j) {
+        VReg *vreg = vt->data[j];
+        if (!(vreg->flag & VRF_UNUSED) || vreg->original == vreg)
+          vt->data[n++] = vreg;
       }
+      vt->len = n;
     }
-    if (!again)
-      break;
   }
 
-  free(vreg_read);
+  free(worklist.data);
+  free(use_counts);
+  free_def_use(&du);
 }
 
 //
 
-static int replace_register_in_bb(BB *bb, VReg *target, VReg *alternation, int start, int ip) {
-  int first = INT_MAX;
-  for (int iir = start; iir < bb->irs->len; ++iir, ++ip) {
-    IR *ir = bb->irs->data[iir];
-
-    if (ir->opr1 == target) {
-      ir->opr1 = alternation;
-      first = MIN(first, ip);
-    }
-    if (ir->opr2 == target) {
-      ir->opr2 = alternation;
-      first = MIN(first, ip);
-    }
-
-    Vector *additional = ir->additional_operands;
-    if (additional != NULL) {
-      for (int i = 0; i < additional->len; ++i) {
-        VReg *vreg = additional->data[i];
-        if (vreg == target)
-          additional->data[i] = alternation;
-      }
-    }
-
-    if (ir->kind == IR_CALL) {
-      int n = ir->call->total_arg_count;
-      VReg **operands = ir->call->args;
-      for (int i = 0; i < n; ++i) {
-        VReg *opr = operands[i];
-        if (opr == target) {
-          operands[i] = alternation;
-          first = MIN(first, ip);
-        }
-      }
-    }
-
-    if (ir->dst == alternation || (ir->dst == target && ir->opr1 != alternation))
-      break;
-  }
-  return first;
-}
-
 static bool calc_const_cond(enum ConditionKind cond, VReg *opr1, VReg *opr2) {
   assert(opr1->flag & VRF_CONST);
   assert(opr2->flag & VRF_CONST);
@@ -621,100 +587,550 @@ static void peephole(RegAlloc *ra, BB *bb) {
 
 // Depends on SSA.
 
-static int replace_register(BBContainer *bbcon, VReg *target, VReg *alternation) {
-  if (target->flag & (VRF_FORCEMEMORY | VRF_VOLATILEREG) ||
-      alternation->flag & (VRF_FORCEMEMORY | VRF_VOLATILEREG))
-    return INT_MAX;
+static void replace_register_at(DefUseSite *site, VReg *target, VReg *alternation) {
+  Phi *phi = site->phi;
+  if (phi != NULL) {
+    for (int i = 0; i < phi->params->len; ++i) {
+      if (phi->params->data[i] == target)
+        phi->params->data[i] = alternation;
+    }
+    return;
+  }
 
-  int first = INT_MAX;
-  int ip = 0;
-  for (int ibb = 0; ibb < bbcon->len; ++ibb) {
-    BB *bb = bbcon->data[ibb];
+  IR *ir = site->ir;
+  if (ir->opr1 == target)
+    ir->opr1 = alternation;
+  if (ir->opr2 == target)
+    ir->opr2 = alternation;
+
+  Vector *additional = ir->additional_operands;
+  if (additional != NULL) {
+    for (int i = 0; i < additional->len; ++i) {
+      if (additional->data[i] == target)
+        additional->data[i] = alternation;
+    }
+  }
 
-    Vector *phis = bb->phis;
-    if (phis != NULL) {
-      for (int iphi = 0; iphi < phis->len; ++iphi) {
-        Phi *phi = phis->data[iphi];
-        for (int i = 0; i < phi->params->len; ++i) {
-          VReg *opr = phi->params->data[i];
-          if (opr == target) {
-            phi->params->data[i] = alternation;
-            first = MIN(first, ip);
-          }
-        }
-      }
+  if (ir->kind == IR_CALL) {
+    int n = ir->call->total_arg_count;
+    VReg **operands = ir->call->args;
+    for (int i = 0; i < n; ++i) {
+      if (operands[i] == target)
+        operands[i] = alternation;
     }
+  }
+}
 
-    int at = replace_register_in_bb(bb, target, alternation, 0, ip);
-    first = MIN(first, at);
-    ip += bb->irs->len;
+static void push_site(Vector *worklist, DefUseSite *site) {
+  if (!site->queued) {
+    site->queued = true;
+    vec_push(worklist, site);
   }
-  return first;
 }
 
+// Replaces all uses of `target` with `alternation`, and puts them into the worklist.
+static bool replace_register(DefUse *du, VReg *target, VReg *alternation, Vector *worklist) {
+  if (target->flag & (VRF_FORCEMEMORY | VRF_VOLATILEREG) ||
+      alternation->flag & (VRF_FORCEMEMORY | VRF_VOLATILEREG) ||
+      target == alternation)
+    return false;
+
+  DefUseLink *uses = du->uses[target->virt];
+  if (uses == NULL)
+    return true;
+  du->uses[target->virt] = NULL;
+
+  DefUseLink *tail = NULL;
+  for (DefUseLink *link = uses; link != NULL; link = link->next) {
+    DefUseSite *site = link->site;
+    tail = link;
+    if (site->ir == NULL && site->phi == NULL)  // Removed.
+      continue;
+    replace_register_at(site, target, alternation);
+    push_site(worklist, site);
+  }
+  if (!(alternation->flag & VRF_CONST)) {
+    // Uses of `target` become uses of `alternation`.
+    tail->next = du->uses[alternation->virt];
+    du->uses[alternation->virt] = uses;
+  }
+  return true;
+}
+
+// Returns the value if all parameters are same, except the phi itself.
+static VReg *trivial_phi_value(Phi *phi) {
+  VReg *value = NULL;
+  for (int i = 0; i < phi->params->len; ++i) {
+    VReg *vreg = phi->params->data[i];
+    if (vreg == phi->dst || vreg == value)
+      continue;
+    if (value != NULL)
+      return NULL;
+    value = vreg;
+  }
+  return value;
+}
+
+// Copy and constant propagation on def-use chains:
+// A site is revisited only when its operand is replaced.
 static void copy_propagation(RegAlloc *ra, BBContainer *bbcon) {
-  bool again;
-  do {
-    again = false;
-    int ip = 0;
-    for (int ibb = 0; ibb < bbcon->len; ++ibb) {
-      BB *bb = bbcon->data[ibb];
-      if (bb->from_bbs->len == 0 && ibb > 0)
+  DefUse du;
+  build_def_use(bbcon, ra->vregs->len, &du);
+
+  Vector worklist;  // <DefUseSite*>
+  vec_init(&worklist);
+  for (int i = du.site_count; --i >= 0; )  // Reversed, to pop in order.
+    push_site(&worklist, &du.sites[i]);
+
+  bool phi_removed = false;
+  while (worklist.len > 0) {
+    DefUseSite *site = vec_pop(&worklist);
+    site->queued = false;
+
+    Phi *phi = site->phi;
+    if (phi != NULL) {
+      VReg *value = trivial_phi_value(phi);
+      if (value == NULL)
         continue;
+      VReg *dst = phi->dst;
+      phi->dst = NULL;  // Mark to remove.
+      site->phi = NULL;
+      phi_removed = true;
+      if (!replace_register(&du, dst, value, &worklist)) {
+        IR *ir = new_ir_mov(dst, value, 0);
+        vec_insert(site->bb->irs, 0, ir);
+      }
+      continue;
+    }
+
+    IR *ir = site->ir;
+    if (ir == NULL)
+      continue;
+    if (constant_folding(ra, ir)) {
+      if (ir->kind == IR_JMP && ir->jmp.cond == COND_NONE) {
+        Vector *irs = site->bb->irs;
+        assert(irs->len > 0 && irs->data[irs->len - 1] == ir);
+        vec_pop(irs);
+        site->ir = NULL;
+        continue;
+      }
+    }
+
+    switch (ir->kind) {
+    case IR_RESULT:
+      // Inlined function call uses RESULT with `dst`.
+      if (ir->dst == NULL)
+        break;
+      // Fallthrough
+    case IR_MOV:
+      if (ir->dst->flag & VRF_VOLATILE)
+        break;
+      replace_register(&du, ir->dst, ir->opr1, &worklist);
+      break;
+    default: break;
+    }
+  }
 
+  if (phi_removed) {
+    for (int i = 0; i < bbcon->len; ++i) {
+      BB *bb = bbcon->data[i];
       Vector *phis = bb->phis;
-      if (phis != NULL) {
-        for (int iphi = 0; iphi < phis->len; ++iphi) {
-          Phi *phi = phis->data[iphi];
-          int n = phi->params->len;
-          assert(n > 0);
-          VReg *dst = phi->dst;
-          VReg *value = phi->params->data[0];
-          int i;
-          for (i = 1; i < n; ++i) {
-            VReg *vreg = phi->params->data[i];
-            if (vreg != value && vreg != dst)
-              break;
-          }
-          if (i >= n) {  // All values are same.
-            IR *ir = new_ir_mov(dst, value, 0);
-            vec_insert(bb->irs, 0, ir);
-            vec_remove_at(phis, iphi--);
-          }
-        }
+      if (phis == NULL)
+        continue;
+      int n = 0;
+      for (int j = 0; j < phis->len; ++j) {
+        Phi *phi = phis->data[j];
+        if (phi->dst != NULL)
+          phis->data[n++] = phi;
       }
+      phis->len = n;
+    }
+  }
 
-      for (int iir = 0; iir < bb->irs->len; ++iir, ++ip) {
-        IR *ir = bb->irs->data[iir];
-        if (constant_folding(ra, ir)) {
-          if (ir->kind == IR_JMP && ir->jmp.cond == COND_NONE) {
-            vec_remove_at(bb->irs, iir);
-            --iir;
-            --ip;
-            continue;
-          }
-        }
+  free(worklist.data);
+  free_def_use(&du);
+}
 
-        switch (ir->kind) {
-        case IR_RESULT:
-          // Inlined function call uses RESULT with `dst`.
-          if (ir->dst == NULL)
-            break;
-          // Fallthrough
-        case IR_MOV:
-          if (ir->dst->flag & VRF_VOLATILE)
-            break;
-          if (replace_register(bbcon, ir->dst, ir->opr1) < ip)  // Former instruction is replaced:
-            again = true;  // Try again.
-          break;
-        default: break;
+// Sparse conditional constant propagation (Wegman-Zadeck)
+
+typedef struct {
+  RegAlloc *ra;
+  DefUse du;
+  // Lattice value for each register: NULL for undefined yet (top), constant,
+  // or the register itself for non constant (bottom).
+  VReg **values;      // [vreg_count]
+  bool *executable;   // [rpo]
+  int *site_starts;   // [rpo]: Index of the first site of BB in `du.sites`.
+  int *edge_starts;   // [rpo]: Index in `edges` for `from_bbs` of BB.
+  bool *edges;        // Whether the edge from `from_bbs` is executable.
+  Vector bb_worklist;    // <BB*>
+  Vector site_worklist;  // <DefUseSite*>
+} Sccp;
+
+static bool same_const(VReg *vreg1, VReg *vreg2) {
+  assert(vreg1->flag & VRF_CONST);
+  assert(vreg2->flag & VRF_CONST);
+  if (vreg1->vsize != vreg2->vsize || ((vreg1->flag ^ vreg2->flag) & VRF_FLONUM))
+    return false;
+#ifndef __NO_FLONUM
+  if (vreg1->flag & VRF_FLONUM)
+    return memcmp(&vreg1->flonum.value, &vreg2->flonum.value, sizeof(double)) == 0;
+#endif
+  return vreg1->fixnum == vreg2->fixnum;
+}
+
+static inline VReg *sccp_value(Sccp *sccp, VReg *vreg) {
+  return vreg->flag & VRF_CONST ? vreg : sccp->values[vreg->virt];
+}
+
+static void sccp_lower(Sccp *sccp, VReg *vreg, VReg *value) {
+  VReg *old = sccp->values[vreg->virt];
+  if (value == NULL || old == vreg)
+    return;
+  if (!(value->flag & VRF_CONST))
+    value = vreg;
+  if (old != NULL) {
+    if (value != vreg && same_const(old, value))
+      return;
+    value = vreg;
+  }
+  sccp->values[vreg->virt] = value;
+
+  for (DefUseLink *link = sccp->du.uses[vreg->virt]; link != NULL; link = link->next) {
+    DefUseSite *site = link->site;
+    if (site->bb->rpo >= 0 && sccp->executable[site->bb->rpo])
+      push_site(&sccp->site_worklist, site);
+  }
+}
+
+static void sccp_mark_edge(Sccp *sccp, BB *from, BB *to) {
+  assert(to->rpo >= 0);
+  bool *edges = &sccp->edges[sccp->edge_starts[to->rpo]];
+  bool found = false, changed = false;
+  for (int i = 0; i < to->from_bbs->len; ++i) {
+    if (to->from_bbs->data[i] == from) {
+      found = true;
+      if (!edges[i])
+        edges[i] = changed = true;
+    }
+  }
+  assert(found);
+  UNUSED(found);
+  if (!changed)
+    return;
+
+  if (!sccp->executable[to->rpo]) {
+    sccp->executable[to->rpo] = true;
+    vec_push(&sccp->bb_worklist, to);
+  } else if (to->phis != NULL) {
+    // Phis see the new edge.
+    DefUseSite *sites = &sccp->du.sites[sccp->site_starts[to->rpo]];
+    for (int i = 0; i < to->phis->len; ++i)
+      push_site(&sccp->site_worklist, &sites[i]);
+  }
+}
+
+static void sccp_visit_branch(Sccp *sccp, BB *bb, IR *ir) {
+  if (ir != NULL) {
+    if (ir->kind == IR_JMP && ir->jmp.cond != COND_ANY) {
+      VReg *opr1 = sccp_value(sccp, ir->opr1), *opr2 = sccp_value(sccp, ir->opr2);
+      if (opr1 != NULL && opr2 != NULL && (opr1->flag & opr2->flag & VRF_CONST)) {
+        bool taken = calc_const_cond(ir->jmp.cond, opr1, opr2);
+        sccp_mark_edge(sccp, bb, taken ? ir->jmp.bb : bb->next);
+        return;
+      }
+    } else if (ir->kind == IR_TJMP) {
+      VReg *opr1 = sccp_value(sccp, ir->opr1);
+      if (opr1 != NULL && opr1->flag & VRF_CONST && (uint64_t)opr1->fixnum < ir->tjmp.len) {
+        sccp_mark_edge(sccp, bb, ir->tjmp.bbs[opr1->fixnum]);
+        return;
+      }
+    }
+  }
+  // Undefined condition is also taken as non constant, not to lose a branch.
+  BB *succ;
+  for (int i = 0; (succ = bb_successor(bb, i)) != NULL; ++i)
+    sccp_mark_edge(sccp, bb, succ);
+}
+
+static VReg *sccp_eval(Sccp *sccp, IR *ir) {
+  switch (ir->kind) {
+  case IR_MOV:
+  case IR_RESULT:
+    return sccp_value(sccp, ir->opr1);
+
+  case IR_ADD: case IR_SUB: case IR_MUL: case IR_DIV: case IR_MOD:
+  case IR_BITAND: case IR_BITOR: case IR_BITXOR: case IR_LSHIFT: case IR_RSHIFT:
+  case IR_COND: case IR_NEG: case IR_BITNOT: case IR_CAST:
+    {
+      VReg *opr1 = sccp_value(sccp, ir->opr1);
+      VReg *opr2 = ir->opr2 != NULL ? sccp_value(sccp, ir->opr2) : NULL;
+      if (opr1 == NULL || (ir->opr2 != NULL && opr2 == NULL))
+        return NULL;
+      if (!(opr1->flag & VRF_CONST) || (opr2 != NULL && !(opr2->flag & VRF_CONST)))
+        break;
+      // Fold on a copy.
+      IR tmp = *ir;
+      tmp.opr1 = opr1;
+      tmp.opr2 = opr2;
+      if (constant_folding(sccp->ra, &tmp) && tmp.kind == IR_MOV)
+        return tmp.opr1;
+    }
+    break;
+  default: break;
+  }
+  return ir->dst;
+}
+
+static void sccp_visit(Sccp *sccp, DefUseSite *site) {
+  Phi *phi = site->phi;
+  if (phi != NULL) {
+    // Meet of parameters through executable edges.
+    bool *edges = &sccp->edges[sccp->edge_starts[site->bb->rpo]];
+    VReg *value = NULL;
+    for (int i = 0; i < phi->params->len; ++i) {
+      VReg *param;
+      if (!edges[i] || (param = sccp_value(sccp, phi->params->data[i])) == NULL)
+        continue;
+      if (!(param->flag & VRF_CONST) || (value != NULL && !same_const(value, param))) {
+        value = phi->dst;
+        break;
+      }
+      value = param;
+    }
+    sccp_lower(sccp, phi->dst, value);
+    return;
+  }
+
+  IR *ir = site->ir;
+  if (ir->kind == IR_JMP || ir->kind == IR_TJMP)
+    sccp_visit_branch(sccp, site->bb, ir);
+  else if (ir->dst != NULL)
+    sccp_lower(sccp, ir->dst, sccp_eval(sccp, ir));
+}
+
+static void sccp_visit_bb(Sccp *sccp, BB *bb) {
+  DefUseSite *sites = &sccp->du.sites[sccp->site_starts[bb->rpo]];
+  int n = bb->irs->len + (bb->phis != NULL ? bb->phis->len : 0);
+  for (int i = 0; i < n; ++i)
+    sccp_visit(sccp, &sites[i]);
+
+  IR *last = bb->irs->len > 0 ? bb->irs->data[bb->irs->len - 1] : NULL;
+  if (last == NULL || (last->kind != IR_JMP && last->kind != IR_TJMP))
+    sccp_visit_branch(sccp, bb, NULL);
+}
+
+// Rewrites the function with the result: Replaces constant registers, folds branches,
+// and deletes unreachable BBs and edges.
+static void sccp_rewrite(Sccp *sccp, BBContainer *bbcon) {
+  RegAlloc *ra = sccp->ra;
+  for (int i = 0; i < sccp->du.vreg_count; ++i) {
+    VReg *value = sccp->values[i];
+    if (value == NULL || !(value->flag & VRF_CONST))
+      continue;
+    VReg *vreg = ra->vregs->data[i];
+    for (DefUseLink *link = sccp->du.uses[i]; link != NULL; link = link->next) {
+      DefUseSite *site = link->site;
+      replace_register_at(site, vreg, value);
+      if (site->bb->rpo >= 0 && sccp->executable[site->bb->rpo])
+        value->flag &= ~VRF_UNUSED;
+    }
+  }
+
+  BB *prev = NULL;
+  int n = 0;
+  for (int i = 0; i < bbcon->len; ++i) {
+    BB *bb = bbcon->data[i];
+    if (bb->rpo < 0 || !sccp->executable[bb->rpo]) {
+      assert(prev != NULL);
+      prev->next = bb->next;
+      continue;
+    }
+    bbcon->data[n++] = prev = bb;
+
+    Vector *irs = bb->irs;
+    IR *ir;
+    if (irs->len > 0 && ((ir = irs->data[irs->len - 1])->kind == IR_JMP || ir->kind == IR_TJMP) &&
+        constant_folding(ra, ir) && ir->kind == IR_JMP && ir->jmp.cond == COND_NONE)
+      vec_pop(irs);
+
+    // Remove edges never executed, together with the phi parameters.
+    bool *edges = &sccp->edges[sccp->edge_starts[bb->rpo]];
+    Vector *from_bbs = bb->from_bbs;
+    Vector *phis = bb->phis;
+    int m = 0;
+    for (int j = 0; j < from_bbs->len; ++j) {
+      if (!edges[j])
+        continue;
+      from_bbs->data[m] = from_bbs->data[j];
+      if (phis != NULL) {
+        for (int k = 0; k < phis->len; ++k) {
+          Phi *phi = phis->data[k];
+          phi->params->data[m] = phi->params->data[j];
         }
       }
+      ++m;
     }
-  } while (again);
+    from_bbs->len = m;
+    if (phis != NULL) {
+      for (int k = 0; k < phis->len; ++k) {
+        Phi *phi = phis->data[k];
+        phi->params->len = m;
+      }
+    }
+  }
+  bbcon->len = n;
 }
 
-//
+static void sccp(RegAlloc *ra, BBContainer *bbcon) {
+  Vector *order = order_bbs(bbcon);
+  int nbbs = order->len;
+  int vreg_count = ra->vregs->len;
+  int const_count = ra->consts->len;
+
+  Sccp sccp;
+  sccp.ra = ra;
+  build_def_use(bbcon, vreg_count, &sccp.du);
+  sccp.values = malloc_or_die(sizeof(*sccp.values) * vreg_count);
+  sccp.executable = calloc_or_die(sizeof(*sccp.executable) * nbbs);
+  sccp.site_starts = calloc_or_die(sizeof(*sccp.site_starts) * nbbs);
+  sccp.edge_starts = malloc_or_die(sizeof(*sccp.edge_starts) * nbbs);
+  vec_init(&sccp.bb_worklist);
+  vec_init(&sccp.site_worklist);
+
+  // Registers defined once in SSA form are tracked, others are non constant.
+  for (int i = 0; i < vreg_count; ++i) {
+    VReg *vreg = ra->vregs->data[i];
+    DefUseSite *def = sccp.du.defs[i];
+    bool tracked = vreg != NULL &&
+                   !(vreg->flag & (VRF_PARAM | VRF_FORCEMEMORY | VRF_VOLATILEREG)) &&
+                   def != NULL && def->next_def == NULL;
+    sccp.values[i] = tracked ? NULL : vreg;
+  }
+
+  int edge_count = 0;
+  for (int i = 0; i < nbbs; ++i) {
+    BB *bb = order->data[i];
+    sccp.edge_starts[i] = edge_count;
+    edge_count += bb->from_bbs->len;
+  }
+  sccp.edges = calloc_or_die(sizeof(*sccp.edges) * (edge_count + 1));
+  for (int i = 0; i < sccp.du.site_count; ++i) {
+    DefUseSite *site = &sccp.du.sites[i];
+    BB *bb = site->bb;
+    if (bb->rpo >= 0 && (i == 0 || site[-1].bb != bb))
+      sccp.site_starts[bb->rpo] = i;
+  }
+
+  BB *entry = bbcon->data[0];
+  assert(entry->rpo == 0);
+  sccp.executable[0] = true;
+  vec_push(&sccp.bb_worklist, entry);
+  for (;;) {
+    if (sccp.site_worklist.len > 0) {
+      DefUseSite *site = vec_pop(&sccp.site_worklist);
+      site->queued = false;
+      sccp_visit(&sccp, site);
+    } else if (sccp.bb_worklist.len > 0) {
+      sccp_visit_bb(&sccp, vec_pop(&sccp.bb_worklist));
+    } else {
+      break;
+    }
+  }
+
+  // Constants spawned in evaluation are dropped unless used, not to emit unused floats.
+  Vector *consts = ra->consts;
+  for (int i = const_count; i < consts->len; ++i) {
+    VReg *vreg = consts->data[i];
+    vreg->flag |= VRF_UNUSED;
+  }
+  sccp_rewrite(&sccp, bbcon);
+  int n = const_count;
+  for (int i = const_count; i < consts->len; ++i) {
+    VReg *vreg = consts->data[i];
+    if (!(vreg->flag & VRF_UNUSED))
+      consts->data[n++] = vreg;
+  }
+  consts->len = n;
+
+  free(sccp.site_worklist.data);
+  free(sccp.bb_worklist.data);
+  free(sccp.edges);
+  free(sccp.edge_starts);
+  free(sccp.site_starts);
+  free(sccp.executable);
+  free(sccp.values);
+  free_def_use(&sccp.du);
+  free_vector(order);
+}
+
+// Pass manager
+
+static void peephole_bbs(RegAlloc *ra, BBContainer *bbcon) {
+  for (int i = 0; i < bbcon->len; ++i) {
+    BB *bb = bbcon->data[i];
+    peephole(ra, bb);
+  }
+}
+
+static void simplify_cfg(RegAlloc *ra, BBContainer *bbcon) {
+  UNUSED(ra);
+  remove_unnecessary_bb(bbcon);
+}
+
+enum {
+  PF_SSA = 1 << 0,        // Works on SSA form: Skipped if SSA is not built.
+  PF_SSA_BEGIN = 1 << 1,  // Builds SSA form.
+  PF_SSA_END = 1 << 2,    // Resolves phis: Skipped if `keep_phi`.
+  PF_NO_PHI = 1 << 3,     // Cannot handle phis.
+};
+
+typedef struct {
+  const char *name;  // For `-f<name>`, `-fno-<name>` and report.
+  void (*run)(RegAlloc *ra, BBContainer *bbcon);
+  int level;         // Enabled at this optimization level or above.
+  int flag;
+  const char *stat;  // Number of removed IRs is reported with this name, if not NULL.
+} OptPass;
+
+// Passes run in this order.
+static const OptPass kPasses[] = {
+  {"peephole", peephole_bbs, 0, 0, "peephole.irs"},
+  {"ssa", make_ssa, 1, PF_SSA_BEGIN, NULL},
+  {"sccp", sccp, 2, PF_SSA, "sccp.irs"},
+  {"copy-prop", copy_propagation, 1, PF_SSA, "copy-prop.irs"},
+  {"dce", remove_unused_vregs, 0, 0, "dce.irs"},
+  {"ssa", resolve_phis, 1, PF_SSA | PF_SSA_END, NULL},
+  {"simplify-cfg", simplify_cfg, 0, PF_NO_PHI, "simplify-cfg.irs"},
+};
+
+static int opt_level;
+static signed char pass_switches[ARRAY_SIZE(kPasses)];  // 0=By level, 1=On, -1=Off.
+
+void set_optimize_level(int level) {
+  // -Os and -Oz: Same as -O2, no pass enlarges code for now.
+  opt_level = level == 's' || level == 'z' ? 2 : level;
+}
+
+bool set_optimize_pass(const char *name, bool enable) {
+  bool found = false;
+  for (size_t i = 0; i < ARRAY_SIZE(kPasses); ++i) {
+    if (strcmp(kPasses[i].name, name) == 0) {
+      pass_switches[i] = enable ? 1 : -1;
+      found = true;
+    }
+  }
+  return found;
+}
+
+static int count_irs(BBContainer *bbcon) {
+  int count = 0;
+  for (int i = 0; i < bbcon->len; ++i) {
+    BB *bb = bbcon->data[i];
+    count += bb->irs->len;
+  }
+  return count;
+}
 
 void optimize(RegAlloc *ra, BBContainer *bbcon) {
   // Clean up unused IRs.
@@ -724,23 +1140,26 @@ void optimize(RegAlloc *ra, BBContainer *bbcon) {
       vec_clear(bb->irs);
   }
 
-  // Peephole
-  for (int i = 0; i < bbcon->len; ++i) {
-    BB *bb = bbcon->data[i];
-    peephole(ra, bb);
-  }
+  bool ssa = false, phi = false;
+  for (size_t i = 0; i < ARRAY_SIZE(kPasses); ++i) {
+    const OptPass *pass = &kPasses[i];
+    if (pass_switches[i] != 0 ? pass_switches[i] < 0 : pass->level > opt_level)
+      continue;
+    if (((pass->flag & PF_SSA) && !ssa) || ((pass->flag & PF_SSA_END) && keep_phi) ||
+        ((pass->flag & PF_NO_PHI) && phi))
+      continue;
 
-  if (apply_ssa) {
-    make_ssa(ra, bbcon);
-    copy_propagation(ra, bbcon);
-    remove_unused_vregs(ra, bbcon);
-    if (!keep_phi) {
-      resolve_phis(ra, bbcon);
-      remove_unnecessary_bb(bbcon);
-    }
-  } else {
-    remove_unused_vregs(ra, bbcon);
-    remove_unnecessary_bb(bbcon);
+    int irs = pass->stat != NULL ? count_irs(bbcon) : 0;
+    report_begin(pass->name);
+    (*pass->run)(ra, bbcon);
+    report_end();
+    if (pass->stat != NULL)
+      report_stat(pass->stat, irs - count_irs(bbcon));
+
+    if (pass->flag & PF_SSA_BEGIN)
+      ssa = phi = true;
+    if (pass->flag & PF_SSA_END)
+      phi = false;
   }
   detect_from_bbs(bbcon);
 }
@@ -1,6 +1,10 @@
 #pragma once
 
+#include <stdbool.h>
+
 typedef struct Vector BBContainer;
 typedef struct RegAlloc RegAlloc;
 
+void set_optimize_level(int level);  // `-O<level>`: Selects passes to run.
+bool set_optimize_pass(const char *name, bool enable);  // `-f<pass>` or `-fno-<pass>`
 void optimize(RegAlloc *ra, BBContainer *bbcon);
@@ -3,7 +3,7 @@
 
 #include <assert.h>
 #include <limits.h>  // CHAR_BIT
-#include <stdlib.h>  // free, qsort
+#include <stdlib.h>  // qsort
 #include <string.h>
 
 #include "be_aux.h"
@@ -13,7 +13,7 @@
 // Register allocator
 
 RegAlloc *new_reg_alloc(const RegAllocSettings *settings) {
-  RegAlloc *ra = calloc_or_die(sizeof(*ra));
+  RegAlloc *ra = arena_alloc(func_arena, sizeof(*ra));
   assert(settings->regset[GPREG].phys_max < (int)(sizeof(ra->used_reg_bits) * CHAR_BIT));
   ra->settings = settings;
   ra->vregs = new_vector();
@@ -28,7 +28,7 @@ RegAlloc *new_reg_alloc(const RegAllocSettings *settings) {
 }
 
 VReg *reg_alloc_spawn_raw(enum VRegSize vsize, int vflag) {
-  VReg *vreg = calloc_or_die(sizeof(*vreg));
+  VReg *vreg = arena_alloc(func_arena, sizeof(*vreg));
   vreg->vsize = vsize;
   vreg->flag = vflag;
   vreg->virt = -1;
@@ -493,8 +493,8 @@ void alloc_physical_registers(RegAlloc *ra, BBContainer *bbcon) {
   assert(ra->settings->regset[FPREG].phys_max < (int)(sizeof(ra->used_reg_bits[FPREG]) * CHAR_BIT));
 
   int vreg_count = ra->vregs->len;
-  LiveInterval *intervals = malloc_or_die(sizeof(LiveInterval) * vreg_count);
-  LiveInterval **sorted_intervals = malloc_or_die(sizeof(LiveInterval*) * vreg_count);
+  LiveInterval *intervals = arena_alloc(func_arena, sizeof(LiveInterval) * vreg_count);
+  LiveInterval **sorted_intervals = arena_alloc(func_arena, sizeof(LiveInterval*) * vreg_count);
 
   for (;;) {
     check_live_interval(bbcon, vreg_count, intervals);
@@ -542,10 +542,8 @@ void alloc_physical_registers(RegAlloc *ra, BBContainer *bbcon) {
 
     if (vreg_count != ra->vregs->len) {
       vreg_count = ra->vregs->len;
-      free(intervals);
-      free(sorted_intervals);
-      intervals = malloc_or_die(sizeof(LiveInterval) * vreg_count);
-      sorted_intervals = malloc_or_die(sizeof(LiveInterval*) * vreg_count);
+      intervals = arena_alloc(func_arena, sizeof(LiveInterval) * vreg_count);
+      sorted_intervals = arena_alloc(func_arena, sizeof(LiveInterval*) * vreg_count);
     }
   }
 
@@ -3,6 +3,7 @@
 
 #include <assert.h>
 #include <limits.h>
+#include <stdint.h>  // intptr_t
 #include <stdlib.h>
 #include <string.h>
 
@@ -10,58 +11,50 @@
 #include "regalloc.h"
 #include "util.h"
 
-#include "table.h"
-
 static inline int ORIG_VIRT(VReg *vreg) {
   return vreg->original->virt;
 }
 
-static inline void assign_new_vregs(RegAlloc *ra, Vector **vreg_table, BB *bb, VReg **vregs) {
+static inline bool is_ssa_target(VReg *vreg) {
+  return !(vreg->flag & (VRF_CONST | VRF_FORCEMEMORY | VRF_VOLATILEREG));
+}
+
+// Current version is saved to `undo`, to restore when leaving a subtree of the dominator tree.
+static inline void set_version(VReg **vregs, Vector *undo, VReg *vreg) {
+  int virt = ORIG_VIRT(vreg);
+  vec_push(undo, vregs[virt]);
+  vregs[virt] = vreg;
+}
+
+static inline void assign_new_vregs(RegAlloc *ra, Vector **vreg_table, BB *bb, VReg **vregs,
+                                    Vector *undo) {
   for (int iir = 0; iir < bb->irs->len; ++iir) {
     IR *ir = bb->irs->data[iir];
-    if (ir->opr1 != NULL && !(ir->opr1->flag & (VRF_CONST | VRF_FORCEMEMORY | VRF_VOLATILEREG))) {
+    if (ir->opr1 != NULL && is_ssa_target(ir->opr1))
       ir->opr1 = vregs[ORIG_VIRT(ir->opr1)];
-    }
-    if (ir->opr2 != NULL && !(ir->opr2->flag & (VRF_CONST | VRF_FORCEMEMORY | VRF_VOLATILEREG))) {
+    if (ir->opr2 != NULL && is_ssa_target(ir->opr2))
       ir->opr2 = vregs[ORIG_VIRT(ir->opr2)];
+    Vector *additional = ir->additional_operands;
+    if (additional != NULL) {
+      // Inline assembler: Output operand comes first, and it is same as `dst`.
+      for (int i = ir->dst != NULL ? 1 : 0; i < additional->len; ++i) {
+        VReg *opr = additional->data[i];
+        if (is_ssa_target(opr))
+          additional->data[i] = vregs[ORIG_VIRT(opr)];
+      }
     }
-    if (ir->dst != NULL && !(ir->dst->flag & (VRF_CONST | VRF_FORCEMEMORY | VRF_VOLATILEREG))) {
+    if (ir->dst != NULL && is_ssa_target(ir->dst)) {
       int virt = ORIG_VIRT(ir->dst);
       Vector *vt = vreg_table[virt];
       VReg *dst = ra->vregs->data[virt];
       if (vt->len > 0)
         ir->dst = dst = reg_alloc_with_original(ra, dst);
       vec_push(vt, dst);
-      vregs[virt] = dst;
-    }
-  }
-}
-
-static inline void push_nexts(BB *bb, Vector *unchecked) {
-  Vector *irs = bb->irs;
-  if (irs->len > 0) {
-    IR *ir = irs->data[irs->len - 1];  // JMP must be the last IR.
-    switch (ir->kind) {
-    case IR_JMP:
-      {
-        BB *dst = ir->jmp.bb;
-        vec_push(unchecked, dst);
-        if (ir->jmp.cond == COND_ANY)
-          return;  // Next BB is not reachable.
-      }
-      break;
-    case IR_TJMP:
-      for (size_t j = 0; j < ir->tjmp.len; ++j) {
-        BB *nbb = ir->tjmp.bbs[j];
-        vec_push(unchecked, nbb);
-      }
-      return;
-    default: break;
+      set_version(vregs, undo, dst);
+      if (additional != NULL)
+        additional->data[0] = dst;
     }
   }
-  BB *next = bb->next;
-  if (next != NULL)
-    vec_push(unchecked, next);
 }
 
 static void replace_vreg_set(Vector *v, VReg **vregs) {
@@ -74,125 +67,212 @@ static void replace_vreg_set(Vector *v, VReg **vregs) {
   }
 }
 
-static Vector **ssa_transform(RegAlloc *ra, BBContainer *bbcon) {
-  int vreg_count = ra->vregs->len;
-  Vector **vreg_table = malloc_or_die(sizeof(*vreg_table) * vreg_count);
-  for (int i = 0; i < vreg_count; ++i) {
-    VReg *vreg = ra->vregs->data[i];
-    Vector *vt = new_vector();
-    if (vreg->flag & (VRF_PARAM | VRF_FORCEMEMORY | VRF_VOLATILEREG))
-      vec_push(vt, vreg);
-    vreg_table[i] = vt;
+// `vregs` is sorted by `virt`.
+static bool vreg_set_contains(Vector *vregs, VReg *vreg) {
+  int lo = 0, hi = vregs->len;
+  while (lo < hi) {
+    int m = lo + (hi - lo) / 2;
+    VReg *mid = vregs->data[m];
+    if (mid->virt == vreg->virt)
+      return true;
+    if (mid->virt < vreg->virt)
+      lo = m + 1;
+    else
+      hi = m;
   }
+  return false;
+}
 
-  // Traverse BBs.
-  int count = bbcon->len;
-  assert(count > 0);
+static Vector **dominance_frontiers(Vector *order) {
+  int n = order->len;
+  Vector **frontiers = calloc_or_die(sizeof(*frontiers) * n);  // <BB*>, indexed by `rpo`.
+  for (int i = 0; i < n; ++i) {
+    BB *bb = order->data[i];
+    if (bb->from_bbs->len < 2)
+      continue;
+    for (int j = 0; j < bb->from_bbs->len; ++j) {
+      for (BB *runner = bb->from_bbs->data[j]; runner != bb->idom; runner = runner->idom) {
+        Vector *df = frontiers[runner->rpo];
+        if (df == NULL) {
+          frontiers[runner->rpo] = df = new_vector();
+        } else if (df->len > 0 && df->data[df->len - 1] == bb) {
+          break;  // Rest of the chain is already visited, too.
+        }
+        vec_push(df, bb);
+      }
+    }
+  }
+  return frontiers;
+}
 
-  Table checked;
-  table_init(&checked);
-  Vector unchecked;
-  vec_init(&unchecked);
-  BB *bb0 = bbcon->data[0];
-  vec_push(&unchecked, bb0);
+// Cytron et al: Put phis on the iterated dominance frontier of assignments,
+// only where the register is live (pruned SSA).
+static void insert_phis(RegAlloc *ra, Vector *order) {
+  int n = order->len;
+  int vreg_count = ra->original_vreg_count;
+  Vector **defs = calloc_or_die(sizeof(*defs) * vreg_count);  // <BB*>, indexed by `virt`.
+  for (int i = 0; i < n; ++i) {
+    BB *bb = order->data[i];
+    for (int j = 0; j < bb->assigned_regs->len; ++j) {
+      VReg *vreg = bb->assigned_regs->data[j];
+      if (!is_ssa_target(vreg))
+        continue;
+      assert(vreg->original == vreg);
+      if (defs[vreg->virt] == NULL)
+        defs[vreg->virt] = new_vector();
+      vec_push(defs[vreg->virt], bb);
+    }
+  }
 
-  VReg **vregs = malloc_or_die(sizeof(*vregs) * vreg_count);
+  Vector **frontiers = dominance_frontiers(order);
+  int *has_phi = malloc_or_die(sizeof(*has_phi) * n);  // Last `virt` processed, not to reset.
+  int *queued = malloc_or_die(sizeof(*queued) * n);
+  for (int i = 0; i < n; ++i)
+    has_phi[i] = queued[i] = -1;
 
-  do {
-    BB *bb = vec_pop(&unchecked);
-    if ((bb->from_bbs->len == 0 && bb != bb0) || table_try_get(&checked, bb->label, NULL))
+  int phi_count = 0, dead_count = 0;
+  for (int virt = 0; virt < vreg_count; ++virt) {
+    Vector *worklist = defs[virt];  // Reused as worklist.
+    if (worklist == NULL)
       continue;
-    table_put(&checked, bb->label, bb);
-
-    memcpy(vregs, ra->vregs->data, sizeof(*vregs) * vreg_count);
-    if (bb->from_bbs->len == 1) {
-      // Oneway flow: Hand over out_regs of the predecessor.
-      BB *from = bb->from_bbs->data[0];
-      for (int i = 0; i < from->out_regs->len; ++i) {
-        VReg *vreg = from->out_regs->data[i];
-        if (vreg->flag & (VRF_FORCEMEMORY | VRF_VOLATILEREG))
-          continue;
-        int virt = ORIG_VIRT(vreg);
-        vregs[virt] = vreg;
-      }
-
-      replace_vreg_set(bb->in_regs, vregs);
-    } else if (bb->from_bbs->len > 1) {
-      // Merge flow: Create new versions, prepare for PHI functions.
-      for (int i = 0; i < bb->in_regs->len; ++i) {
-        VReg *vreg = bb->in_regs->data[i];
-        if (vreg->flag & (VRF_FORCEMEMORY | VRF_VOLATILEREG))
+    VReg *vreg = ra->vregs->data[virt];
+    for (int i = 0; i < worklist->len; ++i) {
+      BB *bb = worklist->data[i];
+      queued[bb->rpo] = virt;
+    }
+    while (worklist->len > 0) {
+      BB *bb = vec_pop(worklist);
+      Vector *df = frontiers[bb->rpo];
+      if (df == NULL)
+        continue;
+      for (int i = 0; i < df->len; ++i) {
+        BB *y = df->data[i];
+        if (has_phi[y->rpo] == virt)
           continue;
-        int virt = ORIG_VIRT(vreg);  // `vreg` must be original, though.
-        Vector *vt = vreg_table[virt];
-        VReg *newver = reg_alloc_with_original(ra, ra->vregs->data[virt]);
-        bb->in_regs->data[i] = vregs[virt] = newver;
-        vec_push(vt, newver);
+        has_phi[y->rpo] = virt;
+        if (!vreg_set_contains(y->in_regs, vreg)) {
+          ++dead_count;
+          continue;  // Dead: No phi needed.
+        }
+
+        Vector *params = new_vector();
+        for (int j = 0; j < y->from_bbs->len; ++j)
+          vec_push(params, NULL);  // Filled in renaming.
+        if (y->phis == NULL)
+          y->phis = new_vector();
+        vec_push(y->phis, new_phi(vreg, params));
+        ++phi_count;
+
+        if (queued[y->rpo] != virt) {
+          queued[y->rpo] = virt;
+          vec_push(worklist, y);
+        }
       }
     }
-    assign_new_vregs(ra, vreg_table, bb, vregs);
-    replace_vreg_set(bb->out_regs, vregs);
-
-    push_nexts(bb, &unchecked);
-  } while (unchecked.len > 0);
-
-  free(vregs);
+    free_vector(worklist);
+  }
 
-  return vreg_table;
+  for (int i = 0; i < n; ++i) {
+    if (frontiers[i] != NULL)
+      free_vector(frontiers[i]);
+  }
+  free(frontiers);
+  free(queued);
+  free(has_phi);
+  free(defs);
+  report_stat("ssa.phis", phi_count);
+  report_stat("ssa.pruned-phis", dead_count);
 }
 
-static void insert_phis(BBContainer *bbcon, int original_vreg_count) {
-  assert(curbb == NULL);
-  VReg **from_vregs = calloc_or_die(sizeof(*from_vregs) * original_vreg_count);
-  for (int ibb = 1; ibb < bbcon->len; ++ibb) {
-    BB *bb = bbcon->data[ibb];
-    if (bb->from_bbs->len < 2)
+static void rename_bb(RegAlloc *ra, Vector **vreg_table, BB *bb, VReg **vregs, Vector *undo) {
+  Vector *phis = bb->phis;
+  if (phis != NULL) {
+    for (int i = 0; i < phis->len; ++i) {
+      Phi *phi = phis->data[i];
+      int virt = ORIG_VIRT(phi->dst);
+      VReg *newver = reg_alloc_with_original(ra, ra->vregs->data[virt]);
+      vec_push(vreg_table[virt], newver);
+      phi->dst = newver;
+      set_version(vregs, undo, newver);
+    }
+  }
+  replace_vreg_set(bb->in_regs, vregs);
+  assign_new_vregs(ra, vreg_table, bb, vregs, undo);
+  replace_vreg_set(bb->out_regs, vregs);
+
+  // Hand over current versions to phis in successors.
+  BB *succ;
+  for (int i = 0; (succ = bb_successor(bb, i)) != NULL; ++i) {
+    Vector *sphis = succ->phis;
+    if (sphis == NULL)
       continue;
-
-    int reg_count = bb->in_regs->len;  // Phi target only.
-    for (int i = 0; i < reg_count; ++i) {
-      VReg *vreg = bb->in_regs->data[i];
-      if (vreg->flag & (VRF_FORCEMEMORY | VRF_VOLATILEREG)) {
-        // Swap with the last one.
-        --reg_count;
-        bb->in_regs->data[i] = bb->in_regs->data[reg_count];
-        bb->in_regs->data[reg_count] = vreg;
-        if (i < reg_count)
-          --i;  // Recheck the swapped one.
+    for (int j = 0; j < succ->from_bbs->len; ++j) {
+      if (succ->from_bbs->data[j] != bb)
+        continue;
+      for (int k = 0; k < sphis->len; ++k) {
+        Phi *phi = sphis->data[k];
+        phi->params->data[j] = vregs[ORIG_VIRT(phi->dst)];
       }
     }
+  }
+}
 
-    Vector *phi_params = new_vector();  // <<VReg*>>
-    for (int i = 0; i < reg_count; ++i)
-      vec_push(phi_params, new_vector());
+// Rename registers in preorder of the dominator tree.
+static Vector **rename_vregs(RegAlloc *ra, Vector *order) {
+  int vreg_count = ra->original_vreg_count;
+  Vector **vreg_table = malloc_or_die(sizeof(*vreg_table) * vreg_count);
+  for (int i = 0; i < vreg_count; ++i) {
+    VReg *vreg = ra->vregs->data[i];
+    Vector *vt = new_vector();
+    if (vreg->flag & (VRF_PARAM | VRF_FORCEMEMORY | VRF_VOLATILEREG))
+      vec_push(vt, vreg);
+    vreg_table[i] = vt;
+  }
 
-    for (int ifrom = 0; ifrom < bb->from_bbs->len; ++ifrom) {
-      BB *from = bb->from_bbs->data[ifrom];
-      for (int j = 0; j < from->out_regs->len; ++j) {
-        VReg *oreg = from->out_regs->data[j];
-        assert(0 <= ORIG_VIRT(oreg) && ORIG_VIRT(oreg) < original_vreg_count);
-        from_vregs[ORIG_VIRT(oreg)] = oreg;
-      }
+  int n = order->len;
+  int *child = malloc_or_die(sizeof(*child) * n);  // First child in the dominator tree.
+  int *sibling = malloc_or_die(sizeof(*sibling) * n);
+  int *marks = malloc_or_die(sizeof(*marks) * n);  // Length of `undo` on entering.
+  for (int i = 0; i < n; ++i)
+    child[i] = -1;
+  for (int i = n; --i > 0; ) {
+    BB *bb = order->data[i];
+    int parent = bb->idom->rpo;
+    sibling[i] = child[parent];
+    child[parent] = i;
+  }
 
-      for (int j = 0; j < reg_count; ++j) {
-        VReg *vreg = bb->in_regs->data[j];
-        assert(vreg->original != vreg && 0 <= ORIG_VIRT(vreg) &&
-               ORIG_VIRT(vreg) < original_vreg_count);
-        VReg *fv = from_vregs[ORIG_VIRT(vreg)];
-        vec_push(phi_params->data[j], fv);
+  VReg **vregs = malloc_or_die(sizeof(*vregs) * vreg_count);
+  memcpy(vregs, ra->vregs->data, sizeof(*vregs) * vreg_count);
+  Vector undo;  // <VReg*>
+  vec_init(&undo);
+  Vector stack;  // <int>, BB index in `order`, or its complement on leaving.
+  vec_init(&stack);
+  vec_push(&stack, (void*)(intptr_t)0);
+  do {
+    int i = (intptr_t)vec_pop(&stack);
+    if (i < 0) {
+      for (i = ~i; undo.len > marks[i]; ) {
+        VReg *vreg = vec_pop(&undo);
+        vregs[ORIG_VIRT(vreg)] = vreg;
       }
+      continue;
     }
 
-    Vector *phis = phi_params;  // Caution, reuse phi_params as phis:<Phi*>
-    for (int i = 0; i < reg_count; ++i) {
-      VReg *vreg = bb->in_regs->data[i];
-      Vector *params = phi_params->data[i];
-      Phi *phi = new_phi(vreg, params);
-      phis->data[i] = phi;
-    }
-    bb->phis = phis;
-  }
-  free(from_vregs);
+    marks[i] = undo.len;
+    rename_bb(ra, vreg_table, order->data[i], vregs, &undo);
+    vec_push(&stack, (void*)(intptr_t)~i);
+    for (int c = child[i]; c >= 0; c = sibling[c])
+      vec_push(&stack, (void*)(intptr_t)c);
+  } while (stack.len > 0);
+
+  free(stack.data);
+  free(undo.data);
+  free(vregs);
+  free(marks);
+  free(sibling);
+  free(child);
+  return vreg_table;
 }
 
 // To make BB merging flow only from unconditional transition, insert BB.
@@ -419,9 +499,11 @@ static void replace_phis(RegAlloc *ra, BB *bb, int ifb, Vector *phis) {
 
 void make_ssa(RegAlloc *ra, BBContainer *bbcon) {
   analyze_reg_flow(bbcon);
+  Vector *order = analyze_dominators(bbcon);
   ra->original_vreg_count = ra->vregs->len;
-  ra->vreg_table = ssa_transform(ra, bbcon);
-  insert_phis(bbcon, ra->original_vreg_count);
+  insert_phis(ra, order);
+  ra->vreg_table = rename_vregs(ra, order);
+  free_vector(order);
 }
 
 void resolve_phis(RegAlloc *ra, BBContainer *bbcon) {
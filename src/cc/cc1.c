@@ -6,11 +6,14 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "ast.h"
 #include "codegen.h"
 #include "emit_code.h"
 #include "fe_misc.h"
 #include "lexer.h"
+#include "optimize.h"
 #include "parser.h"
+#include "pch.h"
 #include "type.h"
 #include "util.h"
 #include "var.h"
@@ -19,7 +22,14 @@
 
 extern void install_builtins(Vector *decls);
 
+static bool token_input;
+static bool make_pch;
+
 static void init_compiler(Vector *decls, FILE *ofp) {
+  compile_error_count = compile_warning_count = 0;
+  reset_labels();
+  reset_codegen();
+
   init_lexer();
   init_global();
   init_emit(ofp);
@@ -38,29 +48,55 @@ static void init_compiler(Vector *decls, FILE *ofp) {
 #endif
 
   install_builtins(decls);
+  init_pch_scope(decls, make_pch);
+  set_lex_pch_callback(load_pch_scope);
 }
 
 static void compile1(FILE *ifp, const char *filename, Vector *decls) {
-  set_source_file(ifp, filename);
+  if (token_input)
+    set_source_token_stream(ifp, filename);
+  else
+    set_source_whole_file(ifp, filename);
   parse(decls);
 }
 
+// Append the global scope after the tokens which cpp has put in precompiled header.
+// It is left out if something cannot be saved, and the tokens are parsed on using then.
+static void append_pch_scope(const char *filename, size_t offset) {
+  DataStorage data;
+  data_init(&data);
+  if (save_pch_scope(&data)) {
+    FILE *fp = fopen(filename, "ab");
+    if (fp == NULL || fseek(fp, 0, SEEK_END) != 0 || ftell(fp) != (long)offset)
+      error("Cannot append to precompiled header: %s", filename);
+    fwrite(data.buf, 1, data.len, fp);
+    fclose(fp);
+  }
+  data_release(&data);
+}
+
 static void usage(FILE *fp) {
   fprintf(
       fp,
       "Usage: cc1 [options] file...\n"
       "Options:\n"
-      "  -O<level>           (ignored)\n"
+      "  -O<level>           Optimization level: 0 (default), 1, 2, 3, s or z\n"
+      "  -f[no-]<pass>       Enable or disable an optimization pass:\n"
+      "                        peephole, ssa, sccp, copy-prop, dce, simplify-cfg\n"
+      "  --token-input       Input binary token stream from cpp\n"
+      "  --make-pch          Append the global scope to precompiled header made by cpp\n"
   );
 }
 
-int main(int argc, char *argv[]) {
+int cc1_main(int argc, char *argv[], FILE *ifp, FILE *ofp) {
   enum {
     OPT_HELP = 128,
     OPT_VERSION,
     OPT_FNO,
     OPT_WNO,
     OPT_SSA,
+    OPT_TOKEN_INPUT,
+    OPT_MAKE_PCH,
   };
 
   static const struct option options[] = {
@@ -78,9 +114,12 @@ int main(int argc, char *argv[]) {
 
     // Feature flag.
     {"-apply-ssa", no_argument, OPT_SSA},
+    {"-token-input", no_argument, OPT_TOKEN_INPUT},
+    {"-make-pch", no_argument, OPT_MAKE_PCH},
 
     {NULL},
   };
+  token_input = make_pch = false;
   int opt;
   while ((opt = optparse(argc, argv, options)) != -1) {
     switch (opt) {
@@ -119,7 +158,9 @@ int main(int argc, char *argv[]) {
         fprintf(stderr, "Warning: missing argument for -f\n");
         break;
       }
-      if (!parse_fopt(optarg, opt == 'f')) {
+      if (opt == 'f' && parse_report_option(optarg))
+        break;
+      if (!parse_fopt(optarg, opt == 'f') && !set_optimize_pass(optarg, opt == 'f')) {
         // Silently ignored.
         // fprintf(stderr, "Warning: unknown option for -f: %s\n", optarg);
       }
@@ -153,10 +194,16 @@ int main(int argc, char *argv[]) {
       break;
 
     case OPT_SSA:
-      {
-        extern bool apply_ssa;
-        apply_ssa = true;
-      }
+      if (cc_flags.optimize_level == 0)
+        cc_flags.optimize_level = 1;
+      break;
+
+    case OPT_TOKEN_INPUT:
+      token_input = true;
+      break;
+
+    case OPT_MAKE_PCH:
+      make_pch = true;
       break;
 
     case '?':
@@ -165,33 +212,59 @@ int main(int argc, char *argv[]) {
     }
   }
 
+  set_optimize_level(cc_flags.optimize_level);
+
   // Compile.
   Vector *toplevel = new_vector();
-  init_compiler(toplevel, stdout);
+  init_compiler(toplevel, ofp);
 
   int iarg = optind;
   if (iarg >= argc)
     error("No input files");
-  for (int i = iarg; i < argc; ++i) {
-    const char *filename = argv[i];
-    FILE *ifp;
-    if (strcmp(filename, "-") == 0) {
-      ifp = stdin;
-      filename = "<stdin>";
-    } else if (!is_file(filename) || (ifp = fopen(filename, "r")) == NULL) {
-      error("Cannot open file: %s\n", filename);
+  report_begin("parse");
+  size_t pch_scope_offset = 0;
+  if (make_pch) {
+    if (iarg + 1 != argc)
+      error("Precompiled header requires one input file");
+    pch_scope_offset = set_source_pch(argv[iarg]);
+    parse_declarations(toplevel);
+  } else {
+    for (int i = iarg; i < argc; ++i) {
+      const char *filename = argv[i];
+      FILE *fp;
+      if (strcmp(filename, "-") == 0) {
+        fp = ifp;
+        filename = "<stdin>";
+      } else if (!is_file(filename) || (fp = fopen(filename, "r")) == NULL) {
+        error("Cannot open file: %s\n", filename);
+      }
+      compile1(fp, filename, toplevel);
+      if (fp != ifp)
+        fclose(fp);
     }
-    compile1(ifp, filename, toplevel);
-    if (ifp != stdin)
-      fclose(ifp);
   }
+  report_end();
+  int result = 0;
   if (compile_error_count != 0)
-    exit(1);
-  if (cc_flags.warn_as_error && compile_warning_count != 0)
-    exit(2);
+    result = 1;
+  else if (cc_flags.warn_as_error && compile_warning_count != 0)
+    result = 2;
+  else if (make_pch)
+    append_pch_scope(argv[iarg], pch_scope_offset);
+  else
+    emit_code(toplevel);  // Generates code for each function, too.
+  reset_derived_types();
+  release_ast();
 
-  gen(toplevel);
-  emit_code(toplevel);
+  if (result == 0)
+    report_output("cc1");
+  else
+    report_discard();
+  return result;
+}
 
-  return 0;
+#if !defined(XCC_INTEGRATED)
+int main(int argc, char *argv[]) {
+  return cc1_main(argc, argv, stdin, stdout);
 }
+#endif
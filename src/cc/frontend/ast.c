@@ -8,6 +8,16 @@
 #include "type.h"
 #include "util.h"
 
+static Arena ast_arena;
+
+void *ast_alloc(size_t size) {
+  return arena_alloc(&ast_arena, size);
+}
+
+void release_ast(void) {
+  arena_release(&ast_arena);
+}
+
 Token *alloc_token(enum TokenKind kind, Line *line, const char *begin, const char *end) {
   if (end == NULL) {
     assert(begin != NULL);
@@ -80,7 +90,7 @@ Expr *strip_cast(Expr *expr) {
 }
 
 Expr *new_expr(enum ExprKind kind, Type *type, const Token *token) {
-  Expr *expr = calloc_or_die(sizeof(*expr));
+  Expr *expr = ast_alloc(sizeof(*expr));
   expr->kind = kind;
   expr->type = type;
   expr->token = token;
@@ -200,21 +210,21 @@ Expr *new_expr_block(Stmt *block) {
 // ================================================
 
 Initializer *new_initializer(enum InitializerKind kind, const Token *token) {
-  Initializer *init = calloc_or_die(sizeof(*init));
+  Initializer *init = ast_alloc(sizeof(*init));
   init->kind = kind;
   init->token = token;
   return init;
 }
 
 VarDecl *new_vardecl(VarInfo *varinfo) {
-  VarDecl *decl = malloc_or_die(sizeof(*decl));
+  VarDecl *decl = ast_alloc(sizeof(*decl));
   decl->varinfo = varinfo;
   decl->init_stmt = NULL;
   return decl;
 }
 
 Stmt *new_stmt(enum StmtKind kind, const Token *token) {
-  Stmt *stmt = malloc_or_die(sizeof(Stmt));
+  Stmt *stmt = ast_alloc(sizeof(Stmt));
   stmt->kind = kind;
   stmt->token = token;
   stmt->reach = 0;
@@ -320,7 +330,7 @@ Stmt *new_stmt_asm(const Token *token, Vector *templates, Vector *outputs, Vecto
 //
 
 static Declaration *new_decl(enum DeclKind kind) {
-  Declaration *decl = malloc_or_die(sizeof(*decl));
+  Declaration *decl = ast_alloc(sizeof(*decl));
   decl->kind = kind;
   return decl;
 }
@@ -346,7 +356,7 @@ Function *new_func(Type *type, const Token *ident, const Vector *params, Table *
                    int flag) {
   assert(type->kind == TY_FUNC);
   assert(ident->kind == TK_IDENT);
-  Function *func = calloc_or_die(sizeof(*func));
+  Function *func = ast_alloc(sizeof(*func));
   func->type = type;
   func->ident = ident;
   func->params = params;
@@ -354,6 +364,8 @@ Function *new_func(Type *type, const Token *ident, const Vector *params, Table *
   func->static_vars = NULL;
   func->scopes = NULL;
   func->body_block = NULL;
+  func->body_tokens = NULL;
+  func->visible_decls = 0;
   func->label_table = NULL;
   func->gotos = NULL;
   func->extra = NULL;
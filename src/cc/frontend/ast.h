@@ -39,6 +39,7 @@ typedef struct Line {
   const char *filename;
   int lineno;
   const char *buf;
+  const struct LineOrigin *origin;  // Token locations in the source, when read from token stream.
 } Line;
 
 // Token
@@ -183,6 +184,10 @@ typedef struct Token {
   };
 } Token;
 
+// AST nodes and types live in an arena, until the translation unit is compiled.
+void *ast_alloc(size_t size);  // Zero-cleared.
+void release_ast(void);
+
 Token *alloc_token(enum TokenKind kind, Line *line, const char *begin, const char *end);
 Token *alloc_ident(const Name *name, Line *line, const char *begin, const char *end);
 
@@ -493,6 +498,8 @@ typedef struct Function {
   Vector *static_vars;  // Static variable entities: <VarInfo*>
   Vector *scopes;  // NULL => prototype definition.
   Stmt *body_block;  // NULL => Prototype definition.
+  Vector *body_tokens;  // <Token*>, Body not parsed yet: parsed lazily on first reference.
+  int visible_decls;  // Global declarations before the body, which it can see.
   Table *label_table;  // <const Name*, Stmt*>
   Vector *gotos;  // <Stmt*>
   void *extra;
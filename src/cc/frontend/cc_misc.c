@@ -15,8 +15,9 @@ bool is_function_omitted(const VarInfo *funcvi) {
   int storage = funcvi->storage;
   if ((storage & VS_REF_TAKEN) || ((storage & (VS_INLINE | VS_EXTERN)) == (VS_INLINE | VS_EXTERN)))
     return false;
-  return (satisfy_inline_criteria(funcvi) ||
-      (storage & (VS_STATIC | VS_USED)) == VS_STATIC);  // Static function but not used.
+  // Check usage first: satisfy_inline_criteria parses the body if it is not parsed yet.
+  return ((storage & (VS_STATIC | VS_USED)) == VS_STATIC ||  // Static function but not used.
+      satisfy_inline_criteria(funcvi));
 }
 
 static void eval_initial_value(Expr *expr, Expr **pvar, int64_t *poffset) {
@@ -10,6 +10,7 @@
 #include "expr.h"
 #include "initializer.h"
 #include "lexer.h"
+#include "parser.h"  // parse_lazy_body
 #include "table.h"
 #include "type.h"
 #include "util.h"
@@ -83,7 +84,7 @@ void parse_error(enum ParseErrorLevel level, const Token *token, const char *fmt
   }
 
   if (token != NULL && token->line != NULL && token->begin != NULL)
-    show_error_line(token->line->buf, token->begin, token->end - token->begin);
+    show_source_line(token->line, token->begin, token->end - token->begin);
   va_end(ap);
 
   if (level == PE_WARNING) {
@@ -141,9 +142,8 @@ static VarInfo *find_var_from_scope(Scope *scope, const Token *ident, Type *type
   assert(ident != NULL);
   const Name *name = ident->ident;
   assert(name != NULL);
-  int idx = var_find(scope->vars, name);
-  if (idx >= 0) {
-    VarInfo *varinfo = scope->vars->data[idx];
+  VarInfo *varinfo = scope_lookup(scope, name);
+  if (varinfo != NULL) {
     if (!same_type(type, varinfo->type)) {
       parse_error(PE_NOFATAL, ident, "`%.*s' type conflict", NAMES(name));
     } else if (!(storage & VS_EXTERN)) {
@@ -364,8 +364,10 @@ void propagate_var_used(void) {
       Function *func = varinfo->global.func;
       if (func == NULL)  // Prototype definition
         continue;
-      if (((varinfo->storage & VS_STATIC) ||
-          (varinfo->storage & (VS_INLINE | VS_EXTERN)) == VS_INLINE) &&
+      // Reference taken: always emitted (see `is_function_omitted`), so its body is needed.
+      if (!(varinfo->storage & VS_REF_TAKEN) &&
+          ((varinfo->storage & VS_STATIC) ||
+           (varinfo->storage & (VS_INLINE | VS_EXTERN)) == VS_INLINE) &&
           (func->attributes == NULL ||
            (!table_try_get(func->attributes, constructor_name, NULL) &&
             !table_try_get(func->attributes, destructor_name, NULL)))) {
@@ -392,6 +394,10 @@ void propagate_var_used(void) {
     table_delete(&unused, varinfo->ident->ident);
     varinfo->storage |= VS_USED;
 
+    // Referred before its definition: the body is not parsed yet.
+    if (varinfo->type->kind == TY_FUNC && varinfo->global.func != NULL)
+      parse_lazy_body(varinfo->global.func);
+
     Vector *refs = varinfo->global.referred_globals;
     if (refs == NULL)
       continue;
@@ -880,6 +886,7 @@ bool satisfy_inline_criteria(const VarInfo *varinfo) {
   if (type->kind == TY_FUNC && (varinfo->storage & VS_INLINE) && !type->func.vaargs) {
     Function *func = varinfo->global.func;
     if (func != NULL) {
+      parse_lazy_body(func);
       // Self-recursion or mutual recursion are prevented,
       // because some inline function must not be defined at funcall point.
       return func->body_block != NULL && func->label_table == NULL && func->gotos == NULL;
@@ -1029,7 +1036,7 @@ static Vector *duplicate_inline_function_asm_args(Function *targetfunc, Scope *t
   Vector *dups = new_vector();
   for (int i = 0; i < srcs->len; ++i) {
     AsmArg *src = srcs->data[i];
-    AsmArg *dup = calloc_or_die(sizeof(*dup));
+    AsmArg *dup = ast_alloc(sizeof(*dup));
     dup->constraint = src->constraint;
     dup->expr = duplicate_inline_function_expr(targetfunc, targetscope, src->expr);
     vec_push(dups, dup);
@@ -7,12 +7,29 @@
 #include <stdbool.h>
 #include <stdlib.h>  // malloc, strtoul
 #include <string.h>
+#include <sys/stat.h>
 #include <sys/types.h>  // ssize_t
 
 #include "table.h"
 #include "util.h"
 
 static bool for_preprocess;
+static bool from_token_stream;
+
+// Whole source read at once: Lines are cut out in place.
+static struct {
+  char *p, *end;  // p == NULL => Not used.
+} source_buffer;
+
+// Tokens to be replayed: tokens == NULL => Not used.
+static struct {
+  const Vector *tokens;
+  int index;
+} replay;
+
+static bool read_token_line(void);
+static Token *get_stream_token(void);
+static const char *operator_text(enum TokenKind kind);
 
 static const struct {
   const char *str;
@@ -137,7 +154,7 @@ void lex_error(const char *p, const char *fmt, ...) {
   fprintf(stderr, "\n");
 
   if (lexer.line != NULL)
-    show_error_line(lexer.line->buf, p, 1);
+    show_source_line(lexer.line, p, 1);
 
   exit(1);
 }
@@ -224,6 +241,7 @@ bool lex_eof_continue(void) {
 }
 
 static void init_lexer_with_flag(bool for_preprocess_) {
+  reset_lexer();
   for_preprocess = for_preprocess_;
   init_reserved_word_table();
 }
@@ -237,6 +255,8 @@ void init_lexer_for_preprocessor(void) {
 }
 
 void set_source_file(FILE *fp, const char *filename) {
+  from_token_stream = false;
+  source_buffer.p = source_buffer.end = NULL;
   lexer.fp = fp;
   lexer.filename = filename;
   lexer.line = NULL;
@@ -250,7 +270,10 @@ void set_source_string(const char *line, const char *filename, int lineno) {
   p->filename = filename;
   p->buf = line;
   p->lineno = lineno;
+  p->origin = NULL;
 
+  from_token_stream = false;
+  source_buffer.p = source_buffer.end = NULL;
   lexer.fp = NULL;
   lexer.filename = filename;
   lexer.line = p;
@@ -259,6 +282,32 @@ void set_source_string(const char *line, const char *filename, int lineno) {
   lexer.lineno = lineno;
 }
 
+// Read the whole input into one buffer, instead of reading line by line,
+// so that lines need no allocation.
+void set_source_whole_file(FILE *fp, const char *filename) {
+  size_t size;
+  char *buf = read_to_end(fp, &size);
+  set_source_file(NULL, filename);
+  source_buffer.p = buf;
+  source_buffer.end = buf + size;
+}
+
+void replay_tokens(const Vector *tokens, LexerState *saved) {
+  saved->lexer = lexer;
+  saved->tokens = replay.tokens;
+  saved->index = replay.index;
+
+  replay.tokens = tokens;
+  replay.index = 0;
+  lexer.idx = -1;
+}
+
+void restore_lexer(const LexerState *saved) {
+  lexer = saved->lexer;
+  replay.tokens = saved->tokens;
+  replay.index = saved->index;
+}
+
 const char *get_lex_p(void) {
   if (lexer.idx < 0)
     return lexer.p;
@@ -301,14 +350,73 @@ static int scan_linemarker(const char *line, long *pnum, char **pfn, int *pflag)
   return n;
 }
 
+// Cut next line out of the source buffer, same as `getline_cont`:
+// Chomp CR/LF, and join lines ending with backslash (moving the rest forward).
+static char *read_buffer_line(void) {
+  char *line = source_buffer.p, *end = source_buffer.end;
+  if (line >= end)
+    return NULL;
+
+  char *w = line, *p = line;
+  for (;;) {
+    char *q = memchr(p, '\n', end - p);
+    char *next = q != NULL ? q + 1 : end;
+    if (q == NULL)
+      q = end;
+    if (q > p && q[-1] == '\r')
+      --q;
+    if (w != p)
+      memmove(w, p, q - p);
+    w += q - p;
+    p = next;
+    ++lexer.lineno;
+    if (w == line || w[-1] != '\\')
+      break;
+    --w;  // Continue line.
+    if (p >= end)
+      break;
+  }
+  *w = '\0';
+  source_buffer.p = p;
+  return line;
+}
+
+// Line records live until the end, so allocate them in chunks.
+static Line *alloc_line(const char *buf) {
+  static Line *pool;
+  static int pool_left;
+  if (pool_left <= 0) {
+    pool_left = 256;
+    pool = malloc_or_die(sizeof(*pool) * pool_left);
+  }
+  --pool_left;
+  Line *line = pool++;
+  line->filename = lexer.filename;
+  line->buf = buf;
+  line->lineno = lexer.lineno;
+  line->origin = NULL;
+  return line;
+}
+
 static bool read_next_line(void) {
-  if (lexer.fp == NULL || feof(lexer.fp))
+  if (from_token_stream)
+    return read_token_line() || lex_eof_continue();
+  bool whole = source_buffer.p != NULL;
+  if (!whole && (lexer.fp == NULL || feof(lexer.fp)))
     return lex_eof_continue();
 
   char *line = NULL;
   size_t capa = 0;
   for (;;) {
-    ssize_t len = getline_cont(&line, &capa, lexer.fp, &lexer.lineno);
+    ssize_t len;
+    if (whole) {
+      line = read_buffer_line();
+      if (line == NULL)
+        return lex_eof_continue();
+      len = 0;
+    } else {
+      len = getline_cont(&line, &capa, lexer.fp, &lexer.lineno);
+    }
     if (len == -1) {
       if (lex_eof_continue())
         continue;
@@ -331,12 +439,8 @@ static bool read_next_line(void) {
     }
   }
 
-  Line *p = malloc_or_die(sizeof(*p));
-  p->filename = lexer.filename;
-  p->buf = line;
-  p->lineno = lexer.lineno;
-  lexer.line = p;
-  lexer.p = lexer.line->buf;
+  lexer.line = alloc_line(line);
+  lexer.p = line;
   return true;
 }
 
@@ -498,23 +602,19 @@ static Token *read_num(const char **pp) {
 const char *read_ident(const char *p_) {
   const unsigned char *p = (const unsigned char*)p_;
   unsigned char uc = *p;
-  int ucc = isutf8first(uc) - 1;
-  if (!(ucc > 0 || isalpha(uc) || uc == '_'))
+  if (!(isutf8first(uc) > 1 || isalpha(uc) || uc == '_'))
     return NULL;
 
   for (;;) {
-    uc = *++p;
-    if (ucc > 0) {
-      if (!isutf8follow(uc)) {
+    p = (const unsigned char*)skip_ident_chars((const char*)p);
+    int ucc = isutf8first(*p) - 1;
+    if (ucc <= 0)
+      break;
+    while (ucc-- > 0) {
+      if (!isutf8follow(*++p))
         lex_error(p_, "Illegal byte sequence");
-      }
-      --ucc;
-      continue;
     }
-    if ((ucc = isutf8first(uc) - 1) > 0)
-      continue;
-    if (!isalnum_(uc))
-      break;
+    ++p;
   }
   return (const char*)p;
 }
@@ -601,8 +701,37 @@ static void *convert_str_to_wstr(const char *src, size_t *plen) {
 }
 #endif
 
-static Token *read_string(const char **pp) {
+// Decode characters of string literal after the opening '"', and return the next of closing one.
+static const char *decode_string(const char *p, bool is_wide, char **pstr, size_t *plen,
+                                 size_t *pcapa) {
   const int ADD = 16;
+  char *str = *pstr;
+  size_t len = *plen, capa = *pcapa;
+  for (int c; (c = *(unsigned char*)p++) != '"'; ) {
+    if (c == '\0')
+      lex_error(p - 1, "String not closed");
+    if (len + 1 >= capa) {
+      capa += ADD;
+      str = realloc_or_die(str, capa * sizeof(*str));
+    }
+
+    if (c == '\\') {
+      c = *(unsigned char*)p;
+      if (c == '\0')
+        lex_error(p, "String not closed");
+      c = backslash(c, is_wide, &p);
+      ++p;
+    }
+    assert(len < capa);
+    str[len++] = c;
+  }
+  *pstr = str;
+  *plen = len;
+  *pcapa = capa;
+  return p;
+}
+
+static Token *read_string(const char **pp) {
   const char *p = *pp;
   const char *begin, *end;
   size_t capa = 16, len = 0;
@@ -619,24 +748,7 @@ static Token *read_string(const char **pp) {
     ++p;
   }
 #endif
-    for (int c; (c = *(unsigned char*)p++) != '"'; ) {
-      if (c == '\0')
-        lex_error(p - 1, "String not closed");
-      if (len + 1 >= capa) {
-        capa += ADD;
-        str = realloc_or_die(str, capa * sizeof(*str));
-      }
-
-      if (c == '\\') {
-        c = *(unsigned char*)p;
-        if (c == '\0')
-          lex_error(p, "String not closed");
-        c = backslash(c, is_wide, &p);
-        ++p;
-      }
-      assert(len < capa);
-      str[len++] = c;
-    }
+    p = decode_string(p, is_wide, &str, &len, &capa);
     end = p;
     if (for_preprocess)
       break;
@@ -724,6 +836,20 @@ static Token *get_token(void) {
   static Line kEofLine = {.buf = ""};
   static Token kEofToken = {.kind = TK_EOF, .line = &kEofLine};
 
+  if (replay.tokens != NULL) {
+    if (replay.index < replay.tokens->len)
+      return replay.tokens->data[replay.index++];
+    kEofLine.filename = lexer.filename;
+    kEofLine.lineno = lexer.lineno;
+    return &kEofToken;
+  }
+
+  if (from_token_stream) {
+    Token *tok = get_stream_token();
+    if (tok != NULL)
+      return tok;
+  }
+
   const char *p = lexer.p;
   if (p == NULL || (p = skip_whitespace_or_comment(p)) == NULL) {
     if ((p = lexer.p) != NULL && *p != '\0')
@@ -808,3 +934,901 @@ void unget_token(Token *token) {
   assert(lexer.idx < MAX_LEX_LOOKAHEAD);
   lexer.fetched[lexer.idx] = token;
 }
+
+// Binary token stream: cpp (--token-output) => cc1 (--token-input)
+//
+// Tokens which cpp has already lexed are passed to cc1 as is,
+// so that cc1 does not have to scan characters again.
+// Token locations in the source line are kept for error messages, and the line itself
+// is read from the file only when an error is reported. Its text is carried in the stream
+// only for a source which cannot be read again (stdin).
+//
+//   stream   := magic (line | pch)*
+//   line     := uleb(count * 4 + has_text * 2 + new_file) position [string(text)] token*
+//   position := uleb(file) uleb(lineno)      (new_file: also when lines go backward)
+//             | uleb(lineno - previous - 1)  (same file as the previous line)
+//   token    := byte(kind + implicit * 0x80) payload [location]
+//     TK_IDENT:     uleb(name)
+//     TK_INTLIT:    uleb(value) uleb(flag)
+//     TK_FLOATLIT:  bytes(value) byte(kind) string(spelling)
+//     TK_STR:       uleb(len * 2 + is_wide) bytes  (decoded, without terminator)
+//                   (Spelling of TK_INTLIT is in decimal, and TK_STR has none.)
+//     PPTK_OTHERCHAR, PPTK_STRINGIFY, PPTK_CONCAT:  string(spelling)
+//     others:       (none)
+//     implicit: Location is omitted, and is the same as the previous token if it has width,
+//               otherwise the spelling is right after it.
+//   location := uleb(0)  (same as the previous token, e.g. expanded from a macro)
+//             | uleb((zigzag(column - end of previous) * 2 + has_width) + 1) [uleb(width)]
+//     width is omitted when the spelling which cc1 knows is there (to verify the source line).
+//   file, name := index to the table, followed by string if it appears first time.
+//   pch      := uleb(0) string(path) uleb(size) uleb(mtime)
+//     Tokens of a header are in its precompiled header: cc1 loads the global scope in it,
+//     or reads the tokens as if they were here.
+//   string := uleb(len) bytes
+
+static const unsigned char kTokenStreamMagic[] = {0x7f, 'X', 'T', 'S', '4'};
+static const unsigned char kPchMagic[] = {0x7f, 'X', 'P', 'C', 'H', '4'};
+
+static struct {
+  FILE *ofp;
+  DataStorage header, data;  // Current line.
+  Table names;  // <index + 1>
+  Table files;  // <index + 1>
+  int name_count, file_count;
+  const char *filename;
+  int lineno;
+  const char *last_filename;  // Position written last.
+  int last_lineno;
+  int token_count;
+  bool carry_text;  // Source cannot be read again.
+  DataStorage text;  // Source text of current line.
+  const char *line_begin, *line_end;  // Source line being preprocessed, to locate tokens.
+  size_t column, width;  // Location of the last token, used also for expanded ones.
+  size_t last_column, last_width;  // Location written last.
+  bool last_inexact;  // Whether the location written last is with width.
+  bool wide_str;  // Last token is a string literal concatenated to a wide one.
+  char *str_buf;  // Work buffer to decode string literals.
+  size_t str_capa;
+} token_writer;
+
+static void put_indexed_name(DataStorage *data, Table *table, int *pcount, const Name *name) {
+  intptr_t index = VOIDP2INT(table_get(table, name)) - 1;
+  if (index >= 0) {
+    data_uleb128(data, -1, index);
+  } else {
+    index = (*pcount)++;
+    table_put(table, name, INT2VOIDP(index + 1));
+    data_uleb128(data, -1, index);
+    data_string(data, name->chars, name->bytes);
+  }
+}
+
+static void flush_token_line(void) {
+  if (token_writer.token_count <= 0)
+    return;
+
+  DataStorage *header = &token_writer.header;
+  header->len = 0;
+  bool new_file = token_writer.filename != token_writer.last_filename ||
+                  token_writer.lineno <= token_writer.last_lineno;
+  data_uleb128(header, -1, token_writer.token_count * 4 + token_writer.carry_text * 2 + new_file);
+  if (new_file) {
+    put_indexed_name(header, &token_writer.files, &token_writer.file_count,
+                     alloc_name(token_writer.filename, NULL, false));
+    data_uleb128(header, -1, token_writer.lineno);
+  } else {
+    data_uleb128(header, -1, token_writer.lineno - token_writer.last_lineno - 1);
+  }
+  token_writer.last_filename = token_writer.filename;
+  token_writer.last_lineno = token_writer.lineno;
+  if (token_writer.carry_text)
+    data_string(header, token_writer.text.buf, token_writer.text.len);
+  fwrite(header->buf, 1, header->len, token_writer.ofp);
+  fwrite(token_writer.data.buf, 1, token_writer.data.len, token_writer.ofp);
+
+  token_writer.data.len = 0;
+  token_writer.token_count = 0;
+}
+
+void init_token_output(FILE *ofp) {
+  token_writer.ofp = ofp;
+  data_init(&token_writer.header);
+  data_init(&token_writer.data);
+  data_init(&token_writer.text);
+  table_init(&token_writer.names);
+  table_init(&token_writer.files);
+  token_writer.name_count = token_writer.file_count = 0;
+  token_writer.filename = token_writer.last_filename = NULL;
+  token_writer.lineno = token_writer.last_lineno = 0;
+  token_writer.token_count = 0;
+  token_writer.carry_text = false;
+  token_writer.wide_str = false;
+  token_writer.str_buf = NULL;
+  token_writer.str_capa = 0;
+  fwrite(kTokenStreamMagic, 1, sizeof(kTokenStreamMagic), ofp);
+}
+
+void put_token_line(const char *filename, int lineno, const char *line) {
+  flush_token_line();
+  if (filename != token_writer.filename)
+    token_writer.carry_text = filename == NULL || !is_file(filename);
+  token_writer.filename = filename;
+  token_writer.lineno = lineno;
+
+  size_t len = strlen(line);
+  while (len > 0 && (line[len - 1] == '\n' || line[len - 1] == '\r'))
+    --len;
+  token_writer.text.len = 0;
+  data_append(&token_writer.text, line, len);
+  token_writer.line_begin = line;
+  token_writer.line_end = line + len;
+  token_writer.column = token_writer.width = 0;
+  token_writer.last_column = token_writer.last_width = 0;
+  token_writer.last_inexact = false;
+}
+
+// Tokens out of the source line (from macro or continued line) are located at the last one.
+bool set_token_origin(const Token *tok) {
+  uintptr_t begin = (uintptr_t)tok->begin, end = (uintptr_t)tok->end;
+  if (begin < (uintptr_t)token_writer.line_begin || end > (uintptr_t)token_writer.line_end ||
+      begin > end)
+    return false;
+  size_t column = tok->begin - token_writer.line_begin, width = tok->end - tok->begin;
+  // Line buffer might be reused for a continued line.
+  if (memcmp(token_writer.text.buf + column, tok->begin, width) != 0)
+    return false;
+  token_writer.column = column;
+  token_writer.width = width;
+  return true;
+}
+
+// Put location of the token, or mark the kind at `kind_pos` implicit.
+static void put_token_location(DataStorage *data, size_t kind_pos, const Token *tok, bool exact,
+                               const char *spelling, size_t spelling_len) {
+  size_t column = token_writer.column, width = token_writer.width;
+  bool last_inexact = token_writer.last_inexact;
+  if (column == token_writer.last_column && width == token_writer.last_width) {
+    if (last_inexact)
+      data->buf[kind_pos] |= 0x80;
+    else
+      data_push(data, 0);
+    token_writer.last_inexact = true;
+    return;
+  }
+  int64_t gap = (int64_t)column - (int64_t)(token_writer.last_column + token_writer.last_width);
+  bool has_width = !exact || width != spelling_len || memcmp(tok->begin, spelling, width) != 0;
+  token_writer.last_column = column;
+  token_writer.last_width = width;
+  token_writer.last_inexact = has_width;
+  if (gap == 0 && !has_width && !last_inexact) {
+    data->buf[kind_pos] |= 0x80;
+    return;
+  }
+  uint64_t zigzag = gap >= 0 ? (uint64_t)gap * 2 : (uint64_t)(-gap) * 2 - 1;
+  data_uleb128(data, -1, (zigzag * 2 + has_width) + 1);
+  if (has_width)
+    data_uleb128(data, -1, width);
+}
+
+void put_token(const Token *tok) {
+  if (tok->kind == PPTK_SPACE)
+    return;
+  if (tok->line == NULL) {
+    // Generated in preprocessor (`##`, `#` or `__LINE__`): Lex its spelling.
+    Lexer bak_lexer = lexer;
+    LexEofCallback bak_callback = set_lex_eof_callback(NULL);
+    set_source_string(strndup(tok->begin, tok->end - tok->begin), lexer.filename, lexer.lineno);
+    for (Token *t; (t = match(-1))->kind != TK_EOF; )
+      put_token(t);
+    set_lex_eof_callback(bak_callback);
+    lexer = bak_lexer;
+    return;
+  }
+
+  bool exact = set_token_origin(tok);
+
+  DataStorage *data = &token_writer.data;
+  const char *spelling = NULL;  // Spelling which cc1 knows.
+  size_t spelling_len = (size_t)-1;
+  char numbuf[32];
+  size_t kind_pos = data->len;
+  assert(tok->kind < 0x80);
+  data_push(data, tok->kind);
+  switch (tok->kind) {
+  case TK_IDENT:
+    put_indexed_name(data, &token_writer.names, &token_writer.name_count, tok->ident);
+    spelling = tok->ident->chars;
+    spelling_len = tok->ident->bytes;
+    break;
+  case TK_INTLIT:
+    data_uleb128(data, -1, (UFixnum)tok->fixnum.value);
+    data_uleb128(data, -1, tok->fixnum.flag);
+    spelling = numbuf;
+    spelling_len = snprintf(numbuf, sizeof(numbuf), "%llu", (unsigned long long)tok->fixnum.value);
+    break;
+#ifndef __NO_FLONUM
+  case TK_FLOATLIT:
+    {
+      union { Flonum value; unsigned char bytes[sizeof(Flonum)]; } u;
+      memset(&u, 0, sizeof(u));  // Clear padding bytes.
+      u.value = tok->flonum.value;
+      data_append(data, u.bytes, sizeof(u.bytes));
+      data_push(data, tok->flonum.kind);
+      spelling = tok->begin;
+      spelling_len = tok->end - tok->begin;
+      data_string(data, spelling, spelling_len);
+    }
+    break;
+#endif
+  case TK_STR:
+    {
+      // Decode again, instead of using the payload: Characters are not converted to wide ones,
+      // and escape sequences after a wide string literal are decoded as wide, as cc1 does.
+      const char *p = tok->begin;
+      bool is_wide = *p == 'L';
+      p += is_wide ? 2 : 1;
+      token_writer.wide_str |= is_wide;
+      size_t len = 0;
+      decode_string(p, token_writer.wide_str, &token_writer.str_buf, &len,
+                    &token_writer.str_capa);
+      data_uleb128(data, -1, len * 2 + is_wide);
+      data_append(data, token_writer.str_buf, len);
+    }
+    break;
+  case PPTK_OTHERCHAR: case PPTK_STRINGIFY: case PPTK_CONCAT:
+    spelling = tok->begin;
+    spelling_len = tok->end - tok->begin;
+    data_string(data, spelling, spelling_len);
+    break;
+  default:
+    spelling = operator_text(tok->kind);
+    if (spelling != NULL)
+      spelling_len = strlen(spelling);
+    break;
+  }
+  if (tok->kind != TK_STR)
+    token_writer.wide_str = false;
+  put_token_location(data, kind_pos, tok, exact, spelling, spelling_len);
+  ++token_writer.token_count;
+}
+
+void flush_token_output(void) {
+  flush_token_line();
+  data_release(&token_writer.header);
+  data_release(&token_writer.data);
+  data_release(&token_writer.text);
+  free(token_writer.str_buf);
+  token_writer.str_buf = NULL;
+  token_writer.str_capa = 0;
+}
+
+// Tables of names and files in index order, to decode tokens written so far.
+void save_token_output(Vector *names, Vector *files) {
+  Table *tables[] = {&token_writer.names, &token_writer.files};
+  Vector *vecs[] = {names, files};
+  int counts[] = {token_writer.name_count, token_writer.file_count};
+  for (int i = 0; i < 2; ++i) {
+    Vector *vec = vecs[i];
+    vec_clear(vec);
+    for (int j = 0; j < counts[i]; ++j)
+      vec_push(vec, NULL);
+    const Name *name;
+    void *value;
+    for (int it = 0; (it = table_iterate(tables[i], it, &name, &value)) != -1; )
+      vec->data[VOIDP2INT(value) - 1] = (void*)name;
+  }
+}
+
+void put_pch_header(unsigned char *buf, const uint64_t offsets[PCH_OFFSET_COUNT]) {
+  assert(sizeof(kPchMagic) + PCH_OFFSET_COUNT * 8 == PCH_HEADER_SIZE);
+  memcpy(buf, kPchMagic, sizeof(kPchMagic));
+  buf += sizeof(kPchMagic);
+  for (int i = 0; i < PCH_OFFSET_COUNT; ++i, buf += 8) {
+    for (int j = 0; j < 8; ++j)
+      buf[j] = offsets[i] >> (j * 8);
+  }
+}
+
+bool read_pch_header(const void *buf, size_t size, uint64_t offsets[PCH_OFFSET_COUNT]) {
+  const unsigned char *p = buf;
+  if (size < PCH_HEADER_SIZE || memcmp(p, kPchMagic, sizeof(kPchMagic)) != 0)
+    return false;
+  p += sizeof(kPchMagic);
+  for (int i = 0; i < PCH_OFFSET_COUNT; ++i, p += 8) {
+    uint64_t value = 0;
+    for (int j = 0; j < 8; ++j)
+      value |= (uint64_t)p[j] << (j * 8);
+    offsets[i] = value;
+  }
+  return offsets[PCH_SCOPE_OFFSET] <= size &&
+         offsets[PCH_TOKENS_OFFSET] <= offsets[PCH_SCOPE_OFFSET] &&
+         offsets[PCH_TOKENS_SIZE] <= offsets[PCH_SCOPE_OFFSET] - offsets[PCH_TOKENS_OFFSET];
+}
+
+// Refer to the precompiled header instead of putting its tokens,
+// and restore the tables used to encode them.
+void put_token_pch(const char *filename, const Vector *names, const Vector *files) {
+  assert(token_writer.name_count == 0 && token_writer.file_count == 0);
+  struct stat st;
+  if (stat(filename, &st) != 0)
+    error("Cannot open file: %s", filename);
+  flush_token_line();
+  DataStorage *data = &token_writer.data;
+  data_uleb128(data, -1, 0);
+  data_string(data, filename, strlen(filename));
+  data_uleb128(data, -1, st.st_size);
+  data_uleb128(data, -1, st.st_mtime);
+  fwrite(data->buf, 1, data->len, token_writer.ofp);
+  data->len = 0;
+  token_writer.wide_str = false;
+  token_writer.last_filename = NULL;  // Position is unknown.
+
+  Table *tables[] = {&token_writer.names, &token_writer.files};
+  const Vector *vecs[] = {names, files};
+  for (int i = 0; i < 2; ++i) {
+    table_init(tables[i]);
+    for (int j = 0; j < vecs[i]->len; ++j)
+      table_put(tables[i], vecs[i]->data[j], INT2VOIDP(j + 1));
+  }
+  token_writer.name_count = names->len;
+  token_writer.file_count = files->len;
+}
+
+// Decoded line: Tokens point to their spellings put in `Line::buf`,
+// and the source line is looked up with their locations (`LineOrigin`) only for error messages.
+static struct {
+  const unsigned char *p, *end;
+  Vector *names;  // <const Name*>
+  Vector *name_kinds;  // <enum TokenKind>
+  Vector *files;  // <const char*>
+  Token *tokens;  // Tokens on current line.
+  int count, index;
+  DataStorage text;  // Work buffer for line.
+  const char *filename;  // Position of the last line.
+  int lineno;
+  const unsigned char *outer_p, *outer_end;  // Stream referring to the precompiled header,
+                                             // while reading the tokens in it.
+} token_reader;
+
+static LexPchCallback lex_pch_callback;
+
+LexPchCallback set_lex_pch_callback(LexPchCallback callback) {
+  LexPchCallback old = lex_pch_callback;
+  lex_pch_callback = callback;
+  return old;
+}
+
+static void broken_token_stream(void) {
+  lexer.line = NULL;
+  lex_error(NULL, "Broken token stream");
+}
+
+static unsigned char read_stream_byte(void) {
+  if (token_reader.p >= token_reader.end)
+    broken_token_stream();
+  return *token_reader.p++;
+}
+
+static uint64_t read_stream_uleb128(void) {
+  uint64_t value = 0;
+  for (int shift = 0; ; shift += 7) {
+    unsigned char c = read_stream_byte();
+    value |= (uint64_t)(c & 0x7f) << shift;
+    if (!(c & 0x80))
+      return value;
+  }
+}
+
+static const char *read_stream_bytes(size_t size) {
+  const unsigned char *p = token_reader.p;
+  if (size > (size_t)(token_reader.end - p))
+    broken_token_stream();
+  token_reader.p = p + size;
+  return (const char*)p;
+}
+
+// Read index to the table, and register the string if it appears first time.
+static int read_stream_index(Vector *table, bool is_name) {
+  uint64_t index = read_stream_uleb128();
+  if (index == (uint64_t)table->len) {
+    size_t len = read_stream_uleb128();
+    const char *chars = read_stream_bytes(len);
+    if (is_name) {
+      const Name *name = alloc_name(chars, chars + len, true);
+      vec_push(table, name);
+      vec_push(token_reader.name_kinds, INT2VOIDP(reserved_word(name)));
+    } else {
+      vec_push(table, strndup(chars, len));
+    }
+  } else if (index > (uint64_t)table->len) {
+    broken_token_stream();
+  }
+  return index;
+}
+
+static const char *operator_text(enum TokenKind kind) {
+  static const char *texts[PPTK_CONCAT];
+  static char single_texts[PPTK_CONCAT][2];
+  if (texts[TK_ADD] == NULL) {
+    for (int i = 0; i < (int)ARRAY_SIZE(kMultiOperators); ++i)
+      texts[kMultiOperators[i].kind] = kMultiOperators[i].ident;
+    for (int c = 0; c < (int)sizeof(kOperatorMap); ++c) {
+      enum TokenKind k = kOperatorMap[c];
+      if (k != 0) {
+        single_texts[k][0] = c;
+        texts[k] = single_texts[k];
+      }
+    }
+    for (int c = 0; c < (int)sizeof(kPunctMap); ++c) {
+      enum TokenKind k = kPunctMap[c];
+      if (k != 0) {
+        single_texts[k][0] = c;
+        texts[k] = single_texts[k];
+      }
+    }
+  }
+  return (unsigned int)kind < ARRAY_SIZE(texts) ? texts[kind] : NULL;
+}
+
+static void init_token_reader(const unsigned char *buf, size_t size, const char *filename) {
+  set_source_file(NULL, filename);
+  from_token_stream = true;
+  token_reader.p = buf;
+  token_reader.end = buf + size;
+  token_reader.names = new_vector();
+  token_reader.name_kinds = new_vector();
+  token_reader.files = new_vector();
+  token_reader.tokens = NULL;
+  token_reader.count = token_reader.index = 0;
+  data_init(&token_reader.text);
+  token_reader.filename = NULL;
+  token_reader.lineno = 0;
+  token_reader.outer_p = token_reader.outer_end = NULL;
+
+  if (size < sizeof(kTokenStreamMagic) ||
+      memcmp(buf, kTokenStreamMagic, sizeof(kTokenStreamMagic)) != 0)
+    broken_token_stream();
+  token_reader.p += sizeof(kTokenStreamMagic);
+}
+
+void set_source_token_stream(FILE *fp, const char *filename) {
+  size_t size;
+  unsigned char *buf = read_to_end(fp, &size);
+  init_token_reader(buf, size, filename);
+}
+
+// Map the precompiled header, which is kept while compiling: Names and tokens point into it.
+static const unsigned char *map_pch(const char *filename, uint64_t offsets[PCH_OFFSET_COUNT],
+                                    size_t *psize) {
+  const unsigned char *buf = map_file(filename, psize);
+  if (buf == NULL || !read_pch_header(buf, *psize, offsets)) {
+    lexer.line = NULL;
+    lex_error(NULL, "Broken precompiled header: %s", filename);
+  }
+  return buf;
+}
+
+// Read the tokens made by cpp, to append the global scope after them.
+size_t set_source_pch(const char *filename) {
+  uint64_t offsets[PCH_OFFSET_COUNT];
+  size_t size;
+  const unsigned char *buf = map_pch(filename, offsets, &size);
+  init_token_reader(buf + offsets[PCH_TOKENS_OFFSET], offsets[PCH_TOKENS_SIZE], filename);
+  return offsets[PCH_SCOPE_OFFSET];
+}
+
+// Tables of names and files in index order, to decode the rest of the stream.
+void save_token_input(Vector *names, Vector *files) {
+  vec_clear(names);
+  vec_concat(names, token_reader.names);
+  vec_clear(files);
+  vec_concat(files, token_reader.files);
+}
+
+void restore_token_input(Vector *names, Vector *files) {
+  token_reader.names = names;
+  token_reader.files = files;
+  Vector *kinds = token_reader.name_kinds;
+  vec_clear(kinds);
+  for (int i = 0; i < names->len; ++i)
+    vec_push(kinds, INT2VOIDP(reserved_word(names->data[i])));
+}
+
+// Use the precompiled header in place of its tokens: Load the global scope in it if possible,
+// otherwise read the tokens, and come back to the outer stream after them.
+static void read_stream_pch(void) {
+  if (token_reader.outer_p != NULL)
+    broken_token_stream();
+  size_t len = read_stream_uleb128();
+  const char *filename = strndup(read_stream_bytes(len), len);
+  uint64_t size = read_stream_uleb128();
+  uint64_t mtime = read_stream_uleb128();
+  struct stat st;
+  if (stat(filename, &st) != 0 || (uint64_t)st.st_size != size ||
+      (uint64_t)st.st_mtime != mtime) {
+    lexer.line = NULL;
+    lex_error(NULL, "Precompiled header changed: %s", filename);
+  }
+
+  uint64_t offsets[PCH_OFFSET_COUNT];
+  size_t mapped_size;
+  const unsigned char *buf = map_pch(filename, offsets, &mapped_size);
+  uint64_t scope_offset = offsets[PCH_SCOPE_OFFSET];
+  if (lex_pch_callback != NULL && scope_offset < mapped_size &&
+      (*lex_pch_callback)(buf + scope_offset, mapped_size - scope_offset))
+    return;
+
+  const unsigned char *tokens = buf + offsets[PCH_TOKENS_OFFSET];
+  size_t tokens_size = offsets[PCH_TOKENS_SIZE];
+  if (tokens_size < sizeof(kTokenStreamMagic) ||
+      memcmp(tokens, kTokenStreamMagic, sizeof(kTokenStreamMagic)) != 0)
+    broken_token_stream();
+  token_reader.outer_p = token_reader.p;
+  token_reader.outer_end = token_reader.end;
+  token_reader.p = tokens + sizeof(kTokenStreamMagic);
+  token_reader.end = tokens + tokens_size;
+}
+
+// Decode tokens on next line, and put their spellings into the line buffer
+// for error messages.
+static bool read_token_line(void) {
+  uint64_t header;
+  for (;;) {
+    if (token_reader.p >= token_reader.end) {
+      if (token_reader.outer_p == NULL)
+        return false;
+      // End of the tokens in precompiled header.
+      token_reader.p = token_reader.outer_p;
+      token_reader.end = token_reader.outer_end;
+      token_reader.outer_p = token_reader.outer_end = NULL;
+      continue;
+    }
+    header = read_stream_uleb128();
+    if (header != 0)
+      break;
+    read_stream_pch();
+  }
+
+  int count = header / 4;
+  if (count <= 0)
+    broken_token_stream();
+  if (header & 1) {
+    int file_index = read_stream_index(token_reader.files, false);
+    token_reader.filename = token_reader.files->data[file_index];
+    token_reader.lineno = read_stream_uleb128();
+  } else {
+    if (token_reader.filename == NULL)
+      broken_token_stream();
+    token_reader.lineno += read_stream_uleb128() + 1;
+  }
+  const char *filename = token_reader.filename;
+  int lineno = token_reader.lineno;
+  const char *source = NULL;
+  size_t source_len = 0;
+  if (header & 2) {
+    source_len = read_stream_uleb128();
+    source = strndup(read_stream_bytes(source_len), source_len);
+  }
+
+  // Tokens, line and locations are allocated at once.
+  Token *tokens = malloc_or_die(sizeof(*tokens) * count + sizeof(Line) + sizeof(LineOrigin) +
+                                sizeof(struct TokenLocation) * count);
+  Line *line = (Line*)&tokens[count];
+  LineOrigin *origin = (LineOrigin*)&line[1];
+  struct TokenLocation *locations = (struct TokenLocation*)&origin[1];
+  line->filename = filename;
+  line->lineno = lineno;
+  line->origin = origin;
+  origin->tokens = tokens;
+  origin->count = count;
+  origin->source = source;
+  origin->locations = locations;
+
+  DataStorage *text = &token_reader.text;
+  text->len = 0;
+  size_t last_column = 0, last_width = 0;
+  for (int i = 0; i < count; ++i) {
+    unsigned char kind_byte = read_stream_byte();
+    enum TokenKind kind = kind_byte & 0x7f;
+    Token *tok = &tokens[i];
+    tok->kind = kind;
+    tok->line = line;
+    const char *spelling;
+    size_t len;
+    size_t spelling_len = (size_t)-1;
+    char numbuf[32];
+    StringBuffer sb;
+    switch (kind) {
+    case TK_IDENT:
+      {
+        int index = read_stream_index(token_reader.names, true);
+        const Name *name = token_reader.names->data[index];
+        tok->kind = VOIDP2INT(token_reader.name_kinds->data[index]);
+        if (tok->kind == TK_EOF) {
+          tok->kind = TK_IDENT;
+          tok->ident = name;
+        }
+        spelling = name->chars;
+        spelling_len = len = name->bytes;
+      }
+      break;
+    case TK_INTLIT:
+      tok->fixnum.value = read_stream_uleb128();
+      tok->fixnum.flag = read_stream_uleb128();
+      spelling_len = len = snprintf(numbuf, sizeof(numbuf), "%llu",
+                                    (unsigned long long)tok->fixnum.value);
+      spelling = numbuf;
+      break;
+#ifndef __NO_FLONUM
+    case TK_FLOATLIT:
+      {
+        union { Flonum value; unsigned char bytes[sizeof(Flonum)]; } u;
+        memcpy(u.bytes, read_stream_bytes(sizeof(u.bytes)), sizeof(u.bytes));
+        tok->flonum.value = u.value;
+        tok->flonum.kind = read_stream_byte();
+        spelling_len = len = read_stream_uleb128();
+        spelling = read_stream_bytes(len);
+      }
+      break;
+#endif
+    case TK_STR:
+      {
+        uint64_t len_wide = read_stream_uleb128();
+        size_t size = len_wide / 2;
+        const char *bytes = read_stream_bytes(size);
+        char *str = malloc_or_die(size + 1);
+        memcpy(str, bytes, size);
+        str[size] = '\0';
+        tok->str.buf = str;
+        tok->str.len = size + 1;
+        tok->str.kind = len_wide & 1 ? STR_WIDE : STR_CHAR;
+
+        sb_init(&sb);
+        sb_append(&sb, len_wide & 1 ? "L\"" : "\"", NULL);
+        escape_string(str, size, &sb);
+        sb_append(&sb, "\"", NULL);
+        spelling = sb_to_string(&sb);
+        len = strlen(spelling);
+      }
+      break;
+    case PPTK_OTHERCHAR: case PPTK_STRINGIFY: case PPTK_CONCAT:
+      spelling_len = len = read_stream_uleb128();
+      spelling = read_stream_bytes(len);
+      break;
+    default:
+      spelling = operator_text(kind);
+      if (spelling == NULL)
+        broken_token_stream();
+      spelling_len = len = strlen(spelling);
+      break;
+    }
+    if (i > 0)
+      data_push(text, ' ');
+    tok->begin = (const char*)(uintptr_t)text->len;  // Offset, until the buffer is fixed.
+    data_append(text, spelling, len);
+    tok->end = (const char*)(uintptr_t)text->len;
+    if (kind == TK_STR)
+      free((char*)spelling);
+
+    uint64_t location;
+    if (kind_byte & 0x80)
+      location = i > 0 && !locations[i - 1].exact ? 0 : 1;  // Same, or gap = 0.
+    else
+      location = read_stream_uleb128();
+    bool exact = false;
+    if (location > 0) {
+      --location;
+      uint64_t zigzag = location / 2;
+      int64_t gap = zigzag & 1 ? -(int64_t)((zigzag + 1) / 2) : (int64_t)(zigzag / 2);
+      int64_t column = (int64_t)(last_column + last_width) + gap;
+      exact = !(location & 1);
+      size_t width = exact ? spelling_len : read_stream_uleb128();
+      if (column < 0 || width == (size_t)-1 ||
+          (source != NULL && ((size_t)column > source_len || width > source_len - column)))
+        broken_token_stream();
+      last_column = column;
+      last_width = width;
+    }
+    locations[i].column = last_column;
+    locations[i].width = last_width;
+    locations[i].exact = exact;
+  }
+  data_push(text, '\0');
+
+  char *buf = malloc_or_die(text->len);
+  memcpy(buf, text->buf, text->len);
+  for (int i = 0; i < count; ++i) {
+    Token *tok = &tokens[i];
+    tok->begin = buf + (uintptr_t)tok->begin;
+    tok->end = buf + (uintptr_t)tok->end;
+  }
+  line->buf = buf;
+
+  token_reader.tokens = tokens;
+  token_reader.count = count;
+  token_reader.index = 0;
+  lexer.filename = filename;
+  lexer.lineno = lineno;
+  lexer.line = line;
+  lexer.p = buf;
+  return true;
+}
+
+// Concatenate adjacent string literals, which might continue to next lines.
+static Token *concat_stream_strings(Token *first) {
+  Line *line = first->line;
+  const char *end = first->end;
+  bool is_wide = first->str.kind == STR_WIDE;
+  size_t len = first->str.len - 1, capa = 0;
+  char *str = NULL;
+  for (;;) {
+    if (token_reader.index >= token_reader.count && !read_next_line())
+      break;
+    Token *next = &token_reader.tokens[token_reader.index];
+    if (next->kind != TK_STR)
+      break;
+    ++token_reader.index;
+
+    size_t size = next->str.len - 1;
+    if (len + size + 1 > capa) {
+      capa = (len + size + 1) * 2;
+      char *buf = realloc_or_die(str, capa);
+      if (str == NULL)
+        memcpy(buf, first->str.buf, len);
+      str = buf;
+    }
+    memcpy(str + len, next->str.buf, size);
+    len += size;
+    is_wide |= next->str.kind == STR_WIDE;
+    if (lexer.line == line)
+      end = next->end;
+  }
+  if (str == NULL && !is_wide)
+    return first;
+
+  if (str == NULL)
+    str = (char*)first->str.buf;
+  else
+    str[len] = '\0';
+  ++len;
+
+  enum StrKind kind = STR_CHAR;
+#ifndef __NO_WCHAR
+  if (is_wide) {
+    str = convert_str_to_wstr(str, &len);
+    kind = STR_WIDE;
+  }
+#endif
+  Token *tok = alloc_token(TK_STR, line, first->begin, end);
+  tok->str.buf = str;
+  tok->str.len = len;
+  tok->str.kind = kind;
+  return tok;
+}
+
+static Token *get_stream_token(void) {
+  while (token_reader.index >= token_reader.count) {
+    if (!read_token_line()) {
+      lexer.p = NULL;
+      return NULL;
+    }
+  }
+
+  Token *tok = &token_reader.tokens[token_reader.index++];
+  switch (tok->kind) {
+  case TK_STR:
+    tok = concat_stream_strings(tok);
+    break;
+  case PPTK_OTHERCHAR: case PPTK_STRINGIFY: case PPTK_CONCAT:
+    lex_error(tok->begin, "Unexpected character `%c'(%d)", *tok->begin, *tok->begin);
+    break;
+  default:
+    break;
+  }
+  lexer.p = token_reader.index > 0 ? token_reader.tokens[token_reader.index - 1].end
+                                   : lexer.line->buf;
+  return tok;
+}
+
+// Source file read to show its line in error messages.
+static struct {
+  const char *filename;
+  char *buf;
+  size_t size;
+} source_cache;
+
+void reset_lexer(void) {
+  for_preprocess = from_token_stream = false;
+  source_buffer.p = source_buffer.end = NULL;
+  replay.tokens = NULL;
+  replay.index = 0;
+  memset(&lexer, 0, sizeof(lexer));
+  lexer.p = "";
+  lexer.idx = -1;
+  lex_eof_callback = NULL;
+  token_writer.ofp = NULL;
+  token_reader.p = token_reader.end = NULL;
+  token_reader.outer_p = token_reader.outer_end = NULL;
+  lex_pch_callback = NULL;
+  free(source_cache.buf);
+  source_cache.filename = NULL;
+  source_cache.buf = NULL;
+  source_cache.size = 0;
+}
+
+static const char *read_source_line(const char *filename, int lineno, size_t *plen) {
+  if (source_cache.filename == NULL || strcmp(source_cache.filename, filename) != 0) {
+    free(source_cache.buf);
+    source_cache.filename = filename;
+    source_cache.buf = NULL;
+    FILE *fp = is_file(filename) ? fopen(filename, "r") : NULL;
+    if (fp == NULL)
+      return NULL;
+    source_cache.buf = read_to_end(fp, &source_cache.size);
+    fclose(fp);
+  }
+  if (source_cache.buf == NULL)
+    return NULL;
+
+  const char *p = source_cache.buf, *end = p + source_cache.size;
+  for (int i = 1; i < lineno; ++i) {
+    p = memchr(p, '\n', end - p);
+    if (p == NULL)
+      return NULL;
+    ++p;
+  }
+  const char *q = memchr(p, '\n', end - p);
+  if (q == NULL)
+    q = end;
+  if (q > p && q[-1] == '\r')
+    --q;
+  *plen = q - p;
+  return p;
+}
+
+// The source line might not match the locations, e.g. after `#line` or a continued line.
+static bool match_source_line(const LineOrigin *origin, const char *source, size_t len) {
+  for (int i = 0; i < origin->count; ++i) {
+    const struct TokenLocation *loc = &origin->locations[i];
+    if (loc->column > len || loc->width > len - loc->column)
+      return false;
+    const Token *tok = &origin->tokens[i];
+    if (loc->exact && memcmp(source + loc->column, tok->begin, loc->width) != 0)
+      return false;
+  }
+  return true;
+}
+
+void show_source_line(const Line *line, const char *p, int len) {
+  const LineOrigin *origin = line->origin;
+  if (origin != NULL) {
+    // Locate the token, and show the source line instead of spellings.
+    int index = -1;
+    for (int i = 0; i < origin->count; ++i) {
+      const Token *tok = &origin->tokens[i];
+      if (tok->begin <= p && p <= tok->end) {
+        index = i;
+        if (p < tok->end)
+          break;
+      }
+    }
+    size_t source_len = 0;
+    const char *source = origin->source;
+    if (source != NULL)
+      source_len = strlen(source);
+    else if (index >= 0)
+      source = read_source_line(line->filename, line->lineno, &source_len);
+    if (index >= 0 && source != NULL && match_source_line(origin, source, source_len)) {
+      const Token *tok = &origin->tokens[index];
+      const struct TokenLocation *loc = &origin->locations[index];
+      size_t spelling_len = tok->end - tok->begin;
+      size_t offset = loc->exact ? (size_t)(p - tok->begin) : 0;
+      int width = loc->exact || len != (int)spelling_len ? len : (int)loc->width;
+      char *text = strndup(source, source_len);
+      show_error_line(text, text + loc->column + offset, MAX(width, 1));
+      free(text);
+      return;
+    }
+  }
+  show_error_line(line->buf, p, len);
+}
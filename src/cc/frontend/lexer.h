@@ -1,6 +1,7 @@
 #pragma once
 
 #include <stdbool.h>
+#include <stdint.h>  // uint64_t
 #include <stdio.h>  // FILE
 
 #include "ast.h"  // Token, TokenKind
@@ -9,6 +10,7 @@
 
 typedef struct Line Line;
 typedef struct Name Name;
+typedef struct Vector Vector;
 
 typedef struct {
   FILE *fp;
@@ -20,9 +22,11 @@ typedef struct {
   int lineno;
 } Lexer;
 
+void reset_lexer(void);  // Clear the states left by the previous run.
 void init_lexer(void);
 void init_lexer_for_preprocessor(void);
 void set_source_file(FILE *fp, const char *filename);
+void set_source_whole_file(FILE *fp, const char *filename);
 void set_source_string(const char *line, const char *filename, int lineno);
 Token *fetch_token(void);
 Token *match(enum TokenKind kind);
@@ -31,7 +35,60 @@ const char *read_ident(const char *p);
 Token *alloc_dummy_ident(void);
 const char *get_lex_p(void);
 _Noreturn void lex_error(const char *p, const char *fmt, ...);
+void show_source_line(const Line *line, const char *p, int len);
 
 typedef bool (*LexEofCallback)(void);
 LexEofCallback set_lex_eof_callback(LexEofCallback callback);
 bool lex_eof_continue(void);
+
+// Replay tokens which are read beforehand, e.g. a function body to be parsed lazily.
+typedef struct {
+  Lexer lexer;
+  const Vector *tokens;
+  int index;
+} LexerState;
+
+void replay_tokens(const Vector *tokens, LexerState *saved);
+void restore_lexer(const LexerState *saved);
+
+// Binary token stream: cpp (--token-output) => cc1 (--token-input)
+void init_token_output(FILE *ofp);
+void put_token_line(const char *filename, int lineno, const char *line);
+bool set_token_origin(const Token *tok);
+void put_token(const Token *tok);
+void flush_token_output(void);
+void save_token_output(Vector *names, Vector *files);
+void set_source_token_stream(FILE *fp, const char *filename);
+void save_token_input(Vector *names, Vector *files);
+void restore_token_input(Vector *names, Vector *files);
+
+// Line decoded from token stream: Locations of its tokens in the source.
+typedef struct LineOrigin {
+  const Token *tokens;
+  int count;
+  const char *source;  // Source text carried in the stream, or NULL to read the file.
+  struct TokenLocation {
+    size_t column, width;
+    bool exact;  // Spelling is at the location, not expanded from a macro.
+  } *locations;
+} LineOrigin;
+
+// Precompiled header: Tokens of a header made by cpp, followed by the global scope
+// which cc1 appends after parsing them.
+enum {
+  PCH_TOKENS_OFFSET,
+  PCH_TOKENS_SIZE,
+  PCH_SCOPE_OFFSET,  // Size made by cpp: The global scope follows, if any.
+  PCH_OFFSET_COUNT,
+};
+
+#define PCH_HEADER_SIZE  (6 + PCH_OFFSET_COUNT * 8)  // Magic, and offsets in 64bit.
+
+void put_pch_header(unsigned char *buf, const uint64_t offsets[PCH_OFFSET_COUNT]);
+bool read_pch_header(const void *buf, size_t size, uint64_t offsets[PCH_OFFSET_COUNT]);
+void put_token_pch(const char *filename, const Vector *names, const Vector *files);
+size_t set_source_pch(const char *filename);  // Returns the offset to append the global scope.
+
+// Load the global scope in precompiled header, or return false to read its tokens.
+typedef bool (*LexPchCallback)(const void *scope, size_t size);
+LexPchCallback set_lex_pch_callback(LexPchCallback callback);
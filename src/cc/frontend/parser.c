@@ -585,7 +585,7 @@ static Vector *parse_asm_arg(void) {
       Expr *expr = parse_assign();
       consume(TK_RPAR, "`)' expected");
 
-      AsmArg *arg = calloc_or_die(sizeof(*arg));
+      AsmArg *arg = ast_alloc(sizeof(*arg));
       arg->constraint = constraint;
       arg->expr = expr;
       mark_var_used(expr);
@@ -872,38 +872,16 @@ static void modify_funparam_vla_type(Type *type, Scope *scope) {
 }
 #endif
 
-static Declaration *parse_defun(Type *functype, int storage, Token *ident, const Token *tok,
-                                Table *attributes) {
-  assert(functype->kind == TY_FUNC);
-
-  const Vector *param_vars = functype->func.param_vars;
-  if (functype->func.params == NULL) {  // Old-style
-    // Treat it as a zero-parameter function.
-    functype->func.params = new_vector();
-    functype->func.vaargs = false;
-    param_vars = new_vector();
-  }
-
-  Function *func = define_func(functype, ident, param_vars, storage, attributes);
-  VarInfo *varinfo = scope_find(global_scope, ident->ident, NULL);
-  assert(varinfo != NULL);
-  if (varinfo->global.func != NULL) {
-    parse_error(PE_NOFATAL, ident, "`%.*s' function already defined", NAMES(func->ident->ident));
-  } else {
-    varinfo->global.func = func;
-  }
-
+static void parse_defun_body(Function *func, VarInfo *varinfo, const Token *tok) {
   assert(curfunc == NULL);
   assert(is_global_scope(curscope));
   curfunc = func;
   static_vars = func->static_vars = new_vector();
   curvarinfo = varinfo;
+  const Vector *param_vars = func->params;
   Vector *top_vars = new_vector();
-  for (int i = 0; i < param_vars->len; ++i) {
-    VarInfo *vi = param_vars->data[i];
-    vec_push(top_vars, vi);
-    ensure_struct(vi->type, tok, curscope);
-  }
+  for (int i = 0; i < param_vars->len; ++i)
+    vec_push(top_vars, param_vars->data[i]);
   func->scopes = new_vector();
   Scope *scope = enter_scope(func);
   scope->vars = top_vars;
@@ -925,7 +903,6 @@ static Declaration *parse_defun(Type *functype, int storage, Token *ident, const
 
   func->body_block = parse_block(tok, scope);
   assert(is_global_scope(curscope));
-  match(TK_SEMICOL);  // Ignore redundant semicolon.
   curfunc = NULL;
   static_vars = NULL;
   curvarinfo = NULL;
@@ -947,6 +924,131 @@ static Declaration *parse_defun(Type *functype, int storage, Token *ident, const
 
   if (cc_flags.warn.unused_variable)
     check_unused_variables(func);
+}
+
+// Static inline functions, which headers define many, are mostly unused.
+// So their bodies are kept as tokens, and parsed on the first reference.
+static bool is_lazy_defun(const Function *func, int storage) {
+  if ((storage & (VS_STATIC | VS_INLINE)) != (VS_STATIC | VS_INLINE))
+    return false;
+  Table *attributes = func->attributes;
+  return attributes == NULL ||
+         (!table_try_get(attributes, alloc_name("constructor", NULL, false), NULL) &&
+          !table_try_get(attributes, alloc_name("destructor", NULL, false), NULL));
+}
+
+// Read tokens until the matching `}', without parsing.
+// Brackets are checked to nest, as the syntax check for a body which might be never parsed.
+static Vector *read_body_tokens(const Token *tok) {
+  Vector *tokens = new_vector();
+  vec_push(tokens, (Token*)tok);
+  Vector *closers = new_vector();  // <enum TokenKind>
+  vec_push(closers, INT2VOIDP(TK_RBRACE));
+  bool reported = false;  // Only the first mismatch, to avoid cascading errors.
+  while (closers->len > 0) {
+    Token *t = match(-1);
+    switch (t->kind) {
+    case TK_LPAR:      vec_push(closers, INT2VOIDP(TK_RPAR)); break;
+    case TK_LBRACE:    vec_push(closers, INT2VOIDP(TK_RBRACE)); break;
+    case TK_LBRACKET:  vec_push(closers, INT2VOIDP(TK_RBRACKET)); break;
+    case TK_RPAR: case TK_RBRACE: case TK_RBRACKET:
+      {
+        enum TokenKind expected = VOIDP2INT(closers->data[closers->len - 1]);
+        if (t->kind != expected && !reported) {
+          reported = true;
+          parse_error(PE_NOFATAL, t, "`%c' expected",
+                      expected == TK_RPAR ? ')' : expected == TK_RBRACE ? '}' : ']');
+        }
+        // Close up to the matching one, if any.
+        int i;
+        for (i = closers->len; --i >= 0; ) {
+          if (VOIDP2INT(closers->data[i]) == t->kind)
+            break;
+        }
+        if (i >= 0)
+          closers->len = i;
+      }
+      break;
+    case TK_EOF:  parse_error(PE_FATAL, NULL, "`}' expected"); break;
+    default: break;
+    }
+    vec_push(tokens, t);
+  }
+  free_vector(closers);
+  return tokens;
+}
+
+void parse_lazy_body(Function *func) {
+  Vector *tokens = func->body_tokens;
+  if (tokens == NULL)
+    return;
+  func->body_tokens = NULL;  // Referred from itself: not parsed yet, same as a recursive call.
+
+  // Might be in the middle of parsing another function: save the states.
+  Function *bak_curfunc = curfunc;
+  Scope *bak_curscope = curscope;
+  VarInfo *bak_curvarinfo = curvarinfo;
+  Vector *bak_static_vars = static_vars;
+  bool bak_parsing_stmt = parsing_stmt;
+  LoopScope bak_loop_scope = loop_scope;
+  LexerState lexer_state;
+  replay_tokens(tokens, &lexer_state);
+  int bak_limit = limit_global_decls(func->visible_decls);
+
+  curfunc = NULL;
+  curscope = global_scope;
+  curvarinfo = NULL;
+  static_vars = NULL;
+  loop_scope.swtch = loop_scope.break_ = loop_scope.continu = NULL;
+
+  const Token *tok = match(TK_LBRACE);
+  assert(tok != NULL);
+  VarInfo *varinfo = scope_find(global_scope, func->ident->ident, NULL);
+  assert(varinfo != NULL);
+  parse_defun_body(func, varinfo, tok);
+
+  limit_global_decls(bak_limit);
+  restore_lexer(&lexer_state);
+  curfunc = bak_curfunc;
+  curscope = bak_curscope;
+  curvarinfo = bak_curvarinfo;
+  static_vars = bak_static_vars;
+  parsing_stmt = bak_parsing_stmt;
+  loop_scope = bak_loop_scope;
+}
+
+static Declaration *parse_defun(Type *functype, int storage, Token *ident, const Token *tok,
+                                Table *attributes) {
+  assert(functype->kind == TY_FUNC);
+
+  const Vector *param_vars = functype->func.param_vars;
+  if (functype->func.params == NULL) {  // Old-style
+    // Treat it as a zero-parameter function.
+    functype->func.params = new_vector();
+    functype->func.vaargs = false;
+    param_vars = new_vector();
+  }
+
+  Function *func = define_func(functype, ident, param_vars, storage, attributes);
+  VarInfo *varinfo = scope_find(global_scope, ident->ident, NULL);
+  assert(varinfo != NULL);
+  if (varinfo->global.func != NULL) {
+    parse_error(PE_NOFATAL, ident, "`%.*s' function already defined", NAMES(func->ident->ident));
+  } else {
+    varinfo->global.func = func;
+  }
+
+  for (int i = 0; i < param_vars->len; ++i) {
+    VarInfo *vi = param_vars->data[i];
+    ensure_struct(vi->type, tok, curscope);
+  }
+
+  if (varinfo->global.func == func && is_lazy_defun(func, storage)) {
+    func->body_tokens = read_body_tokens(tok);
+    func->visible_decls = global_decl_count();
+  } else
+    parse_defun_body(func, varinfo, tok);
+  match(TK_SEMICOL);  // Ignore redundant semicolon.
 
   Declaration *decl = new_decl_defun(func);
   varinfo->global.funcdecl = decl;
@@ -1238,16 +1340,40 @@ static void modify_dtor_func(Vector *decls) {
 }
 #endif
 
-void parse(Vector *decls) {
+// Bodies in the main source file are parsed even if not referred, to report their errors.
+// Only the ones in headers are left unparsed.
+static void parse_unreferred_bodies(const char *filename) {
+  for (int i = 0; i < global_scope->vars->len; ++i) {
+    VarInfo *varinfo = global_scope->vars->data[i];
+    Function *func;
+    if (varinfo->type->kind != TY_FUNC || (func = varinfo->global.func) == NULL ||
+        func->body_tokens == NULL)
+      continue;
+    const Token *tok = func->body_tokens->data[0];
+    if (filename != NULL && tok->line->filename != NULL &&
+        strcmp(tok->line->filename, filename) == 0)
+      parse_lazy_body(func);
+  }
+}
+
+const Token *parse_declarations(Vector *decls) {
   curscope = global_scope;
 
-  while (!match(TK_EOF)) {
+  const Token *eof;
+  while ((eof = match(TK_EOF)) == NULL) {
     Declaration *decl = parse_declaration(decls);
     if (decl != NULL)
       vec_push(decls, decl);
   }
+  return eof;
+}
+
+void parse(Vector *decls) {
+  const Token *eof = parse_declarations(decls);
 
   propagate_var_used();
+  // The last line is in the main source file, after returning from all includes.
+  parse_unreferred_bodies(eof->line->filename);
 
 #if XCC_TARGET_PLATFORM == XCC_PLATFORM_APPLE || XCC_TARGET_PLATFORM == XCC_PLATFORM_WASI
   modify_dtor_func(decls);
@@ -14,6 +14,7 @@ typedef struct Type Type;
 typedef struct Vector Vector;
 
 void parse(Vector *decls);  // <Declaration*>
+const Token *parse_declarations(Vector *decls);  // Without the checks at the end of input.
 
 //
 
@@ -31,6 +32,7 @@ Expr *parse_const_fixnum(void);
 Expr *parse_assign(void);
 Expr *parse_expr(void);
 Stmt *parse_block(const Token *tok, Scope *scope);
+void parse_lazy_body(Function *func);
 Initializer *parse_initializer(void);
 
 Token *consume(enum TokenKind kind, const char *error);
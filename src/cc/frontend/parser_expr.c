@@ -343,6 +343,8 @@ static Expr *variable(Token *ident) {
     if (varinfo->storage & VS_ENUM_MEMBER)
       return new_expr_fixlit(varinfo->type, ident, varinfo->enum_member.value);
     type = varinfo->type;
+    if (type->kind == TY_FUNC && is_global_scope(scope) && varinfo->global.func != NULL)
+      parse_lazy_body(varinfo->global.func);
   } else {
     parse_error(PE_NOFATAL, ident, "`%.*s' undeclared", NAMES(ident->ident));
     type = &tyInt;
@@ -324,7 +324,7 @@ Type *parse_raw_type(int *pstorage) {
       if (!no_type_combination(&tc, 0, 0))
         parse_error(PE_NOFATAL, tok, ILLEGAL_TYPE_COMBINATION);
 
-      type = calloc_or_die(sizeof(*type));
+      type = ast_alloc(sizeof(*type));
       type->kind = TY_AUTO;
       break;
     case TK_TYPEOF:
@@ -542,7 +542,7 @@ static Type *parse_direct_declarator_suffix(Type *type) {
     {
       type = arrayof(subtype, length);
       if (basetype->qualifier & TQ_CONST)
-        type->qualifier |= TQ_CONST;
+        type = qualified_type(type, TQ_CONST);
     }
   } else if (match(TK_LPAR)) {
     bool vaargs;
@@ -563,7 +563,7 @@ Type *parse_direct_declarator(Type *type, Token **pident) {
   Token *ident = NULL;
   if (match(TK_LPAR)) {
     Type *ret = type;
-    Type *placeholder = calloc_or_die(sizeof(*placeholder));
+    Type *placeholder = ast_alloc(sizeof(*placeholder));
     assert(placeholder != NULL);
     memcpy(placeholder, type, sizeof(*placeholder));
 
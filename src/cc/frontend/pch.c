@@ -0,0 +1,999 @@
+// Global scope in precompiled header
+//
+// `cc1 --make-pch` parses the tokens which cpp has put in the precompiled header,
+// and appends the global scope after them. When the token stream refers to the header,
+// cc1 loads the scope instead of parsing the declarations again.
+//
+// Objects are written at the first reference, and referred by index after that:
+//   ref := uleb(0)          NULL
+//        | uleb(1) object   First time
+//        | uleb(index + 2)
+// Objects existing before the header (builtins) are indexed in the same order on saving and
+// loading, and referred without being written. Strings are followed by a terminator,
+// and loaded names point into the file, which is kept mapped.
+//
+//   scope := uleb(version) uleb(arch) uleb(base_globals) uleb(base_decls)
+//            uleb(count) (uleb(kind) name value)*  Global declarations in the header.
+//            uleb(count) declaration*              Toplevel declarations in the header.
+//            uleb(count) name* uleb(count) file*   Tables to decode the rest of token stream.
+
+#include "../../config.h"
+#include "pch.h"
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdlib.h>  // free
+#include <string.h>
+#ifndef __NO_WCHAR
+#include <wchar.h>
+#endif
+
+#include "ast.h"
+#include "fe_misc.h"  // compile_error_count
+#include "lexer.h"
+#include "table.h"
+#include "type.h"
+#include "util.h"
+#include "var.h"
+
+#define PCH_SCOPE_VERSION  (1)
+
+// Object pointer to index.
+typedef struct {
+  const void *key;  // NULL => empty.
+  int index;
+} ObjEntry;
+
+typedef struct {
+  ObjEntry *entries;
+  int capacity;  // Power of 2.
+  int count;
+} ObjMap;
+
+static inline uint32_t hash_ptr(const void *key) {
+  uint64_t h = (uint64_t)(uintptr_t)key * 0x9e3779b97f4a7c15ULL;
+  return h >> 32;
+}
+
+static ObjEntry *objmap_find(const ObjMap *map, const void *key) {
+  uint32_t mask = map->capacity - 1;
+  for (uint32_t i = hash_ptr(key) & mask; ; i = (i + 1) & mask) {
+    ObjEntry *entry = &map->entries[i];
+    if (entry->key == NULL || entry->key == key)
+      return entry;
+  }
+}
+
+static int objmap_get(const ObjMap *map, const void *key) {
+  if (map->count == 0)
+    return -1;
+  const ObjEntry *entry = objmap_find(map, key);
+  return entry->key != NULL ? entry->index : -1;
+}
+
+static void objmap_put(ObjMap *map, const void *key, int index) {
+  assert(key != NULL);
+  if (map->count >= map->capacity / 2) {
+    ObjMap old = *map;
+    map->capacity = old.capacity > 0 ? old.capacity * 2 : 256;
+    map->entries = calloc_or_die(sizeof(*map->entries) * map->capacity);
+    map->count = 0;
+    for (int i = 0; i < old.capacity; ++i) {
+      const ObjEntry *e = &old.entries[i];
+      if (e->key != NULL)
+        objmap_put(map, e->key, e->index);
+    }
+    free(old.entries);
+  }
+  ObjEntry *entry = objmap_find(map, key);
+  if (entry->key == NULL) {
+    entry->key = key;
+    ++map->count;
+  }
+  entry->index = index;
+}
+
+// State before the header.
+static struct {
+  Vector *decls;  // Toplevel declarations.
+  int global_count, decl_count;
+  DataStorage snapshot;  // Objects written on start, to check they are intact on saving.
+} base;
+
+enum ElemKind {
+  EK_TYPE,
+  EK_VAR,
+  EK_PARAM,
+  EK_TOKEN,
+};
+
+enum VarKind {
+  VK_ENUM_MEMBER,
+  VK_LOCAL,  // Parameter of prototype.
+  VK_FUNC,
+  VK_GLOBAL,
+};
+
+// ================================================
+// Writer
+
+static struct {
+  DataStorage *data;  // NULL => Only index the objects.
+  ObjMap map;
+  Vector *objects;  // Indexed objects in order.
+  bool failed;  // Something cannot be saved.
+} writer;
+
+static void begin_writer(DataStorage *data) {
+  writer.data = data;
+  writer.map.entries = NULL;
+  writer.map.capacity = writer.map.count = 0;
+  writer.objects = new_vector();
+  writer.failed = false;
+}
+
+static void end_writer(void) {
+  free(writer.map.entries);
+  writer.map.entries = NULL;
+  writer.map.capacity = writer.map.count = 0;
+  writer.objects = NULL;
+  writer.data = NULL;
+}
+
+static void write_uleb(uint64_t value) {
+  if (writer.data != NULL)
+    data_uleb128(writer.data, -1, value);
+}
+
+static void write_sleb(int64_t value) {
+  if (writer.data != NULL)
+    data_leb128(writer.data, -1, value);
+}
+
+static void write_string(const void *chars, size_t len) {
+  if (writer.data != NULL) {
+    data_string(writer.data, chars, len);
+    data_push(writer.data, '\0');
+  }
+}
+
+// Returns true for the first time: The caller puts the object after it.
+static bool write_ref(const void *p) {
+  if (p == NULL) {
+    write_uleb(0);
+    return false;
+  }
+  int index = objmap_get(&writer.map, p);
+  if (index >= 0) {
+    write_uleb(index + 2);
+    return false;
+  }
+  objmap_put(&writer.map, p, writer.objects->len);
+  vec_push(writer.objects, (void*)p);
+  write_uleb(1);
+  return true;
+}
+
+static void write_name(const Name *name) {
+  if (write_ref(name))
+    write_string(name->chars, name->bytes);
+}
+
+static void write_cstr(const char *str) {
+  if (write_ref(str))
+    write_string(str, strlen(str));
+}
+
+static void write_type(const Type *type);
+static void write_varinfo(const VarInfo *varinfo, bool param);
+static void write_token(const Token *tok);
+
+static void write_vector(const Vector *vec, enum ElemKind kind) {
+  if (!write_ref(vec))
+    return;
+  write_uleb(vec->len);
+  for (int i = 0; i < vec->len; ++i) {
+    const void *elem = vec->data[i];
+    switch (kind) {
+    case EK_TYPE:   write_type(elem); break;
+    case EK_VAR:    write_varinfo(elem, false); break;
+    case EK_PARAM:  write_varinfo(elem, true); break;
+    case EK_TOKEN:  write_token(elem); break;
+    }
+  }
+}
+
+// Attributes: <Vector<Token*>>
+static void write_attributes(Table *table) {
+  if (!write_ref(table))
+    return;
+  write_uleb(table->count);
+  const Name *name;
+  void *value;
+  for (int it = 0; (it = table_iterate(table, it, &name, &value)) != -1; ) {
+    write_name(name);
+    write_vector(value, EK_TOKEN);
+  }
+}
+
+static void write_token_payload(const Token *tok, bool in_line) {
+  switch (tok->kind) {
+  case TK_IDENT:
+    write_name(tok->ident);
+    break;
+  case TK_INTLIT:
+    write_uleb((UFixnum)tok->fixnum.value);
+    write_sleb(tok->fixnum.flag);
+    break;
+#ifndef __NO_FLONUM
+  case TK_FLOATLIT:
+    {
+      union { Flonum value; unsigned char bytes[sizeof(Flonum)]; } u;
+      memset(&u, 0, sizeof(u));  // Clear padding bytes.
+      u.value = tok->flonum.value;
+      write_string(u.bytes, sizeof(u.bytes));
+      write_uleb(tok->flonum.kind);
+    }
+    break;
+#endif
+  case TK_STR:
+    {
+      size_t size = tok->str.len;
+#ifndef __NO_WCHAR
+      // Ones in a line are decoded from token stream as bytes, and converted on concatenation.
+      if (tok->str.kind == STR_WIDE && !in_line)
+        size *= sizeof(wchar_t);
+#endif
+      write_uleb(tok->str.kind);
+      write_string(tok->str.buf, size);
+    }
+    break;
+  default:
+    break;
+  }
+}
+
+// Only lines from token stream are saved, and their tokens are written in them.
+static void write_line(const Line *line) {
+  if (!write_ref(line))
+    return;
+  const LineOrigin *origin = line->origin;
+  if (origin == NULL) {
+    writer.failed = true;
+    return;
+  }
+  write_cstr(line->filename);
+  write_uleb(line->lineno);
+  write_string(line->buf, strlen(line->buf));
+  write_uleb(origin->source != NULL);
+  if (origin->source != NULL)
+    write_string(origin->source, strlen(origin->source));
+  write_uleb(origin->count);
+  for (int i = 0; i < origin->count; ++i) {
+    const Token *tok = &origin->tokens[i];
+    const struct TokenLocation *loc = &origin->locations[i];
+    write_uleb(tok->kind);
+    write_uleb(tok->begin - line->buf);
+    write_uleb(tok->end - tok->begin);
+    write_token_payload(tok, true);
+    write_uleb(loc->column);
+    write_uleb(loc->width);
+    write_uleb(loc->exact);
+  }
+}
+
+static void write_token(const Token *tok) {
+  if (!write_ref(tok))
+    return;
+  const Line *line = tok->line;
+  write_line(line);
+  const LineOrigin *origin = line != NULL ? line->origin : NULL;
+  if (origin == NULL) {  // Made in parser, or builtin.
+    writer.failed = true;
+    return;
+  }
+  if (tok >= origin->tokens && tok < origin->tokens + origin->count) {
+    write_uleb(0);
+    write_uleb(tok - origin->tokens);
+    return;
+  }
+
+  // Made from the ones in the line, e.g. concatenated string literal.
+  uintptr_t buf = (uintptr_t)line->buf, len = strlen(line->buf);
+  uintptr_t begin = (uintptr_t)tok->begin, end = (uintptr_t)tok->end;
+  if (begin < buf || end > buf + len || begin > end) {
+    writer.failed = true;
+    return;
+  }
+  write_uleb(1);
+  write_uleb(tok->kind);
+  write_uleb(begin - buf);
+  write_uleb(end - begin);
+  write_token_payload(tok, false);
+}
+
+static void write_struct_info(const StructInfo *sinfo) {
+  if (!write_ref(sinfo))
+    return;
+  write_uleb(sinfo->member_count);
+  write_sleb(sinfo->size);
+  write_uleb(sinfo->align);
+  write_uleb(sinfo->is_union);
+  write_uleb(sinfo->is_flexible);
+  for (int i = 0; i < sinfo->member_count; ++i) {
+    const MemberInfo *member = &sinfo->members[i];
+    write_name(member->name);
+    write_type(member->type);
+    write_uleb(member->offset);
+#ifndef __NO_BITFIELD
+    write_sleb(member->bitfield.active);
+    write_sleb(member->bitfield.width);
+    write_uleb(member->bitfield.position);
+    write_uleb(member->bitfield.base_kind);
+#endif
+  }
+}
+
+static void write_type(const Type *type) {
+  if (!write_ref(type))
+    return;
+  write_uleb(type->kind);
+  write_uleb(type->qualifier);
+  switch (type->kind) {
+  case TY_VOID:
+    break;
+  case TY_FIXNUM:
+    write_uleb(type->fixnum.kind);
+    write_uleb(type->fixnum.is_unsigned);
+    write_name(type->fixnum.enum_.ident);
+    break;
+  case TY_FLONUM:
+    write_uleb(type->flonum.kind);
+    break;
+  case TY_PTR: case TY_ARRAY:
+#ifndef __NO_VLA
+    if (type->pa.vla != NULL || type->pa.size_var != NULL)
+      writer.failed = true;
+#endif
+    write_type(type->pa.ptrof);
+    write_sleb(type->pa.length);
+    break;
+  case TY_FUNC:
+    write_type(type->func.ret);
+    write_vector(type->func.params, EK_TYPE);
+    write_vector(type->func.param_vars, EK_PARAM);
+    write_uleb(type->func.vaargs);
+    break;
+  case TY_STRUCT:
+    write_name(type->struct_.name);
+    write_struct_info(type->struct_.info);
+    break;
+  default:
+    writer.failed = true;
+    break;
+  }
+}
+
+static void write_decl(const Declaration *decl);
+
+// Only prototypes, and bodies not parsed yet.
+static void write_function(const Function *func) {
+  if (!write_ref(func))
+    return;
+  if (func->static_vars != NULL || func->scopes != NULL || func->body_block != NULL ||
+      func->label_table != NULL || func->gotos != NULL || func->extra != NULL)
+    writer.failed = true;
+  write_type(func->type);
+  write_token(func->ident);
+  write_vector(func->params, EK_PARAM);
+  write_vector(func->body_tokens, EK_TOKEN);
+  write_uleb(func->visible_decls);
+  write_attributes(func->attributes);
+  write_uleb(func->flag);
+}
+
+static void write_decl(const Declaration *decl) {
+  if (!write_ref(decl))
+    return;
+  write_uleb(decl->kind);
+  if (decl->kind == DCL_DEFUN)
+    write_function(decl->defun.func);
+  else
+    writer.failed = true;
+}
+
+// Global variables must have no initializer: Only declarations are saved.
+static void write_varinfo(const VarInfo *varinfo, bool param) {
+  if (!write_ref(varinfo))
+    return;
+  write_token(varinfo->ident);
+  write_type(varinfo->type);
+  write_uleb(varinfo->storage);
+  if (varinfo->storage & VS_ENUM_MEMBER) {
+    write_uleb(VK_ENUM_MEMBER);
+    write_sleb(varinfo->enum_member.value);
+  } else if (param) {
+    write_uleb(VK_LOCAL);
+    if (varinfo->local.init != NULL || varinfo->local.vreg != NULL ||
+        varinfo->local.frameinfo != NULL)
+      writer.failed = true;
+  } else if (varinfo->type->kind == TY_FUNC) {
+    write_uleb(VK_FUNC);
+    write_function(varinfo->global.func);
+    write_decl(varinfo->global.funcdecl);
+    write_vector(varinfo->global.referred_globals, EK_VAR);
+  } else {
+    write_uleb(VK_GLOBAL);
+    if (varinfo->global.init != NULL)
+      writer.failed = true;
+    write_vector(varinfo->global.referred_globals, EK_VAR);
+  }
+}
+
+static void write_global_decl(const GlobalDecl *decl) {
+  write_uleb(decl->kind);
+  write_name(decl->name);
+  switch (decl->kind) {
+  case GD_VAR:     write_varinfo(decl->value, false); break;
+  case GD_STRUCT:  write_struct_info(decl->value); break;
+  case GD_TYPEDEF: case GD_ENUM:  write_type(decl->value); break;
+  }
+}
+
+// Index the objects before the header in the same order, on both saving and loading.
+static void write_base_objects(void) {
+  static Type *kStaticTypes[] = {
+    &tyChar, &tyInt, &tyVoid, &tyConstVoid, &tyVoidPtr, &tyBool, &tySize, &tySSize,
+    &tyFloat, &tyDouble, &tyLDouble,
+  };
+  for (int i = 0; i < (int)ARRAY_SIZE(kStaticTypes); ++i)
+    write_ref(kStaticTypes[i]);
+  for (int u = 0; u < 2; ++u) {
+    for (int q = 0; q < 4; ++q) {
+      for (enum FixnumKind kind = FX_CHAR; kind <= FX_LLONG; ++kind)
+        write_ref(get_fixnum_type(kind, u, q));
+    }
+  }
+
+  int count;
+  GlobalDecl *decls = list_global_decls(&count);
+  for (int i = 0; i < base.global_count; ++i)
+    write_global_decl(&decls[i]);
+  free(decls);
+  for (int i = 0; i < base.decl_count; ++i)
+    write_decl(base.decls->data[i]);
+}
+
+void init_pch_scope(Vector *decls, bool saving) {
+  base.decls = decls;
+  base.global_count = global_decl_count();
+  base.decl_count = decls->len;
+  data_release(&base.snapshot);
+  data_init(&base.snapshot);
+  if (saving) {
+    begin_writer(&base.snapshot);
+    write_base_objects();
+    end_writer();
+  }
+}
+
+bool save_pch_scope(DataStorage *data) {
+  // Warnings are not reported again on loading.
+  if (compile_error_count > 0 || compile_warning_count > 0)
+    return false;
+
+  // Objects before the header must be intact, to be referred by index.
+  DataStorage snapshot;
+  data_init(&snapshot);
+  begin_writer(&snapshot);
+  write_base_objects();
+  bool intact = snapshot.len == base.snapshot.len &&
+                memcmp(snapshot.buf, base.snapshot.buf, snapshot.len) == 0;
+  data_release(&snapshot);
+  if (!intact) {
+    end_writer();
+    return false;
+  }
+
+  writer.data = data;
+  writer.failed = false;
+  write_uleb(PCH_SCOPE_VERSION);
+  write_uleb(XCC_TARGET_ARCH);
+  write_uleb(base.global_count);
+  write_uleb(base.decl_count);
+
+  int count;
+  GlobalDecl *decls = list_global_decls(&count);
+  write_uleb(count - base.global_count);
+  for (int i = base.global_count; i < count; ++i)
+    write_global_decl(&decls[i]);
+  free(decls);
+  write_uleb(base.decls->len - base.decl_count);
+  for (int i = base.decl_count; i < base.decls->len; ++i)
+    write_decl(base.decls->data[i]);
+
+  Vector names, files;
+  vec_init(&names);
+  vec_init(&files);
+  save_token_input(&names, &files);
+  write_uleb(names.len);
+  for (int i = 0; i < names.len; ++i)
+    write_name(names.data[i]);
+  write_uleb(files.len);
+  for (int i = 0; i < files.len; ++i)
+    write_cstr(files.data[i]);
+
+  bool ok = !writer.failed;
+  end_writer();
+  return ok;
+}
+
+// ================================================
+// Reader: Checks bounds, and fails without touching the state on broken data.
+
+static struct {
+  const unsigned char *p, *end;
+  Vector *objects;
+  bool broken;
+} reader;
+
+static uint64_t read_uleb(void) {
+  uint64_t value = 0;
+  for (int shift = 0; shift < 64; shift += 7) {
+    if (reader.p >= reader.end)
+      break;
+    unsigned char c = *reader.p++;
+    value |= (uint64_t)(c & 0x7f) << shift;
+    if (!(c & 0x80))
+      return value;
+  }
+  reader.broken = true;
+  return 0;
+}
+
+static int64_t read_sleb(void) {
+  uint64_t value = 0;
+  for (int shift = 0; shift < 64; ) {
+    if (reader.p >= reader.end)
+      break;
+    unsigned char c = *reader.p++;
+    value |= (uint64_t)(c & 0x7f) << shift;
+    shift += 7;
+    if (!(c & 0x80)) {
+      if (shift < 64 && (c & 0x40))
+        value |= ~(uint64_t)0 << shift;
+      return (int64_t)value;
+    }
+  }
+  reader.broken = true;
+  return 0;
+}
+
+// Count of elements, each of which takes a byte at least.
+static int read_count(void) {
+  uint64_t count = read_uleb();
+  if (count > (uint64_t)(reader.end - reader.p)) {
+    reader.broken = true;
+    return 0;
+  }
+  return count;
+}
+
+static const char *read_string(size_t *plen) {
+  uint64_t len = read_uleb();
+  if (len >= (uint64_t)(reader.end - reader.p) || reader.p[len] != '\0') {
+    reader.broken = true;
+    len = 0;
+  }
+  const char *str = reader.broken ? "" : (const char*)reader.p;
+  reader.p += reader.broken ? 0 : len + 1;
+  if (plen != NULL)
+    *plen = len;
+  return str;
+}
+
+// Returns the index to put a new object at, or -1 with the one referred.
+static int read_ref(void **pobj) {
+  uint64_t ref = read_uleb();
+  *pobj = NULL;
+  if (ref == 1) {
+    vec_push(reader.objects, NULL);
+    return reader.objects->len - 1;
+  }
+  if (ref >= 2) {
+    ref -= 2;
+    if (ref < (uint64_t)reader.objects->len && reader.objects->data[ref] != NULL)
+      *pobj = reader.objects->data[ref];
+    else
+      reader.broken = true;
+  }
+  return -1;
+}
+
+static const Name *read_name(void) {
+  void *obj;
+  int index = read_ref(&obj);
+  if (index < 0)
+    return obj;
+  size_t len;
+  const char *chars = read_string(&len);
+  const Name *name = alloc_name(chars, chars + len, false);
+  reader.objects->data[index] = (void*)name;
+  return name;
+}
+
+static const char *read_cstr(void) {
+  void *obj;
+  int index = read_ref(&obj);
+  if (index < 0)
+    return obj;
+  const char *str = read_string(NULL);
+  reader.objects->data[index] = (void*)str;
+  return str;
+}
+
+static Type *read_type(void);
+static VarInfo *read_varinfo(void);
+static Token *read_token(void);
+
+static Vector *read_vector(enum ElemKind kind) {
+  void *obj;
+  int index = read_ref(&obj);
+  if (index < 0)
+    return obj;
+  Vector *vec = new_vector();
+  reader.objects->data[index] = vec;
+  int count = read_count();
+  for (int i = 0; i < count && !reader.broken; ++i) {
+    void *elem = NULL;
+    switch (kind) {
+    case EK_TYPE:   elem = read_type(); break;
+    case EK_VAR: case EK_PARAM:  elem = read_varinfo(); break;
+    case EK_TOKEN:  elem = read_token(); break;
+    }
+    vec_push(vec, elem);
+  }
+  return vec;
+}
+
+static Table *read_attributes(void) {
+  void *obj;
+  int index = read_ref(&obj);
+  if (index < 0)
+    return obj;
+  Table *table = alloc_table();
+  reader.objects->data[index] = table;
+  int count = read_count();
+  for (int i = 0; i < count && !reader.broken; ++i) {
+    const Name *name = read_name();
+    Vector *value = read_vector(EK_TOKEN);
+    if (name != NULL)
+      table_put(table, name, value);
+    else
+      reader.broken = true;
+  }
+  return table;
+}
+
+static void read_token_payload(Token *tok, bool in_line) {
+  switch (tok->kind) {
+  case TK_IDENT:
+    tok->ident = read_name();
+    if (tok->ident == NULL)
+      reader.broken = true;
+    break;
+  case TK_INTLIT:
+    tok->fixnum.value = (Fixnum)read_uleb();
+    tok->fixnum.flag = read_sleb();
+    break;
+#ifndef __NO_FLONUM
+  case TK_FLOATLIT:
+    {
+      union { Flonum value; unsigned char bytes[sizeof(Flonum)]; } u;
+      size_t len;
+      const char *bytes = read_string(&len);
+      if (len == sizeof(u.bytes)) {
+        memcpy(u.bytes, bytes, sizeof(u.bytes));
+      } else {
+        reader.broken = true;
+        u.value = 0;
+      }
+      tok->flonum.value = u.value;
+      tok->flonum.kind = read_uleb();
+    }
+    break;
+#endif
+  case TK_STR:
+    {
+      tok->str.kind = read_uleb();
+      size_t size;
+      const char *bytes = read_string(&size);
+      // Copied to be aligned for wide characters.
+      char *buf = malloc_or_die(size + 1);
+      memcpy(buf, bytes, size);
+      buf[size] = '\0';
+      tok->str.buf = buf;
+      tok->str.len = size;
+#ifndef __NO_WCHAR
+      if (tok->str.kind == STR_WIDE && !in_line)
+        tok->str.len = size / sizeof(wchar_t);
+#endif
+    }
+    break;
+  default:
+    break;
+  }
+}
+
+static Line *read_line(void) {
+  void *obj;
+  int index = read_ref(&obj);
+  if (index < 0)
+    return obj;
+  const char *filename = read_cstr();
+  int lineno = read_uleb();
+  size_t buf_len;
+  const char *buf = read_string(&buf_len);
+  const char *source = read_uleb() != 0 ? read_string(NULL) : NULL;
+  int count = read_count();
+  if (reader.broken)
+    return NULL;
+
+  // Allocated at once, as the lexer does.
+  Token *tokens = malloc_or_die(sizeof(*tokens) * count + sizeof(Line) + sizeof(LineOrigin) +
+                                sizeof(struct TokenLocation) * count);
+  Line *line = (Line*)&tokens[count];
+  LineOrigin *origin = (LineOrigin*)&line[1];
+  struct TokenLocation *locations = (struct TokenLocation*)&origin[1];
+  line->filename = filename;
+  line->lineno = lineno;
+  line->buf = buf;
+  line->origin = origin;
+  origin->tokens = tokens;
+  origin->count = count;
+  origin->source = source;
+  origin->locations = locations;
+  reader.objects->data[index] = line;
+
+  for (int i = 0; i < count; ++i) {
+    Token *tok = &tokens[i];
+    tok->kind = read_uleb();
+    tok->line = line;
+    uint64_t begin = read_uleb(), len = read_uleb();
+    if (begin > buf_len || len > buf_len - begin) {
+      reader.broken = true;
+      begin = len = 0;
+    }
+    tok->begin = buf + begin;
+    tok->end = tok->begin + len;
+    read_token_payload(tok, true);
+    locations[i].column = read_uleb();
+    locations[i].width = read_uleb();
+    locations[i].exact = read_uleb() != 0;
+  }
+  return line;
+}
+
+static Token *read_token(void) {
+  void *obj;
+  int index = read_ref(&obj);
+  if (index < 0)
+    return obj;
+  Line *line = read_line();
+  Token *tok = NULL;
+  if (line != NULL) {
+    const LineOrigin *origin = line->origin;
+    if (read_uleb() == 0) {
+      uint64_t i = read_uleb();
+      if (i < (uint64_t)origin->count)
+        tok = (Token*)&origin->tokens[i];
+    } else {
+      enum TokenKind kind = read_uleb();
+      uint64_t begin = read_uleb(), len = read_uleb();
+      size_t buf_len = strlen(line->buf);
+      if (begin <= buf_len && len <= buf_len - begin) {
+        tok = alloc_token(kind, line, line->buf + begin, line->buf + begin + len);
+        read_token_payload(tok, false);
+      }
+    }
+  }
+  if (tok == NULL)
+    reader.broken = true;
+  reader.objects->data[index] = tok;
+  return tok;
+}
+
+static StructInfo *read_struct_info(void) {
+  void *obj;
+  int index = read_ref(&obj);
+  if (index < 0)
+    return obj;
+  StructInfo *sinfo = ast_alloc(sizeof(*sinfo));
+  reader.objects->data[index] = sinfo;
+  int count = read_count();
+  sinfo->member_count = count;
+  sinfo->size = read_sleb();
+  sinfo->align = read_uleb();
+  sinfo->is_union = read_uleb() != 0;
+  sinfo->is_flexible = read_uleb() != 0;
+  MemberInfo *members = ast_alloc(sizeof(*members) * count);
+  for (int i = 0; i < count && !reader.broken; ++i) {
+    MemberInfo *member = &members[i];
+    member->name = read_name();
+    member->type = read_type();
+    member->offset = read_uleb();
+#ifndef __NO_BITFIELD
+    member->bitfield.active = read_sleb();
+    member->bitfield.width = read_sleb();
+    member->bitfield.position = read_uleb();
+    member->bitfield.base_kind = read_uleb();
+#endif
+  }
+  sinfo->members = members;
+  return sinfo;
+}
+
+static Type *read_type(void) {
+  void *obj;
+  int index = read_ref(&obj);
+  if (index < 0)
+    return obj;
+  Type *type = ast_alloc(sizeof(*type));
+  reader.objects->data[index] = type;
+  type->kind = read_uleb();
+  type->qualifier = read_uleb();
+  switch (type->kind) {
+  case TY_VOID:
+    break;
+  case TY_FIXNUM:
+    type->fixnum.kind = read_uleb();
+    type->fixnum.is_unsigned = read_uleb() != 0;
+    type->fixnum.enum_.ident = read_name();
+    break;
+  case TY_FLONUM:
+    type->flonum.kind = read_uleb();
+    break;
+  case TY_PTR: case TY_ARRAY:
+    type->pa.ptrof = read_type();
+    type->pa.length = read_sleb();
+    break;
+  case TY_FUNC:
+    type->func.ret = read_type();
+    type->func.params = read_vector(EK_TYPE);
+    type->func.param_vars = read_vector(EK_PARAM);
+    type->func.vaargs = read_uleb() != 0;
+    break;
+  case TY_STRUCT:
+    type->struct_.name = read_name();
+    type->struct_.info = read_struct_info();
+    break;
+  default:
+    reader.broken = true;
+    break;
+  }
+  return type;
+}
+
+static Declaration *read_decl(void);
+
+static Function *read_function(void) {
+  void *obj;
+  int index = read_ref(&obj);
+  if (index < 0)
+    return obj;
+  Function *func = ast_alloc(sizeof(*func));
+  reader.objects->data[index] = func;
+  func->type = read_type();
+  func->ident = read_token();
+  func->params = read_vector(EK_PARAM);
+  func->body_tokens = read_vector(EK_TOKEN);
+  func->visible_decls = read_uleb();
+  func->attributes = read_attributes();
+  func->flag = read_uleb();
+  return func;
+}
+
+static Declaration *read_decl(void) {
+  void *obj;
+  int index = read_ref(&obj);
+  if (index < 0)
+    return obj;
+  Declaration *decl = ast_alloc(sizeof(*decl));
+  reader.objects->data[index] = decl;
+  decl->kind = read_uleb();
+  if (decl->kind == DCL_DEFUN)
+    decl->defun.func = read_function();
+  else
+    reader.broken = true;
+  return decl;
+}
+
+static VarInfo *read_varinfo(void) {
+  void *obj;
+  int index = read_ref(&obj);
+  if (index < 0)
+    return obj;
+  VarInfo *varinfo = ast_alloc(sizeof(*varinfo));
+  reader.objects->data[index] = varinfo;
+  varinfo->ident = read_token();
+  varinfo->type = read_type();
+  varinfo->storage = read_uleb();
+  switch (read_uleb()) {
+  case VK_ENUM_MEMBER:
+    varinfo->enum_member.value = read_sleb();
+    break;
+  case VK_LOCAL:
+    break;
+  case VK_FUNC:
+    varinfo->global.func = read_function();
+    varinfo->global.funcdecl = read_decl();
+    varinfo->global.referred_globals = read_vector(EK_VAR);
+    break;
+  case VK_GLOBAL:
+    varinfo->global.referred_globals = read_vector(EK_VAR);
+    break;
+  default:
+    reader.broken = true;
+    break;
+  }
+  return varinfo;
+}
+
+static void read_global_decl(GlobalDecl *decl) {
+  decl->kind = read_uleb();
+  decl->name = read_name();
+  switch (decl->kind) {
+  case GD_VAR:     decl->value = read_varinfo(); break;
+  case GD_STRUCT:  decl->value = read_struct_info(); break;
+  case GD_TYPEDEF: case GD_ENUM:  decl->value = read_type(); break;
+  default:         decl->value = NULL; break;
+  }
+  if (decl->name == NULL || decl->value == NULL)
+    reader.broken = true;
+}
+
+// Load the scope saved after the header, if the state is the same as on saving.
+bool load_pch_scope(const void *buf, size_t size) {
+  if (global_decl_count() != base.global_count || base.decls->len != base.decl_count)
+    return false;
+  reader.p = buf;
+  reader.end = reader.p + size;
+  reader.broken = false;
+  if (read_uleb() != PCH_SCOPE_VERSION || read_uleb() != XCC_TARGET_ARCH ||
+      read_uleb() != (uint64_t)base.global_count || read_uleb() != (uint64_t)base.decl_count ||
+      reader.broken)
+    return false;
+
+  begin_writer(NULL);
+  write_base_objects();
+  reader.objects = writer.objects;
+  end_writer();
+
+  int count = read_count();
+  GlobalDecl *decls = calloc_or_die(sizeof(*decls) * MAX(count, 1));
+  for (int i = 0; i < count && !reader.broken; ++i)
+    read_global_decl(&decls[i]);
+  Vector *toplevel = new_vector();
+  for (int n = read_count(); n > 0 && !reader.broken; --n)
+    vec_push(toplevel, read_decl());
+  Vector *names = new_vector();
+  for (int n = read_count(); n > 0 && !reader.broken; --n)
+    vec_push(names, (void*)read_name());
+  Vector *files = new_vector();
+  for (int n = read_count(); n > 0 && !reader.broken; --n)
+    vec_push(files, (void*)read_cstr());
+
+  bool ok = !reader.broken && reader.p == reader.end;
+  if (ok) {
+    for (int i = 0; i < count; ++i)
+      add_global_decl(&decls[i]);
+    vec_concat(base.decls, toplevel);
+    restore_token_input(names, files);
+    report_stat("pch.decls", count);
+  }
+  free(decls);
+  free_vector(toplevel);
+  free_vector(reader.objects);
+  reader.objects = NULL;
+  return ok;
+}
@@ -0,0 +1,13 @@
+// Global scope in precompiled header
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>  // size_t
+
+typedef struct DataStorage DataStorage;
+typedef struct Vector Vector;
+
+void init_pch_scope(Vector *decls, bool saving);  // After builtins are installed.
+bool save_pch_scope(DataStorage *data);
+bool load_pch_scope(const void *buf, size_t size);
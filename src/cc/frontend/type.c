@@ -271,44 +271,121 @@ Type *get_fixnum_type_from_size(size_t size) {
   return NULL;
 }
 
-Type *ptrof(Type *type) {
-  Type *ptr = malloc_or_die(sizeof(*ptr));
-  ptr->kind = TY_PTR;
-  ptr->qualifier = 0;
-  ptr->pa.ptrof = type;
-  ptr->pa.length = 0;
+// Derived types are interned, so identical ones share an object: Pointers, arrays with
+// fixed length, and qualified types. Types which are modified after creation (arrays with
+// unknown length, VLAs and functions) are allocated each time.
+
+enum DerivedKind {
+  DT_PTR,
+  DT_ARRAY,
+  DT_QUALIFIED,
+};
+
+typedef struct {
+  const Type *base;
+  ssize_t arg;  // Array length, or qualifier.
+  enum DerivedKind kind;
+  Type *type;  // NULL: Empty slot.
+} DerivedType;
+
+static struct {
+  DerivedType *entries;
+  int capacity;  // 2^n
+  int count;
+} derived_types;
+
+static unsigned int hash_derived_type(enum DerivedKind kind, const Type *base, ssize_t arg) {
+  uint64_t h = ((uint64_t)(uintptr_t)base ^ ((uint64_t)arg << 8) ^ kind) * 0x9e3779b97f4a7c15ULL;
+  return h >> 32;
+}
+
+static DerivedType *find_slot(DerivedType *entries, int capacity, enum DerivedKind kind,
+                              const Type *base, ssize_t arg) {
+  unsigned int mask = capacity - 1;
+  for (unsigned int i = hash_derived_type(kind, base, arg) & mask; ; i = (i + 1) & mask) {
+    DerivedType *e = &entries[i];
+    if (e->type == NULL || (e->kind == kind && e->base == base && e->arg == arg))
+      return e;
+  }
+}
+
+// Returns an entry for the key: Caller must set `type` if it is NULL.
+static DerivedType *find_derived_type(enum DerivedKind kind, const Type *base, ssize_t arg) {
+  if (derived_types.count * 2 >= derived_types.capacity) {
+    int old_capacity = derived_types.capacity;
+    DerivedType *old_entries = derived_types.entries;
+    int capacity = old_capacity > 0 ? old_capacity * 2 : 256;
+    DerivedType *entries = calloc_or_die(sizeof(*entries) * capacity);
+    for (int i = 0; i < old_capacity; ++i) {
+      DerivedType *e = &old_entries[i];
+      if (e->type != NULL)
+        *find_slot(entries, capacity, e->kind, e->base, e->arg) = *e;
+    }
+    free(old_entries);
+    derived_types.entries = entries;
+    derived_types.capacity = capacity;
+  }
+
+  DerivedType *e = find_slot(derived_types.entries, derived_types.capacity, kind, base, arg);
+  if (e->type == NULL) {
+    e->kind = kind;
+    e->base = base;
+    e->arg = arg;
+    ++derived_types.count;
+  }
+  return e;
+}
+
+void reset_derived_types(void) {
+  free(derived_types.entries);
+  derived_types.entries = NULL;
+  derived_types.capacity = derived_types.count = 0;
+}
+
+static Type *new_pa_type(enum TypeKind kind, Type *type, ssize_t length) {
+  Type *pa = ast_alloc(sizeof(*pa));
+  pa->kind = kind;
+  pa->qualifier = 0;
+  pa->pa.ptrof = type;
+  pa->pa.length = length;
 #ifndef __NO_VLA
-  ptr->pa.vla = NULL;
-  ptr->pa.size_var = NULL;
+  pa->pa.vla = NULL;
+  pa->pa.size_var = NULL;
 #endif
-  return ptr;
+  return pa;
+}
+
+Type *ptrof(Type *type) {
+  DerivedType *e = find_derived_type(DT_PTR, type, 0);
+  if (e->type == NULL)
+    e->type = new_pa_type(TY_PTR, type, 0);
+  return e->type;
 }
 
 Type *arrayof(Type *type, ssize_t length) {
-  Type *arr = malloc_or_die(sizeof(*arr));
-  arr->kind = TY_ARRAY;
-  arr->qualifier = 0;
-  arr->pa.ptrof = type;
-  arr->pa.length = length;
-#ifndef __NO_VLA
-  arr->pa.vla = NULL;
-  arr->pa.size_var = NULL;
-#endif
-  return arr;
+  if (length < 0)  // Length is determined later, or VLA.
+    return new_pa_type(TY_ARRAY, type, length);
+  DerivedType *e = find_derived_type(DT_ARRAY, type, length);
+  if (e->type == NULL)
+    e->type = new_pa_type(TY_ARRAY, type, length);
+  return e->type;
 }
 
 Type *array_to_ptr(Type *type) {
   assert(type->kind == TY_ARRAY);
-  Type *p = ptrof(type->pa.ptrof);
 #ifndef __NO_VLA
-  p->pa.vla = type->pa.vla;
-  p->pa.size_var = type->pa.size_var;
+  if (type->pa.vla != NULL) {
+    Type *p = new_pa_type(TY_PTR, type->pa.ptrof, 0);
+    p->pa.vla = type->pa.vla;
+    p->pa.size_var = type->pa.size_var;
+    return p;
+  }
 #endif
-  return p;
+  return ptrof(type->pa.ptrof);
 }
 
 Type *new_func_type(Type *ret, const Vector *types, bool vaargs) {
-  Type *f = malloc_or_die(sizeof(*f));
+  Type *f = ast_alloc(sizeof(*f));
   f->kind = TY_FUNC;
   f->qualifier = 0;
   f->func.ret = ret;
@@ -322,13 +399,35 @@ Type *qualified_type(Type *type, int additional) {
   int modified = type->qualifier | additional;
   if (modified == type->qualifier)
     return type;
+
+  DerivedType *e = NULL;
+  switch (type->kind) {
+  case TY_FUNC: case TY_AUTO:
+    break;
+  case TY_PTR: case TY_ARRAY:
+#ifndef __NO_VLA
+    if (type->pa.vla != NULL)
+      break;
+#endif
+    if (type->pa.length < 0)
+      break;
+    // Fallthrough
+  default:
+    e = find_derived_type(DT_QUALIFIED, type, modified);
+    if (e->type != NULL)
+      return e->type;
+    break;
+  }
+
   Type *ctype = clone_type(type);
   ctype->qualifier = modified;
+  if (e != NULL)
+    e->type = ctype;
   return ctype;
 }
 
 Type *clone_type(const Type *type) {
-  Type *cloned = malloc_or_die(sizeof(*cloned));
+  Type *cloned = ast_alloc(sizeof(*cloned));
   *cloned = *type;
   return cloned;
 }
@@ -340,9 +439,13 @@ Type *get_callee_type(Type *type) {
 }
 
 // Struct
+
+#define MEMBER_TABLE_THRESHOLD  (8)  // Linear search is faster for fewer members.
+
 StructInfo *create_struct_info(MemberInfo *members, int count, bool is_union, bool is_flexible) {
-  StructInfo *sinfo = malloc_or_die(sizeof(*sinfo));
+  StructInfo *sinfo = ast_alloc(sizeof(*sinfo));
   sinfo->members = members;
+  sinfo->member_table = NULL;
   sinfo->member_count = count;
   sinfo->is_union = is_union;
   sinfo->is_flexible = is_flexible;
@@ -353,7 +456,7 @@ StructInfo *create_struct_info(MemberInfo *members, int count, bool is_union, bo
 }
 
 Type *create_struct_type(StructInfo *sinfo, const Name *name, int qualifier) {
-  Type *type = malloc_or_die(sizeof(*type));
+  Type *type = ast_alloc(sizeof(*type));
   type->kind = TY_STRUCT;
   type->qualifier = qualifier;
   type->struct_.name = name;
@@ -361,20 +464,36 @@ Type *create_struct_type(StructInfo *sinfo, const Name *name, int qualifier) {
   return type;
 }
 
-int find_struct_member(const StructInfo *sinfo, const Name *name) {
-  const MemberInfo *members = sinfo->members;
-  for (int i = 0, len = sinfo->member_count; i < len; ++i) {
-    const MemberInfo *info = &members[i];
-    if (info->name != NULL && equal_name(info->name, name))
-      return i;
+int find_struct_member(StructInfo *sinfo, const Name *name) {
+  MemberInfo *members = sinfo->members;
+  int count = sinfo->member_count;
+  if (count < MEMBER_TABLE_THRESHOLD) {
+    for (int i = 0; i < count; ++i) {
+      const MemberInfo *info = &members[i];
+      if (info->name != NULL && equal_name(info->name, name))
+        return i;
+    }
+    return -1;
   }
-  return -1;
+
+  Table *table = sinfo->member_table;
+  if (table == NULL) {
+    sinfo->member_table = table = alloc_table();
+    table_reserve(table, count);
+    for (int i = 0; i < count; ++i) {
+      MemberInfo *info = &members[i];
+      if (info->name != NULL && table_get(table, info->name) == NULL)  // First one wins.
+        table_put(table, info->name, info);
+    }
+  }
+  MemberInfo *info = table_get(table, name);
+  return info != NULL ? info - members : -1;
 }
 
 // Enum
 
 Type *create_enum_type(const Name *name) {
-  Type *type = malloc_or_die(sizeof(*type));
+  Type *type = ast_alloc(sizeof(*type));
   type->kind = TY_FIXNUM;
   type->qualifier = 0;
   type->fixnum.kind = FX_ENUM;
@@ -391,6 +510,8 @@ static inline bool same_type_func_param(const Type *type1, const Type *type2) {
 bool same_type_without_qualifier(const Type *type1, const Type *type2, bool ignore_qualifier) {
   const int QMASK = TQ_CONST;
   for (;;) {
+    if (type1 == type2)  // Derived types are interned.
+      return true;
     if (type1->kind != type2->kind ||
         (!ignore_qualifier && (type1->qualifier & QMASK) != (type2->qualifier & QMASK)))
       return false;
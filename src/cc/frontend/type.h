@@ -10,6 +10,7 @@
 
 typedef struct Expr Expr;
 typedef struct Name Name;
+typedef struct Table Table;
 typedef struct Vector Vector;
 
 // Fixnum
@@ -68,6 +69,7 @@ typedef struct MemberInfo {
 
 typedef struct StructInfo {
   MemberInfo *members;
+  Table *member_table;  // <MemberInfo*>, built lazily for many members.
   ssize_t size;
   int member_count;
   size_t align;
@@ -154,13 +156,14 @@ Type *array_to_ptr(Type *type);
 Type *new_func_type(Type *ret, const Vector *types, bool vaargs);
 Type *qualified_type(Type *type, int additional);
 Type *clone_type(const Type *type);
+void reset_derived_types(void);  // Forget interned types, when they are released.
 Type *get_callee_type(Type *type);
 
 // Struct
 
 StructInfo *create_struct_info(MemberInfo *members, int count, bool is_union, bool is_flexible);
 Type *create_struct_type(StructInfo *sinfo, const Name *name, int qualifier);
-int find_struct_member(const StructInfo *sinfo, const Name *name);
+int find_struct_member(StructInfo *sinfo, const Name *name);
 
 Type *create_enum_type(const Name *name);
 
@@ -24,7 +24,7 @@ int var_find(const Vector *vars, const Name *name) {
 
 VarInfo *var_add(Vector *vars, const Token *token, Type *type, int storage) {
   assert(token == NULL || var_find(vars, token->ident) < 0);
-  VarInfo *varinfo = calloc_or_die(sizeof(*varinfo));
+  VarInfo *varinfo = ast_alloc(sizeof(*varinfo));
   varinfo->ident = token;
   varinfo->type = type;
   varinfo->storage = storage;
@@ -37,10 +37,52 @@ VarInfo *var_add(Vector *vars, const Token *token, Type *type, int storage) {
 Scope *global_scope;
 static Table global_var_table;
 
+// Declaration order of names in the global scope, to hide the ones declared after
+// a deferred function body from it.
+static struct {
+  Table vars, structs, typedefs, enums;  // <order + 1>
+  int count;
+  int limit;  // -1 => No limit.
+} global_decls;
+
+static void order_global_decl(Table *table, const Name *name) {
+  if (table_get(table, name) == NULL)
+    table_put(table, name, INT2VOIDP(++global_decls.count));
+}
+
+static bool is_global_decl_visible(Table *table, const Name *name) {
+  if (global_decls.limit < 0)
+    return true;
+  void *order = table_get(table, name);
+  return order == NULL || VOIDP2INT(order) <= global_decls.limit;
+}
+
+int global_decl_count(void) {
+  return global_decls.count;
+}
+
+int limit_global_decls(int limit) {
+  int prev = global_decls.limit;
+  global_decls.limit = limit;
+  return prev;
+}
+
 void init_global(void) {
   global_scope = new_scope(NULL);
   global_scope->vars = new_vector();
   table_init(&global_var_table);
+
+  table_init(&global_decls.vars);
+  table_init(&global_decls.structs);
+  table_init(&global_decls.typedefs);
+  table_init(&global_decls.enums);
+  global_decls.count = 0;
+  global_decls.limit = -1;
+}
+
+static VarInfo *find_global(const Name *name) {
+  VarInfo *varinfo = table_get(&global_var_table, name);
+  return varinfo != NULL && is_global_decl_visible(&global_decls.vars, name) ? varinfo : NULL;
 }
 
 static VarInfo *define_global(const Token *token, Type *type, int storage) {
@@ -61,6 +103,7 @@ static VarInfo *define_global(const Token *token, Type *type, int storage) {
     varinfo = var_add(global_scope->vars, token, type, storage & ~VS_STATIC);
     varinfo->storage = storage;
     table_put(&global_var_table, name, varinfo);
+    order_global_decl(&global_decls.vars, name);
   }
   return varinfo;
 }
@@ -68,7 +111,7 @@ static VarInfo *define_global(const Token *token, Type *type, int storage) {
 // Scope
 
 Scope *new_scope(Scope *parent) {
-  Scope *scope = calloc_or_die(sizeof(*scope));
+  Scope *scope = ast_alloc(sizeof(*scope));
   scope->parent = parent;
   scope->vars = new_vector();
   return scope;
@@ -79,19 +122,46 @@ bool is_global_scope(Scope *scope) {
   return scope->parent == NULL;
 }
 
+#define VAR_TABLE_THRESHOLD  (8)  // Linear search is faster for fewer variables.
+
+VarInfo *scope_lookup(Scope *scope, const Name *name) {
+  Vector *vars = scope->vars;
+  if (vars == NULL)
+    return NULL;
+  if (vars->len < VAR_TABLE_THRESHOLD) {
+    int idx = var_find(vars, name);
+    return idx >= 0 ? vars->data[idx] : NULL;
+  }
+
+  Table *table = scope->var_table;
+  if (table == NULL) {
+    scope->var_table = table = alloc_table();
+  } else if (scope->indexed_vars != vars) {  // Replaced.
+    table_clear(table);
+    scope->indexed_count = 0;
+  }
+  scope->indexed_vars = vars;
+  // Variables are only appended, so index the rest.
+  for (int i = scope->indexed_count; i < vars->len; ++i) {
+    VarInfo *varinfo = vars->data[i];
+    if (varinfo->ident != NULL && table_get(table, varinfo->ident->ident) == NULL)  // First one wins.
+      table_put(table, varinfo->ident->ident, varinfo);
+  }
+  scope->indexed_count = vars->len;
+  return table_get(table, name);
+}
+
 VarInfo *scope_find(Scope *scope, const Name *name, Scope **pscope) {
   VarInfo *varinfo = NULL;
   for (; scope != NULL; scope = scope->parent) {
     if (is_global_scope(scope)) {
-      varinfo = table_get(&global_var_table, name);
+      varinfo = find_global(name);
       break;
     }
 
-    int idx = var_find(scope->vars, name);
-    if (idx >= 0) {
-      varinfo = scope->vars->data[idx];
+    varinfo = scope_lookup(scope, name);
+    if (varinfo != NULL)
       break;
-    }
   }
   if (pscope != NULL)
     *pscope = scope;
@@ -117,7 +187,8 @@ StructInfo *find_struct(Scope *scope, const Name *name, Scope **pscope) {
     if (scope->struct_table == NULL)
       continue;
     StructInfo *sinfo = table_get(scope->struct_table, name);
-    if (sinfo != NULL) {
+    if (sinfo != NULL &&
+        (!is_global_scope(scope) || is_global_decl_visible(&global_decls.structs, name))) {
       if (pscope != NULL)
         *pscope = scope;
       return sinfo;
@@ -130,19 +201,23 @@ void define_struct(Scope *scope, const Name *name, StructInfo *sinfo) {
   if (scope->struct_table == NULL)
     scope->struct_table = alloc_table();
   table_put(scope->struct_table, name, sinfo);
+  if (is_global_scope(scope))
+    order_global_decl(&global_decls.structs, name);
 }
 
 Type *find_typedef(Scope *scope, const Name *name, Scope **pscope) {
   for (; scope != NULL; scope = scope->parent) {
+    bool global = is_global_scope(scope);
     Type *type;
-    if (scope->typedef_table != NULL && (type = table_get(scope->typedef_table, name)) != NULL) {
+    if (scope->typedef_table != NULL && (type = table_get(scope->typedef_table, name)) != NULL &&
+        (!global || is_global_decl_visible(&global_decls.typedefs, name))) {
       if (pscope != NULL)
         *pscope = scope;
       return type;
     }
 
     // Shadowed by variable?
-    if (var_find(scope->vars, name) >= 0)
+    if ((global ? find_global(name) : scope_lookup(scope, name)) != NULL)
       break;
   }
   return NULL;
@@ -156,6 +231,8 @@ bool add_typedef(Scope *scope, const Name *name, Type *type) {
     scope->typedef_table = alloc_table();
   }
   table_put(scope->typedef_table, name, (void*)type);
+  if (is_global_scope(scope))
+    order_global_decl(&global_decls.typedefs, name);
   return true;
 }
 
@@ -164,18 +241,68 @@ Type *find_enum(Scope *scope, const Name *name) {
     if (scope->enum_table == NULL)
       continue;
     Type *type = table_get(scope->enum_table, name);
-    if (type != NULL)
+    if (type != NULL &&
+        (!is_global_scope(scope) || is_global_decl_visible(&global_decls.enums, name)))
       return type;
   }
   return NULL;
 }
 
+static void put_enum(Scope *scope, const Name *name, Type *type) {
+  if (scope->enum_table == NULL)
+    scope->enum_table = alloc_table();
+  table_put(scope->enum_table, name, type);
+  if (is_global_scope(scope))
+    order_global_decl(&global_decls.enums, name);
+}
+
 Type *define_enum(Scope *scope, const Name *name) {
   Type *type = create_enum_type(name);
-  if (name != NULL) {
-    if (scope->enum_table == NULL)
-      scope->enum_table = alloc_table();
-    table_put(scope->enum_table, name, type);
-  }
+  if (name != NULL)
+    put_enum(scope, name, type);
   return type;
 }
+
+// Global declarations in order
+
+GlobalDecl *list_global_decls(int *pcount) {
+  static const enum GlobalDeclKind kKinds[] = {GD_VAR, GD_STRUCT, GD_TYPEDEF, GD_ENUM};
+  Table *orders[] = {&global_decls.vars, &global_decls.structs, &global_decls.typedefs,
+                     &global_decls.enums};
+  Table *values[] = {&global_var_table, global_scope->struct_table, global_scope->typedef_table,
+                     global_scope->enum_table};
+  int count = global_decls.count;
+  GlobalDecl *decls = calloc_or_die(sizeof(*decls) * MAX(count, 1));
+  for (int i = 0; i < (int)ARRAY_SIZE(orders); ++i) {
+    const Name *name;
+    void *order;
+    for (int it = 0; (it = table_iterate(orders[i], it, &name, &order)) != -1; ) {
+      GlobalDecl *decl = &decls[VOIDP2INT(order) - 1];
+      decl->kind = kKinds[i];
+      decl->name = name;
+      decl->value = table_get(values[i], name);
+    }
+  }
+  *pcount = count;
+  return decls;
+}
+
+void add_global_decl(const GlobalDecl *decl) {
+  switch (decl->kind) {
+  case GD_VAR:
+    assert(table_get(&global_var_table, decl->name) == NULL);
+    vec_push(global_scope->vars, decl->value);
+    table_put(&global_var_table, decl->name, decl->value);
+    order_global_decl(&global_decls.vars, decl->name);
+    break;
+  case GD_STRUCT:
+    define_struct(global_scope, decl->name, decl->value);
+    break;
+  case GD_TYPEDEF:
+    add_typedef(global_scope, decl->name, decl->value);
+    break;
+  case GD_ENUM:
+    put_enum(global_scope, decl->name, decl->value);
+    break;
+  }
+}
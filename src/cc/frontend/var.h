@@ -75,6 +75,9 @@ static inline bool is_local_storage(const VarInfo *varinfo)  { return !(varinfo-
 typedef struct Scope {
   struct Scope *parent;
   Vector *vars;  // <VarInfo*>
+  Table *var_table;  // <VarInfo*>, index of `vars` built lazily for many variables.
+  const Vector *indexed_vars;  // `vars` indexed in `var_table`,
+  int indexed_count;           // up to this count.
   Table *struct_table;  // <StructInfo*>
   Table *typedef_table;  // <Type*>
   Table *enum_table;  // <Type*>
@@ -86,8 +89,14 @@ extern Vector *static_vars;  // <VarInfo*>
 Scope *new_scope(Scope *parent);
 bool is_global_scope(Scope *scope);
 VarInfo *scope_find(Scope *scope, const Name *name, Scope **pscope);
+VarInfo *scope_lookup(Scope *scope, const Name *name);  // Only in the scope, not in parents.
 VarInfo *scope_add(Scope *scope, const Token *name, Type *type, int storage);
 
+// Names declared in the global scope are counted in order, and the ones after the limit
+// are not found: a deferred function body must not see declarations following it.
+int global_decl_count(void);
+int limit_global_decls(int limit);  // -1 => No limit. Returns the previous one.
+
 StructInfo *find_struct(Scope *scope, const Name *name, Scope **pscope);
 void define_struct(Scope *scope, const Name *name, StructInfo *sinfo);
 
@@ -96,3 +105,20 @@ bool add_typedef(Scope *scope, const Name *name, Type *type);
 
 Type *find_enum(Scope *scope, const Name *name);
 Type *define_enum(Scope *scope, const Name *name);
+
+// Global declarations in order, e.g. to save them in precompiled header.
+enum GlobalDeclKind {
+  GD_VAR,
+  GD_STRUCT,
+  GD_TYPEDEF,
+  GD_ENUM,
+};
+
+typedef struct {
+  enum GlobalDeclKind kind;
+  const Name *name;
+  void *value;  // VarInfo*, StructInfo* or Type*
+} GlobalDecl;
+
+GlobalDecl *list_global_decls(int *pcount);  // Allocated, in declaration order.
+void add_global_decl(const GlobalDecl *decl);
@@ -1,8 +1,10 @@
 #include "../config.h"
 
 #include <assert.h>
+#include <stdlib.h>
 #include <string.h>
 
+#include "lexer.h"
 #include "preprocessor.h"
 #include "util.h"
 
@@ -16,18 +18,27 @@ static void usage(FILE *fp) {
       "  -isystem <path>     Add system include path\n"
       "  -idirafter <path>   Add include path (lower priority)\n"
       "  -C                  Preserve comments\n"
+      "  --token-output      Output binary token stream for cc1\n"
+      "  --make-pch          Output precompiled header\n"
   );
 }
 
-int main(int argc, char *argv[]) {
-  FILE *ofp = stdout;
+int cpp_main(int argc, char *argv[], FILE *ofp) {
+  reset_preprocessor();
   init_preprocessor(ofp);
+  bool token_output = false;
+  bool make_pch = false;
+  // Options which affect preprocess, to check validity of precompiled header.
+  StringBuffer signature;
+  sb_init(&signature);
 
   enum {
     OPT_HELP = 128,
     OPT_VERSION,
     OPT_ISYSTEM,
     OPT_IDIRAFTER,
+    OPT_TOKEN_OUTPUT,
+    OPT_MAKE_PCH,
   };
 
   static const struct option options[] = {
@@ -37,6 +48,9 @@ int main(int argc, char *argv[]) {
     {"D", required_argument},  // Define macro
     {"U", required_argument},  // Undefine macro
     {"C", no_argument},  // Do not discard comments
+    {"f", required_argument},  // -ftime-report, -fmem-report
+    {"-token-output", no_argument, OPT_TOKEN_OUTPUT},
+    {"-make-pch", no_argument, OPT_MAKE_PCH},
     {"-help", no_argument, OPT_HELP},
     {"v", no_argument, OPT_VERSION},
     {"-version", no_argument, OPT_VERSION},
@@ -44,6 +58,19 @@ int main(int argc, char *argv[]) {
   };
   int opt;
   while ((opt = optparse(argc, argv, options)) != -1) {
+    switch (opt) {
+    case 'I': case 'D': case 'U': case OPT_ISYSTEM: case OPT_IDIRAFTER:
+      {
+        const char *prefix = opt == 'I' ? "-I" : opt == 'D' ? "-D" : opt == 'U' ? "-U"
+                           : opt == OPT_ISYSTEM ? "-isystem " : "-idirafter ";
+        sb_append(&signature, prefix, NULL);
+        sb_append(&signature, optarg, NULL);
+        sb_append(&signature, "\n", NULL);
+      }
+      break;
+    default: break;
+    }
+
     switch (opt) {
     default: assert(false); break;
     case OPT_HELP:
@@ -70,12 +97,43 @@ int main(int argc, char *argv[]) {
     case 'C':
       set_preserve_comment(true);
       break;
+    case OPT_TOKEN_OUTPUT:
+      token_output = true;
+      break;
+    case OPT_MAKE_PCH:
+      make_pch = true;
+      break;
+    case 'f':
+      if (!parse_report_option(optarg))
+        fprintf(stderr, "Warning: unknown option: %s\n", argv[optind - 1]);
+      break;
     case '?':
       fprintf(stderr, "Warning: unknown option: %s\n", argv[optind - 1]);
       break;
     }
   }
 
+  set_pch_signature(sb_to_string(&signature));
+
+  FILE *tokfp = ofp;
+  char *tokbuf = NULL;
+  size_t toksize = 0;
+  if (make_pch) {
+    if (optind + 1 != argc)
+      error("Precompiled header requires one input file");
+    token_output = true;
+    set_pch_output(true);
+    tokfp = open_memstream(&tokbuf, &toksize);
+    if (tokfp == NULL)
+      error("open_memstream failed");
+  }
+  if (token_output) {
+    set_preserve_comment(false);
+    set_token_output(true);
+    init_token_output(tokfp);
+  }
+
+  report_begin("preprocess");
   int iarg = optind;
   if (iarg < argc) {
     for (int i = iarg; i < argc; ++i) {
@@ -89,5 +147,20 @@ int main(int argc, char *argv[]) {
   } else {
     preprocess(stdin, "*stdin*");
   }
+  if (token_output)
+    flush_token_output();
+  if (make_pch) {
+    fclose(tokfp);
+    write_pch(ofp, tokbuf, toksize);
+    free(tokbuf);
+  }
+  report_end();
+  report_output("cpp");
   return 0;
 }
+
+#if !defined(XCC_INTEGRATED)
+int main(int argc, char *argv[]) {
+  return cpp_main(argc, argv, stdout);
+}
+#endif
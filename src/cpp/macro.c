@@ -4,6 +4,7 @@
 #include <alloca.h>
 #include <assert.h>
 #include <limits.h>  // INT_MAX
+#include <stdint.h>  // uintptr_t
 #include <stdlib.h>  // malloc
 #include <string.h>
 
@@ -38,84 +39,174 @@ Macro *new_macro(Vector *params, const Name *vaargs_ident, Vector *body) {
 
 //
 
-typedef Table HideSet;
+// Pointer pair map: Open addressing hash table keyed on two pointers.
 
-static Vector hideset_array;
+typedef struct {
+  const void *key1;  // NULL => empty slot.
+  const void *key2;
+  void *value;
+} PtrMapEntry;
 
-static int search_hideset(const Token *tok) {
-  int n = hideset_array.len >> 1;
-  int lo = -1, hi = n;
-  while (hi - lo > 1) {
-    int m = lo + ((hi - lo) >> 1);
-    const Token *t = hideset_array.data[m << 1];
-    if (t < tok)
-      lo = m;
-    else
-      hi = m;
+typedef struct {
+  PtrMapEntry *entries;
+  int capacity;  // Power of 2.
+  int count;
+} PtrMap;
+
+static inline uint32_t hash_ptr2(const void *key1, const void *key2) {
+  uint64_t h = ((uint64_t)(uintptr_t)key1 ^ ((uint64_t)(uintptr_t)key2 << 7)) * 0x9e3779b97f4a7c15ULL;
+  return h >> 32;
+}
+
+static PtrMapEntry *ptrmap_find(const PtrMap *map, const void *key1, const void *key2) {
+  uint32_t mask = map->capacity - 1;
+  for (uint32_t i = hash_ptr2(key1, key2) & mask; ; i = (i + 1) & mask) {
+    PtrMapEntry *entry = &map->entries[i];
+    if (entry->key1 == NULL || (entry->key1 == key1 && entry->key2 == key2))
+      return entry;
   }
-  return hi << 1;
 }
 
-static HideSet *get_hideset(const Token *tok) {
-  int i = search_hideset(tok);
-  assert(i >= 0 && i <= hideset_array.len);
-  if (i < hideset_array.len) {
-    const Token *t = hideset_array.data[i];
-    if (t == tok)
-      return hideset_array.data[i + 1];
+static bool ptrmap_try_get(const PtrMap *map, const void *key1, const void *key2, void **output) {
+  if (map->count == 0)
+    return false;
+  const PtrMapEntry *entry = ptrmap_find(map, key1, key2);
+  *output = entry->value;
+  return entry->key1 != NULL;
+}
+
+static inline void *ptrmap_get(const PtrMap *map, const void *key1, const void *key2) {
+  void *value;
+  return ptrmap_try_get(map, key1, key2, &value) ? value : NULL;
+}
+
+static void ptrmap_put(PtrMap *map, const void *key1, const void *key2, void *value) {
+  assert(key1 != NULL);
+  if (map->count >= map->capacity / 2) {
+    PtrMap old = *map;
+    map->capacity = old.capacity > 0 ? old.capacity * 2 : 64;
+    map->entries = calloc_or_die(sizeof(*map->entries) * map->capacity);
+    map->count = 0;
+    for (int i = 0; i < old.capacity; ++i) {
+      const PtrMapEntry *e = &old.entries[i];
+      if (e->key1 != NULL)
+        ptrmap_put(map, e->key1, e->key2, e->value);
+    }
+    free(old.entries);
   }
-  return NULL;
+  PtrMapEntry *entry = ptrmap_find(map, key1, key2);
+  if (entry->key1 == NULL) {
+    entry->key1 = key1;
+    entry->key2 = key2;
+    ++map->count;
+  }
+  entry->value = value;
 }
 
-static void set_token_hideset(const Token *tok, HideSet *hs) {
-  int i = search_hideset(tok);
-  assert(i >= 0 && i <= hideset_array.len);
-  if (i < hideset_array.len && ((Token*)hideset_array.data[i]) == tok) {
-    hideset_array.data[i + 1] = hs;
-  } else {
-    vec_insert(&hideset_array, i, tok);
-    vec_insert(&hideset_array, i + 1, hs);
+static void ptrmap_clear(PtrMap *map) {
+  free(map->entries);
+  map->entries = NULL;
+  map->capacity = map->count = 0;
+}
+
+// Hide set: Immutable list of macro names sorted by address, and hash-consed
+// so that equal sets share the same pointer. Empty set is NULL.
+
+typedef struct HideSet {
+  const Name *name;
+  const struct HideSet *next;
+} HideSet;
+
+static PtrMap hideset_nodes;  // (name, next) => HideSet*
+static PtrMap hideset_unions;  // (hs1, hs2) => HideSet*
+static PtrMap hideset_intersections;  // (hs1, hs2) => HideSet*
+static PtrMap token_hidesets;  // (Token*, NULL) => HideSet*
+
+#define NAME_LT(a, b)  ((uintptr_t)(a) < (uintptr_t)(b))
+
+static const HideSet *hideset_cons(const Name *name, const HideSet *next) {
+  HideSet *hs = ptrmap_get(&hideset_nodes, name, next);
+  if (hs == NULL) {
+    hs = malloc_or_die(sizeof(*hs));
+    hs->name = name;
+    hs->next = next;
+    ptrmap_put(&hideset_nodes, name, next, hs);
   }
+  return hs;
 }
 
-static HideSet *clone_hideset(HideSet *hs) {
-  HideSet *cloned = alloc_table();
-  if (hs != NULL) {
-    const Name *name;
-    void *value;
-    for (int it = 0; (it = table_iterate(hs, it, &name, &value)) != -1; )
-      table_put(cloned, name, value);
+static bool hideset_contains(const HideSet *hs, const Name *name) {
+  for (; hs != NULL && !NAME_LT(name, hs->name); hs = hs->next) {
+    if (hs->name == name)
+      return true;
   }
-  return cloned;
+  return false;
 }
 
-static inline void hideset_put(HideSet *hs, const Name *token) {
-  assert(hs != NULL);
-  table_put(hs, token, (void*)token);
+static const HideSet *hideset_put(const HideSet *hs, const Name *name) {
+  if (hs == NULL || NAME_LT(name, hs->name))
+    return hideset_cons(name, hs);
+  if (hs->name == name)
+    return hs;
+  return hideset_cons(hs->name, hideset_put(hs->next, name));
 }
 
-static void union_hideset(HideSet *hs, HideSet *hs2) {
-  assert(hs != NULL);
-  if (hs2 != NULL) {
-    const Name *name;
-    void *value;
-    for (int it = 0; (it = table_iterate(hs2, it, &name, &value)) != -1; )
-      table_put(hs, name, value);
+static const HideSet *union_hideset(const HideSet *hs1, const HideSet *hs2) {
+  if (hs1 == hs2 || hs2 == NULL)
+    return hs1;
+  if (hs1 == NULL)
+    return hs2;
+  if (NAME_LT(hs2, hs1)) {  // Commutative: normalize the key.
+    const HideSet *t = hs1;
+    hs1 = hs2;
+    hs2 = t;
   }
+
+  const HideSet *result = ptrmap_get(&hideset_unions, hs1, hs2);
+  if (result == NULL) {
+    if (hs1->name == hs2->name)
+      result = hideset_cons(hs1->name, union_hideset(hs1->next, hs2->next));
+    else if (NAME_LT(hs1->name, hs2->name))
+      result = hideset_cons(hs1->name, union_hideset(hs1->next, hs2));
+    else
+      result = hideset_cons(hs2->name, union_hideset(hs1, hs2->next));
+    ptrmap_put(&hideset_unions, hs1, hs2, (void*)result);
+  }
+  return result;
 }
 
-static void intersection_hideset(HideSet *hs, HideSet *hs2) {
-  assert(hs != NULL);
-  if (hs2 == NULL) {
-    table_init(hs);
-  } else {
-    const Name *name;
-    void *value;
-    for (int it = 0; (it = table_iterate(hs, it, &name, &value)) != -1; ) {
-      if (!table_try_get(hs2, name, NULL))
-        table_delete(hs, name);
-    }
+static const HideSet *intersection_hideset(const HideSet *hs1, const HideSet *hs2) {
+  if (hs1 == hs2)
+    return hs1;
+  if (hs1 == NULL || hs2 == NULL)
+    return NULL;
+  if (NAME_LT(hs2, hs1)) {  // Commutative: normalize the key.
+    const HideSet *t = hs1;
+    hs1 = hs2;
+    hs2 = t;
   }
+
+  void *cached;
+  if (ptrmap_try_get(&hideset_intersections, hs1, hs2, &cached))  // Result can be empty (NULL).
+    return cached;
+
+  const HideSet *result;
+  if (hs1->name == hs2->name)
+    result = hideset_cons(hs1->name, intersection_hideset(hs1->next, hs2->next));
+  else if (NAME_LT(hs1->name, hs2->name))
+    result = intersection_hideset(hs1->next, hs2);
+  else
+    result = intersection_hideset(hs1, hs2->next);
+  ptrmap_put(&hideset_intersections, hs1, hs2, (void*)result);
+  return result;
+}
+
+static inline const HideSet *get_hideset(const Token *tok) {
+  return ptrmap_get(&token_hidesets, tok, NULL);
+}
+
+static inline void set_token_hideset(const Token *tok, const HideSet *hs) {
+  ptrmap_put(&token_hidesets, tok, NULL, (void*)hs);
 }
 
 static void glue1(Vector *ls, const Token *tok2) {
@@ -172,22 +263,15 @@ static Token *stringize(const Vector *arg) {
   return tok;
 }
 
-static void hsadd(HideSet *hs, Vector *ts) {
+static void hsadd(const HideSet *hs, Vector *ts) {
   for (int i = 0; i < ts->len; ++i) {
     const Token *tok = ts->data[i];
-    if (tok->kind == TK_IDENT || tok->kind == TK_RPAR) {
-      HideSet *h = get_hideset(tok);
-      if (h == NULL) {
-        h = clone_hideset(hs);
-        set_token_hideset(tok, h);
-      } else {
-        union_hideset(h, hs);
-      }
-    }
+    if (tok->kind == TK_IDENT || tok->kind == TK_RPAR)
+      set_token_hideset(tok, union_hideset(get_hideset(tok), hs));
   }
 }
 
-static Vector *subst(Macro *macro, Table *param_table, Vector *args, HideSet *hs) {
+static Vector *subst(Macro *macro, Table *param_table, Vector *args, const HideSet *hs) {
   Vector *os = new_vector();
   Vector *body = macro->body;
   if (body == NULL)
@@ -341,7 +425,10 @@ static Table macro_table;  // <Name, Macro*>
 
 void macro_init(void) {
   table_init(&macro_table);
-  vec_init(&hideset_array);
+  ptrmap_clear(&hideset_nodes);
+  ptrmap_clear(&hideset_unions);
+  ptrmap_clear(&hideset_intersections);
+  ptrmap_clear(&token_hidesets);
 }
 
 void macro_add(const Name *name, Macro *macro) {
@@ -356,27 +443,34 @@ void macro_delete(const Name *name) {
   table_delete(&macro_table, name);
 }
 
+int macro_iterate(int iterator, const Name **pname, Macro **pmacro) {
+  return table_iterate(&macro_table, iterator, pname, (void**)pmacro);
+}
+
 void macro_expand(Vector *tokens) {
-  for (int i = 0; i < tokens->len; ++i) {
-    const Token *tok = tokens->data[i];
-    if (tok->kind != TK_IDENT)
-      continue;
-    Macro *macro = macro_get(tok->ident);
-    if (macro == NULL)
-      continue;
-    HideSet *hs = get_hideset(tok);
-    if (hs != NULL && table_try_get(hs, tok->ident, NULL))
+  // Unprocessed tokens are kept in reverse order, so replacing the head is cheap.
+  Vector *stack = new_vector();
+  for (int i = tokens->len; --i >= 0; )
+    vec_push(stack, tokens->data[i]);
+  tokens->len = 0;
+
+  while (stack->len > 0) {
+    Token *tok = vec_pop(stack);
+    Macro *macro;
+    const HideSet *hs;
+    if (tok->kind != TK_IDENT || (macro = macro_get(tok->ident)) == NULL ||
+        hideset_contains(hs = get_hideset(tok), tok->ident)) {
+      vec_push(tokens, tok);
       continue;
+    }
 
-    int next = i + 1;
     const Vector *replaced = NULL;
     if (macro->params_len < 0) {  // "()-less macro"
-      hs = clone_hideset(hs);
-      hideset_put(hs, tok->ident);
-      replaced = subst(macro, NULL, NULL, hs);
+      replaced = subst(macro, NULL, NULL, hideset_put(hs, tok->ident));
     } else {  // "()'d macro"
-      Vector *args = pp_funargs(tokens, &next,
-                                macro->vaargs_ident != NULL ? macro->params_len : INT_MAX);
+      Token *rpar;
+      Vector *args = pp_funargs(stack, macro->vaargs_ident != NULL ? macro->params_len : INT_MAX,
+                                &rpar);
       if (args != NULL) {
         // Accept no argument for single parameter macro.
         if (args->len == 0 && macro->vaargs_ident == NULL && macro->params_len == 1)
@@ -388,21 +482,17 @@ void macro_expand(Vector *tokens) {
           pp_parse_error(tok, "Too %s arguments for macro `%.*s'", cmp, NAMES(tok->ident));
         }
 
-        assert(next > 0);
-        HideSet *hs2 = get_hideset(tokens->data[next - 1]);
-        hs = clone_hideset(hs);
-        intersection_hideset(hs, hs2);
-        hideset_put(hs, tok->ident);
-        replaced = subst(macro, macro->param_table, args, hs);
+        hs = intersection_hideset(hs, get_hideset(rpar));
+        replaced = subst(macro, macro->param_table, args, hideset_put(hs, tok->ident));
       }
     }
 
-    if (replaced != NULL) {
-      for (int n = next - i; n > 0; --n)
-        vec_remove_at(tokens, i);
-      for (int j = 0; j < replaced->len; ++j)
-        vec_insert(tokens, i + j, replaced->data[j]);
-      --i;
+    if (replaced == NULL) {
+      vec_push(tokens, tok);
+      continue;
     }
+    // Rescan replaced tokens.
+    for (int j = replaced->len; --j >= 0; )
+      vec_push(stack, replaced->data[j]);
   }
 }
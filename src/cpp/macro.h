@@ -19,4 +19,5 @@ void macro_init(void);
 void macro_add(const Name *name, Macro *macro);
 Macro *macro_get(const Name *name);
 void macro_delete(const Name *name);
+int macro_iterate(int iterator, const Name **pname, Macro **pmacro);  // -1 => end
 void macro_expand(Vector *tokens);
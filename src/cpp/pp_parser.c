@@ -23,6 +23,41 @@ Stream *set_pp_stream(Stream *stream) {
   return old;
 }
 
+ssize_t stream_getline(Stream *stream, char **lineptr, size_t *capa) {
+  if (stream->p == NULL)
+    return getline_cont(lineptr, capa, stream->fp, &stream->lineno);
+
+  const char *p = stream->p, *end = stream->end;
+  if (p >= end)
+    return -1;
+  size_t len = 0;
+  for (;;) {
+    const char *q = memchr(p, '\n', end - p);
+    const char *next = q != NULL ? q + 1 : end;
+    if (q == NULL)
+      q = end;
+    if (q > p && q[-1] == '\r')
+      --q;
+    size_t n = q - p;
+    if (len + n + 1 > *capa) {
+      *capa = len + n + 1;
+      *lineptr = realloc_or_die(*lineptr, *capa);
+    }
+    memcpy(*lineptr + len, p, n);
+    len += n;
+    p = next;
+    ++stream->lineno;
+    if (len == 0 || (*lineptr)[len - 1] != '\\')
+      break;
+    --len;  // Continue line.
+    if (p >= end)
+      break;
+  }
+  (*lineptr)[len] = '\0';
+  stream->p = p;
+  return len;
+}
+
 static void pp_parse_error_valist(const Token *token, const char *fmt, va_list ap) {
   if (fmt != NULL) {
     if (token == NULL)
@@ -120,7 +155,7 @@ Token *pp_match(enum TokenKind kind) {
 
         char *line = NULL;
         size_t capa = 0;
-        ssize_t len = getline_cont(&line, &capa, pp_stream->fp, &pp_stream->lineno);
+        ssize_t len = stream_getline(pp_stream, &line, &capa);
         if (len == -1) {
           lex_error(comment_start, "Block comment not closed");
         }
@@ -166,31 +201,25 @@ static Token *match2(enum TokenKind kind) {
   return pp_match(kind);
 }
 
-static Token *match3(enum TokenKind kind, Vector *tokens, int *pindex) {
-  int index = *pindex;
-  Token *tok;
-  if (index < tokens->len) {
-    tok = tokens->data[index];
-    if ((int)kind == -1 || tok->kind == kind)
-      ++index;
-    else
-      tok = NULL;
-  } else {
-    tok = match2(kind);
-    if (tok != NULL && tok->kind != TK_EOF) {
-      vec_push(tokens, tok);
-      ++index;
-    }
+static Token *match3(enum TokenKind kind, Vector *stack) {
+  if (stack->len > 0) {
+    Token *tok = stack->data[stack->len - 1];
+    if ((int)kind != -1 && tok->kind != kind)
+      return NULL;
+    --stack->len;
+    return tok;
   }
-  *pindex = index;
-  return tok;
+  return match2(kind);
 }
 
-Vector *pp_funargs(Vector *tokens, int *pindex, int vaarg) {
+Vector *pp_funargs(Vector *stack, int vaarg, Token **prpar) {
   Vector *args = NULL;
-  while (match3(PPTK_SPACE, tokens, pindex))
-    ;
-  if (match3(TK_LPAR, tokens, pindex)) {
+  int spaces = 0;
+  while (match3(PPTK_SPACE, stack))
+    ++spaces;
+  if (!match3(TK_LPAR, stack)) {
+    stack->len += spaces;  // Spaces are only in the stack, so put them back.
+  } else {
     args = new_vector();
     Vector *arg = NULL;
     int paren = 0;
@@ -198,8 +227,8 @@ Vector *pp_funargs(Vector *tokens, int *pindex, int vaarg) {
     const Token *tok_space = NULL;
     for (;;) {
       const char *start = get_lex_p();
-      bool fetched = *pindex >= tokens->len;
-      Token *tok = match3(-1, tokens, pindex);
+      bool fetched = stack->len <= 0;
+      Token *tok = match3(-1, stack);
       if (tok == NULL /*|| tok->kind == TK_EOF*/) {
         pp_parse_error(NULL, "`)' expected");
       }
@@ -207,8 +236,10 @@ Vector *pp_funargs(Vector *tokens, int *pindex, int vaarg) {
       if (tok->kind == TK_LPAR) {
         ++paren;
       } else if (tok->kind == TK_RPAR) {
-        if (paren <= 0)
+        if (paren <= 0) {
+          *prpar = tok;
           break;
+        }
         --paren;
       }
 
@@ -2,6 +2,7 @@
 
 #include <stdint.h>  // int64_t
 #include <stdio.h>  // FILE
+#include <sys/types.h>  // ssize_t
 
 #include "lexer.h"  // TokenKind, Token
 
@@ -13,12 +14,17 @@ typedef int64_t PpResult;
 typedef struct {
   const char *filename;
   FILE *fp;
+  const char *p, *end;  // Source buffer, read instead of `fp` if non-NULL.
   int lineno;
 } Stream;
 
 Stream *set_pp_stream(Stream *stream);
+// Read next line, joining lines ending with backslash, same as `getline_cont`.
+ssize_t stream_getline(Stream *stream, char **lineptr, size_t *capa);
 PpResult pp_expr(void);
-Vector *pp_funargs(Vector *tokens, int *pindex, int vaarg);  // <Vector*<Token*>>
+// Parse macro arguments from `stack` (tokens in reverse order, top is next), then from source.
+// Returns NULL without consuming if `(` doesn't follow.
+Vector *pp_funargs(Vector *stack, int vaarg, Token **prpar);  // <Vector*<Token*>>
 
 Token *pp_match(enum TokenKind kind);
 Token *pp_consume(enum TokenKind kind, const char *error);
@@ -8,6 +8,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/stat.h>
 #include <unistd.h>
 
 #include "lexer.h"
@@ -22,6 +23,8 @@
 
 static FILE *pp_ofp;
 static bool preserve_comment;
+static bool emit_tokens;  // Output binary token stream, instead of text.
+static bool pch_allowed;  // No token or directive has appeared yet: Precompiled header can be used.
 
 // Is `#if` condition satisfied?
 enum Satisfy {
@@ -30,6 +33,14 @@ enum Satisfy {
   ElseAppeared,
 };
 
+// Multiple include optimization: Detect the file is wrapped in `#ifndef X` ... `#endif`.
+enum GuardState {
+  GS_TOP,       // Only whitespaces or comments so far.
+  GS_INSIDE,    // Inside `#ifndef`.
+  GS_CLOSED,    // After `#endif`.
+  GS_NONE,      // Not guarded.
+};
+
 typedef struct PreprocessFile {
   Vector *condstack;
   Token *tok_lineno;
@@ -37,16 +48,22 @@ typedef struct PreprocessFile {
   bool enable;
   enum Satisfy satisfy;
   int out_lineno;
+  enum GuardState guard_state;
+  const Name *guard;  // Macro name of include guard.
   char linenobuf[sizeof(int) * 3 + 1];  // Buffer for __LINE__
 } PreprocessFile;
 
 static PreprocessFile *curpf;
 
-#define OUTPUT_PPLINE(...)  do { fprintf(pp_ofp, __VA_ARGS__); ++curpf->out_lineno; } while (0)
+static void preprocess_stream(const Stream *stream);
+
+#define OUTPUT_PPLINE(...)  do { if (!emit_tokens) { fprintf(pp_ofp, __VA_ARGS__); ++curpf->out_lineno; } } while (0)
 #define OUTPUT_COMMENT(...)  do { if (preserve_comment) OUTPUT_PPLINE(__VA_ARGS__); } while (0)
 
 static char *cat_path_cwd(const char *dir, const char *path) {
-  char *cwd = getcwd(NULL, 0);
+  static char *cwd;
+  if (cwd == NULL)
+    cwd = getcwd(NULL, 0);
   return JOIN_PATHS(cwd, dir, path);
 }
 
@@ -125,7 +142,7 @@ static bool handle_block_comment(const char **pp, Stream *stream) {
 
     char *line = NULL;
     size_t capa = 0;
-    ssize_t len = getline_cont(&line, &capa, stream->fp, &stream->lineno);
+    ssize_t len = stream_getline(stream, &line, &capa);
     if (len == -1) {
       lex_error(comment_start, "Block comment not closed");
     }
@@ -136,6 +153,8 @@ static bool handle_block_comment(const char **pp, Stream *stream) {
 
 static void process_line(const char *line, Stream *stream) {
   set_source_string(line, stream->filename, stream->lineno);
+  if (emit_tokens)
+    put_token_line(stream->filename, stream->lineno, line);
 
   const char *begin = get_lex_p();
 
@@ -163,15 +182,23 @@ static void process_line(const char *line, Stream *stream) {
 
     if (match(TK_EOF))
       break;
+    pch_allowed = false;
+    if (curpf->condstack->len == 0)
+      curpf->guard_state = GS_NONE;
 
     Token *ident = match(TK_IDENT);
     Macro *macro;
     if (ident != NULL) {
       if (equal_name(ident->ident, defined)) {
         // TODO: Raise error if not matched.
-        match(TK_LPAR);
-        match(TK_IDENT);
-        match(TK_RPAR);
+        static const enum TokenKind kinds[] = {TK_LPAR, TK_IDENT, TK_RPAR};
+        if (emit_tokens)
+          put_token(ident);
+        for (int i = 0; i < (int)ARRAY_SIZE(kinds); ++i) {
+          Token *tok = match(kinds[i]);
+          if (tok != NULL && emit_tokens)
+            put_token(tok);
+        }
       } else if ((macro = can_expand_ident(ident->ident)) != NULL) {
         const char *p = begin;
         begin = ident->end;  // Update for EOF callback.
@@ -180,24 +207,35 @@ static void process_line(const char *line, Stream *stream) {
         vec_push(tokens, ident);
         macro_expand(tokens);
 
-        if (ident->begin != p)
-          fwrite(p, ident->begin - p, 1, pp_ofp);
-
-        // Everything should have been expanded, so output
-        for (int i = 0; i < tokens->len; ++i) {
-          const Token *tok = tokens->data[i];
-          fwrite(tok->begin, tok->end - tok->begin, 1, pp_ofp);
-        }
-        if (macro->params_len >= 0) {
-          // Put whitespace to avoid unexpected concatenation.
-          fputc(' ', pp_ofp);
+        if (emit_tokens) {
+          // Expanded tokens are located at the macro invocation.
+          set_token_origin(ident);
+          for (int i = 0; i < tokens->len; ++i)
+            put_token(tokens->data[i]);
+        } else {
+          if (ident->begin != p)
+            fwrite(p, ident->begin - p, 1, pp_ofp);
+
+          // Everything should have been expanded, so output
+          for (int i = 0; i < tokens->len; ++i) {
+            const Token *tok = tokens->data[i];
+            fwrite(tok->begin, tok->end - tok->begin, 1, pp_ofp);
+          }
+          if (macro->params_len >= 0) {
+            // Put whitespace to avoid unexpected concatenation.
+            fputc(' ', pp_ofp);
+          }
         }
         begin = get_lex_p();
+      } else if (emit_tokens) {
+        put_token(ident);
       }
       continue;
     }
 
-    match(-1);
+    Token *tok = match(-1);
+    if (emit_tokens)
+      put_token(tok);
   }
 
   if (begin != NULL)
@@ -213,11 +251,14 @@ static char *preprocess_one_line(const char *line, Stream *stream, size_t *psize
     error("open_memstream failed");
   FILE *bak_fp = pp_ofp;
   int bak_lineno = curpf->out_lineno;
+  bool bak_emit_tokens = emit_tokens;
   pp_ofp = memfp;
+  emit_tokens = false;
 
   process_line(line, stream);
   pp_ofp = bak_fp;
   curpf->out_lineno = bak_lineno;
+  emit_tokens = bak_emit_tokens;
   fclose(memfp);
 
   assert(expanded[size] == '\0');
@@ -233,31 +274,75 @@ static char *preprocess_one_line(const char *line, Stream *stream, size_t *psize
 #define INC_ORDERS  (INC_AFTER + 1)
 
 static Vector sys_inc_paths[INC_ORDERS];  // <const char*>
-static Vector pragma_once_files;  // <const char*>
 
 static const Name *key_file;
 static const Name *key_line;
 
-static bool registered_pragma_once(const char *filename) {
-  for (int i = 0, len = pragma_once_files.len; i < len; ++i) {
-    const char *fn = pragma_once_files.data[i];
-    if (strcmp(fn, filename) == 0)
-      return true;
-  }
-  return false;
-}
+// Identity of a file, shared among its path aliases (symbolic links, etc.).
+typedef struct FileInfo {
+  const Name *guard;  // Macro name of include guard.
+  char *content;  // Kept for the file included again without guard.
+  size_t size;
+  int active;  // Number of inclusions being processed, which read `content`.
+  bool pragma_once;
+} FileInfo;
+
+static Table file_infos;  // <FileInfo*>: (st_dev, st_ino) => info
+static Table path_infos;  // <FileInfo*>: Full path => info
 
-static void register_pragma_once(const char *filename) {
+static FileInfo *get_file_info(const char *filename) {
   if (!is_fullpath(filename))
     filename = fullpath(filename);
-  vec_push(&pragma_once_files, filename);
+  const Name *path = alloc_name(filename, NULL, true);
+  FileInfo *info = table_get(&path_infos, path);
+  if (info == NULL) {
+    struct stat st;
+    if (stat(filename, &st) != 0)
+      return NULL;
+    uint64_t id[2] = {st.st_dev, st.st_ino};
+    const Name *key = alloc_name((char*)id, (char*)&id[2], true);
+    info = table_get(&file_infos, key);
+    if (info == NULL) {
+      info = calloc_or_die(sizeof(*info));
+      table_put(&file_infos, key, info);
+    }
+    table_put(&path_infos, path, info);
+  }
+  return info;
+}
+
+// Whether the file can be skipped: `#pragma once`, or include guard macro is still defined.
+static bool is_skippable(FileInfo *info) {
+  return info->pragma_once || (info->guard != NULL && macro_get(info->guard) != NULL);
+}
+
+// Read include file, whose content is read from disk only once.
+static const char *read_include(FileInfo *info, const char *filename) {
+  if (info->content == NULL) {
+    FILE *fp = fopen(filename, "r");
+    if (fp == NULL)
+      return NULL;
+    info->content = read_to_end(fp, &info->size);
+    fclose(fp);
+  }
+  return info->content;
+}
+
+static Table dir_exists_table;  // <const Name*>: Include directory => non-NULL if exists
+
+static bool dir_exists(const char *dir) {
+  const Name *name = alloc_name(dir, NULL, true);
+  void *result;
+  if (!table_try_get(&dir_exists_table, name, &result)) {
+    struct stat st;
+    result = stat(dir, &st) == 0 && S_ISDIR(st.st_mode) ? (void*)name : NULL;
+    table_put(&dir_exists_table, name, result);
+  }
+  return result != NULL;
 }
 
 // Search include file from system include paths.
-//   result!=NULL: Found (returns found path into *pfn)
-//   result==NULL, *pfn!=NULL: Found, but blocked because of pragma once.
-//   result==NULL, *pfn==NULL: Not found.
-static FILE *search_sysinc(const char *prevdir, const char *path, char **pfn) {
+static char *search_sysinc(const char *prevdir, const char *path) {
   for (int ord = 0; ord < INC_ORDERS; ++ord) {
     Vector *v = &sys_inc_paths[ord];
     for (int idx = 0; idx < v->len; ++idx) {
@@ -267,20 +352,315 @@ static FILE *search_sysinc(const char *prevdir, const char *path, char **pfn) {
         continue;
       }
 
-      FILE *fp = NULL;
+      if (!dir_exists(v->data[idx]))
+        continue;
       char *fn = cat_path_cwd(v->data[idx], path);
-      if (registered_pragma_once(fn) ||  // If pragma once hit, then fp keeps NULL.
-          (is_file(fn) && (fp = fopen(fn, "r")) != NULL)) {
-        *pfn = fn;
-        return fp;
-      }
+      if (is_file(fn))
+        return fn;
+      free(fn);
     }
   }
-  *pfn = NULL;
   return NULL;
 }
 
+static Table include_cache;  // <const char*>: Including directory and spelled name => full path
+
+// Resolve include file into full path, or NULL if not found.
+static const char *resolve_include(const char *dir, const char *path, bool sys, bool is_next) {
+  StringBuffer sb;
+  sb_init(&sb);
+  if (!sys || is_next)
+    sb_append(&sb, dir, NULL);
+  sb_append(&sb, is_next ? "\n+" : sys ? "\n<" : "\n\"", NULL);
+  sb_append(&sb, path, NULL);
+  char *keystr = sb_to_string(&sb);
+  const Name *key = alloc_name(keystr, NULL, true);
+  free(keystr);
+
+  void *result;
+  if (table_try_get(&include_cache, key, &result))
+    return result;
+
+  char *fn = NULL;
+  if (!sys && !is_next) {  // Search from current directory.
+    fn = cat_path_cwd(dir, path);
+    if (!is_file(fn)) {
+      free(fn);
+      fn = NULL;
+    }
+  }
+  if (fn == NULL)
+    fn = search_sysinc(is_next ? dir : NULL, path);
+  table_put(&include_cache, key, fn);
+  return fn;
+}
+
+// Precompiled header: Preprocessed tokens of a header, and the state after it
+// (macros, include guards and `#pragma once`).
+// It is used instead of the header, when the source starts with its `#include`.
+// The token stream refers to the file instead of carrying the tokens, and cc1 loads
+// the global scope which it has appended after parsing them (See cc/frontend/pch.c).
+// The file must be placed next to the header (`foo.h` => `foo.pch`).
+//
+//   pch := header signature deps tokens names files macros file_states [scope]
+//   header := magic offsets  (See lexer.h)
+//   deps := count (path size mtime)*
+//   macros := count (name params_len+1 param* vaargs body)*
+//   file_states := count (path guard pragma_once)*
+
+static bool pch_output;
+static bool toplevel_started;
+static const char *pch_signature = "";  // Options affecting preprocess.
+static Vector pch_deps;  // <const char*>: Files read to build PCH.
+
+static Vector *parse_macro_body(const char *p, Stream *stream);
+
+static void pch_put_names(DataStorage *data, const Vector *names) {
+  data_uleb128(data, -1, names->len);
+  for (int i = 0; i < names->len; ++i) {
+    const Name *name = names->data[i];
+    data_string(data, name->chars, name->bytes);
+  }
+}
+
+void write_pch(FILE *ofp, const void *tokens, size_t size) {
+  DataStorage data;
+  data_init(&data);
+  unsigned char header[PCH_HEADER_SIZE] = {0};  // Put after the offsets are fixed.
+  data_append(&data, header, sizeof(header));
+  data_string(&data, pch_signature, strlen(pch_signature));
+
+  data_uleb128(&data, -1, pch_deps.len);
+  for (int i = 0; i < pch_deps.len; ++i) {
+    const char *path = pch_deps.data[i];
+    struct stat st;
+    if (stat(path, &st) != 0)
+      error("Cannot open file: %s", path);
+    data_string(&data, path, strlen(path));
+    data_uleb128(&data, -1, st.st_size);
+    data_uleb128(&data, -1, st.st_mtime);
+  }
+
+  uint64_t offsets[PCH_OFFSET_COUNT];
+  offsets[PCH_TOKENS_OFFSET] = data.len;
+  offsets[PCH_TOKENS_SIZE] = size;
+  data_append(&data, tokens, size);
+  Vector names, files;
+  vec_init(&names);
+  vec_init(&files);
+  save_token_output(&names, &files);
+  pch_put_names(&data, &names);
+  pch_put_names(&data, &files);
+
+  Vector macros;  // [name, macro, name, macro, ...]
+  vec_init(&macros);
+  const Name *name;
+  Macro *macro;
+  for (int it = 0; (it = macro_iterate(it, &name, &macro)) != -1; ) {
+    if (!equal_name(name, key_file) && !equal_name(name, key_line)) {
+      vec_push(&macros, name);
+      vec_push(&macros, macro);
+    }
+  }
+  data_uleb128(&data, -1, macros.len / 2);
+  for (int i = 0; i < macros.len; i += 2) {
+    name = macros.data[i];
+    macro = macros.data[i + 1];
+    data_string(&data, name->chars, name->bytes);
+    data_uleb128(&data, -1, macro->params_len + 1);
+    if (macro->params_len > 0) {
+      const Name **params = calloc_or_die(sizeof(*params) * macro->params_len);
+      const Name *param;
+      void *index;
+      for (int it = 0; (it = table_iterate(macro->param_table, it, &param, &index)) != -1; ) {
+        if (VOIDP2INT(index) < macro->params_len)
+          params[VOIDP2INT(index)] = param;
+      }
+      for (int j = 0; j < macro->params_len; ++j)
+        data_string(&data, params[j]->chars, params[j]->bytes);
+      free(params);
+    }
+    const Name *vaargs = macro->vaargs_ident;
+    data_string(&data, vaargs != NULL ? vaargs->chars : "", vaargs != NULL ? vaargs->bytes : 0);
+
+    // Body: Spellings of tokens, which are parsed again on loading.
+    StringBuffer sb;
+    sb_init(&sb);
+    if (macro->body != NULL) {
+      for (int j = 0; j < macro->body->len; ++j) {
+        const Token *tok = macro->body->data[j];
+        sb_append(&sb, tok->begin, tok->end);
+      }
+    }
+    char *body = sb_to_string(&sb);
+    data_string(&data, body, strlen(body));
+    free(body);
+  }
+
+  Vector states;  // [path, info, path, info, ...]
+  vec_init(&states);
+  FileInfo *info;
+  for (int it = 0; (it = table_iterate(&path_infos, it, &name, (void**)&info)) != -1; ) {
+    if (info->guard != NULL || info->pragma_once) {
+      vec_push(&states, name);
+      vec_push(&states, info);
+    }
+  }
+  data_uleb128(&data, -1, states.len / 2);
+  for (int i = 0; i < states.len; i += 2) {
+    name = states.data[i];
+    info = states.data[i + 1];
+    data_string(&data, name->chars, name->bytes);
+    const Name *guard = info->guard;
+    data_string(&data, guard != NULL ? guard->chars : "", guard != NULL ? guard->bytes : 0);
+    data_push(&data, info->pragma_once);
+  }
+
+  offsets[PCH_SCOPE_OFFSET] = data.len;
+  put_pch_header(data.buf, offsets);
+  fwrite(data.buf, 1, data.len, ofp);
+  data_release(&data);
+}
+
+typedef struct {
+  const unsigned char *p, *end;
+  const char *filename;
+} PchReader;
+
+static void pch_check_size(PchReader *reader, size_t size) {
+  if (size > (size_t)(reader->end - reader->p))
+    error("Broken precompiled header: %s", reader->filename);
+}
+
+static uint64_t pch_read_uleb128(PchReader *reader) {
+  uint64_t value = 0;
+  for (int shift = 0; ; shift += 7) {
+    pch_check_size(reader, 1);
+    unsigned char c = *reader->p++;
+    value |= (uint64_t)(c & 0x7f) << shift;
+    if (!(c & 0x80))
+      return value;
+  }
+}
+
+static const char *pch_read_bytes(PchReader *reader, size_t size) {
+  pch_check_size(reader, size);
+  const char *p = (const char*)reader->p;
+  reader->p += size;
+  return p;
+}
+
+static char *pch_read_string(PchReader *reader) {
+  size_t len = pch_read_uleb128(reader);
+  return strndup(pch_read_bytes(reader, len), len);
+}
+
+static const Name *pch_read_name(PchReader *reader) {
+  size_t len = pch_read_uleb128(reader);
+  if (len == 0)
+    return NULL;
+  const char *p = pch_read_bytes(reader, len);
+  return alloc_name(p, p + len, true);
+}
+
+static Vector *pch_read_names(PchReader *reader) {
+  Vector *names = new_vector();
+  for (size_t n = pch_read_uleb128(reader); n > 0; --n)
+    vec_push(names, pch_read_name(reader));
+  return names;
+}
+
+// Whether the PCH was built with the same options, and files are not changed.
+static bool is_pch_valid(PchReader *reader, uint64_t offsets[PCH_OFFSET_COUNT]) {
+  if (!read_pch_header(reader->p, reader->end - reader->p, offsets))
+    return false;
+  reader->end = reader->p + offsets[PCH_SCOPE_OFFSET];  // Scope is for cc1.
+  reader->p += PCH_HEADER_SIZE;
+
+  size_t len = pch_read_uleb128(reader);
+  const char *signature = pch_read_bytes(reader, len);
+  if (len != strlen(pch_signature) || memcmp(signature, pch_signature, len) != 0)
+    return false;
+
+  for (size_t n = pch_read_uleb128(reader); n > 0; --n) {
+    char *path = pch_read_string(reader);
+    uint64_t size = pch_read_uleb128(reader);
+    uint64_t mtime = pch_read_uleb128(reader);
+    struct stat st;
+    bool ok = stat(path, &st) == 0 && (uint64_t)st.st_size == size &&
+              (uint64_t)st.st_mtime == mtime;
+    free(path);
+    if (!ok)
+      return false;
+  }
+  return true;
+}
+
+// Use PCH for the header (`foo.h` => `foo.pch`), if exists and valid.
+static bool load_pch(const char *header) {
+  char *filename = change_ext(header, "pch");
+  size_t size;
+  unsigned char *content = map_file(filename, &size);
+  if (content == NULL) {
+    free(filename);
+    return false;
+  }
+
+  PchReader reader = {.p = content, .end = content + size, .filename = filename};
+  uint64_t offsets[PCH_OFFSET_COUNT];
+  if (!is_pch_valid(&reader, offsets)) {
+    unmap_file(content, size);
+    free(filename);
+    return false;
+  }
+
+  pch_read_bytes(&reader, offsets[PCH_TOKENS_SIZE]);  // Tokens are read by cc1.
+  Vector *names = pch_read_names(&reader);
+  Vector *files = pch_read_names(&reader);
+  put_token_pch(filename, names, files);
+
+  // Replace macros, except ones for current file.
+  Vector *olds = new_vector();
+  const Name *name;
+  for (int it = 0; (it = macro_iterate(it, &name, NULL)) != -1; ) {
+    if (!equal_name(name, key_file) && !equal_name(name, key_line))
+      vec_push(olds, name);
+  }
+  for (int i = 0; i < olds->len; ++i)
+    macro_delete(olds->data[i]);
+  for (size_t n = pch_read_uleb128(&reader); n > 0; --n) {
+    name = pch_read_name(&reader);
+    int params_len = (int)pch_read_uleb128(&reader) - 1;
+    Vector *params = NULL;
+    if (params_len >= 0) {
+      params = new_vector();
+      for (int i = 0; i < params_len; ++i)
+        vec_push(params, pch_read_name(&reader));
+    }
+    const Name *vaargs = pch_read_name(&reader);
+    char *body = pch_read_string(&reader);
+    macro_add(name, new_macro(params, vaargs, parse_macro_body(body, NULL)));
+  }
+
+  for (size_t n = pch_read_uleb128(&reader); n > 0; --n) {
+    char *path = pch_read_string(&reader);
+    const Name *guard = pch_read_name(&reader);
+    bool pragma_once = *pch_read_bytes(&reader, 1) != 0;
+    FileInfo *info = get_file_info(path);
+    if (info != NULL) {
+      info->guard = guard;
+      info->pragma_once = pragma_once;
+    }
+  }
+
+  unmap_file(content, size);
+  free(filename);
+  return true;
+}
+
 static void handle_include(const char *p, Stream *stream, bool is_next) {
+  bool allow_pch = pch_allowed;
+  pch_allowed = false;
   const char *orgp = p = skip_whitespaces(p);
 
   if (*p != '<')
@@ -350,31 +730,31 @@ static void handle_include(const char *p, Stream *stream, bool is_next) {
   }
 
   char *path = strndup(p, q - p);
-  char *fn = NULL;
-  FILE *fp = NULL;
   char *dir = strdup(dirname(strdup(stream->filename)));
-  // Search from current directory.
-  if (!is_next && !sys) {
-    fn = cat_path_cwd(dir, path);
-    if (registered_pragma_once(fn))
-      return;
-    if (is_file(fn))
-      fp = fopen(fn, "r");
-  }
-  if (fp == NULL) {
-    fp = search_sysinc(is_next ? dir : NULL, path, &fn);
-    if (fp == NULL) {
-      if (fn == NULL)  // Raise error except pragma once.
-        error("Cannot open file: %s", path);
-      return;
-    }
+  const char *fn = resolve_include(dir, path, sys, is_next);
+  FileInfo *info;
+  if (fn == NULL || (info = get_file_info(fn)) == NULL)
+    error("Cannot open file: %s", path);
+  if (is_skippable(info))
+    return;
+  if (allow_pch && load_pch(fn))
+    return;
+  const char *content = read_include(info, fn);
+  if (content == NULL)
+    error("Cannot open file: %s", path);
+
+  Stream incstream = {.filename = fn, .p = content, .end = content + info->size};
+  ++info->active;
+  preprocess_stream(&incstream);
+  // Guarded file is not read again, but the content might still be read by an outer inclusion.
+  if (--info->active == 0 && (info->guard != NULL || info->pragma_once)) {
+    free(info->content);
+    info->content = NULL;
   }
 
-  preprocess(fp, fn);
-  fclose(fp);
-
   // Put linemarker to restore line and filename.
-  fprintf(pp_ofp, "# %d \"%s\" 2\n", stream->lineno + 1, stream->filename);
+  if (!emit_tokens)
+    fprintf(pp_ofp, "# %d \"%s\" 2\n", stream->lineno + 1, stream->filename);
 }
 
 static void handle_pragma(const char **pp, const char *filename) {
@@ -382,8 +762,9 @@ static void handle_pragma(const char **pp, const char *filename) {
   const char *begin = p;
   const char *end = read_ident(p);
   if ((end - begin) == 4 && strncmp(begin, "once", 4) == 0) {
-    if (!registered_pragma_once(filename))
-      register_pragma_once(filename);
+    FileInfo *info = get_file_info(filename);
+    if (info != NULL)
+      info->pragma_once = true;
     *pp = end;
   } else {
     fprintf(stderr, "Warning: unhandled #pragma: %s\n", p);
@@ -400,10 +781,7 @@ static void handle_line_directive(const char **pp, Stream *stream) {
     FILE *memfp = fmemopen(expanded, size, "r");
     assert(memfp != NULL);
 
-    Stream tmp_stream;
-    tmp_stream.fp = memfp;
-    tmp_stream.filename = stream->filename;
-    tmp_stream.lineno = stream->lineno;
+    Stream tmp_stream = {.filename = stream->filename, .fp = memfp, .lineno = stream->lineno};
     Stream *bak_stream = set_pp_stream(&tmp_stream);
     set_source_file(memfp, stream->filename);
     num = pp_expr();
@@ -453,7 +831,7 @@ static Vector *parse_macro_body(const char *p, Stream *stream) {
         char *line = NULL;
         if (stream != NULL) {
           size_t capa = 0;
-          len = getline_cont(&line, &capa, stream->fp, &stream->lineno);
+          len = stream_getline(stream, &line, &capa);
         }
         if (len == -1) {
           lex_error(comment_start, "Block comment not closed");
@@ -546,6 +924,7 @@ static void handle_undef(const char **pp) {
 static const char *find_double_quote_end(const char *p) {
   const char *start = p;
   for (;;) {
+    p = find_chars(p, '"', '\\', '"');
     switch (*p++) {
     case '\0':
       lex_error(start, "Quote not closed");
@@ -569,7 +948,7 @@ static const char *find_block_comment_end(const char *comment_start, Stream *str
 
     char *line = NULL;
     size_t capa = 0;
-    ssize_t len = getline_cont(&line, &capa, stream->fp, &stream->lineno);
+    ssize_t len = stream_getline(stream, &line, &capa);
     if (len == -1) {
       lex_error(comment_start, "Block comment not closed");
     }
@@ -580,6 +959,7 @@ static const char *find_block_comment_end(const char *comment_start, Stream *str
 
 static void process_disabled_line(const char *p, Stream *stream) {
   for (;;) {
+    p = find_chars(p, '"', '\'', '/');
     switch (*p++) {
     case '\0':
       return;
@@ -617,6 +997,69 @@ static void process_disabled_line(const char *p, Stream *stream) {
   }
 }
 
+// Whether quotes and comments in the line [p, q) are closed within it.
+// `*pspecial` caches the next quote or slash, not to scan following lines again.
+static bool is_closed_line(const char *p, const char *q, const char **pspecial) {
+  for (;;) {
+    if (*pspecial < p)
+      *pspecial = find_chars(p, '"', '\'', '/');
+    const char *r = *pspecial;
+    if (r >= q)
+      return true;
+    char c = *r++;
+    switch (c) {
+    case '"': case '\'':
+      for (; r < q && *r != c; ++r) {
+        if (*r == '\0')
+          return false;
+        if (*r == '\\')
+          ++r;
+      }
+      if (r >= q)
+        return false;
+      p = r + 1;
+      break;
+    case '/':
+      if (*r == '/')
+        return true;
+      if (*r == '*') {
+        r = block_comment_end(r + 1);
+        if (r == NULL || r > q)
+          return false;
+      }
+      p = r;
+      break;
+    default:  // Embedded '\0'.
+      return false;
+    }
+  }
+}
+
+// Skip lines in disabled block directly on the source buffer, instead of reading
+// them one by one: Stops at a line which can be a directive (`#` or block comment
+// at the top), or which needs care (quote or comment continues, or backslash at the end).
+static void skip_disabled_lines(Stream *stream) {
+  const char *p = stream->p, *end = stream->end;
+  const char *special = find_chars(p, '"', '\'', '/');
+  int lineno = stream->lineno;
+  for (; p < end; ++lineno) {
+    const char *s = p;
+    while (*s != '\n' && isspace(*s))
+      ++s;
+    if (*s == '#' || (*s == '/' && s[1] == '*'))
+      break;
+    const char *q = memchr(s, '\n', end - s);
+    if (q == NULL)
+      break;
+    const char *e = q > s && q[-1] == '\r' ? q - 1 : q;
+    if ((e > s && e[-1] == '\\') || !is_closed_line(s, q, &special))
+      break;
+    p = q + 1;
+  }
+  stream->p = p;
+  stream->lineno = lineno;
+}
+
 static bool handle_ifdef(const char **pp) {
   const char *p = *pp;
   const char *begin = p;
@@ -638,10 +1081,7 @@ static bool handle_if(const char **pp, Stream *stream, bool enable) {
     FILE *memfp = fmemopen(expanded, size, "r");
     assert(memfp != NULL);
 
-    Stream tmp_stream;
-    tmp_stream.fp = memfp;
-    tmp_stream.filename = stream->filename;
-    tmp_stream.lineno = stream->lineno;
+    Stream tmp_stream = {.filename = stream->filename, .fp = memfp, .lineno = stream->lineno};
     Stream *bak_stream = set_pp_stream(&tmp_stream);
     set_source_file(memfp, stream->filename);
     result = pp_expr();
@@ -675,7 +1115,13 @@ void init_preprocessor(FILE *ofp) {
 
   // Keep sys_inc_paths.
 
-  vec_init(&pragma_once_files);
+  table_init(&file_infos);
+  table_init(&path_infos);
+  table_init(&dir_exists_table);
+  table_init(&include_cache);
+
+  vec_clear(&pch_deps);
+  pch_allowed = toplevel_started = false;
 
   macro_init();
   init_lexer_for_preprocessor();
@@ -685,18 +1131,39 @@ void set_preserve_comment(bool enable) {
   preserve_comment = enable;
 }
 
+void set_token_output(bool enable) {
+  emit_tokens = enable;
+}
+
+void set_pch_output(bool enable) {
+  pch_output = enable;
+}
+
+void set_pch_signature(const char *signature) {
+  pch_signature = signature;
+}
+
 static const char *process_directive(PreprocessFile *ppf, const char *line) {
   // Find '#'
   const char *directive = find_directive(line);
   if (directive == NULL)
     return line;
 
+  // Only `#include` at the top can use precompiled header.
+  if (keyword(directive, "include") == NULL)
+    pch_allowed = false;
+
   if (isdigit(*directive)) {
     // Assume linemarkers: output as is.
     OUTPUT_PPLINE("%s\n", line);
     return NULL;
   }
 
+  // Only `#ifndef` at the top and its `#endif` are allowed for include guard.
+  if (ppf->condstack->len == 0 &&
+      !(ppf->guard_state == GS_TOP && keyword(directive, "ifndef") != NULL))
+    ppf->guard_state = GS_NONE;
+
   const char *next;
   if ((next = keyword(directive, "ifdef")) != NULL) {
     vec_push(ppf->condstack, INT2VOIDP(cond_value(ppf->enable, ppf->satisfy)));
@@ -704,6 +1171,14 @@ static const char *process_directive(PreprocessFile *ppf, const char *line) {
     ppf->satisfy = defined ? Satisfied : NotSatisfied;
     ppf->enable = ppf->enable && ppf->satisfy == Satisfied;
   } else if ((next = keyword(directive, "ifndef")) != NULL) {
+    if (ppf->guard_state == GS_TOP) {
+      const char *p = next;
+      const char *end = read_ident(p);
+      if (end != NULL) {
+        ppf->guard_state = GS_INSIDE;
+        ppf->guard = alloc_name(p, end, false);
+      }
+    }
     vec_push(ppf->condstack, INT2VOIDP(cond_value(ppf->enable, ppf->satisfy)));
     bool defined = handle_ifdef(&next);
     ppf->satisfy = defined ? NotSatisfied : Satisfied;
@@ -720,6 +1195,8 @@ static const char *process_directive(PreprocessFile *ppf, const char *line) {
     intptr_t flag = VOIDP2INT(ppf->condstack->data[last]);
     if (ppf->satisfy == ElseAppeared)
       error("Illegal #else");
+    if (last == 0)
+      ppf->guard_state = GS_NONE;
     ppf->enable = !ppf->enable && ppf->satisfy == NotSatisfied && ((flag & CF_ENABLE) != 0);
     ppf->satisfy = ElseAppeared;
   } else if ((next = keyword(directive, "elif")) != NULL) {
@@ -729,6 +1206,8 @@ static const char *process_directive(PreprocessFile *ppf, const char *line) {
     intptr_t flag = VOIDP2INT(ppf->condstack->data[last]);
     if (ppf->satisfy == ElseAppeared)
       error("Illegal #elif");
+    if (last == 0)
+      ppf->guard_state = GS_NONE;
 
     bool cond = false;
     bool cond2 = handle_if(&next, &ppf->stream, ppf->enable);
@@ -745,6 +1224,8 @@ static const char *process_directive(PreprocessFile *ppf, const char *line) {
     int flag = VOIDP2INT(vec_pop(ppf->condstack));
     ppf->enable = (flag & CF_ENABLE) != 0;
     ppf->satisfy = (flag & CF_SATISFY_MASK) >> CF_SATISFY_SHIFT;
+    if (ppf->condstack->len == 0 && ppf->guard_state == GS_INSIDE)
+      ppf->guard_state = GS_CLOSED;
   } else if (ppf->enable) {
     if ((next = keyword(directive, "include")) != NULL) {
       handle_include(next, &ppf->stream, false);
@@ -766,7 +1247,8 @@ static const char *process_directive(PreprocessFile *ppf, const char *line) {
     } else if ((next = keyword(directive, "line")) != NULL) {
       handle_line_directive(&next, &ppf->stream);
       int flag = 1;
-      fprintf(pp_ofp, "# %d \"%s\" %d\n", ppf->stream.lineno, ppf->stream.filename, flag);
+      if (!emit_tokens)
+        fprintf(pp_ofp, "# %d \"%s\" %d\n", ppf->stream.lineno, ppf->stream.filename, flag);
       define_file_macro(ppf->stream.filename);
       ppf->out_lineno = --ppf->stream.lineno;
       next = NULL;
@@ -780,11 +1262,13 @@ static const char *process_directive(PreprocessFile *ppf, const char *line) {
 }
 
 static void adjust_output_lineno(PreprocessFile *ppf) {
+  if (emit_tokens)
+    return;  // Token stream holds line number for each line.
   assert(ppf->out_lineno <= ppf->stream.lineno);
   int d = ppf->stream.lineno - ppf->out_lineno;
   if (d > 0) {
     if (d >= 5) {
-      fprintf(pp_ofp, "# %d \"%s\"\n", ppf->stream.lineno, ppf->stream.filename);
+      fprintf(pp_ofp, "# %d \"%s\"\n", ppf->stream.lineno + 1, ppf->stream.filename);
     } else {
       for (int i = 0; i < d; ++i)
         fprintf(pp_ofp, "\n");
@@ -796,9 +1280,12 @@ static void adjust_output_lineno(PreprocessFile *ppf) {
 const char *get_processed_next_line(void) {
   PreprocessFile *ppf = curpf;
   for (;;) {
+    if (!ppf->enable && ppf->stream.p != NULL)
+      skip_disabled_lines(&ppf->stream);
+
     char *line = NULL;
     size_t capa = 0;
-    ssize_t len = getline_cont(&line, &capa, ppf->stream.fp, &ppf->stream.lineno);
+    ssize_t len = stream_getline(&ppf->stream, &line, &capa);
     if (len == -1)
       return NULL;
 
@@ -816,21 +1303,32 @@ const char *get_processed_next_line(void) {
   }
 }
 
-void preprocess(FILE *fp, const char *filename) {
+static void preprocess_stream(const Stream *stream) {
+  const char *filename = stream->filename;
   Macro *old_file_macro = macro_get(key_file);
   Macro *old_line_macro = macro_get(key_line);
 
   PreprocessFile pf;
   pf.condstack = new_vector();
-  pf.stream = (Stream){.filename = filename, .fp = fp, .lineno = 0};
+  pf.stream = *stream;
   pf.enable = true;
   pf.out_lineno = 0;
   pf.satisfy = NotSatisfied;
+  pf.guard_state = GS_TOP;
+  pf.guard = NULL;
 
   Stream *old_stream = set_pp_stream(&pf.stream);
   PreprocessFile *oldpf = curpf;
   curpf = &pf;
 
+  if (oldpf == NULL) {
+    // Token output must be empty to put tokens from precompiled header.
+    pch_allowed = emit_tokens && !pch_output && !toplevel_started;
+    toplevel_started = true;
+  }
+  if (pch_output)
+    vec_push(&pch_deps, is_fullpath(filename) ? filename : fullpath(filename));
+
   define_file_macro(pf.stream.filename);
 
   // __LINE__ : Dirty hack.
@@ -839,7 +1337,8 @@ void preprocess(FILE *fp, const char *filename) {
   vec_push(lineno_tokens, pf.tok_lineno);
   macro_add(key_line, new_macro(NULL, NULL, lineno_tokens));
 
-  fprintf(pp_ofp, "# 1 \"%s\" 1\n", filename);
+  if (!emit_tokens)
+    fprintf(pp_ofp, "# 1 \"%s\" 1\n", filename);
 
   for (const char *line; (line = get_processed_next_line()) != NULL;) {
     process_line(line, &pf.stream);
@@ -848,6 +1347,11 @@ void preprocess(FILE *fp, const char *filename) {
 
   if (pf.condstack->len > 0)
     error("#if not closed");
+  if (pf.guard_state == GS_CLOSED) {
+    FileInfo *info = get_file_info(filename);
+    if (info != NULL)
+      info->guard = pf.guard;
+  }
 
   curpf = oldpf;
   set_pp_stream(old_stream);
@@ -856,6 +1360,15 @@ void preprocess(FILE *fp, const char *filename) {
   macro_add(key_line, old_line_macro);
 }
 
+void preprocess(FILE *fp, const char *filename) {
+  // Read whole source, to skip disabled blocks on the buffer.
+  size_t size;
+  char *content = read_to_end(fp, &size);
+  Stream stream = {.filename = filename, .p = content, .end = content + size};
+  preprocess_stream(&stream);
+  free(content);
+}
+
 void define_macro(const char *arg) {
   char *p = strchr(arg, '=');
   Macro *macro = new_macro(NULL, NULL, parse_macro_body(p != NULL ? p + 1 : "1", NULL));
@@ -870,4 +1383,20 @@ void undef_macro(const char *begin, const char *end) {
 void add_inc_path(enum IncludeOrder order, const char *path) {
   assert(order < INC_ORDERS);
   vec_push(&sys_inc_paths[order], strdup(path));
+  table_init(&include_cache);
+}
+
+void reset_preprocessor(void) {
+  pp_ofp = NULL;
+  preserve_comment = emit_tokens = pch_allowed = false;
+  curpf = NULL;
+  for (int i = 0; i < INC_ORDERS; ++i)
+    vec_clear(&sys_inc_paths[i]);
+  table_init(&file_infos);
+  table_init(&path_infos);
+  table_init(&dir_exists_table);
+  table_init(&include_cache);
+  pch_output = toplevel_started = false;
+  pch_signature = "";
+  vec_clear(&pch_deps);
 }
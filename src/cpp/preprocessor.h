@@ -9,8 +9,13 @@ enum IncludeOrder {
   INC_AFTER,
 };
 
+void reset_preprocessor(void);  // Clear the states left by the previous run, include paths too.
 void init_preprocessor(FILE *ofp);
 void set_preserve_comment(bool enable);
+void set_token_output(bool enable);
+void set_pch_output(bool enable);
+void set_pch_signature(const char *signature);
+void write_pch(FILE *ofp, const void *tokens, size_t size);
 void preprocess(FILE *fp, const char *filename);
 
 void define_macro(const char *arg);  // "FOO" or "BAR=QUX"
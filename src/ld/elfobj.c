@@ -54,6 +54,7 @@ static void load_symtab(ElfObj *elfobj) {
     assert(elfobj->symbol_table == NULL);
     Table *symbol_table = alloc_table();
     elfobj->symbol_table = symbol_table;
+    reserve_names(p->symtab.count);
     for (size_t i = 0, count = p->symtab.count; i < count; ++i) {
       Elf64_Sym *sym = &symbols[i];
       unsigned char bind = ELF64_ST_BIND(sym->st_info);
@@ -908,6 +908,7 @@ static Vector *parse_options(int argc, char *argv[], Options *opts) {
     {"l", required_argument},  // Library
     {"L", required_argument},  // Add library path
     {"Map", required_argument, OPT_OUTMAP},  // Output map file
+    {"f", required_argument},  // -ftime-report, -fmem-report
     {"-help", no_argument, OPT_HELP},
     {"v", no_argument, OPT_VERSION},
     {"-version", no_argument, OPT_VERSION},
@@ -963,6 +964,10 @@ static Vector *parse_options(int argc, char *argv[], Options *opts) {
     case OPT_NO_PIE:
       // Silently ignored.
       break;
+    case 'f':
+      if (!parse_report_option(optarg))
+        fprintf(stderr, "Warning: unknown option: %s\n", argv[optind - 1]);
+      break;
     case '?':
       fprintf(stderr, "Warning: unknown option: %s\n", argv[optind - 1]);
       break;
@@ -1127,29 +1132,35 @@ static void collect_section_data(Vector *section_lists[SECTION_COUNT],
 }
 
 static int do_link(Vector *sources, const Options *opts) {
+  report_begin("load");
   LinkEditor *ld = malloc_or_die(sizeof(*ld));
   ld_init(ld, sources->len);
   for (int i = 0; i < sources->len; ++i) {
     char *src = sources->data[i];
     ld_load(ld, i, src);
   }
+  report_end();
 
   const Name *entry_name = alloc_name(opts->entry, NULL, false);
   Table unresolved;
   table_init(&unresolved);
   table_put(&unresolved, entry_name, (void*)entry_name);
 
+  report_begin("resolve");
   Vector *section_lists[SECTION_COUNT];  // <LinkElem*>
   prepare_section_lists(ld, section_lists);
 
-  if (ld_resolve_symbols(ld, &unresolved) > 0)
+  if (ld_resolve_symbols(ld, &unresolved) > 0) {
+    report_discard();
     return 1;
+  }
   if (unresolved.count > 0) {
     fprintf(stderr, "Unresolved: #%d\n", unresolved.count);
     const Name *name;
     for (int it = 0; (it = table_iterate(&unresolved, it, &name, NULL)) != -1;) {
       fprintf(stderr, "  %.*s\n", NAMES(name));
     }
+    report_discard();
     return 1;
   }
 
@@ -1159,12 +1170,19 @@ static int do_link(Vector *sources, const Options *opts) {
   prepare_section_groups(section_lists, section_groups);
 
   ld_calc_address(section_groups, section_lists, LOAD_ADDRESS);
+  report_end();
+
+  report_begin("relocate");
   ld_load_elf_objects(section_lists);
 
   int error_count = ld_resolve_relas(ld);
-  if (error_count > 0)
+  if (error_count > 0) {
+    report_discard();
     return 1;
+  }
+  report_end();
 
+  report_begin("output");
   collect_section_data(section_lists, section_groups);
 
   uint64_t entry_address = ld_symbol_address(ld, entry_name);
@@ -1174,6 +1192,11 @@ static int do_link(Vector *sources, const Options *opts) {
 
   if (opts->outmapfn != NULL && result)
     result = output_map_file(ld, opts->outmapfn, entry_address, entry_name);
+  report_end();
+  if (result)
+    report_output("ld");
+  else
+    report_discard();
   return result ? 0 : 1;
 }
 
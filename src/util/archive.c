@@ -124,6 +124,8 @@ Archive *load_archive(const char *filename) {
     char *strtab = malloc_or_die(strtablen);  // Buffer pointer is not kept.
     read_or_die(fp, strtab, -1, strtablen, "Strtab");
     char *p = strtab;
+    table_reserve(&ar->symbol_table, symbol_count);
+    reserve_names(symbol_count);
     for (uint32_t i = 0; i < symbol_count; ++i) {
       char *q = memchr(p, '\0', &strtab[strtablen] - p);
       if (q == NULL)
@@ -5,15 +5,44 @@
 
 // Hash
 
+static inline uint64_t load_word(const char *p) {
+  uint64_t w;
+  memcpy(&w, p, sizeof(w));
+  return w;
+}
+
+static inline uint64_t load_tail(const char *p, int n) {
+  const unsigned char *u = (const unsigned char*)p;
+  uint64_t w = 0;
+  for (int i = 0; i < n; ++i)
+    w |= (uint64_t)u[i] << (i * 8);
+  return w;
+}
+
+// Word at a time, instead of byte by byte.
 static uint32_t hash_string(const char *key, int length) {
-  const unsigned char *u = (const unsigned char*)key;
-  // FNV1a
-  uint32_t hash = 2166136261u;
-  for (int i = 0; i < length; ++i)
-    hash = (hash ^ u[i]) * 16777619u;
-  return hash;
+  const uint64_t K = 0x517cc1b727220a95ULL;
+  uint64_t hash = length;
+  for (; length >= 8; key += 8, length -= 8)
+    hash = (((hash << 5) | (hash >> 59)) ^ load_word(key)) * K;
+  if (length > 0)
+    hash = (((hash << 5) | (hash >> 59)) ^ load_tail(key, length)) * K;
+  // Mix upper bits into lower ones, because table index is masked.
+  hash ^= hash >> 32;
+  hash *= 0x85ebca6bu;
+  hash ^= hash >> 29;
+  return (uint32_t)hash;
 }
 
+// Table internals
+
+#define MIN_CAPACITY  (16)
+#define MAX_LOAD(capacity)  ((capacity) - (capacity) / 4)  // 75%
+#define MAX_DISTANCE  (255)
+
+#define META_DIST(meta)  ((meta) & 0xff)
+#define META_FP(hash)  ((uint16_t)(((hash) >> 24) << 8))  // Upper bits, independent from index.
+
 // Name
 
 static Table name_table;
@@ -23,98 +52,147 @@ static const Name *find_name_table(const char *chars, int bytes, uint32_t hash)
   if (table->count == 0)
     return NULL;
 
-  for (uint32_t index = hash % table->capacity; ; index = (index + 1) % table->capacity) {
-    TableEntry *entry = &table->entries[index];
-    const Name *key = entry->key;
-    if (key == NULL) {
-      if (entry->value == NULL)
-        return NULL;
-    } else if (key->bytes == bytes &&
-               key->hash == hash &&
-               memcmp(key->chars, chars, bytes) == 0) {
-      return key;
+  uint32_t mask = table->capacity - 1;
+  uint16_t fp = META_FP(hash);
+  for (uint32_t index = hash & mask, dist = 1;; index = (index + 1) & mask, ++dist) {
+    uint16_t meta = table->metas[index];
+    if (META_DIST(meta) < dist)
+      return NULL;
+    if (meta == (fp | dist)) {
+      const Name *key = table->entries[index].key;
+      if (key->hash == hash && key->bytes == bytes && memcmp(key->chars, chars, bytes) == 0)
+        return key;
     }
   }
 }
 
+// Names live until the end, so allocate them from chunks.
+// Copied string is put right after its header.
+static void *alloc_name_memory(size_t size) {
+  enum { CHUNK_SIZE = 64 * 1024 };
+  static char *ptr, *end;
+
+  size = (size + sizeof(void*) - 1) & -sizeof(void*);
+  if (size > (size_t)(end - ptr)) {
+    if (size > CHUNK_SIZE / 4)
+      return malloc(size);  // Large one: Keep current chunk.
+    char *chunk = malloc(CHUNK_SIZE);
+    if (chunk == NULL)
+      return NULL;
+    ptr = chunk;
+    end = chunk + CHUNK_SIZE;
+  }
+  void *p = ptr;
+  ptr += size;
+  return p;
+}
+
 const Name *alloc_name(const char *begin, const char *end, bool make_copy) {
   int bytes = end != NULL ? (int)(end - begin) : (int)strlen(begin);
   uint32_t hash = hash_string(begin, bytes);
   const Name *name = find_name_table(begin, bytes, hash);
   if (name == NULL) {
+    Name *new_name = alloc_name_memory(sizeof(*new_name) + (make_copy ? bytes + 1 : 0));
+    if (new_name == NULL)
+      return NULL;
     if (make_copy) {
-      char *new_str = malloc(bytes);
-      if (new_str == NULL)
-        return NULL;
+      char *new_str = (char*)(new_name + 1);
       memcpy(new_str, begin, bytes);
+      new_str[bytes] = '\0';
       begin = new_str;
     }
-    Name *new_name = malloc(sizeof(*new_name));
-    if (new_name == NULL) {
-      if (make_copy)
-        free((void*)begin);
-    } else {
-      new_name->chars = begin;
-      new_name->bytes = bytes;
-      new_name->hash = hash;
-      table_put(&name_table, new_name, new_name);
-      name = new_name;
-    }
+    new_name->chars = begin;
+    new_name->bytes = bytes;
+    new_name->hash = hash;
+    table_put(&name_table, new_name, new_name);
+    name = new_name;
   }
   return name;
 }
 
+void reserve_names(int count) {
+  table_reserve(&name_table, name_table.count + count);
+}
+
 bool equal_name(const Name *name1, const Name *name2) {
   return name1 == name2;  // All names are interned, so they can compare by pointers.
 }
 
 // Table
 
-static TableEntry *find_entry(TableEntry *entries, int capacity, const Name *key) {
-  TableEntry *tombstone = NULL;
-  for (uint32_t index = key->hash % capacity; ; index = (index + 1) % capacity) {
-    TableEntry *entry = &entries[index];
-    if (entry->key == NULL) {
-      if (entry->value == NULL) {
-        return tombstone != NULL ? tombstone : entry;
-      } else {  // Tombstone.
-        if (tombstone == NULL)
-          tombstone = entry;
-      }
-    } else if (entry->key == key) {
-      return entry;
+// Robin Hood: Entries from the same home slot are contiguous, and probing can stop
+// at an entry closer to its home than the key would be.
+// Only metas are touched until the fingerprint matches.
+static TableEntry *find_entry(const Table *table, const Name *key) {
+  if (table->count == 0)
+    return NULL;
+
+  uint32_t mask = table->capacity - 1;
+  uint32_t hash = key->hash;
+  uint16_t fp = META_FP(hash);
+  for (uint32_t index = hash & mask, dist = 1;; index = (index + 1) & mask, ++dist) {
+    uint16_t meta = table->metas[index];
+    if (META_DIST(meta) < dist)
+      return NULL;
+    if (meta == (fp | dist) && table->entries[index].key == key)
+      return &table->entries[index];
+  }
+}
+
+// Put new entry, swapping with richer ones (closer to their home) on the way.
+// Returns false if the distance exceeds the limit, and `*entry` holds the one left.
+static bool insert_entry(Table *table, TableEntry *entry) {
+  TableEntry cur = *entry;
+  uint32_t mask = table->capacity - 1;
+  uint32_t hash = cur.key->hash;
+  uint16_t fp = META_FP(hash);
+  for (uint32_t index = hash & mask, dist = 1;; index = (index + 1) & mask, ++dist) {
+    if (dist > MAX_DISTANCE) {
+      *entry = cur;
+      return false;
+    }
+    uint16_t meta = table->metas[index];
+    if (meta == 0) {
+      table->metas[index] = fp | dist;
+      table->entries[index] = cur;
+      return true;
+    }
+    if (META_DIST(meta) < dist) {
+      TableEntry tmp = table->entries[index];
+      table->entries[index] = cur;
+      table->metas[index] = fp | dist;
+      cur = tmp;
+      fp = meta & 0xff00;
+      dist = META_DIST(meta);
     }
   }
 }
 
 static void adjust_capacity(Table *table, int new_capacity) {
-  TableEntry *new_entries = malloc(sizeof(TableEntry) * new_capacity);
+  // Entries and metas in one block.
+  TableEntry *new_entries = calloc(new_capacity, sizeof(TableEntry) + sizeof(uint16_t));
   if (new_entries == NULL)
     return;
-  for (int i = 0; i < new_capacity; ++i) {
-    TableEntry *entry = &new_entries[i];
-    entry->key = NULL;
-    entry->value = NULL;
-  }
 
   TableEntry *old_entries = table->entries;
+  uint16_t *old_metas = table->metas;
   int old_capacity = table->capacity;
-  int new_count = 0;
+  table->entries = new_entries;
+  table->metas = (uint16_t*)&new_entries[new_capacity];
+  table->capacity = new_capacity;
   for (int i = 0; i < old_capacity; ++i) {
-    TableEntry *entry = &old_entries[i];
-    if (entry->key == NULL)
-      continue;
-
-    TableEntry *dest = find_entry(new_entries, new_capacity, entry->key);
-    dest->key = entry->key;
-    dest->value = entry->value;
-    ++new_count;
+    TableEntry entry = old_entries[i];
+    if (old_metas[i] != 0 && !insert_entry(table, &entry)) {
+      // Too long probe even after growing: Grow more.
+      table->entries = old_entries;
+      table->metas = old_metas;
+      table->capacity = old_capacity;
+      free(new_entries);
+      adjust_capacity(table, new_capacity * 2);
+      return;
+    }
   }
-
   free(old_entries);
-  table->entries = new_entries;
-  table->capacity = new_capacity;
-  table->count = table->used = new_count;
 }
 
 Table *alloc_table(void) {
@@ -126,26 +204,34 @@ Table *alloc_table(void) {
 
 void table_init(Table *table) {
   table->entries = NULL;
-  table->count = table->used = table->capacity = 0;
+  table->metas = NULL;
+  table->count = table->capacity = 0;
 }
 
-void *table_get(Table *table, const Name *key) {
-  if (table->count == 0)
-    return NULL;
+void table_clear(Table *table) {
+  if (table->capacity > 0) {
+    memset(table->entries, 0, sizeof(*table->entries) * table->capacity);
+    memset(table->metas, 0, sizeof(*table->metas) * table->capacity);
+  }
+  table->count = 0;
+}
 
-  TableEntry *entry = find_entry(table->entries, table->capacity, key);
-  if (entry->key == NULL)
-    return NULL;
+void table_reserve(Table *table, int count) {
+  int capacity = table->capacity > 0 ? table->capacity : MIN_CAPACITY;
+  while (MAX_LOAD(capacity) < count)
+    capacity *= 2;
+  if (capacity > table->capacity)
+    adjust_capacity(table, capacity);
+}
 
-  return entry->value;
+void *table_get(Table *table, const Name *key) {
+  TableEntry *entry = find_entry(table, key);
+  return entry != NULL ? entry->value : NULL;
 }
 
 bool table_try_get(Table *table, const Name *key, void **output) {
-  if (table->count == 0)
-    return false;
-
-  TableEntry *entry = find_entry(table->entries, table->capacity, key);
-  if (entry->key == NULL)
+  TableEntry *entry = find_entry(table, key);
+  if (entry == NULL)
     return false;
 
   if (output != NULL)
@@ -154,40 +240,43 @@ bool table_try_get(Table *table, const Name *key, void **output) {
 }
 
 bool table_put(Table *table, const Name *key, void *value) {
-  const int MIN_CAPACITY = 15;
-  if (table->used >= table->capacity / 2) {
-    int capacity = table->capacity * 2 - 1;  // Keep odd.
-    if (capacity < MIN_CAPACITY)
-      capacity = MIN_CAPACITY;
-    adjust_capacity(table, capacity);
-  }
-
-  TableEntry *entry = find_entry(table->entries, table->capacity, key);
-  bool is_new_key = entry->key == NULL;
-  if (is_new_key) {
-    ++table->count;
-    if (entry->value == NULL)
-      ++table->used;
+  TableEntry *entry = find_entry(table, key);
+  if (entry != NULL) {
+    entry->value = value;
+    return false;
   }
 
-  entry->key = key;
-  entry->value = value;
-  return is_new_key;
+  table_reserve(table, table->count + 1);
+  TableEntry cur = {.key = key, .value = value};
+  while (!insert_entry(table, &cur))
+    adjust_capacity(table, table->capacity * 2);
+  ++table->count;
+  return true;
 }
 
 bool table_delete(Table *table, const Name *key) {
-  if (table->count == 0)
-    return false;
-
-  TableEntry *entry = find_entry(table->entries, table->capacity, key);
-  if (entry->key == NULL)
+  TableEntry *entry = find_entry(table, key);
+  if (entry == NULL)
     return false;
 
+  // Shift following entries back, instead of leaving tombstone.
+  TableEntry *entries = table->entries;
+  uint16_t *metas = table->metas;
+  uint32_t mask = table->capacity - 1;
+  uint32_t index = entry - entries;
+  for (;;) {
+    uint32_t next = (index + 1) & mask;
+    uint16_t meta = metas[next];
+    if (META_DIST(meta) <= 1)  // Empty, or at its home.
+      break;
+    metas[index] = meta - 1;
+    entries[index] = entries[next];
+    index = next;
+  }
+  metas[index] = 0;
+  entries[index].key = NULL;
+  entries[index].value = NULL;
   --table->count;
-  // Put tombstone.
-  entry->key = NULL;
-  entry->value = entry;
-
   return true;
 }
 
@@ -14,27 +14,32 @@ typedef struct Name {
 } Name;
 
 const Name *alloc_name(const char *begin, const char *end, bool make_copy);
+void reserve_names(int count);  // Hint: `count` more names are coming.
 bool equal_name(const Name *name1, const Name *name2);
 
 // For printf, usage: printf("%.*s\n", NAMES(name))
 #define NAMES(name)  ((name)->bytes), ((name)->chars)
 
 // Hash Table
+//   Open addressing with Robin Hood hashing, capacity is power of 2.
+//   Deleting an entry moves following ones, so restart iteration after `table_delete`.
 
 typedef struct TableEntry {
-  const Name *key;
+  const Name *key;  // NULL => empty.
   void *value;
 } TableEntry;
 
 typedef struct Table {
   TableEntry *entries;
+  uint16_t *metas;  // For each entry: (fingerprint << 8) | (distance from home + 1), 0 => empty.
   int capacity;
   int count;
-  int used;  // Include tombstone count.
 } Table;
 
 Table *alloc_table(void);
 void table_init(Table *table);
+void table_clear(Table *table);  // Remove all entries, keeping the capacity.
+void table_reserve(Table *table, int count);  // Make room for `count` entries without rehash.
 void *table_get(Table *table, const Name *key);
 bool table_try_get(Table *table, const Name *key, void **output);
 bool table_put(Table *table, const Name *key, void *value);
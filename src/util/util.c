@@ -2,12 +2,18 @@
 
 #include <assert.h>
 #include <ctype.h>
+#include <fcntl.h>  // open
 #include <limits.h>  // CHAR_BIT
 #include <stdarg.h>
 #include <stdbool.h>
 #include <stdlib.h>  // malloc
 #include <string.h>  // strcmp
+#if !defined(__wasm)
+#include <sys/mman.h>  // mmap
+#endif
 #include <sys/stat.h>
+#include <time.h>  // clock_gettime
+#include <unistd.h>  // write
 
 #include "../version.h"
 #include "table.h"
@@ -78,7 +84,64 @@ void *read_or_die(FILE *fp, void *buf, long offset, size_t size, const char *msg
   return buf;
 }
 
+// Read whole rest of the stream (file or pipe), terminated with '\0'.
+void *read_to_end(FILE *fp, size_t *psize) {
+  DataStorage data;
+  data_init(&data);
+  for (;;) {
+    data_reserve(&data, data.len + 4096);
+    size_t size = fread(data.buf + data.len, 1, data.capacity - data.len, fp);
+    if (size == 0)
+      break;
+    data.len += size;
+  }
+  data_push(&data, '\0');
+  *psize = data.len - 1;
+  return data.buf;
+}
+
+void *map_file(const char *path, size_t *psize) {
+  int fd = open(path, O_RDONLY);
+  if (fd == -1)
+    return NULL;
+  struct stat st;
+  void *p = NULL;
+  if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+    *psize = st.st_size;
+#if !defined(__wasm)
+    // Private mapping: Written pages are copied, and the file is kept intact.
+    p = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    if (p == MAP_FAILED)
+      p = NULL;
+#else
+    p = malloc_or_die(st.st_size);
+    if (read(fd, p, st.st_size) != st.st_size) {
+      free(p);
+      p = NULL;
+    }
+#endif
+  }
+  close(fd);
+  return p;
+}
+
+void unmap_file(void *p, size_t size) {
+#if !defined(__wasm)
+  munmap(p, size);
+#else
+  UNUSED(size);
+  free(p);
+#endif
+}
+
+static struct {
+  unsigned long count;
+  unsigned long bytes;
+} alloc_stats;  // For -fmem-report.
+
 void *malloc_or_die(size_t size) {
+  ++alloc_stats.count;
+  alloc_stats.bytes += size;
   void *p = malloc(size);
   if (p == NULL) {
     fprintf(stderr, "memory overflow\n");
@@ -88,6 +151,8 @@ void *malloc_or_die(size_t size) {
 }
 
 void *calloc_or_die(size_t size) {
+  ++alloc_stats.count;
+  alloc_stats.bytes += size;
   void *p = calloc(1, size);
   if (p == NULL) {
     fprintf(stderr, "memory overflow\n");
@@ -97,6 +162,8 @@ void *calloc_or_die(size_t size) {
 }
 
 void *realloc_or_die(void *ptr, size_t size) {
+  ++alloc_stats.count;
+  alloc_stats.bytes += size;
   void *p = realloc(ptr, size);
   if (p == NULL) {
     fprintf(stderr, "memory overflow\n");
@@ -105,14 +172,26 @@ void *realloc_or_die(void *ptr, size_t size) {
   return p;
 }
 
-const Name *alloc_label(void) {
-  static int label_no;
-  ++label_no;
-  char buf[2 + sizeof(int) * 3 + 1];
-  snprintf(buf, sizeof(buf), "L.%04d", label_no);
+static int label_no, emit_label_no;
+
+static const Name *format_label(const char *fmt, int no) {
+  char buf[3 + sizeof(int) * 3 + 1];
+  snprintf(buf, sizeof(buf), fmt, no);
   return alloc_name(buf, NULL, true);
 }
 
+const Name *alloc_label(void) {
+  return format_label("L.%04d", ++label_no);
+}
+
+const Name *alloc_emit_label(void) {
+  return format_label("L.e%04d", ++emit_label_no);
+}
+
+void reset_labels(void) {
+  label_no = emit_label_no = 0;
+}
+
 ssize_t getline_chomp(char **lineptr, size_t *n, FILE *stream) {
   ssize_t len = getline(lineptr, n, stream);
   if (len > 0) {
@@ -341,11 +420,132 @@ bool is_im32(int64_t x) {
   return x <= (((int64_t)1 << 31) - 1) && x >= -((int64_t)1 << 31);
 }
 
+// Scanning kernels: Test a block of bytes at once, with SSE2 or SWAR (8 bytes in uint64_t).
+// Blocks are read from aligned addresses, so reading over the terminating '\0'
+// never crosses a page boundary.
+// Flagged bytes have all bits set (SSE2), or the most significant bit set (SWAR).
+//
+// So the last block can run past the end of the object, which the hardware allows but
+// AddressSanitizer reports: `scan_load` is excluded from it (and not inlined then),
+// every other access is checked as usual.
+
+#if defined(__GNUC__) && !defined(__XCC)
+#define SCAN_LOAD_ATTR  __attribute__((no_sanitize_address))
+#else
+#define SCAN_LOAD_ATTR
+#endif
+
+#if defined(__SSE2__) && !defined(__XCC)
+#include <emmintrin.h>
+
+#define SCAN_BLOCK_SIZE  (16)
+#define SCAN_ALL  (0xffffU)
+typedef __m128i ScanBlock;
+typedef unsigned int ScanMask;
+
+static SCAN_LOAD_ATTR inline ScanBlock scan_load(const char *p) {
+  return _mm_load_si128((const __m128i*)p);
+}
+static inline ScanBlock scan_or(ScanBlock x, ScanBlock y)  { return _mm_or_si128(x, y); }
+static inline ScanBlock scan_set_bits(ScanBlock x, char c)  { return _mm_or_si128(x, _mm_set1_epi8(c)); }
+static inline ScanBlock scan_eq(ScanBlock x, char c)  { return _mm_cmpeq_epi8(x, _mm_set1_epi8(c)); }
+static inline ScanBlock scan_range(ScanBlock x, char lo, char hi) {  // lo <= x <= hi (ASCII)
+  return _mm_and_si128(_mm_cmpgt_epi8(x, _mm_set1_epi8(lo - 1)),
+                       _mm_cmpgt_epi8(_mm_set1_epi8(hi + 1), x));
+}
+static inline ScanMask scan_mask(ScanBlock x)  { return _mm_movemask_epi8(x); }
+static inline ScanMask scan_discard(ScanMask m, int n)  { return m >> n; }  // Drop first n bytes.
+static inline int scan_first(ScanMask m)  { return __builtin_ctz(m); }
+
+#else
+#define SCAN_BLOCK_SIZE  (8)
+#define SCAN_ONES  (~(uint64_t)0 / 0xff)
+#define SCAN_ALL   (SCAN_ONES * 0x80)
+typedef uint64_t ScanBlock;
+typedef uint64_t ScanMask;
+
+static SCAN_LOAD_ATTR inline ScanBlock scan_load(const char *p) {
+#if defined(__GNUC__) && !defined(__XCC)
+  typedef uint64_t __attribute__((may_alias)) AliasBlock;  // Direct load, not memcpy call.
+  return *(const AliasBlock*)p;
+#else
+  ScanBlock x;
+  memcpy(&x, p, sizeof(x));
+  return x;
+#endif
+}
+static inline ScanBlock scan_or(ScanBlock x, ScanBlock y)  { return x | y; }
+static inline ScanBlock scan_set_bits(ScanBlock x, char c)  { return x | (SCAN_ONES * (unsigned char)c); }
+static inline ScanBlock scan_eq(ScanBlock x, char c) {
+  // Exact for each byte: no carry over bytes, unlike `(x - 0x01..) & ~x & 0x80..`.
+  ScanBlock y = x ^ (SCAN_ONES * (unsigned char)c);
+  return ~(((y & ~SCAN_ALL) + ~SCAN_ALL) | y | ~SCAN_ALL);
+}
+static inline ScanBlock scan_range(ScanBlock x, char lo, char hi) {  // lo <= x <= hi (ASCII)
+  ScanBlock low7 = x & ~SCAN_ALL;
+  return (low7 + SCAN_ONES * (0x80 - lo)) & ~(low7 + SCAN_ONES * (0x7f - hi)) & ~x & SCAN_ALL;
+}
+static inline ScanMask scan_mask(ScanBlock x)  { return x; }
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+static inline ScanMask scan_discard(ScanMask m, int n)  { return m << (n * 8); }
+#else
+static inline ScanMask scan_discard(ScanMask m, int n)  { return m >> (n * 8); }
+#endif
+static inline int scan_first(ScanMask m) {
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+  return __builtin_clzll(m) >> 3;
+#elif defined(__GNUC__) || defined(__XCC)
+  return __builtin_ctzll(m) >> 3;
+#else
+  int i = 0;
+  for (; (m & 0x80) == 0; m >>= 8)
+    ++i;
+  return i;
+#endif
+}
+#endif
+
+// Scan blocks from `s` until `MASK(block)` flags any byte, and return the first one.
+// Bytes before `s` in the first (aligned) block are discarded from the mask.
+#define SCAN_BLOCKS(s, MASK) \
+  { \
+    const char *block = (const char*)((uintptr_t)(s) & -(uintptr_t)SCAN_BLOCK_SIZE); \
+    ScanMask m = scan_discard(MASK(scan_load(block)), (s) - block); \
+    if (m != 0) \
+      return (s) + scan_first(m); \
+    for (;;) { \
+      block += SCAN_BLOCK_SIZE; \
+      m = MASK(scan_load(block)); \
+      if (m != 0) \
+        return block + scan_first(m); \
+    } \
+  }
+
+static inline ScanMask not_space_mask(ScanBlock x) {
+  return scan_mask(scan_or(scan_eq(x, ' '), scan_range(x, '\t', '\r'))) ^ SCAN_ALL;
+}
+
+static inline ScanMask not_ident_mask(ScanBlock x) {
+  ScanBlock alpha = scan_range(scan_set_bits(x, 0x20), 'a', 'z');  // Lower case.
+  return scan_mask(scan_or(scan_or(alpha, scan_range(x, '0', '9')), scan_eq(x, '_'))) ^ SCAN_ALL;
+}
+
 const char *skip_whitespaces(const char *s) {
-  while (isspace(*s))
-    ++s;
-  return s;
+  SCAN_BLOCKS(s, not_space_mask)
+}
+
+// Skip ASCII identifier characters: [0-9A-Za-z_]*
+const char *skip_ident_chars(const char *s) {
+  SCAN_BLOCKS(s, not_ident_mask)
+}
+
+// Find the first c1, c2, c3 or '\0'.
+const char *find_chars(const char *s, char c1, char c2, char c3) {
+#define CHARS_MASK(x) \
+  scan_mask(scan_or(scan_or(scan_eq(x, c1), scan_eq(x, c2)), scan_or(scan_eq(x, c3), scan_eq(x, '\0'))))
+  SCAN_BLOCKS(s, CHARS_MASK)
 }
+#undef CHARS_MASK
 
 const char *block_comment_start(const char *p) {
   const char *q = skip_whitespaces(p);
@@ -354,8 +554,8 @@ const char *block_comment_start(const char *p) {
 
 const char *block_comment_end(const char *p) {
   for (;;) {
-    p = strchr(p, '*');
-    if (p == NULL)
+    p = find_chars(p, '*', '*', '*');
+    if (*p == '\0')
       return NULL;
     if (*(++p) == '/')
       return p + 1;
@@ -595,6 +795,76 @@ void data_close_chunk(DataStorage *data, ssize_t num) {
   data_uleb128(data, pos, num);
 }
 
+// Arena
+
+#define ARENA_ALIGN      (16)
+#define ARENA_MIN_CHUNK  (4 << 10)
+#define ARENA_MAX_CHUNK  (256 << 10)
+#define ARENA_HEADER     ALIGN(sizeof(ArenaChunk), ARENA_ALIGN)
+
+struct ArenaChunk {
+  ArenaChunk *next;
+  size_t size;
+};
+
+static struct {
+  unsigned long count;
+  unsigned long bytes;
+  size_t reserved;  // Chunk bytes held by all arenas.
+  size_t peak;
+} arena_stats;  // For -fmem-report.
+
+static ArenaChunk *arena_new_chunk(Arena *arena, size_t size) {
+  ArenaChunk *chunk = calloc_or_die(size);
+  chunk->size = size;
+  arena->capacity += size;
+  arena_stats.reserved += size;
+  if (arena_stats.reserved > arena_stats.peak)
+    arena_stats.peak = arena_stats.reserved;
+  return chunk;
+}
+
+void *arena_alloc(Arena *arena, size_t size) {
+  ++arena_stats.count;
+  arena_stats.bytes += size;
+  size = ALIGN(MAX(size, (size_t)1), ARENA_ALIGN);  // Distinct address even for zero size.
+  if (size <= (size_t)(arena->end - arena->ptr)) {
+    void *p = arena->ptr;
+    arena->ptr += size;
+    return p;
+  }
+
+  if (size > ARENA_MAX_CHUNK / 4) {
+    // Large block has its own chunk, and the current chunk is kept to be bumped.
+    ArenaChunk *chunk = arena_new_chunk(arena, ARENA_HEADER + size);
+    ArenaChunk **pp = arena->chunks != NULL ? &arena->chunks->next : &arena->chunks;
+    chunk->next = *pp;
+    *pp = chunk;
+    return (char*)chunk + ARENA_HEADER;
+  }
+
+  // Chunk size grows with the arena, not to waste memory for small ones.
+  size_t chunk_size = MIN(MAX(arena->capacity, (size_t)ARENA_MIN_CHUNK), (size_t)ARENA_MAX_CHUNK);
+  ArenaChunk *chunk = arena_new_chunk(arena, chunk_size);
+  chunk->next = arena->chunks;
+  arena->chunks = chunk;
+  char *p = (char*)chunk + ARENA_HEADER;
+  arena->ptr = p + size;
+  arena->end = (char*)chunk + chunk_size;
+  return p;
+}
+
+void arena_release(Arena *arena) {
+  for (ArenaChunk *chunk = arena->chunks, *next; chunk != NULL; chunk = next) {
+    next = chunk->next;
+    arena_stats.reserved -= chunk->size;
+    free(chunk);
+  }
+  arena->chunks = NULL;
+  arena->ptr = arena->end = NULL;
+  arena->capacity = 0;
+}
+
 // StringBuffer
 
 typedef struct {
@@ -761,3 +1031,193 @@ int optparse(int argc, char *const argv[], const struct option *opts) {
   return '?';
 #undef ERROR
 }
+
+// Performance report
+
+#define MAX_REPORT_PHASES  (32)
+#define MAX_REPORT_DEPTH   (8)
+#define MAX_REPORT_STATS  (16)
+
+static struct {
+  bool time, mem;
+  const char *file;
+  struct {
+    const char *name;
+    long usec;
+  } phases[MAX_REPORT_PHASES];
+  int phase_count;
+  struct {
+    const char *name;
+    long value;
+  } stats[MAX_REPORT_STATS];
+  int stat_count;
+  int stack[MAX_REPORT_DEPTH];
+  int depth;
+  long last;  // Timestamp in usec.
+} report;
+
+static long current_usec(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000000L + ts.tv_nsec / 1000;
+}
+
+// Add elapsed time to the innermost phase.
+static void report_lap(void) {
+  long now = current_usec();
+  if (report.depth > 0)
+    report.phases[report.stack[report.depth - 1]].usec += now - report.last;
+  report.last = now;
+}
+
+static long peak_rss_kb(void) {
+  FILE *fp = fopen("/proc/self/status", "r");
+  if (fp == NULL)
+    return -1;
+  long kb = -1;
+  char *line = NULL;
+  size_t capa = 0;
+  while (getline_chomp(&line, &capa, fp) != -1) {
+    if (strncmp(line, "VmHWM:", 6) == 0) {
+      kb = strtol(line + 6, NULL, 10);
+      break;
+    }
+  }
+  free(line);
+  fclose(fp);
+  return kb;
+}
+
+bool parse_report_option(const char *opt) {
+  if (strcmp(opt, "time-report") == 0) {
+    report.time = true;
+  } else if (strcmp(opt, "mem-report") == 0) {
+    report.mem = true;
+  } else if (strncmp(opt, "report-file=", 12) == 0) {
+    report.file = opt + 12;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+void report_begin(const char *phase) {
+  if (!report.time)
+    return;
+  report_lap();
+
+  int i;
+  for (i = 0; i < report.phase_count; ++i) {
+    if (strcmp(report.phases[i].name, phase) == 0)
+      break;
+  }
+  if (i >= report.phase_count) {
+    assert(report.phase_count < MAX_REPORT_PHASES);
+    report.phases[i].name = phase;
+    report.phases[i].usec = 0;
+    ++report.phase_count;
+  }
+  assert(report.depth < MAX_REPORT_DEPTH);
+  report.stack[report.depth++] = i;
+}
+
+void report_end(void) {
+  if (!report.time)
+    return;
+  assert(report.depth > 0);
+  report_lap();
+  --report.depth;
+}
+
+void report_stat(const char *name, long value) {
+  if (!report.time)
+    return;
+
+  int i;
+  for (i = 0; i < report.stat_count; ++i) {
+    if (strcmp(report.stats[i].name, name) == 0)
+      break;
+  }
+  if (i >= report.stat_count) {
+    assert(report.stat_count < MAX_REPORT_STATS);
+    report.stats[i].name = name;
+    report.stats[i].value = 0;
+    ++report.stat_count;
+  }
+  report.stats[i].value += value;
+}
+
+void report_output(const char *tool) {
+  if (report.time || report.mem) {
+    char buf[2048];
+    size_t len = 0;
+    if (report.file != NULL) {
+      len += snprintf(buf + len, sizeof(buf) - len, "{\"tool\":\"%s\"", tool);
+      if (report.time) {
+        len += snprintf(buf + len, sizeof(buf) - len, ",\"time_us\":{");
+        for (int i = 0; i < report.phase_count; ++i)
+          len += snprintf(buf + len, sizeof(buf) - len, "%s\"%s\":%ld", i > 0 ? "," : "",
+                          report.phases[i].name, report.phases[i].usec);
+        len += snprintf(buf + len, sizeof(buf) - len, "}");
+        if (report.stat_count > 0) {
+          len += snprintf(buf + len, sizeof(buf) - len, ",\"stats\":{");
+          for (int i = 0; i < report.stat_count; ++i)
+            len += snprintf(buf + len, sizeof(buf) - len, "%s\"%s\":%ld", i > 0 ? "," : "",
+                            report.stats[i].name, report.stats[i].value);
+          len += snprintf(buf + len, sizeof(buf) - len, "}");
+        }
+      }
+      if (report.mem)
+        len += snprintf(buf + len, sizeof(buf) - len,
+                        ",\"peak_rss_kb\":%ld,\"allocs\":%lu,\"alloc_bytes\":%lu"
+                        ",\"arena_allocs\":%lu,\"arena_bytes\":%lu,\"arena_peak_kb\":%lu",
+                        peak_rss_kb(), alloc_stats.count, alloc_stats.bytes, arena_stats.count,
+                        arena_stats.bytes, (unsigned long)(arena_stats.peak >> 10));
+      len += snprintf(buf + len, sizeof(buf) - len, "}\n");
+      assert(len < sizeof(buf));
+
+      // Single write, for processes sharing the file.
+      int fd = open(report.file, O_WRONLY | O_CREAT | O_APPEND, 0644);
+      if (fd < 0 || write(fd, buf, len) != (ssize_t)len)
+        perror(report.file);
+      if (fd >= 0)
+        close(fd);
+    } else {
+      if (report.time) {
+        long total = 0;
+        for (int i = 0; i < report.phase_count; ++i)
+          total += report.phases[i].usec;
+        fprintf(stderr, "Time report (%s):\n", tool);
+        for (int i = 0; i < report.phase_count; ++i) {
+          long usec = report.phases[i].usec;
+          fprintf(stderr, "  %-12s %6ld.%03ld ms %3ld%%\n", report.phases[i].name, usec / 1000,
+                  usec % 1000, total > 0 ? usec * 100 / total : 0L);
+        }
+        fprintf(stderr, "  %-12s %6ld.%03ld ms\n", "total", total / 1000, total % 1000);
+        if (report.stat_count > 0) {
+          fprintf(stderr, "Statistics (%s):\n", tool);
+          for (int i = 0; i < report.stat_count; ++i)
+            fprintf(stderr, "  %-20s %8ld\n", report.stats[i].name, report.stats[i].value);
+        }
+      }
+      if (report.mem) {
+        fprintf(stderr, "Memory report (%s):\n", tool);
+        fprintf(stderr, "  peak RSS     %ld KB\n", peak_rss_kb());
+        fprintf(stderr, "  allocations  %lu (%lu bytes)\n", alloc_stats.count,
+                alloc_stats.bytes);
+        if (arena_stats.count > 0)
+          fprintf(stderr, "  arena        %lu (%lu bytes), peak %lu KB\n", arena_stats.count,
+                  arena_stats.bytes, (unsigned long)(arena_stats.peak >> 10));
+      }
+    }
+  }
+  report_discard();
+}
+
+void report_discard(void) {
+  // Start over, for next tool running in the same process.
+  report.phase_count = report.depth = report.stat_count = 0;
+  alloc_stats.count = alloc_stats.bytes = 0;
+  arena_stats.count = arena_stats.bytes = 0;
+  arena_stats.peak = arena_stats.reserved;
+}
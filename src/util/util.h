@@ -29,10 +29,16 @@ int xvalue(char c);
 bool starts_with(const char *str, const char *prefix);
 int most_significant_bit(size_t x);
 void *read_or_die(FILE *fp, void *buf, long offset, size_t size, const char *msg);
+void *read_to_end(FILE *fp, size_t *psize);  // Terminated with '\0', not counted in size.
+void *map_file(const char *path, size_t *psize);  // Whole file in memory, NULL if failed or empty.
+void unmap_file(void *p, size_t size);
 void *malloc_or_die(size_t size);
 void *calloc_or_die(size_t size);  // No `count` argument.
 void *realloc_or_die(void *ptr, size_t size);
 const Name *alloc_label(void);
+// While emitting code: Numbered apart, so that labels of following functions are not shifted.
+const Name *alloc_emit_label(void);
+void reset_labels(void);  // Restart label numbering, for next compile unit.
 ssize_t getline_chomp(char **lineptr, size_t *n, FILE *stream);
 ssize_t getline_cont(char **lineptr, size_t *n, FILE *stream, int *plineno);
 bool is_fullpath(const char *filename);
@@ -53,6 +59,8 @@ bool is_im8(int64_t x);
 bool is_im16(int64_t x);
 bool is_im32(int64_t x);
 const char *skip_whitespaces(const char *s);
+const char *skip_ident_chars(const char *s);
+const char *find_chars(const char *s, char c1, char c2, char c3);
 const char *block_comment_start(const char *p);
 const char *block_comment_end(const char *p);
 int64_t wrap_value(int64_t value, int size, bool is_unsigned);
@@ -101,6 +109,20 @@ void data_close_chunk(DataStorage *data, ssize_t num);
 void data_varint32(DataStorage *data, ssize_t pos, int64_t val);
 void data_varuint32(DataStorage *data, ssize_t pos, uint64_t val);
 
+// Arena: Bump allocator, whose memory is released all at once.
+
+typedef struct ArenaChunk ArenaChunk;
+
+typedef struct Arena {
+  ArenaChunk *chunks;
+  char *ptr;
+  char *end;
+  size_t capacity;  // Total size of chunks.
+} Arena;  // Zero-cleared value is an empty arena.
+
+void *arena_alloc(Arena *arena, size_t size);  // Zero-cleared.
+void arena_release(Arena *arena);  // Free all the memory, and the arena becomes empty.
+
 // StringBuffer
 
 typedef struct StringBuffer {
@@ -134,3 +156,12 @@ extern int optind, opterr, optopt;
 extern char *optarg;
 
 int optparse(int argc, char *const argv[], const struct option *opts);
+
+// Performance report (-ftime-report, -fmem-report)
+
+bool parse_report_option(const char *opt);  // `time-report`, `mem-report` or `report-file=<path>`
+void report_begin(const char *phase);  // Time in nested phases is not counted for outer one.
+void report_end(void);
+void report_stat(const char *name, long value);  // Accumulated, and shown with time.
+void report_output(const char *tool);  // To report file in JSON, or stderr.
+void report_discard(void);  // Drop open phases and counts without output, on failure.
@@ -92,11 +92,10 @@ static int resolve_symbols_archive(WasmLinker *linker, Archive *ar) {
       table_delete(unresolved, name);
 
       WasmObj *wasmobj = load_archive_content(ar, symbol, load_wasmobj);
-      if (wasmobj != NULL) {
+      if (wasmobj != NULL)
         resolve_symbols_wasmobj(linker, wasmobj);
-        retry = true;
-        break;
-      }
+      retry = true;  // Deletion moves entries in the table, so iterate again.
+      break;
     }
     if (!retry)
       break;
@@ -176,6 +175,7 @@ static bool resolve_symbols(WasmLinker *linker) {
 
   // Enumerate unresolved: import
   uint32_t unresolved_func_count = 0;
+  Vector *linker_defined = new_vector();  // <const Name*>: Moved to `defined` after iteration.
   const Name *name;
   SymbolInfo *sym;
   for (int it = 0; (it = table_iterate(&linker->unresolved, it, &name, (void**)&sym)) != -1; ) {
@@ -203,8 +203,7 @@ static bool resolve_symbols(WasmLinker *linker) {
     case SIK_SYMTAB_GLOBAL:
       if (equal_name(name, linker->sp_name) || equal_name(name, linker->heapbase_name)) {
         // TODO: Check type, etc.
-        table_delete(&linker->unresolved, name);
-        table_put(&linker->defined, name, (void*)sym);
+        vec_push(linker_defined, (void*)name);
         break;
       }
       // Fallthrough.
@@ -215,8 +214,7 @@ static bool resolve_symbols(WasmLinker *linker) {
 
     case SIK_SYMTAB_TABLE:
       if (equal_name(name, linker->indirect_function_table_name)) {
-        table_delete(&linker->unresolved, name);
-        table_put(&linker->defined, name, (void*)sym);
+        vec_push(linker_defined, (void*)name);
         break;
       }
       fprintf(stderr, "Unresolved: %.*s\n", NAMES(name));
@@ -224,6 +222,14 @@ static bool resolve_symbols(WasmLinker *linker) {
       break;
     }
   }
+  // Deletion moves entries in the table, so it is done after the iteration.
+  for (int i = 0; i < linker_defined->len; ++i) {
+    name = linker_defined->data[i];
+    sym = table_get(&linker->unresolved, name);
+    table_delete(&linker->unresolved, name);
+    table_put(&linker->defined, name, (void*)sym);
+  }
+  free_vector(linker_defined);
   linker->unresolved_func_count = unresolved_func_count;
 
   return err_count == 0;
@@ -137,7 +137,7 @@ static void compilec(FILE *ppin, const char *filename, Vector *toplevel) {
   init_lexer();
 
   // Compile.
-  set_source_file(ppin, filename);
+  set_source_whole_file(ppin, filename);
   parse(toplevel);
   if (compile_error_count != 0)
     exit(1);
@@ -0,0 +1,380 @@
+#include "../config.h"
+#include "cache.h"
+
+#include <fcntl.h>  // open
+#include <stdlib.h>  // qsort
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "../version.h"
+#include "table.h"
+#include "util.h"
+
+// SHA-256
+
+#define ROTR(x, n)  (((x) >> (n)) | ((x) << (32 - (n))))
+
+static const uint32_t kSha256K[64] = {
+  0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+  0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+  0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+  0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+  0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+  0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+  0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+  0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+static void sha256_block(uint32_t state[8], const unsigned char *p) {
+  uint32_t w[64];
+  for (int i = 0; i < 16; ++i, p += 4)
+    w[i] = (uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 8 | p[3];
+  for (int i = 16; i < 64; ++i) {
+    uint32_t s0 = ROTR(w[i - 15], 7) ^ ROTR(w[i - 15], 18) ^ (w[i - 15] >> 3);
+    uint32_t s1 = ROTR(w[i - 2], 17) ^ ROTR(w[i - 2], 19) ^ (w[i - 2] >> 10);
+    w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+  }
+
+  uint32_t v[8];
+  memcpy(v, state, sizeof(v));
+  for (int i = 0; i < 64; ++i) {
+    uint32_t a = v[0], e = v[4];
+    uint32_t s1 = ROTR(e, 6) ^ ROTR(e, 11) ^ ROTR(e, 25);
+    uint32_t ch = (e & v[5]) ^ (~e & v[6]);
+    uint32_t t1 = v[7] + s1 + ch + kSha256K[i] + w[i];
+    uint32_t s0 = ROTR(a, 2) ^ ROTR(a, 13) ^ ROTR(a, 22);
+    uint32_t maj = (a & v[1]) ^ (a & v[2]) ^ (v[1] & v[2]);
+    memmove(&v[1], &v[0], sizeof(*v) * 7);
+    v[4] += t1;
+    v[0] = t1 + s0 + maj;
+  }
+  for (int i = 0; i < 8; ++i)
+    state[i] += v[i];
+}
+
+void sha256_init(Sha256 *ctx) {
+  static const uint32_t kInitial[8] = {
+    0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19,
+  };
+  memcpy(ctx->state, kInitial, sizeof(kInitial));
+  ctx->length = 0;
+}
+
+void sha256_update(Sha256 *ctx, const void *data, size_t size) {
+  const unsigned char *p = data;
+  size_t used = ctx->length & 63;
+  ctx->length += size;
+  if (used > 0) {
+    size_t n = MIN(64 - used, size);
+    memcpy(ctx->buf + used, p, n);
+    p += n;
+    size -= n;
+    if (used + n < 64)
+      return;
+    sha256_block(ctx->state, ctx->buf);
+  }
+  for (; size >= 64; p += 64, size -= 64)
+    sha256_block(ctx->state, p);
+  memcpy(ctx->buf, p, size);
+}
+
+void sha256_final(Sha256 *ctx, unsigned char digest[32]) {
+  static const unsigned char kPadding[64] = {0x80};
+  uint64_t bits = ctx->length * 8;
+  size_t used = ctx->length & 63;
+  sha256_update(ctx, kPadding, used < 56 ? 56 - used : 120 - used);
+  unsigned char len[8];
+  for (int i = 0; i < 8; ++i)
+    len[i] = bits >> (56 - i * 8);
+  sha256_update(ctx, len, sizeof(len));
+
+  for (int i = 0; i < 8; ++i) {
+    for (int j = 0; j < 4; ++j)
+      digest[i * 4 + j] = ctx->state[i] >> (24 - j * 8);
+  }
+}
+
+// Cache directory
+//
+// Each entry is stored in `DIR/xx/KEY.EXT` (xx: first two digits of the key).
+// `DIR/index` is an append-only log, one line per use:
+//   `M name size`: Miss, and the result is stored.
+//   `H name size`: Hit.
+//   `E name size`: Entry carried over by compaction.
+//   `T hits misses`: Statistics carried over by compaction.
+// Line order gives recency, so eviction does not need access times.
+
+static struct {
+  const char *dir;
+  const char *index_path;
+  size_t max_size;
+  unsigned char salt[32];  // Toolchain identity.
+  off_t index_size;  // At open, to detect any use.
+} cache;
+
+typedef struct {
+  const Name *name;
+  size_t size;
+  int seq;  // Last use.
+} CacheEntry;
+
+typedef struct {
+  Vector *entries;  // Least recently used first.
+  size_t total_size;
+  int lines;
+  long hits, misses;
+} CacheIndex;
+
+static void *read_whole(const char *path, size_t *psize) {
+  FILE *fp = fopen(path, "rb");
+  if (fp == NULL)
+    return NULL;
+
+  void *data = NULL;
+  struct stat st;
+  if (fstat(fileno(fp), &st) == 0) {
+    size_t size = st.st_size;
+    data = malloc_or_die(size > 0 ? size : 1);
+    if (fread(data, 1, size, fp) == size) {
+      *psize = size;
+    } else {
+      free(data);
+      data = NULL;
+    }
+  }
+  fclose(fp);
+  return data;
+}
+
+static char *entry_name(const char *key, const char *ext) {
+  size_t size = 3 + strlen(key) + 1 + strlen(ext) + 1;
+  char *name = malloc_or_die(size);
+  snprintf(name, size, "%.2s/%s.%s", key, key, ext);
+  return name;
+}
+
+static bool append_index(char kind, const char *name, size_t size) {
+  char line[128];
+  int len = snprintf(line, sizeof(line), "%c %s %lu\n", kind, name, (unsigned long)size);
+  int fd = open(cache.index_path, O_WRONLY | O_CREAT | O_APPEND, 0644);
+  if (fd < 0)
+    return false;
+  // Single write, to keep lines intact among concurrent compilers.
+  bool ok = write(fd, line, len) == len;
+  close(fd);
+  return ok;
+}
+
+static int compare_entry(const void *pa, const void *pb) {
+  const CacheEntry *a = *(const CacheEntry**)pa;
+  const CacheEntry *b = *(const CacheEntry**)pb;
+  return a->seq - b->seq;
+}
+
+static void read_index(CacheIndex *index) {
+  index->entries = new_vector();
+  index->total_size = 0;
+  index->lines = 0;
+  index->hits = index->misses = 0;
+
+  FILE *fp = fopen(cache.index_path, "r");
+  if (fp == NULL)
+    return;
+
+  Table table;
+  table_init(&table);
+  char *line = NULL;
+  size_t capa = 0;
+  for (; getline_chomp(&line, &capa, fp) != -1; ++index->lines) {
+    if (line[0] == '\0' || line[1] != ' ')
+      continue;
+    char *p = &line[2];
+    if (line[0] == 'T') {
+      index->hits += strtol(p, &p, 10);
+      index->misses += strtol(p, &p, 10);
+      continue;
+    }
+
+    char *q = strchr(p, ' ');
+    if (q == NULL)
+      continue;
+    index->hits += line[0] == 'H';
+    index->misses += line[0] == 'M';
+
+    const Name *name = alloc_name(p, q, true);
+    CacheEntry *entry = table_get(&table, name);
+    if (entry == NULL) {
+      entry = malloc_or_die(sizeof(*entry));
+      entry->name = name;
+      table_put(&table, name, entry);
+      vec_push(index->entries, entry);
+    }
+    entry->size = strtoul(q + 1, NULL, 10);
+    entry->seq = index->lines;
+  }
+  free(line);
+  fclose(fp);
+
+  qsort(index->entries->data, index->entries->len, sizeof(*index->entries->data), compare_entry);
+  for (int i = 0; i < index->entries->len; ++i) {
+    CacheEntry *entry = index->entries->data[i];
+    index->total_size += entry->size;
+  }
+}
+
+bool cache_open(const char *dir, size_t max_size, const char *exe) {
+  struct stat st;
+  if (mkdir(dir, 0755) != 0 && (stat(dir, &st) != 0 || !S_ISDIR(st.st_mode)))
+    return false;
+
+  cache.dir = dir;
+  cache.index_path = JOIN_PATHS(dir, "index");
+  cache.max_size = max_size;
+  cache.index_size = stat(cache.index_path, &st) == 0 ? st.st_size : 0;
+
+  Sha256 ctx;
+  sha256_init(&ctx);
+  char buf[64];
+  int len = snprintf(buf, sizeof(buf), "xcc %s %d", VERSION, XCC_TARGET_ARCH);
+  sha256_update(&ctx, buf, len + 1);
+  // Development builds share the version, so distinguish them by the executable.
+  if (exe != NULL && stat(exe, &st) == 0) {
+    int64_t stamp[2] = {st.st_size, st.st_mtime};
+    sha256_update(&ctx, stamp, sizeof(stamp));
+  }
+  sha256_final(&ctx, cache.salt);
+  return true;
+}
+
+bool cache_enabled(void) {
+  return cache.dir != NULL;
+}
+
+void cache_hash_init(Sha256 *ctx) {
+  sha256_init(ctx);
+  sha256_update(ctx, cache.salt, sizeof(cache.salt));
+}
+
+void cache_hash_final(Sha256 *ctx, char key[CACHE_KEY_SIZE]) {
+  static const char kHexDigits[] = "0123456789abcdef";
+  unsigned char digest[32];
+  sha256_final(ctx, digest);
+  for (int i = 0; i < 32; ++i) {
+    key[i * 2] = kHexDigits[digest[i] >> 4];
+    key[i * 2 + 1] = kHexDigits[digest[i] & 15];
+  }
+  key[64] = '\0';
+}
+
+bool cache_fetch(const char *key, const char *ext, FILE *ofp) {
+  char *name = entry_name(key, ext);
+  char *path = JOIN_PATHS(cache.dir, name);
+  size_t size;
+  void *data = read_whole(path, &size);
+  bool ok = data != NULL && fwrite(data, 1, size, ofp) == size;
+  if (ok)
+    append_index('H', name, size);
+  free(data);
+  free(path);
+  free(name);
+  return ok;
+}
+
+void cache_store(const char *key, const char *ext, const void *data, size_t size) {
+  char *name = entry_name(key, ext);
+  char prefix[3] = {key[0], key[1], '\0'};
+  char *subdir = JOIN_PATHS(cache.dir, prefix);
+  mkdir(subdir, 0755);
+
+  // Write to a temporary file and rename it, so that others never see a partial entry.
+  char *path = JOIN_PATHS(subdir, name + 3);
+  size_t len = strlen(path) + 8;
+  char *tmp = malloc_or_die(len);
+  snprintf(tmp, len, "%s.XXXXXX", path);
+  int fd = mkstemps(tmp, 0);
+  if (fd >= 0) {
+    bool ok = write(fd, data, size) == (ssize_t)size;
+    close(fd);
+    if (ok && rename(tmp, path) == 0)
+      append_index('M', name, size);
+    else
+      remove(tmp);
+  }
+  free(tmp);
+  free(path);
+  free(subdir);
+  free(name);
+}
+
+void cache_store_file(const char *key, const char *ext, const char *path) {
+  size_t size;
+  void *data = read_whole(path, &size);
+  if (data != NULL) {
+    cache_store(key, ext, data, size);
+    free(data);
+  }
+}
+
+void cache_trim(void) {
+  struct stat st;
+  if (cache.dir == NULL || stat(cache.index_path, &st) != 0 || st.st_size == cache.index_size)
+    return;
+
+  CacheIndex index;
+  read_index(&index);
+  int evict = 0;
+  if (index.total_size > cache.max_size) {
+    // Make some room, not to evict on every compile.
+    size_t limit = cache.max_size / 10 * 9;
+    for (; evict < index.entries->len && index.total_size > limit; ++evict) {
+      CacheEntry *entry = index.entries->data[evict];
+      char *name = strndup(entry->name->chars, entry->name->bytes);
+      char *path = JOIN_PATHS(cache.dir, name);
+      remove(path);
+      free(path);
+      free(name);
+      index.total_size -= entry->size;
+    }
+  }
+
+  // Compact the log when entries are evicted or it has grown large.
+  int live = index.entries->len - evict;
+  if (evict == 0 && index.lines <= live * 2 + 1)
+    return;
+
+  // Lines appended by others during compaction are lost: their entries remain
+  // untracked, until the same results are stored again.
+  char *tmp = JOIN_PATHS(cache.dir, "index.XXXXXX");
+  int fd = mkstemps(tmp, 0);
+  FILE *fp = fd >= 0 ? fdopen(fd, "w") : NULL;
+  if (fp != NULL) {
+    fprintf(fp, "T %ld %ld\n", index.hits, index.misses);
+    for (int i = evict; i < index.entries->len; ++i) {
+      CacheEntry *entry = index.entries->data[i];
+      fprintf(fp, "E %.*s %lu\n", NAMES(entry->name), (unsigned long)entry->size);
+    }
+    if (fclose(fp) != 0 || rename(tmp, cache.index_path) != 0)
+      remove(tmp);
+  } else if (fd >= 0) {
+    close(fd);
+    remove(tmp);
+  }
+  free(tmp);
+}
+
+void cache_show_stats(FILE *fp) {
+  CacheIndex index;
+  read_index(&index);
+  long total = index.hits + index.misses;
+  fprintf(fp,
+          "cache directory: %s\n"
+          "entries:         %d\n"
+          "size:            %lu KB (max %lu KB)\n"
+          "hits:            %ld\n"
+          "misses:          %ld\n"
+          "hit rate:        %ld%%\n",
+          cache.dir, index.entries->len,
+          (unsigned long)(index.total_size >> 10), (unsigned long)(cache.max_size >> 10),
+          index.hits, index.misses, total > 0 ? index.hits * 100 / total : 0L);
+}
@@ -0,0 +1,38 @@
+// Compile cache
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>  // size_t
+#include <stdint.h>  // uint32_t, uint64_t
+#include <stdio.h>  // FILE
+
+// SHA-256
+
+typedef struct {
+  uint32_t state[8];
+  uint64_t length;  // Total bytes.
+  unsigned char buf[64];
+} Sha256;
+
+void sha256_init(Sha256 *ctx);
+void sha256_update(Sha256 *ctx, const void *data, size_t size);
+void sha256_final(Sha256 *ctx, unsigned char digest[32]);
+
+// Cache directory
+//
+// Compiled results (.s or .o) are stored as files keyed on a hash of the
+// preprocessed source, the compile options and the toolchain itself.
+
+#define CACHE_KEY_SIZE  (64 + 1)  // Hex digits of SHA-256, and '\0'.
+#define DEFAULT_CACHE_SIZE  ((size_t)1 << 30)
+
+bool cache_open(const char *dir, size_t max_size, const char *exe);
+bool cache_enabled(void);
+void cache_hash_init(Sha256 *ctx);  // Seeded with toolchain identity.
+void cache_hash_final(Sha256 *ctx, char key[CACHE_KEY_SIZE]);
+bool cache_fetch(const char *key, const char *ext, FILE *ofp);
+void cache_store(const char *key, const char *ext, const void *data, size_t size);
+void cache_store_file(const char *key, const char *ext, const char *path);
+void cache_trim(void);  // Evict least recently used entries to fit in the size limit.
+void cache_show_stats(FILE *fp);
@@ -1,8 +1,10 @@
 #include "../config.h"
 
 #include <assert.h>
+#include <ctype.h>  // isdigit
 #include <fcntl.h>  // open
 #include <libgen.h>  // dirname
+#include <poll.h>
 #include <signal.h>
 #include <stdbool.h>
 #include <stdio.h>
@@ -12,8 +14,10 @@
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <sys/wait.h>
+#include <time.h>  // clock_gettime
 #include <unistd.h>
 
+#include "cache.h"
 #include "util.h"
 
   // Hack: AT_REMOVEDIR defined in riscv-gnu-toolchain differs on MacOS and Linux?
@@ -153,8 +157,17 @@ static void usage(FILE *fp) {
       "  -c                  Output object file\n"
       "  -S                  Output assembly code\n"
       "  -E                  Output preprocess result\n"
+      "  -x c-header         Output precompiled header: <header>.pch\n"
       "  -l <name>           Add library\n"
       "  -L <path>           Add library path\n"
+      "  -j[N]               Compile sources in parallel (Default: CPU count or make jobserver)\n"
+      "  -no-integrated      Run cpp, cc1 and as as separate processes\n"
+      "  --cache-dir=<dir>   Reuse compile results cached in the directory\n"
+      "  --cache-size=<size> Limit cache size, with K/M/G suffix (Default: 1G)\n"
+      "  --cache-stats       Show cache statistics\n"
+      "  -ftime-report       Show time spent in each phase of cpp, cc1, as and ld\n"
+      "  -fmem-report        Show peak memory usage and allocation counts\n"
+      "  -freport-file=<fn>  Output the reports above in JSON\n"
   );
 }
 
@@ -165,25 +178,8 @@ enum OutType {
   OutExecutable,
 };
 
-static int compile_csource(const char *source_fn, enum OutType out_type, const char *ofn, int ofd,
-                           Vector *cpp_cmd, Vector *cc1_cmd, Vector *as_cmd, Vector *ld_cmd) {
-  const char *objfn = NULL;
-  int obj_fd = -1;
-  if (out_type > OutAssembly) {
-    if (ofn != NULL && out_type < OutExecutable) {
-      objfn = ofn;
-    } else {
-      char template[] = "/tmp/xcc-XXXXXX.o";
-      obj_fd = mkstemps(template, 2);
-      if (obj_fd == -1) {
-        perror("Failed to open output file");
-        exit(1);
-      }
-      objfn = strdup(template);
-      vec_push(&remove_on_exit, objfn);
-    }
-  }
-
+static int compile_csource(const char *source_fn, enum OutType out_type, const char *objfn, int ofd,
+                           Vector *cpp_cmd, Vector *cc1_cmd, Vector *as_cmd) {
   int as_fd[2];
   pid_t as_pid = -1;
 
@@ -197,12 +193,9 @@ static int compile_csource(const char *source_fn, enum OutType out_type, const c
 
   int res = compile(source_fn, cpp_cmd, out_type == OutPreprocess ? NULL : cc1_cmd, ofd);
 
-  if (out_type >= OutExecutable)
-    vec_push(ld_cmd, objfn);
-
   if (res != 0 && as_pid != -1) {
     kill(as_pid, SIGKILL);
-    remove(ofn);
+    remove(objfn);
   }
   if (as_pid != -1) {
     close(as_fd[0]);
@@ -210,26 +203,145 @@ static int compile_csource(const char *source_fn, enum OutType out_type, const c
     as_pid = -1;
     res |= wait_process(as_pid);
   }
-  if (obj_fd != -1) {
-    close(obj_fd);
-  }
   return res;
 }
 
-static int compile_asm(const char *source_fn, enum OutType out_type, const char *ofn, int ofd,
-                       Vector *as_cmd, Vector *ld_cmd) {
-  const char *objfn = NULL;
-  if (out_type > OutAssembly) {
-    if (ofn != NULL && out_type < OutExecutable) {
-      objfn = ofn;
-    } else {
-      size_t len = strlen(source_fn);
-      char *p = malloc_or_die(len + 3);
-      memcpy(p, source_fn, len);
-      strcpy(p + len, ".o");
-      objfn = p;
+#if !defined(USE_SYS_AS)
+// Integrated compile: Run cpp, cc1 and as in this process,
+// and pass intermediate results through memory buffers.
+
+extern int cpp_main(int argc, char *argv[], FILE *ofp);
+extern int cc1_main(int argc, char *argv[], FILE *ifp, FILE *ofp);
+extern int as_main(int argc, char *argv[], FILE *ifp);
+
+static int command_argc(Vector *command) {
+  int argc = 0;
+  while (command->data[argc] != NULL)
+    ++argc;
+  return argc;
+}
+
+static FILE *open_membuf(char *buf, size_t size) {
+  // fmemopen might reject empty buffer.
+  FILE *fp = size > 0 ? fmemopen(buf, size, "r") : fopen("/dev/null", "r");
+  if (fp == NULL)
+    error("cannot open memory buffer");
+  return fp;
+}
+
+static bool is_report_option(const char *arg) {
+  return strcmp(arg, "-ftime-report") == 0 || strcmp(arg, "-fmem-report") == 0 ||
+         strncmp(arg, "-freport-file=", 14) == 0;
+}
+
+// Cache key: Preprocessed source and options for cc1 and as,
+// except executable paths, input/output filenames and report options.
+static void make_cache_key(char key[CACHE_KEY_SIZE], const char *ppbuf, size_t ppsize,
+                           Vector *cc1_cmd, Vector *as_cmd) {
+  Sha256 ctx;
+  cache_hash_init(&ctx);
+  int cc1_argc = cc1_cmd->len - 2;  // [cc1, ..., "-", NULL]
+  int as_argc = as_cmd->len - 4;  // [as, ..., "-o", ofn, src, NULL]
+  Vector *cmds[] = {cc1_cmd, as_cmd};
+  int argcs[] = {cc1_argc, as_argc};
+  for (int i = 0; i < 2; ++i) {
+    for (int j = 1; j < argcs[i]; ++j) {
+      const char *arg = cmds[i]->data[j];
+      if (!is_report_option(arg))
+        sha256_update(&ctx, arg, strlen(arg) + 1);
     }
+    sha256_update(&ctx, "\n", 1);  // Separator.
+  }
+  sha256_update(&ctx, ppbuf, ppsize);
+  cache_hash_final(&ctx, key);
+}
+
+static bool fetch_cached(const char *key, enum OutType out_type, const char *objfn, FILE *ofp) {
+  if (out_type == OutAssembly)
+    return cache_fetch(key, "s", ofp);
+
+  FILE *fp = fopen(objfn, "wb");
+  if (fp == NULL)
+    return false;
+  bool ok = cache_fetch(key, "o", fp);
+  return fclose(fp) == 0 && ok;
+}
+
+static int compile_integrated(const char *source_fn, enum OutType out_type, const char *objfn,
+                              int ofd, Vector *cpp_cmd, Vector *cc1_cmd, Vector *as_cmd) {
+  FILE *ofp = stdout;
+  if (out_type <= OutAssembly && ofd != STDOUT_FILENO) {
+    int fd = dup(ofd);
+    if (fd == -1 || (ofp = fdopen(fd, "w")) == NULL)
+      error("cannot open output");
+  }
+
+  // When src is NULL, no input file is given and cpp read from stdin.
+  cpp_cmd->data[cpp_cmd->len - 2] = strcmp(source_fn, "-") == 0 ? NULL : (void*)source_fn;
+  char *ppbuf = NULL;
+  size_t ppsize = 0;
+  FILE *ppfp = out_type == OutPreprocess ? ofp : open_memstream(&ppbuf, &ppsize);
+  optind = 0;
+  int res = cpp_main(command_argc(cpp_cmd), (char**)cpp_cmd->data, ppfp);
+  if (out_type == OutPreprocess) {
+    if (ofp != stdout)
+      fclose(ofp);
+    fflush(stdout);
+    return res;
+  }
+  fclose(ppfp);
+
+  char key[CACHE_KEY_SIZE];
+  bool use_cache = res == 0 && cache_enabled();
+  bool hit = false;
+  if (use_cache) {
+    make_cache_key(key, ppbuf, ppsize, cc1_cmd, as_cmd);
+    hit = fetch_cached(key, out_type, objfn, ofp);
+  }
 
+  char *asmbuf = NULL;
+  size_t asmsize = 0;
+  if (res == 0 && !hit) {
+    FILE *ifp = open_membuf(ppbuf, ppsize);
+    FILE *asmfp = out_type == OutAssembly && !use_cache ? ofp : open_memstream(&asmbuf, &asmsize);
+    optind = 0;
+    res = cc1_main(command_argc(cc1_cmd), (char**)cc1_cmd->data, ifp, asmfp);
+    fclose(ifp);
+    if (asmfp != ofp)
+      fclose(asmfp);
+    if (res == 0 && out_type == OutAssembly && use_cache) {
+      fwrite(asmbuf, 1, asmsize, ofp);
+      cache_store(key, "s", asmbuf, asmsize);
+    }
+  }
+  free(ppbuf);
+  if (out_type == OutAssembly) {
+    free(asmbuf);
+    if (ofp != stdout)
+      fclose(ofp);
+    fflush(stdout);
+    return res;
+  }
+
+  if (res == 0 && !hit) {
+    assert(as_cmd->len >= 3);
+    as_cmd->data[as_cmd->len - 3] = (void*)objfn;  // Overwrite output filename.
+    as_cmd->data[as_cmd->len - 2] = "-";  // Overwrite source filename.
+    FILE *ifp = open_membuf(asmbuf, asmsize);
+    optind = 0;
+    res = as_main(command_argc(as_cmd), (char**)as_cmd->data, ifp);
+    fclose(ifp);
+    if (res == 0 && use_cache)
+      cache_store_file(key, "o", objfn);
+  }
+  free(asmbuf);
+  return res;
+}
+#endif
+
+static int compile_asm(const char *source_fn, enum OutType out_type, const char *objfn, int ofd,
+                       Vector *as_cmd) {
+  if (out_type > OutAssembly) {
     assert(as_cmd->len >= 3);
     as_cmd->data[as_cmd->len - 3] = (void*)objfn;  // Overwrite output filename.
     as_cmd->data[as_cmd->len - 2] = (void*)source_fn;  // Overwrite source filename.
@@ -238,9 +350,6 @@ static int compile_asm(const char *source_fn, enum OutType out_type, const char
   int status = 0;
   pid_t as_pid = exec_with_ofd((char**)as_cmd->data, ofd);
   waitpid(as_pid, &status, 0);
-
-  if (out_type >= OutExecutable)
-    vec_push(ld_cmd, objfn);
   return status;
 }
 
@@ -283,6 +392,15 @@ typedef struct {
   const char *ofn;
   enum OutType out_type;
   enum SourceType src_type;
+  bool make_pch;  // -x c-header
+  int jobs;  // 0=sequential, -1=auto
+  bool integrated;  // Run cpp, cc1 and as in process.
+  const char *cache_dir;
+  size_t cache_size;
+  bool cache_stats;
+  bool time_report, mem_report;
+  const char *report_file;  // Output summary in JSON.
+  const char *report_tmp;  // Tools append their reports.
   bool nodefaultlibs, nostdlib, nostdinc;
   bool use_ld;
 } Options;
@@ -307,6 +425,11 @@ static void parse_options(int argc, char *argv[], Options *opts) {
     OPT_NO_PIE,
 
     OPT_SSA,
+    OPT_INTEGRATED,
+    OPT_NO_INTEGRATED,
+    OPT_CACHE_DIR,
+    OPT_CACHE_SIZE,
+    OPT_CACHE_STATS,
   };
 
   static const struct option kOptions[] = {
@@ -320,6 +443,7 @@ static void parse_options(int argc, char *argv[], Options *opts) {
     {"U", required_argument},  // Undefine macro
     {"C", no_argument},  // Do not discard comments
     {"o", required_argument},  // Specify output filename
+    {"j", optional_argument},  // Parallel jobs
     {"x", required_argument},  // Specify code type
     {"O", optional_argument},  // Optimization level
     {"l", required_argument},  // Library
@@ -348,6 +472,11 @@ static void parse_options(int argc, char *argv[], Options *opts) {
 
     // Feature flag.
     {"-apply-ssa", no_argument, OPT_SSA},
+    {"integrated", no_argument, OPT_INTEGRATED},
+    {"no-integrated", no_argument, OPT_NO_INTEGRATED},
+    {"-cache-dir", required_argument, OPT_CACHE_DIR},
+    {"-cache-size", required_argument, OPT_CACHE_SIZE},
+    {"-cache-stats", no_argument, OPT_CACHE_STATS},
 
     {NULL},
   };
@@ -401,6 +530,19 @@ static void parse_options(int argc, char *argv[], Options *opts) {
       vec_push(opts->linker_options, "-o");
       vec_push(opts->linker_options, opts->ofn);
       break;
+    case 'j':
+      if (optarg == NULL && optind < argc && isdigit(*argv[optind]))
+        optarg = argv[optind++];
+      if (optarg == NULL) {
+        opts->jobs = -1;
+      } else {
+        char *q;
+        long n = strtol(optarg, &q, 10);
+        if (*q != '\0' || n <= 0)
+          error("invalid number of jobs: %s", optarg);
+        opts->jobs = n;
+      }
+      break;
     case 'c':
       opts->out_type = OutObject;
       break;
@@ -415,6 +557,10 @@ static void parse_options(int argc, char *argv[], Options *opts) {
     case 'x':
       if (strcmp(optarg, "c") == 0) {
         opts->src_type = Clanguage;
+      } else if (strcmp(optarg, "c-header") == 0) {
+        opts->src_type = Clanguage;
+        opts->out_type = OutPreprocess;
+        opts->make_pch = true;
       } else if (strcmp(optarg, "assembler") == 0) {
         opts->src_type = Assembly;
       } else {
@@ -493,6 +639,12 @@ static void parse_options(int argc, char *argv[], Options *opts) {
           fprintf(stderr, "extra argument required for '-fuse-ld");
         }
         opts->use_ld = true;
+      } else if (strcmp(optarg, "time-report") == 0) {
+        opts->time_report = true;
+      } else if (strcmp(optarg, "mem-report") == 0) {
+        opts->mem_report = true;
+      } else if (strncmp(optarg, "report-file=", 12) == 0) {
+        opts->report_file = optarg + 12;
       } else {
         const char *opt = argv[optind - 1];
         vec_push(opts->cc1_cmd, opt);
@@ -530,14 +682,76 @@ static void parse_options(int argc, char *argv[], Options *opts) {
     case OPT_SSA:
       vec_push(opts->cc1_cmd, argv[optind - 1]);
       break;
+
+    case OPT_INTEGRATED:
+    case OPT_NO_INTEGRATED:
+#if !defined(USE_SYS_AS)
+      opts->integrated = opt == OPT_INTEGRATED;
+#endif
+      break;
+
+    case OPT_CACHE_DIR:
+      opts->cache_dir = optarg;
+      break;
+    case OPT_CACHE_SIZE:
+      {
+        char *q;
+        unsigned long size = strtoul(optarg, &q, 10);
+        switch (*q) {
+        case 'G': case 'g':  size <<= 10;  // Fallthrough
+        case 'M': case 'm':  size <<= 10;  // Fallthrough
+        case 'K': case 'k':  size <<= 10; ++q; break;
+        default: break;
+        }
+        if (*q != '\0' || size == 0)
+          error("invalid cache size: %s", optarg);
+        opts->cache_size = size;
+      }
+      break;
+    case OPT_CACHE_STATS:
+      opts->cache_stats = true;
+      break;
     }
   }
 }
 
-static int do_compile(Options *opts, const char *root) {
-  UNUSED(root);
-  int ofd = STDOUT_FILENO;
-  int res = 0;
+typedef struct {
+  const char *src;
+  const char *outfn;  // Output filename for -E and -S.
+  const char *objfn;  // Object filename.
+  enum SourceType st;
+} CompileJob;
+
+static const char *object_filename(const char *src, enum SourceType st, enum OutType out_type,
+                                   const char *outfn) {
+  if (out_type <= OutAssembly)
+    return NULL;
+  if (outfn != NULL && out_type < OutExecutable)
+    return outfn;
+
+  if (st == Assembly) {
+    size_t len = strlen(src);
+    char *p = malloc_or_die(len + 3);
+    memcpy(p, src, len);
+    strcpy(p + len, ".o");
+    return p;
+  }
+
+  char template[] = "/tmp/xcc-XXXXXX.o";
+  int obj_fd = mkstemps(template, 2);
+  if (obj_fd == -1) {
+    perror("Failed to open output file");
+    exit(1);
+  }
+  close(obj_fd);
+  const char *objfn = strdup(template);
+  vec_push(&remove_on_exit, objfn);
+  return objfn;
+}
+
+// Enumerate compile jobs, and put objects and libraries into ld command in command line order.
+static Vector *collect_jobs(Options *opts) {
+  Vector *jobs = new_vector();
   for (int i = 0; i < opts->sources->len; ++i) {
     char *src = opts->sources->data[i];
     const char *outfn = opts->ofn;
@@ -556,15 +770,13 @@ static int do_compile(Options *opts, const char *root) {
           outfn = change_ext(basename(src), "o");
         else if (opts->out_type == OutAssembly)
           outfn = change_ext(basename(src), "s");
-      }
-    }
-
-    if (opts->out_type <= OutAssembly && outfn != NULL && strcmp(outfn, "-") != 0) {
-      close(STDOUT_FILENO);
-      ofd = open(outfn, O_WRONLY | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
-      if (ofd == -1) {
-        perror("Failed to open output file");
-        exit(1);
+        else if (opts->make_pch)
+          outfn = change_ext(src, "pch");  // Placed next to the header, to be found by cpp.
+      } else if (opts->make_pch) {
+        // cpp looks for the precompiled header only next to the header.
+        const char *pchfn = change_ext(src, "pch");
+        if (strcmp(JOIN_PATHS(".", outfn), JOIN_PATHS(".", pchfn)) != 0)
+          error("precompiled header must be output next to the header: %s", pchfn);
       }
     }
 
@@ -577,27 +789,347 @@ static int do_compile(Options *opts, const char *root) {
       else if (strcasecmp(ext, "a") == 0)  st = ArchiveFile;
     }
 
-    switch (st) {
-    case UnknownSource:
-      fprintf(stderr, "Unknown source type: %s\n", src);
-      res = -1;
-      break;
-    case Clanguage:
-      res = compile_csource(src, opts->out_type, outfn, ofd, opts->cpp_cmd, opts->cc1_cmd,
-                            opts->as_cmd, opts->ld_cmd);
-      break;
-    case Assembly:
-      res = compile_asm(src, opts->out_type, outfn, ofd, opts->as_cmd, opts->ld_cmd);
-      break;
-    case ObjectFile:
-    case ArchiveFile:
+    if (st == ObjectFile || st == ArchiveFile) {
       if (opts->out_type >= OutExecutable)
         vec_push(opts->ld_cmd, src);
-      break;
+      continue;
+    }
+
+    CompileJob *job = malloc_or_die(sizeof(*job));
+    job->src = src;
+    job->outfn = outfn;
+    job->st = st;
+    job->objfn = st == UnknownSource ? NULL : object_filename(src, st, opts->out_type, outfn);
+    if (job->objfn != NULL && opts->out_type >= OutExecutable)
+      vec_push(opts->ld_cmd, job->objfn);
+    vec_push(jobs, job);
+  }
+  return jobs;
+}
+
+// Let cc1 parse the header tokens written by cpp, and append its global scope.
+static int complete_pch(Options *opts, const char *pchfn) {
+  Vector *cmd = new_vector();
+  for (int i = 0; i < opts->cc1_cmd->len - 2; ++i)  // Except ["-", NULL].
+    vec_push(cmd, opts->cc1_cmd->data[i]);
+  vec_push(cmd, "--make-pch");
+  vec_push(cmd, pchfn);
+  vec_push(cmd, NULL);
+
+  int res;
+#if !defined(USE_SYS_AS)
+  if (opts->integrated) {
+    optind = 0;
+    res = cc1_main(command_argc(cmd), (char**)cmd->data, stdin, stdout);
+  } else
+#endif
+  {
+    res = wait_process(exec_with_ofd((char**)cmd->data, -1));
+  }
+  if (res != 0)
+    remove(pchfn);
+  return res;
+}
+
+static int run_job(Options *opts, CompileJob *job, int ofd) {
+  switch (job->st) {
+  case Clanguage:
+    {
+      int res;
+#if !defined(USE_SYS_AS)
+      if (opts->integrated)
+        res = compile_integrated(job->src, opts->out_type, job->objfn, ofd, opts->cpp_cmd,
+                                 opts->cc1_cmd, opts->as_cmd);
+      else
+#endif
+        res = compile_csource(job->src, opts->out_type, job->objfn, ofd, opts->cpp_cmd,
+                              opts->cc1_cmd, opts->as_cmd);
+      if (res == 0 && opts->make_pch && job->outfn != NULL && strcmp(job->outfn, "-") != 0)
+        res = complete_pch(opts, job->outfn);
+      return res;
+    }
+  case Assembly:
+    return compile_asm(job->src, opts->out_type, job->objfn, ofd, opts->as_cmd);
+  default:
+    fprintf(stderr, "Unknown source type: %s\n", job->src);
+    return -1;
+  }
+}
+
+// A job killed by a signal has no chance to tell it.
+static void check_job_status(const CompileJob *job, int status) {
+  if (WIFSIGNALED(status))
+    fprintf(stderr, "%s: compiler terminated by signal %d\n", job->src != NULL ? job->src : "-",
+            WTERMSIG(status));
+}
+
+// In process stages might abort or exit on a fatal error, and leave their states behind:
+// Run them in a child process for each source, to go on with the rest.
+static int run_job_isolated(Options *opts, CompileJob *job, int ofd) {
+#if !defined(USE_SYS_AS)
+  if (opts->integrated && job->st == Clanguage) {
+    fflush(stdout);
+    fflush(stderr);
+    pid_t pid = fork1();
+    if (pid == 0) {
+      // Temporary files are owned by the parent.
+      vec_clear(&remove_on_exit);
+      exit(run_job(opts, job, ofd) == 0 ? 0 : 1);
+    }
+    int status = wait_process(pid);
+    check_job_status(job, status);
+    return status;
+  }
+#endif
+  return run_job(opts, job, ofd);
+}
+
+static bool output_to_file(Options *opts, CompileJob *job) {
+  return opts->out_type <= OutAssembly && job->outfn != NULL && strcmp(job->outfn, "-") != 0;
+}
+
+static int open_output(Options *opts, CompileJob *job, int ofd) {
+  if (output_to_file(opts, job)) {
+    close(STDOUT_FILENO);
+    ofd = open(job->outfn, O_WRONLY | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+    if (ofd == -1) {
+      perror("Failed to open output file");
+      exit(1);
+    }
+  }
+  return ofd;
+}
+
+// Parallel compilation (-j)
+
+static struct {
+  int rfd;  // Non-blocking read end, -1 if no jobserver.
+  int wfd;
+  int tokens;  // Tokens acquired (the implicit one is not counted).
+} jobserver = {-1, -1, 0};
+
+static int cpu_count(void) {
+#if defined(_SC_NPROCESSORS_ONLN)
+  long n = sysconf(_SC_NPROCESSORS_ONLN);
+  if (n > 0)
+    return n;
+#endif
+  return 1;
+}
+
+// Join GNU make jobserver, advertised in MAKEFLAGS
+// as `--jobserver-auth=R,W`, `--jobserver-fds=R,W` or `--jobserver-auth=fifo:PATH`.
+static bool join_jobserver(void) {
+  static const char *kKeys[] = {"--jobserver-auth=", "--jobserver-fds="};
+  const char *makeflags = getenv("MAKEFLAGS");
+  if (makeflags == NULL)
+    return false;
+
+  const char *auth = NULL;
+  for (int i = 0; i < (int)ARRAY_SIZE(kKeys); ++i) {
+    // Last one wins.
+    size_t len = strlen(kKeys[i]);
+    for (const char *p = makeflags; (p = strstr(p, kKeys[i])) != NULL; p += len)
+      auth = p + len;
+  }
+  if (auth == NULL)
+    return false;
+
+  const char *end = auth;
+  while (*end != '\0' && *end != ' ')
+    ++end;
+
+  int rfd = -1, wfd = -1;
+  if (strncmp(auth, "fifo:", 5) == 0) {
+    char *path = strndup(auth + 5, end - (auth + 5));
+    rfd = open(path, O_RDONLY | O_NONBLOCK);
+    if (rfd >= 0 && (wfd = open(path, O_WRONLY)) < 0) {
+      close(rfd);
+      rfd = -1;
+    }
+    free(path);
+  } else {
+    char *q;
+    int r = strtol(auth, &q, 10);
+    if (*q != ',')
+      return false;
+    wfd = strtol(q + 1, &q, 10);
+    if (q != end || r < 0 || wfd < 0)
+      return false;
+    // Reopen the read end to make it non-blocking, without affecting other processes.
+    char path[32];
+    snprintf(path, sizeof(path), "/proc/self/fd/%d", r);
+    rfd = open(path, O_RDONLY | O_NONBLOCK);
+  }
+  if (rfd < 0)
+    return false;
+
+  jobserver.rfd = rfd;
+  jobserver.wfd = wfd;
+  return true;
+}
+
+static bool acquire_job_slot(int running, int max_jobs) {
+  if (running == 0)
+    return true;  // Use the implicit token.
+  if (jobserver.rfd < 0)
+    return running < max_jobs;
+
+  char c;
+  if (read(jobserver.rfd, &c, 1) != 1)
+    return false;
+  ++jobserver.tokens;
+  return true;
+}
+
+static void release_job_slot(void) {
+  if (jobserver.tokens > 0) {
+    char c = '+';
+    if (write(jobserver.wfd, &c, 1) != 1)
+      perror("jobserver");
+    --jobserver.tokens;
+  }
+}
+
+static void copy_diagnostics(FILE *fp) {
+  int fd = fileno(fp);
+  if (lseek(fd, 0, SEEK_SET) == 0) {
+    char buf[4096];
+    ssize_t size;
+    while ((size = read(fd, buf, sizeof(buf))) > 0) {
+      if (write(STDERR_FILENO, buf, size) != size)
+        break;
+    }
+  }
+  fclose(fp);
+}
+
+static pid_t start_job(Options *opts, CompileJob *job, FILE *errfp) {
+  fflush(stdout);
+  fflush(stderr);
+  pid_t pid = fork1();
+  if (pid == 0) {
+    // Temporary files are owned by the parent.
+    vec_clear(&remove_on_exit);
+
+    // Collect diagnostics, to output them in a chunk.
+    close(STDERR_FILENO);
+    if (dup(fileno(errfp)) == -1)
+      exit(1);
+
+    int ofd = open_output(opts, job, STDOUT_FILENO);
+    int res = run_job(opts, job, ofd);
+    fflush(stderr);
+    exit(res == 0 ? 0 : 1);
+  }
+  return pid;
+}
+
+// Sleep until a token is available from jobserver, or a job exits (closing its pipe).
+static void wait_token_or_job(const pid_t *pids, const int *exitfds, int count) {
+  struct pollfd *fds = calloc_or_die(sizeof(*fds) * (count + 1));
+  int n = 0;
+  fds[n].fd = jobserver.rfd;
+  fds[n++].events = POLLIN;
+  for (int i = 0; i < count; ++i) {
+    if (pids[i] != -1 && exitfds[i] >= 0) {
+      fds[n].fd = exitfds[i];
+      fds[n++].events = POLLIN;
+    }
+  }
+  poll(fds, n, -1);  // Interrupted or failed: Caller checks again.
+  free(fds);
+}
+
+static int compile_parallel(Options *opts, Vector *jobs, int max_jobs) {
+  int count = jobs->len;
+  pid_t *pids = calloc_or_die(sizeof(*pids) * count);
+  int *exitfds = calloc_or_die(sizeof(*exitfds) * count);
+  FILE **errfps = calloc_or_die(sizeof(*errfps) * count);
+  int res = 0;
+  int running = 0;
+  for (int next = 0; next < count || running > 0; ) {
+    if (next < count && acquire_job_slot(running, max_jobs)) {
+      FILE *errfp = tmpfile();
+      if (errfp == NULL)
+        error("cannot create temporary file");
+      errfps[next] = errfp;
+      // With jobserver, the job inherits the write end of a pipe and holds it until exit,
+      // so that its exit and a token can be waited together.
+      int fds[2] = {-1, -1};
+      if (jobserver.rfd >= 0 && pipe(fds) != 0)
+        error("pipe failed");
+      pids[next] = start_job(opts, jobs->data[next], errfp);
+      exitfds[next] = fds[0];
+      if (fds[1] >= 0)
+        close(fds[1]);
+      ++next;
+      ++running;
+      continue;
+    }
+
+    int status = -1;
+    pid_t done;
+    if (jobserver.rfd >= 0 && next < count) {
+      done = waitpid(-1, &status, WNOHANG);
+      if (done == 0) {
+        wait_token_or_job(pids, exitfds, next);
+        continue;
+      }
+    } else {
+      done = waitpid(-1, &status, 0);
+    }
+    if (done < 0)
+      error("wait failed");
+    for (int i = 0; i < next; ++i) {
+      if (pids[i] == done) {
+        pids[i] = -1;
+        if (exitfds[i] >= 0)
+          close(exitfds[i]);
+        copy_diagnostics(errfps[i]);
+        check_job_status(jobs->data[i], status);
+        res |= status;
+        --running;
+        release_job_slot();
+        break;
+      }
+    }
+  }
+  free(errfps);
+  free(exitfds);
+  free(pids);
+  return res;
+}
+
+static int do_compile(Options *opts, const char *root) {
+  UNUSED(root);
+  Vector *jobs = collect_jobs(opts);
+
+  int max_jobs = opts->jobs;
+  if (max_jobs < 0)
+    max_jobs = join_jobserver() ? jobs->len : cpu_count();
+  bool parallel = max_jobs > 1 && jobs->len > 1 &&
+                  !(opts->ofn != NULL && opts->out_type < OutExecutable);
+  for (int i = 0; parallel && i < jobs->len; ++i) {
+    // Outputs to stdout are not serialized.
+    CompileJob *job = jobs->data[i];
+    if (opts->out_type <= OutAssembly && !output_to_file(opts, job))
+      parallel = false;
+  }
+
+  int res = 0;
+  if (parallel) {
+    res = compile_parallel(opts, jobs, max_jobs);
+  } else {
+    // Go on after an error, to report the ones in the rest too.
+    int ofd = STDOUT_FILENO;
+    for (int i = 0; i < jobs->len; ++i) {
+      CompileJob *job = jobs->data[i];
+      ofd = open_output(opts, job, ofd);
+      res |= run_job_isolated(opts, job, ofd);
     }
-    if (res != 0)
-      break;
   }
+  cache_trim();
 
   if (res == 0 && opts->out_type >= OutExecutable) {
     if (!opts->use_ld) {
@@ -620,6 +1152,204 @@ static int do_compile(Options *opts, const char *root) {
   return res == 0 ? 0 : 1;
 }
 
+// Performance report (-ftime-report, -fmem-report)
+// Each tool, in process or not, appends its report to a temporary file as a JSON line,
+// and the driver sums them up.
+
+static long current_usec(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000000L + ts.tv_nsec / 1000;
+}
+
+static void prepare_report(Options *opts) {
+  char template[] = "/tmp/xcc-XXXXXX.json";
+  int fd = mkstemps(template, 5);
+  if (fd == -1) {
+    perror("Failed to open report file");
+    exit(1);
+  }
+  close(fd);
+  opts->report_tmp = strdup(template);
+  vec_push(&remove_on_exit, opts->report_tmp);
+
+  StringBuffer sb;
+  sb_init(&sb);
+  sb_append(&sb, "-freport-file=", NULL);
+  sb_append(&sb, opts->report_tmp, NULL);
+  const char *file_opt = sb_to_string(&sb);
+
+  Vector *cmds[] = {
+    opts->cpp_cmd, opts->cc1_cmd,
+#if !defined(USE_SYS_AS)
+    opts->as_cmd,
+#endif
+#if !defined(USE_SYS_LD)
+    opts->use_ld ? NULL : opts->ld_cmd,
+#endif
+  };
+  for (int i = 0; i < (int)ARRAY_SIZE(cmds); ++i) {
+    Vector *cmd = cmds[i];
+    if (cmd == NULL)
+      continue;
+    if (opts->time_report)
+      vec_push(cmd, "-ftime-report");
+    if (opts->mem_report)
+      vec_push(cmd, "-fmem-report");
+    vec_push(cmd, file_opt);
+  }
+}
+
+typedef struct {
+  const char *name;
+  long value;
+} ReportItem;
+
+static void add_report_item(Vector *items, const char *name, size_t len, long value) {
+  for (int i = 0; i < items->len; ++i) {
+    ReportItem *item = items->data[i];
+    if (strncmp(item->name, name, len) == 0 && item->name[len] == '\0') {
+      item->value += value;
+      return;
+    }
+  }
+  ReportItem *item = malloc_or_die(sizeof(*item));
+  item->name = strndup(name, len);
+  item->value = value;
+  vec_push(items, item);
+}
+
+static long report_value(const char *line, const char *key) {
+  const char *p = strstr(line, key);
+  return p != NULL ? strtol(p + strlen(key), NULL, 10) : 0;
+}
+
+// Add `{"key":value,...}` in the line as "tool.key".
+static void add_report_items(Vector *items, const char *line, const char *key, const char *tool,
+                             int toollen) {
+  const char *p = strstr(line, key);
+  if (p == NULL)
+    return;
+  for (p += strlen(key); *p == '"'; ) {
+    const char *item = p + 1;
+    int itemlen = strcspn(item, "\"");
+    char *q;
+    long value = strtol(item + itemlen + 2, &q, 10);  // Skip `":`.
+    char name[64];
+    int namelen = snprintf(name, sizeof(name), "%.*s.%.*s", toollen, tool, itemlen, item);
+    add_report_item(items, name, MIN(namelen, (int)sizeof(name) - 1), value);
+    p = q + (*q == ',' ? 1 : 0);
+  }
+}
+
+static void output_report(Options *opts, long wall_usec) {
+  FILE *fp = fopen(opts->report_tmp, "r");
+  if (fp == NULL)
+    return;
+
+  Vector *runs = new_vector();  // <ReportItem*>, per tool.
+  Vector *phases = new_vector();  // <ReportItem*>, "tool.phase"
+  Vector *stats = new_vector();  // <ReportItem*>, "tool.stat"
+  long peak_rss_kb = -1, allocs = 0, alloc_bytes = 0;
+  long arena_allocs = 0, arena_bytes = 0, arena_peak_kb = 0;
+  char *line = NULL;
+  size_t capa = 0;
+  while (getline_chomp(&line, &capa, fp) != -1) {
+    const char *tool = strstr(line, "\"tool\":\"");
+    if (tool == NULL)
+      continue;
+    tool += 8;
+    int toollen = strcspn(tool, "\"");
+    add_report_item(runs, tool, toollen, 1);
+
+    add_report_items(phases, line, "\"time_us\":{", tool, toollen);
+    add_report_items(stats, line, "\"stats\":{", tool, toollen);
+
+    peak_rss_kb = MAX(peak_rss_kb, report_value(line, "\"peak_rss_kb\":"));
+    allocs += report_value(line, "\"allocs\":");
+    alloc_bytes += report_value(line, "\"alloc_bytes\":");
+    arena_allocs += report_value(line, "\"arena_allocs\":");
+    arena_bytes += report_value(line, "\"arena_bytes\":");
+    arena_peak_kb = MAX(arena_peak_kb, report_value(line, "\"arena_peak_kb\":"));
+  }
+  free(line);
+  fclose(fp);
+
+  long total = 0;
+  for (int i = 0; i < phases->len; ++i)
+    total += ((ReportItem*)phases->data[i])->value;
+
+  if (opts->report_file != NULL) {
+    FILE *ofp = fopen(opts->report_file, "w");
+    if (ofp == NULL) {
+      perror(opts->report_file);
+      return;
+    }
+    fprintf(ofp, "{\"wall_us\":%ld,\"runs\":{", wall_usec);
+    for (int i = 0; i < runs->len; ++i) {
+      ReportItem *item = runs->data[i];
+      fprintf(ofp, "%s\"%s\":%ld", i > 0 ? "," : "", item->name, item->value);
+    }
+    fprintf(ofp, "}");
+    if (opts->time_report) {
+      fprintf(ofp, ",\"total_us\":%ld,\"time_us\":{", total);
+      for (int i = 0; i < phases->len; ++i) {
+        ReportItem *item = phases->data[i];
+        fprintf(ofp, "%s\"%s\":%ld", i > 0 ? "," : "", item->name, item->value);
+      }
+      fprintf(ofp, "}");
+      if (stats->len > 0) {
+        fprintf(ofp, ",\"stats\":{");
+        for (int i = 0; i < stats->len; ++i) {
+          ReportItem *item = stats->data[i];
+          fprintf(ofp, "%s\"%s\":%ld", i > 0 ? "," : "", item->name, item->value);
+        }
+        fprintf(ofp, "}");
+      }
+    }
+    if (opts->mem_report)
+      fprintf(ofp,
+              ",\"peak_rss_kb\":%ld,\"allocs\":%ld,\"alloc_bytes\":%ld"
+              ",\"arena_allocs\":%ld,\"arena_bytes\":%ld,\"arena_peak_kb\":%ld",
+              peak_rss_kb, allocs, alloc_bytes, arena_allocs, arena_bytes, arena_peak_kb);
+    fprintf(ofp, "}\n");
+    fclose(ofp);
+    return;
+  }
+
+  fprintf(stderr, "Runs:");
+  for (int i = 0; i < runs->len; ++i) {
+    ReportItem *item = runs->data[i];
+    fprintf(stderr, " %s x%ld", item->name, item->value);
+  }
+  fprintf(stderr, "\n");
+  if (opts->time_report) {
+    fprintf(stderr, "Time report:\n");
+    for (int i = 0; i < phases->len; ++i) {
+      ReportItem *item = phases->data[i];
+      fprintf(stderr, "  %-16s %6ld.%03ld ms %3ld%%\n", item->name, item->value / 1000,
+              item->value % 1000, total > 0 ? item->value * 100 / total : 0L);
+    }
+    fprintf(stderr, "  %-16s %6ld.%03ld ms\n", "total", total / 1000, total % 1000);
+    fprintf(stderr, "  %-16s %6ld.%03ld ms\n", "wall", wall_usec / 1000, wall_usec % 1000);
+    if (stats->len > 0) {
+      fprintf(stderr, "Statistics:\n");
+      for (int i = 0; i < stats->len; ++i) {
+        ReportItem *item = stats->data[i];
+        fprintf(stderr, "  %-24s %8ld\n", item->name, item->value);
+      }
+    }
+  }
+  if (opts->mem_report) {
+    fprintf(stderr, "Memory report:\n");
+    fprintf(stderr, "  peak RSS         %ld KB\n", peak_rss_kb);
+    fprintf(stderr, "  allocations      %ld (%ld bytes)\n", allocs, alloc_bytes);
+    if (arena_allocs > 0)
+      fprintf(stderr, "  arena            %ld (%ld bytes), peak %ld KB\n", arena_allocs, arena_bytes,
+              arena_peak_kb);
+  }
+}
+
 #define STR(x)   STR2(x)
 #define STR2(x)  #x
 
@@ -724,6 +1454,20 @@ int main(int argc, char *argv[]) {
     .ofn = NULL,
     .out_type = OutExecutable,
     .src_type = UnknownSource,
+    .make_pch = false,
+    .jobs = 0,
+#if !defined(USE_SYS_AS)
+    .integrated = true,
+#else
+    .integrated = false,
+#endif
+    .cache_dir = NULL,
+    .cache_size = DEFAULT_CACHE_SIZE,
+    .cache_stats = false,
+    .time_report = false,
+    .mem_report = false,
+    .report_file = NULL,
+    .report_tmp = NULL,
     .nodefaultlibs = false,
     .nostdlib = false,
     .nostdinc = false,
@@ -731,6 +1475,19 @@ int main(int argc, char *argv[]) {
   };
   parse_options(argc, argv, &opts);
 
+  if (opts.cache_dir != NULL) {
+    if (!opts.integrated)
+      fprintf(stderr, "Warning: --cache-dir is ignored with -no-integrated\n");
+    else if (!cache_open(opts.cache_dir, opts.cache_size, xccpath))
+      error("cannot open cache directory: %s", opts.cache_dir);
+  }
+  if (opts.cache_stats) {
+    if (!cache_enabled())
+      error("--cache-stats requires --cache-dir");
+    cache_show_stats(stdout);
+    return 0;
+  }
+
   if (opts.sources->len == 0) {
     fprintf(stderr, "No input files\n\n");
     usage(stderr);
@@ -742,6 +1499,17 @@ int main(int argc, char *argv[]) {
     vec_push(cpp_cmd, JOIN_PATHS(root, "include"));
   }
 
+  if (opts.time_report || opts.mem_report)
+    prepare_report(&opts);
+
+  if (opts.make_pch) {
+    vec_push(cpp_cmd, "--make-pch");
+  } else if (opts.out_type != OutPreprocess) {
+    // Pass tokens from cpp to cc1 in binary, to avoid lexing them twice.
+    vec_push(cpp_cmd, "--token-output");
+    vec_push(cc1_cmd, "--token-input");
+  }
+
   vec_push(cpp_cmd, NULL);  // Buffer for src.
   vec_push(cpp_cmd, NULL);  // Terminator.
   vec_push(cc1_cmd, "-");   // Read from cpp pipe.
@@ -769,5 +1537,9 @@ int main(int argc, char *argv[]) {
 
   atexit(remove_tmp_files);
 
-  return do_compile(&opts, root);
+  long start = current_usec();
+  int res = do_compile(&opts, root);
+  if (res == 0 && opts.report_tmp != NULL)
+    output_report(&opts, current_usec() - start);
+  return res;
 }
@@ -78,6 +78,11 @@ function test_if() {
   try_pp 'Block comment hide #else' 'AAA /*#elseBBB */' '#if 1\nAAA /*\n#else\nBBB */\n#endif' '-C'
   try_pp 'Line comment hide #else' '' '#if 0\nAAA\n//#else\nBBB\n#endif' '-C'
   try_pp 'Double quote in #if' '' "#if 0\n// \"str not closed, but in comment'\n#endif" '-C'
+  try_pp 'Skip lines in #if 0' '# 8 "*stdin*"8' "#if 0\na\nb\nc\nd\ne\n#endif\n__LINE__"
+  try_pp 'Block comment hide #else in #if 0' '6' "#if 0\nx /*\n#else\n*/ y\n#endif\n__LINE__"
+  try_pp 'Continued string hide #else in #if 0' '5' "#if 0\nchar *s = \"a\\\\\n#else\";\n#endif\n__LINE__"
+  try_pp 'Continued line hide #else in #if 0' '5' "#if 0\nint x = 1 \\\\\n#else\n#endif\n__LINE__"
+  try_pp 'Comment before # in #if 0' '4' "#if 0\nc = '\\\\'' /* */; // #else\n  /**/ #else\n__LINE__\n#endif"
 
   end_test_suite
 }
@@ -203,6 +208,26 @@ function test_run() {
   echo -e "#include_next <tmp.h>\n#define FOO (29)" > tmp.h
   try_run "Include with include_next" 42 "#include <tmp.h>\nint main(){return FOO+BAR;}"  "-I . -I tmp_include"
 
+  # Include guard
+  echo -e "/* guard */\n#ifndef TMP_H_\n#define TMP_H_\nx += 11;\n#endif  // TMP_H_" > tmp.h
+  try_run 'Include guard' 11 "int main(){int x = 0;\n#include \"tmp.h\"\n#include \"tmp.h\"\nreturn x;}"
+  try_run 'Include guard undefined' 22 "int main(){int x = 0;\n#include \"tmp.h\"\n#include \"tmp.h\"\n#undef TMP_H_\n#include \"tmp.h\"\nreturn x;}"
+  echo -e "#ifndef TMP_H_\n#define TMP_H_\n#endif\nx += 11;" > tmp.h
+  try_run 'Token after include guard' 22 "int main(){int x = 0;\n#include \"tmp.h\"\n#include \"tmp.h\"\nreturn x;}"
+  echo -e "#ifndef TMP_H_\n#define TMP_H_\n#else\nx += 11;\n#endif" > tmp.h
+  try_run 'Include guard with else' 11 "int main(){int x = 0;\n#include \"tmp.h\"\n#include \"tmp.h\"\nreturn x;}"
+  echo -e "#ifndef TMP_H_\n#define TMP_H_\n#include \"tmp.h\"\nx += 11;\n#endif" > tmp.h
+  try_run 'Guarded header includes itself' 11 "int main(){int x = 0;\n#include \"tmp.h\"\nreturn x;}"
+
+  # Pragma once through symbolic link
+  echo -e "#pragma once\nx += 11;" > tmp.h
+  ln -sf ../tmp.h tmp_include/tmp_link.h
+  try_run 'Pragma once via symlink' 11 "int main(){int x = 0;\n#include \"tmp.h\"\n#include \"tmp_include/tmp_link.h\"\nreturn x;}"
+
+  # Header included many times
+  echo -e "X(11)\nX(22)" > tmp_include/tmp_x.h
+  try_run 'X-macro header' 27 "int main(){int x = 0;\n#define X(n)  x += n;\n#include <tmp_x.h>\n#undef X\n#define X(n)  x -= n / 11;\n#include <tmp_x.h>\n#include <tmp_x.h>\nreturn x;}" "-I tmp_nonexist -I tmp_include"
+
   end_test_suite
 }
 
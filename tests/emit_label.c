@@ -0,0 +1,36 @@
+// Labels allocated while emitting code (jump table, float conversion)
+// must not shift labels of following functions.
+
+int table(int x) {
+  switch (x) {
+  case 0: return 10;
+  case 1: return 11;
+  case 2: return 12;
+  case 3: return 13;
+  case 4: return 14;
+  case 5: return 15;
+  }
+  return -1;
+}
+
+double to_double(unsigned long x) {
+  return x;
+}
+
+unsigned long from_double(double x) {
+  return x;
+}
+
+const char *name(int x) {
+  if (x > 0)
+    return "positive";
+  else if (x < 0)
+    return "negative";
+  return "zero";
+}
+
+double scale(double x) {
+  for (int i = 0; i < 3; ++i)
+    x *= 1.5;
+  return x;
+}
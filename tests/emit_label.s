@@ -0,0 +1,172 @@
+
+	.text
+	.globl table
+	.p2align 1
+	.type table, @function
+table:
+	endbr64
+
+	cmp $5, %edi
+	ja L.0009
+
+	mov %edi, %edi
+	lea L.e0001(%rip), %rax
+	jmp *(%rax,%rdi,8)
+	.section .rodata
+	.p2align 3
+L.e0001:
+	.quad L.0010
+	.quad L.0011
+	.quad L.0012
+	.quad L.0013
+	.quad L.0014
+	.quad L.0015
+	.text
+L.0010:
+	mov $10, %eax
+	jmp L.0008
+L.0011:
+	mov $11, %eax
+	jmp L.0008
+L.0012:
+	mov $12, %eax
+	jmp L.0008
+L.0013:
+	mov $13, %eax
+	jmp L.0008
+L.0014:
+	mov $14, %eax
+	jmp L.0008
+L.0015:
+	mov $15, %eax
+	jmp L.0008
+L.0009:
+	mov $-1, %eax
+L.0008:
+	ret
+
+	.text
+	.globl to_double
+	.p2align 1
+	.type to_double, @function
+to_double:
+	endbr64
+
+	test %rdi, %rdi
+	js L.e0002
+	cvtsi2sd %rdi, %xmm0
+	jmp L.e0003
+L.e0002:
+	push %rax
+	mov %rdi, %rax
+	shr $1, %rax
+	cvtsi2sd %rax, %xmm0
+	addsd %xmm0, %xmm0
+	pop %rax
+L.e0003:
+
+	ret
+
+	.text
+	.globl from_double
+	.p2align 1
+	.type from_double, @function
+from_double:
+	endbr64
+
+	lea L.0034(%rip), %rax
+	movsd (%rax), %xmm1
+	comisd %xmm0, %xmm1
+	jae L.0031
+
+	jmp L.0032
+L.0031:
+	cvttsd2si %xmm0, %rax
+	jmp L.0033
+L.0032:
+	lea L.0034(%rip), %rdi
+	movsd (%rdi), %xmm1
+	subsd %xmm1, %xmm0
+	cvttsd2si %xmm0, %rdi
+	mov $-9223372036854775808, %rsi
+	xor %rsi, %rdi
+	mov %rdi, %rax
+L.0033:
+
+	ret
+	.section .rodata
+	.local L.0034
+	.p2align 3
+L.0034:
+	.quad 0x43e0000000000000
+
+	.text
+	.globl name
+	.p2align 1
+	.type name, @function
+name:
+	endbr64
+
+	test %edi, %edi
+	jle L.0039
+
+	lea L.0002(%rip), %rax
+	jmp L.0037
+L.0039:
+	test %edi, %edi
+	jge L.0042
+
+	lea L.0004(%rip), %rax
+	jmp L.0037
+L.0042:
+	lea L.0006(%rip), %rax
+L.0037:
+	ret
+
+	.section .rodata
+	.local L.0002
+	.type L.0002, @object
+L.0002:
+	.string "positive"
+	.section .rodata
+	.local L.0004
+	.type L.0004, @object
+L.0004:
+	.string "negative"
+	.section .rodata
+	.local L.0006
+	.type L.0006, @object
+L.0006:
+	.string "zero"
+
+	.text
+	.globl scale
+	.p2align 1
+	.type scale, @function
+scale:
+	endbr64
+
+	mov $0, %eax
+	jmp L.0052
+L.0050:
+	movsd %xmm0, %xmm1
+	lea L.0054(%rip), %rdi
+	movsd (%rdi), %xmm2
+	mulsd %xmm2, %xmm1
+	movsd %xmm1, %xmm0
+
+	mov %eax, %edi
+	inc %edi
+	mov %edi, %eax
+L.0052:
+	cmp $3, %eax
+	jl L.0050
+
+
+	ret
+	.section .rodata
+	.local L.0054
+	.p2align 3
+L.0054:
+	.quad 0x3ff8000000000000
+
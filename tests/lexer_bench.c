@@ -0,0 +1,125 @@
+// Micro-benchmark: Lexing throughput on large input, in MB/s.
+//   Usage: lexer_bench files...
+// The files are concatenated and repeated up to the size, to get stable numbers.
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "lexer.h"
+#include "util.h"
+
+#define MIN_SIZE  (32 << 20)
+
+static double now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void report(const char *title, size_t size, double elapsed) {
+  printf("  %-20s %8.1f MB/s\n", title, size / elapsed / (1 << 20));
+}
+
+static const char *find_chars_bytewise(const char *p, char c1, char c2, char c3) {
+  for (char c; (c = *p) != '\0' && c != c1 && c != c2 && c != c3; ++p)
+    ;
+  return p;
+}
+
+static const char *skip_whitespaces_bytewise(const char *p) {
+  while (isspace(*p))
+    ++p;
+  return p;
+}
+
+static const char *skip_ident_chars_bytewise(const char *p) {
+  while (isalnum_(*p))
+    ++p;
+  return p;
+}
+
+static char *load_input(int argc, char *argv[], size_t *psize) {
+  DataStorage data;
+  data_init(&data);
+  for (int i = 1; i < argc; ++i) {
+    FILE *fp = fopen(argv[i], "r");
+    if (fp == NULL)
+      error("Cannot open file: %s", argv[i]);
+    char buf[4096];
+    for (size_t n; (n = fread(buf, 1, sizeof(buf), fp)) > 0; )
+      data_append(&data, buf, n);
+    fclose(fp);
+    data_push(&data, '\n');
+  }
+  if (data.len == 0)
+    error("No input");
+  size_t len = data.len;
+  data_reserve(&data, (MIN_SIZE / len + 1) * len + 1);  // Not to realloc in appending itself.
+  while (data.len < MIN_SIZE)
+    data_append(&data, data.buf, len);
+  data_push(&data, '\0');
+  *psize = data.len - 1;
+  return (char*)data.buf;
+}
+
+int main(int argc, char *argv[]) {
+  if (argc < 2) {
+    fprintf(stderr, "Usage: lexer_bench files...\n");
+    return 1;
+  }
+
+  size_t size;
+  char *src = load_input(argc, argv, &size);
+  printf("Input: %.1f MB\n", (double)size / (1 << 20));
+
+  // Scanning kernels over whole input, compared with bytewise loops.
+  {
+    double start = now();
+    size_t count = 0;
+    for (const char *p = src; *(p = find_chars(p, '"', '\'', '/')) != '\0'; ++p)
+      ++count;
+    report("find_chars", size, now() - start);
+
+    start = now();
+    size_t count2 = 0;
+    for (const char *p = src; *(p = find_chars_bytewise(p, '"', '\'', '/')) != '\0'; ++p)
+      ++count2;
+    report("  (bytewise)", size, now() - start);
+
+    start = now();
+    for (const char *p = src; *p != '\0'; ) {
+      const char *q = skip_ident_chars(skip_whitespaces(p));
+      p = q == p ? p + 1 : q;
+    }
+    report("skip_*", size, now() - start);
+
+    start = now();
+    for (const char *p = src; *p != '\0'; ) {
+      const char *q = skip_ident_chars_bytewise(skip_whitespaces_bytewise(p));
+      p = q == p ? p + 1 : q;
+    }
+    report("  (bytewise)", size, now() - start);
+    if (count != count2)
+      error("find_chars mismatch: %zu vs %zu", count, count2);
+  }
+
+  // Lexer: Only tokenize, so that errors in parsing are not reported.
+  {
+    init_lexer();
+    FILE *fp = fmemopen(src, size, "r");
+    if (fp == NULL)
+      error("fmemopen failed");
+    double start = now();
+    set_source_whole_file(fp, "*bench*");
+    long count = 0;
+    while (match(-1)->kind != TK_EOF)
+      ++count;
+    report("lexer", size, now() - start);
+    printf("  (%ld tokens)\n", count);
+    fclose(fp);
+  }
+  return 0;
+}
@@ -4,9 +4,20 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 
 #include "./xtest.h"
 
+static const Name **make_names(const char *prefix, int n) {
+  const Name **names = malloc(sizeof(*names) * n);
+  for (int i = 0; i < n; ++i) {
+    char buf[32];
+    snprintf(buf, sizeof(buf), "%s%d", prefix, i);
+    names[i] = alloc_name(buf, NULL, true);
+  }
+  return names;
+}
+
 TEST(table) {
   const Name *key = alloc_name("1", NULL, false);
 
@@ -29,7 +40,167 @@ TEST(table) {
   EXPECT_NULL(table_get(&table, key));
   EXPECT_TRUE(!table_try_get(&table, key, NULL));
   EXPECT_EQ(0, table.count);
-  EXPECT_EQ(1, table.used);
+
+  // Deleted slot is reused, without growing.
+  int capacity = table.capacity;
+  table_put(&table, key, data);
+  EXPECT_EQ(1, table.count);
+  EXPECT_EQ(capacity, table.capacity);
+}
+
+TEST(clear) {
+  const int N = 100;
+  const Name **names = make_names("clr", N);
+
+  Table table;
+  table_init(&table);
+  for (int i = 0; i < N; ++i)
+    table_put(&table, names[i], (void*)&names[i]);
+  int capacity = table.capacity;
+  table_clear(&table);
+  EXPECT_EQ(0, table.count);
+  EXPECT_EQ(capacity, table.capacity);
+  EXPECT_NULL(table_get(&table, names[0]));
+  EXPECT_EQ(-1, table_iterate(&table, 0, NULL, NULL));
+
+  // Reused without growing.
+  for (int i = 0; i < N; i += 2)
+    table_put(&table, names[i], (void*)&names[i]);
+  EXPECT_EQ(N / 2, table.count);
+  EXPECT_EQ(capacity, table.capacity);
+  EXPECT_NULL(table_get(&table, names[1]));
+  EXPECT_PTREQ(&names[2], table_get(&table, names[2]));
 }
 
-XTEST_MAIN();
+TEST(many) {
+  const int N = 1000;
+  const Name **names = make_names("key", N);
+
+  Table table;
+  table_init(&table);
+  int errors = 0;
+  for (int i = 0; i < N; ++i)
+    errors += !table_put(&table, names[i], (void*)&names[i]);
+  EXPECT_EQ(0, errors);
+  EXPECT_EQ(N, table.count);
+  EXPECT_EQ(0, table.capacity & (table.capacity - 1));
+
+  // Delete odd ones, then others are still found.
+  for (int i = 1; i < N; i += 2)
+    errors += !table_delete(&table, names[i]);
+  EXPECT_EQ(N / 2, table.count);
+  for (int i = 0; i < N; ++i) {
+    void *value;
+    bool found = table_try_get(&table, names[i], &value);
+    if (found != (i % 2 == 0) || (found && value != &names[i]))
+      ++errors;
+  }
+  EXPECT_EQ(0, errors);
+
+  int count = 0;
+  for (int it = 0; (it = table_iterate(&table, it, NULL, NULL)) != -1; )
+    ++count;
+  EXPECT_EQ(N / 2, count);
+}
+
+TEST(reserve) {
+  const int N = 500;
+  const Name **names = make_names("reserve", N);
+
+  Table table;
+  table_init(&table);
+  table_reserve(&table, N);
+  int capacity = table.capacity;
+  EXPECT_TRUE(capacity >= N);
+  for (int i = 0; i < N; ++i)
+    table_put(&table, names[i], NULL);
+  EXPECT_EQ(capacity, table.capacity);
+
+  // Never shrinks.
+  table_reserve(&table, 1);
+  EXPECT_EQ(capacity, table.capacity);
+}
+
+// Micro-benchmark: `table_test --bench`
+static double now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void report(const char *title, int n, double elapsed) {
+  printf("  %-12s %7.1f ns/op\n", title, elapsed * 1e9 / n);
+}
+
+static int bench1(int N, int R) {
+  const Name **names = make_names("sym_", N);
+  const Name **misses = make_names("miss_", N);
+  printf("%d entries:\n", N);
+
+  Table table;
+  table_init(&table);
+  double start = now();
+  for (int r = 0; r < R; ++r) {
+    table_clear(&table);
+    for (int i = 0; i < N; ++i)
+      table_put(&table, names[i], (void*)names[i]);
+  }
+  report("put", N * R, now() - start);
+
+  int found = 0;
+  start = now();
+  for (int r = 0; r < R; ++r) {
+    for (int i = 0; i < N; ++i)
+      found += table_get(&table, names[i]) != NULL;
+  }
+  report("get (hit)", N * R, now() - start);
+
+  start = now();
+  for (int r = 0; r < R; ++r) {
+    for (int i = 0; i < N; ++i)
+      found += table_get(&table, misses[i]) != NULL;
+  }
+  report("get (miss)", N * R, now() - start);
+
+  start = now();
+  for (int r = 0; r < R; ++r) {
+    for (int i = 0; i < N; i += 2)
+      table_delete(&table, names[i]);
+    for (int i = 0; i < N; i += 2)
+      table_put(&table, names[i], (void*)names[i]);
+  }
+  report("delete+put", N * R, now() - start);
+
+  start = now();
+  for (int r = 0; r < R; ++r) {
+    for (int i = 0; i < N; ++i)
+      alloc_name(names[i]->chars, names[i]->chars + names[i]->bytes, false);
+  }
+  report("alloc_name", N * R, now() - start);
+
+  // Intern new names, with copying.
+  enum { W = 48 };
+  char *strs = malloc(N * W);
+  for (int i = 0; i < N; ++i)
+    snprintf(&strs[i * W], W, "new_identifier_%d_%d", N, i);
+  start = now();
+  for (int i = 0; i < N; ++i)
+    alloc_name(&strs[i * W], NULL, true);
+  report("intern", N, now() - start);
+
+  if (found != N * R) {
+    fprintf(stderr, "Unexpected count: %d\n", found);
+    return 1;
+  }
+  return 0;
+}
+
+static int bench(void) {
+  return bench1(1 << 10, 1 << 10) | bench1(1 << 20, 4);
+}
+
+int main(int argc, char *argv[]) {
+  if (argc > 1 && strcmp(argv[1], "--bench") == 0)
+    return bench();
+  return xtest_main();
+}
@@ -103,6 +103,15 @@ function test_function() {
   try_direct 'infinite loop and exit' 77 '#include <stdlib.h>\nint main(){for (int i = 0; ; ++i) if (i == 10) exit(77);}'
   try_direct 'multiple prototype' 22 'int foo(), bar=76, qux(); int main(){return foo() - qux();} int foo(){return 98;} int qux(){return bar;}'
 
+  # Static inline bodies are parsed later, but must not see declarations after them.
+  compile_error 'inline refers later var' 'static inline int f(void){return later;} int later; int main(){return f();}'
+  compile_error 'inline refers later typedef' 'static inline int f(void){T x = 0; return x;} typedef int T; int main(){return f();}'
+  compile_error 'inline refers later enum' 'static inline int f(void){return LATER;} enum {LATER}; int main(){return f();}'
+  compile_error 'inline refers later struct' 'static inline int f(void){struct S s = {0}; return s.x;} struct S {int x;}; int main(){return f();}'
+  # Unreferred bodies in headers are never parsed, but their brackets are checked.
+  printf 'static inline int unreferred(void){return (1];}\n' > tmp_inline.h
+  compile_error 'unreferred inline in header' '#include "tmp_inline.h"\nint main(){return 0;}'
+
   end_test_suite
 }
 
@@ -250,10 +259,47 @@ function test_error_line() {
       ${MAKE_ERR};}"
   check_error_line "After include" 2 "#include <stdio.h>
     ${MAKE_ERR};}"
+  check_error_line "String literal over lines" 4 "int main() {
+      const char *s = \"abc\"
+                      \"def\";
+      ${MAKE_ERR};}"
+  check_error_line "#line directive" 100 "int main() {
+    #line 100
+      ${MAKE_ERR};}"
+
+  begin_test 'Source line kept in message'
+  local msg
+  msg=$(echo -e '#define BAD (1 + nothing)\nint main() {\n  return  0 + BAD;\n}' | \
+      $XCC -o "$AOUT" -xc - 2>&1)
+  local err=''
+  [[ "$msg" == *$'\n  return  0 + BAD;\n              ^~~'* ]] || err="unexpected message: ${msg}"
+  end_test "$err"
 
   end_test_suite
 }
 
+function test_asm() {
+  begin_test_suite "Assembly"
+
+  # Expected output is for xcc on x86-64 Linux.
+  if [[ "$ARCH" != "x86_64" || "$(uname)" != "Linux" ]] ||
+      { [[ -n "$RE_SKIP" ]] && echo -n '//-WCC' | grep "$RE_SKIP" > /dev/null; }; then
+    end_test_suite
+    return
+  fi
+
+  # Same as the output when all functions were generated before emission,
+  # except labels allocated while emitting (L.eNNNN).
+  begin_test 'label numbers'
+  local err=''
+  $XCC -S -o tmp_emit_label.s emit_label.c || err='Compile failed'
+  [[ -z "$err" ]] && ! diff -u emit_label.s tmp_emit_label.s && err='Differ'
+  end_test "$err"
+
+  rm -f tmp_emit_label.s
+  end_test_suite
+}
+
 function test_link() {
   begin_test_suite "Link"
 
@@ -288,10 +334,462 @@ function test_link() {
   end_test_suite
 }
 
+cache_try() {
+  local title="$1"
+  local expected_hits="$2"
+  local expected="$3"
+  shift 3
+
+  begin_test "$title"
+
+  eval "$XCC" --cache-dir="$CACHE_DIR" -o "$AOUT" -Wall -Werror "$@" "$SILENT" || {
+    end_test 'Compile failed'
+    return
+  }
+
+  $RUN_AOUT
+  local actual="$?"
+  local hits
+  hits=$("$XCC" --cache-dir="$CACHE_DIR" --cache-stats | sed -n 's/^hits: *//p')
+
+  local err=''
+  [[ "$actual" == "$expected" ]] || err="${expected} expected, but ${actual}"
+  [[ "$hits" == "$expected_hits" ]] || err="${expected_hits} hits expected, but ${hits}"
+  end_test "$err"
+}
+
+test_cache() {
+  begin_test_suite "Cache"
+
+  # Compile cache is a feature of xcc driver.
+  if [[ -n "$RE_SKIP" ]]; then
+    echo -n '//-WCC' | grep "$RE_SKIP" > /dev/null && {
+      end_test_suite
+      return
+    };
+  fi
+
+  CACHE_DIR=$(mktemp -d)
+  echo 'int main(void){return ANS;}' > tmp_cache.c
+  cache_try 'miss'                   0 11 -DANS=11 tmp_cache.c
+  cache_try 'hit'                    1 11 -DANS=11 tmp_cache.c
+  cache_try 'source changed'         1 22 -DANS=22 tmp_cache.c
+  cache_try 'option changed'         1 22 -DANS=22 -O1 tmp_cache.c
+  cache_try 'hit after other result' 2 11 -DANS=11 tmp_cache.c
+  rm -rf "$CACHE_DIR"
+
+  end_test_suite
+}
+
+test_report() {
+  begin_test_suite "Report"
+
+  # Performance report is collected by xcc driver.
+  if [[ -n "$RE_SKIP" ]]; then
+    echo -n '//-WCC' | grep "$RE_SKIP" > /dev/null && {
+      end_test_suite
+      return
+    };
+  fi
+
+  local report
+  report=$(mktemp)
+  echo 'int main(void){return 0;}' > tmp_report.c
+
+  begin_test 'phases in report file'
+  local err=''
+  if "$XCC" -O2 -ftime-report -fmem-report -freport-file="$report" -o "$AOUT" tmp_report.c; then
+    for key in '"cpp.preprocess"' '"cc1.parse"' '"cc1.ssa"' '"as.emit"' '"ld.output"' \
+               '"cc1.dce.irs"' '"peak_rss_kb"' '"allocs"'; do
+      grep -q "$key" "$report" || { err="${key} not found"; break; }
+    done
+  else
+    err='Compile failed'
+  fi
+  end_test "$err"
+
+  rm -f "$report"
+  end_test_suite
+}
+
+tokstream_try() {
+  local title="$1"
+  shift
+
+  begin_test "$title"
+
+  local err=''
+  local text_size token_size
+  text_size=$("$CPP" "$@" | wc -c) && token_size=$("$CPP" --token-output "$@" | wc -c) || {
+    end_test 'Preprocess failed'
+    return
+  }
+  [[ "$token_size" -le "$text_size" ]] || err="Token stream ${token_size} > text ${text_size}"
+  end_test "$err"
+}
+
+test_token_stream() {
+  begin_test_suite "Token stream"
+
+  # Token stream is passed between cpp and cc1 run by xcc driver.
+  if [[ -n "$RE_SKIP" ]]; then
+    echo -n '//-WCC' | grep "$RE_SKIP" > /dev/null && {
+      end_test_suite
+      return
+    };
+  fi
+
+  local CPP CC1
+  CPP="$(dirname "$XCC")/cpp"
+  CC1="$(dirname "$XCC")/cc1"
+
+  echo '#define STR(x)  #x
+#define CAT(a, b)  a ## b
+#define SQR(x)  ((x) * (x))
+typedef unsigned int wchar_t;
+const char *s = "tab\t" "quote\"" STR(a + b) "\x41\101" "\
+continued";
+const wchar_t *w = "narrow " L"wideあ" "\n";
+char c = '"'\\n'"', d = '"'\\x7f'"';
+double f = 1.5e3 + .25f + 0x1p4;
+unsigned long long u = 18446744073709551615ULL;
+int CAT(fo, o)(int x) {
+  return SQR(x + 1)   +   SQR(
+      x) - 0x10 - 010;
+}' > tmp_tok.c
+
+  begin_test 'same code as text'
+  local err=''
+  "$CPP" tmp_tok.c | "$CC1" - > tmp_tok_text.s &&
+      "$CPP" --token-output tmp_tok.c | "$CC1" --token-input - > tmp_tok_bin.s || err='Compile failed'
+  [[ -z "$err" ]] && ! cmp -s tmp_tok_text.s tmp_tok_bin.s && err='Output differs'
+  end_test "$err"
+
+  tokstream_try 'smaller than text: valtest.c' -I../include -D__XCC valtest.c
+  tokstream_try 'smaller than text: parser.c' -I../include -D__XCC -DXCC_TARGET_ARCH=XCC_ARCH_X64 \
+      -I../src/util -I../src/cc/frontend -I../src/cc/backend ../src/cc/frontend/parser.c
+
+  rm -f tmp_tok.c tmp_tok_text.s tmp_tok_bin.s
+  end_test_suite
+}
+
+parallel_try() {
+  local title="$1"
+  local expected="$2"
+  shift 2
+
+  begin_test "$title"
+
+  rm -f "$AOUT"
+  "$XCC" -o "$AOUT" "$@" || {
+    end_test 'Compile failed'
+    return
+  }
+
+  $RUN_AOUT
+  local actual="$?"
+
+  local err=''
+  [[ "$actual" == "$expected" ]] || err="${expected} expected, but ${actual}"
+  end_test "$err"
+}
+
+test_parallel() {
+  begin_test_suite "Parallel"
+
+  # Parallel compilation is run by xcc driver.
+  if [[ -n "$RE_SKIP" ]]; then
+    echo -n '//-WCC' | grep "$RE_SKIP" > /dev/null && {
+      end_test_suite
+      return
+    };
+  fi
+
+  local srcs=()
+  for i in 1 2 3 4; do
+    echo "int f$i(void){return $i;}" > "tmp_par$i.c"
+    srcs+=("tmp_par$i.c")
+  done
+  echo 'int f1(void), f2(void), f3(void), f4(void);
+int main(void){return f1() + f2() * f3() + f4();}' > tmp_par_main.c
+  srcs+=(tmp_par_main.c)
+
+  parallel_try '-j'     11 "${srcs[@]}" -j
+  parallel_try '-j2'    11 -j2 "${srcs[@]}"
+  parallel_try '-j 3'   11 -j 3 "${srcs[@]}"
+  parallel_try '-j with source next' 11 -j tmp_par1.c tmp_par2.c tmp_par3.c tmp_par4.c tmp_par_main.c
+
+  begin_test 'invalid job count'
+  "$XCC" -j 0 -c tmp_par1.c 2> /dev/null
+  end_test "$([[ $? -ne 0 ]] || echo 'not rejected')"
+
+  # Diagnostics from each job are not interleaved.
+  for i in 1 2 3; do
+    echo "void w$i(void){int a$i, b$i, c$i;}" > "tmp_par_warn$i.c"
+  done
+  begin_test 'diagnostics per job'
+  local msg err=''
+  if msg=$("$XCC" -j3 -Wall -c tmp_par_warn1.c tmp_par_warn2.c tmp_par_warn3.c 2>&1); then
+    local files
+    files=$(echo "$msg" | grep -o '^tmp_par_warn[0-9]\.c' | uniq)
+    [[ $(echo "$files" | wc -l) -eq 3 && $(echo "$files" | sort -u | wc -l) -eq 3 ]] || \
+        err="interleaved: ${msg}"
+    [[ $(echo "$msg" | grep -c '^tmp_par_warn') -eq 9 ]] || err="missing: ${msg}"
+  else
+    err='Compile failed'
+  fi
+  end_test "$err"
+
+  # One failing job fails the whole, and others are kept.
+  echo 'int f2(void){return undefined_var;}' > tmp_par_bad.c
+  begin_test 'one job fails'
+  rm -f tmp_par1.o tmp_par3.o tmp_par_bad.o
+  err=''
+  if msg=$("$XCC" -j3 -c tmp_par1.c tmp_par_bad.c tmp_par3.c 2>&1); then
+    err='Failure expected'
+  else
+    [[ "$msg" == *'undefined_var'* ]] || err="no diagnostics: ${msg}"
+    [[ -f tmp_par1.o && -f tmp_par3.o && ! -f tmp_par_bad.o ]] || err='unexpected objects'
+  fi
+  end_test "$err"
+
+  # A source crashing the in-process compiler does not take the driver down,
+  # and the rest are compiled, without temporary objects left.
+  echo 'int main(){return 0;} int main;' > tmp_par_fatal.c
+  begin_test 'fatal error in one source'
+  rm -f tmp_par1.o tmp_par3.o tmp_par_fatal.o
+  "$XCC" -c tmp_par1.c tmp_par_fatal.c tmp_par3.c 2> /dev/null
+  local rc=$?
+  err=''
+  [[ $rc -eq 1 ]] || err="exit code 1 expected, but ${rc}"
+  [[ -f tmp_par1.o && -f tmp_par3.o && ! -f tmp_par_fatal.o ]] || err='unexpected objects'
+  end_test "$err"
+
+  begin_test 'no temporary objects left'
+  local tmpobjs
+  tmpobjs=$(ls /tmp/xcc-*.o 2> /dev/null | wc -l)
+  "$XCC" -o "$AOUT" tmp_par1.c tmp_par_fatal.c tmp_par_main.c 2> /dev/null
+  rc=$?
+  err=''
+  [[ $rc -eq 1 ]] || err="exit code 1 expected, but ${rc}"
+  [[ $(ls /tmp/xcc-*.o 2> /dev/null | wc -l) -eq $tmpobjs ]] || err='temporary objects left'
+  end_test "$err"
+
+  # Join make jobserver, and give back all tokens taken.
+  printf 'all:\n\t+$(XCC) -j -o $(AOUT) %s\n' "${srcs[*]}" > tmp_par.mk
+  begin_test 'make jobserver'
+  rm -f "$AOUT"
+  err=''
+  if msg=$(MAKEFLAGS= timeout 60 make -s -j3 -f tmp_par.mk XCC="$XCC" AOUT="$AOUT" 2>&1); then
+    [[ "$msg" != *'jobserver'* ]] || err="$msg"
+    $RUN_AOUT
+    local actual="$?"
+    [[ "$actual" == 11 ]] || err="11 expected, but ${actual}"
+  else
+    err="make failed: ${msg}"
+  fi
+  end_test "$err"
+
+  rm -f tmp_par*.c tmp_par*.o tmp_par.mk
+  end_test_suite
+}
+
+pch_try() {
+  local title="$1"
+  local expected="$2"
+  shift 2
+
+  begin_test "$title"
+
+  "$XCC" -o "$AOUT" "$@" tmp_pch.c || {
+    end_test 'Compile failed'
+    return
+  }
+
+  $RUN_AOUT
+  local actual="$?"
+
+  local err=''
+  [[ "$actual" == "$expected" ]] || err="${expected} expected, but ${actual}"
+  end_test "$err"
+}
+
+# Check the count of declarations loaded from the global scope in precompiled header.
+pch_scope_try() {
+  local title="$1"
+  local pattern="$2"
+
+  begin_test "$title"
+
+  local report
+  report=$("$XCC" -ftime-report -o "$AOUT" tmp_pch.c 2>&1) || {
+    end_test 'Compile failed'
+    return
+  }
+  local actual
+  actual=$(echo "$report" | awk '$1 == "cc1.pch.decls" {print $2}')
+
+  local err=''
+  [[ "$actual" =~ ^${pattern}$ ]] || err="cc1.pch.decls: '${pattern}' expected, but '${actual}'"
+  end_test "$err"
+}
+
+test_pch() {
+  begin_test_suite "Precompiled header"
+
+  # Precompiled header is made by xcc driver.
+  if [[ -n "$RE_SKIP" ]]; then
+    echo -n '//-WCC' | grep "$RE_SKIP" > /dev/null && {
+      end_test_suite
+      return
+    };
+  fi
+
+  printf '#ifndef TMP_PCH_H\n#define TMP_PCH_H\n#define ANS 11\ntypedef struct {int x;} Foo;\n#endif\n' > tmp_pch.h
+  echo '#include "tmp_pch.h"
+#include "tmp_pch.h"
+int main(void){Foo foo = {ANS}; return foo.x;}' > tmp_pch.c
+  rm -f tmp_pch.pch
+  pch_try 'without pch' 11
+
+  begin_test 'make pch'
+  "$XCC" -x c-header tmp_pch.h && [[ -f tmp_pch.pch ]]
+  end_test "$([[ $? -eq 0 ]] || echo 'tmp_pch.pch not made')"
+
+  pch_try 'use pch' 11
+
+  begin_test 'pch output next to header'
+  "$XCC" -x c-header tmp_pch.h -o ./tmp_pch.pch
+  end_test "$([[ $? -eq 0 ]] || echo 'rejected')"
+  begin_test 'pch output elsewhere'
+  "$XCC" -x c-header tmp_pch.h -o tmp_pch_other.pch 2> /dev/null
+  end_test "$([[ $? -ne 0 && ! -f tmp_pch_other.pch ]] || echo 'not rejected')"
+
+  # Modify the header, keeping its size and time stamp: Only the precompiled header can tell 11.
+  cp -p tmp_pch.h tmp_pch.bak
+  sed -i.tmp 's/ANS 11/ANS 22/' tmp_pch.h
+  touch -r tmp_pch.bak tmp_pch.h
+  pch_try 'pch is used' 11
+  pch_try 'option changed' 22 -DFOO
+  echo '' >> tmp_pch.h  # Size changes.
+  pch_try 'header updated' 22
+
+  # cc1 appends its global scope, and loads it instead of parsing the declarations.
+  echo '#include <stdio.h>
+enum Color {RED, GREEN = 5, BLUE};
+struct Node {struct Node *next; int value;};
+typedef struct Node Node;
+int sum(const Node *node);
+static inline int twice(int x) {return x * 2;}' > tmp_pch.h
+  echo '#include "tmp_pch.h"
+int sum(const Node *node) {int s = 0; for (; node != NULL; node = node->next) s += node->value; return s;}
+int main(void){Node a = {NULL, twice(BLUE)}, b = {&a, GREEN}; return sum(&b);}' > tmp_pch.c
+  "$XCC" -x c-header tmp_pch.h
+  pch_try 'declarations in pch' 17
+  pch_scope_try 'global scope in pch' '[1-9][0-9]*'
+
+  echo 'static int table[] = {3, 4};
+static inline int second(void) {return table[1];}' > tmp_pch.h
+  echo '#include "tmp_pch.h"
+int main(void){return second();}' > tmp_pch.c
+  "$XCC" -x c-header tmp_pch.h
+  pch_try 'initializer in pch' 4
+  pch_scope_try 'tokens only for initializer' ''
+
+  # Function bodies are parsed on use, and errors point the header.
+  printf 'static inline int bad(void) {\n  return undefined_var;\n}\n' > tmp_pch.h
+  echo '#include "tmp_pch.h"
+int main(void){return bad();}' > tmp_pch.c
+  "$XCC" -x c-header tmp_pch.h
+  begin_test 'error in pch body'
+  local msg
+  msg=$("$XCC" -o "$AOUT" tmp_pch.c 2>&1)
+  end_test "$([[ $? -ne 0 && "$msg" == *'tmp_pch.h(2)'* ]] || echo 'error not in header')"
+
+  rm -f tmp_pch.h tmp_pch.h.tmp tmp_pch.bak tmp_pch.pch
+  end_test_suite
+}
+
+# Count lines matching a pattern in assembly output.
+asm_try() {
+  local title="$1"
+  local pattern="$2"
+  local expected="$3"
+  local input="$4"
+
+  begin_test "$title"
+
+  # Patterns are for x86-64 assembly from xcc.
+  if [[ "$ARCH" != "x86_64" ]] || { [[ -n "$RE_SKIP" ]] && echo -n '//-WCC' | grep "$RE_SKIP" > /dev/null; }; then
+    end_test
+    return
+  fi
+
+  local asm
+  asm=$(echo -e "$input" | $XCC -S -o - -xc -) || {
+    end_test 'Compile failed'
+    return
+  }
+  local actual
+  actual=$(echo "$asm" | grep -cE "$pattern")
+
+  local err=''
+  [[ "$actual" == "$expected" ]] || err="${expected} lines of '${pattern}' expected, but ${actual}"
+  end_test "$err"
+}
+
+# Check a statistic of -ftime-report.
+stat_try() {
+  local title="$1"
+  local name="$2"
+  local expected="$3"
+  local input="$4"
+
+  begin_test "$title"
+
+  # Report is collected by xcc driver.
+  if [[ -n "$RE_SKIP" ]] && echo -n '//-WCC' | grep "$RE_SKIP" > /dev/null; then
+    end_test
+    return
+  fi
+
+  local report
+  report=$(echo -e "$input" | $XCC -ftime-report -c -o tmp_stat.o -xc - 2>&1) || {
+    end_test 'Compile failed'
+    return
+  }
+  local actual
+  actual=$(echo "$report" | awk -v name="$name" '$1 == name {print $2}')
+
+  local err=''
+  [[ "$actual" == "$expected" ]] || err="${name}: ${expected} expected, but ${actual}"
+  end_test "$err"
+}
+
 test_ssa() {
   begin_test_suite "SSA"
 
+  # SSA pipeline runs at -O1 or above.
+  local XCC="$XCC -O1"
+
   try 'swap variables' 74 'int a = 7, b = 4; for (int i = 0; i < 2; ++i) { int d = a; a = b; b = d; } return a*10 + b;'
+  XCC="$XCC -fno-copy-prop" try 'without copy-prop' 74 'int a = 7, b = 4; for (int i = 0; i < 2; ++i) { int d = a; a = b; b = d; } return a*10 + b;'
+  XCC="$XCC -fno-ssa -fno-dce" try 'without ssa and dce' 74 'int a = 7, b = 4; for (int i = 0; i < 2; ++i) { int d = a; a = b; b = d; } return a*10 + b;'
+  try 'nested loop with branches' 73 'int s = 0, t = 5; for (int i = 0; i < 10; ++i) { for (int j = 0; j < i; ++j) { if (j & 1) s += j; else t ^= j; } } return s + t;'
+
+  # Phi for `t` is not placed at the loop header, where it is dead.
+  local loop_temp='int main(void) {int s = 0; for (int i = 0; i < 5; ++i) { int t = i * 2; s += t; } return s;}'
+  stat_try 'phis only for live registers' cc1.ssa.phis 2 "$loop_temp"
+  stat_try 'dead phis pruned' cc1.ssa.pruned-phis 4 "$loop_temp"
+
+  try 'copy chain in loop' 18 'int a = 3, b, c, d = 0; for (int i = 0; i < 4; ++i) { b = a; c = b; d += c; a = c + 1; } return d;'
+  XCC="$XCC -fno-dce" try 'copy chain without dce' 18 'int a = 3, b, c, d = 0; for (int i = 0; i < 4; ++i) { b = a; c = b; d += c; a = c + 1; } return d;'
+
+  # Phi of same copies folds, then the copies and the branch are removed through def-use chains.
+  local copy_branch='int f(int x, int y) {int a = x, b; if (y) b = a; else b = a; int c = b, d = c; return d * c;}'
+  asm_try 'copy chain through phi' '^\s+(test|j[a-z]+)\s' 0 "$copy_branch"
+  XCC="$XCC -fno-dce" asm_try 'copy chain through phi without dce' '^\s+(test|j[a-z]+)\s' 3 "$copy_branch"
+  stat_try 'copy chain removed' cc1.dce.irs 5 "$copy_branch"
 
   echo 'int main(void) {int x = 1, y = 0; return x / y;}' > tmp_zerodiv.c
   link_success 'zero division (NOEXEC)' tmp_zerodiv.c
@@ -307,6 +805,23 @@ test_ssa() {
     return x;
   "
 
+  # Sparse conditional constant propagation runs at -O2.
+  local XCC="$XCC -O2"
+  try 'constant flag' 5 'const int debug = 0; int x = 5; if (debug) x = 99; return x;'
+  try 'constant through phi' 7 'int a = 3, b; if (a > 2) b = a + 4; else b = a * 9; return b;'
+  try 'dead loop' 1 'int n = 0, r = 1; while (n > 0) { r *= n; --n; } return r;'
+  try 'phi of equal constants' 12 'int k = 4, m; for (int i = 0; i < 3; ++i) m = k * 3; return m;'
+  XCC="$XCC -fno-sccp" try 'without sccp' 7 'int a = 3, b; if (a > 2) b = a + 4; else b = a * 9; return b;'
+
+  local optimistic='int main(void) {int x = 1, i = 0; while (i < 10) { if (x != 1) x = 2; ++i; } return x;}'
+  asm_try 'optimistic constant: branch folded' 'cmp \$1,' 0 "$optimistic"
+  XCC="$XCC -fno-sccp" asm_try 'optimistic constant without sccp' 'cmp \$1,' 1 "$optimistic"
+  asm_try 'constant flag in loop' '\$99' 0 'int main(void) {int debug = 0, x = 5; for (int i = 0; i < 3; ++i) { if (debug) x = 99; } return x;}'
+  local dead_loop='int main(void) {int n = 0, r = 1; while (n > 0) { r *= n; --n; } return r;}'
+  asm_try 'unreachable blocks removed' '^L\.|^\s+j[a-z]+\s' 0 "$dead_loop"
+  stat_try 'unreachable IRs counted' cc1.sccp.irs 5 "$dead_loop"
+
+  rm -f tmp_stat.o
   end_test_suite
 }
 
@@ -317,7 +832,13 @@ test_initializer
 test_function
 test_error
 test_error_line
+test_asm
 test_link
+test_parallel
+test_cache
+test_report
+test_token_stream
+test_pch
 test_ssa
 
 if [[ $FAILED_SUITE_COUNT -ne 0 ]]; then
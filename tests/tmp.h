@@ -0,0 +1,2 @@
+#pragma once
+x += 11;
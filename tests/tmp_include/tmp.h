@@ -0,0 +1 @@
+#define BAR (13)
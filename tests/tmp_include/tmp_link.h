@@ -0,0 +1 @@
+../tmp.h
\ No newline at end of file
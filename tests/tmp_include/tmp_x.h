@@ -0,0 +1,2 @@
+X(11)
+X(22)
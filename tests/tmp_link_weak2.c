@@ -0,0 +1 @@
+int weakfunc(void) {return 22;}
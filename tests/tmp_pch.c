@@ -0,0 +1,2 @@
+#include "tmp_pch.h"
+int main(void){return second();}
@@ -53,6 +53,32 @@ TEST(sb) {
   EXPECT_EQ(true, sb_empty(&sb));
 }
 
+TEST(arena) {
+  Arena arena = {0};
+  int misaligned = 0, nonzero = 0;
+  char *prev = NULL;
+  int overlap = 0;
+  for (int i = 0; i < 10000; ++i) {
+    size_t size = i % 100 == 0 ? 100000 : (size_t)(i % 37);  // Includes 0 and large blocks.
+    unsigned char *p = arena_alloc(&arena, size);
+    misaligned += ((uintptr_t)p & 15) != 0;
+    for (size_t j = 0; j < size; ++j)
+      nonzero += p[j] != 0;
+    memset(p, 0xff, size);
+    overlap += (char*)p == prev;
+    prev = (char*)p;
+  }
+  EXPECT_EQ(0, misaligned);
+  EXPECT_EQ(0, nonzero);
+  EXPECT_EQ(0, overlap);
+
+  arena_release(&arena);
+  EXPECT_NULL(arena.chunks);
+  EXPECT_EQ(0, arena.capacity);
+  EXPECT_NOT_NULL(arena_alloc(&arena, 0));
+  arena_release(&arena);
+}
+
 TEST(escape) {
   StringBuffer sb;
   sb_init(&sb);
@@ -109,4 +135,34 @@ TEST(change_ext) {
   EXPECT_STREQ("dir", "/foo/bar.baz/qux.s", change_ext("/foo/bar.baz/qux", "s"));
 }
 
+TEST(scan) {
+  // Try every alignment and length, to cover both bytewise and block paths.
+  char buf[64 + 1];
+  int ws_error = 0, ident_error = 0, find_error = 0, find_nul_error = 0;
+  for (int start = 0; start < 16; ++start) {
+    for (int len = 0; start + len < 64; ++len) {
+      memset(buf, 'x', sizeof(buf) - 1);
+      buf[sizeof(buf) - 1] = '\0';
+      for (int i = 0; i < len; ++i)
+        buf[start + i] = " \t\n\v\f\r"[i % 6];
+      ws_error += skip_whitespaces(&buf[start]) != &buf[start + len];
+
+      for (int i = 0; i < len; ++i)
+        buf[start + i] = "aZ_09zA"[i % 7];
+      buf[start + len] = "@[`{/:-\x80 "[len % 10];
+      ident_error += skip_ident_chars(&buf[start]) != &buf[start + len];
+
+      buf[start + len] = '*';
+      find_error += find_chars(&buf[start], '*', '"', '\'') != &buf[start + len];
+      buf[start + len] = '\0';
+      find_nul_error += find_chars(&buf[start], '*', '"', '\'') != &buf[start + len];
+    }
+  }
+  EXPECT_EQ(0, ws_error);
+  EXPECT_EQ(0, ident_error);
+  EXPECT_EQ(0, find_error);
+  EXPECT_EQ(0, find_nul_error);
+  EXPECT_STREQ("non-ASCII", "\xe3\x81\x82", skip_ident_chars("abc\xe3\x81\x82"));
+}
+
 XTEST_MAIN();
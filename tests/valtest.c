@@ -1106,6 +1106,31 @@ TTT:;
     EXPECT("shadow var", 10, x);
   }
 
+  {
+    int a = 1, b = 2, c = 3, d = 4, e = 5, f = 6, g = 7, h = 8, x = 9;
+    {
+      int a0 = 0, b0 = 0, c0 = 0, d0 = 0, e0 = 0, f0 = 0, g0 = 0, h0 = 0;
+      int y = x + a0 + b0 + c0 + d0 + e0 + f0 + g0 + h0;  // Look up x in outer scope.
+      int x = 100;  // Declared after lookup in this scope.
+      y += x;
+      EXPECT("shadow in many vars", 109, y);
+    }
+    EXPECT("many vars", 45, a + b + c + d + e + f + g + h + x);
+  }
+
+  {
+    int a = 1, b = 2, c = 3, d = 4, e = 5, f = 6, g = 7, h = 8;
+    extern int e_val;
+    int x = e_val + a + h;  // Look up in indexed scope.
+    extern int e_val;  // Redeclared.
+    typedef int T;
+    {
+      T T = 3;  // Typedef name redeclared as variable in inner scope.
+      x += T;
+    }
+    EXPECT("redeclare in many vars", 1616, x + e_val + b + c + d + e + f + g - 1);
+  }
+
   {
     typedef int Foo;
     {
@@ -1297,6 +1322,21 @@ TEST(struct) {
     EXPECT("scoped struct", 5, size + sizeof(struct S));
   }
 
+  {
+    struct {
+      int m0, m1, m2, m3, m4, m5, m6, m7, m8;
+      struct { int m9; };
+    } s = {.m8 = 8, .m9 = 9, .m1 = 1};
+    s.m7 = 7;
+    EXPECT("many members", 25, s.m1 + s.m7 + s.m8 + s.m9 + s.m0);
+  }
+
+  {
+    typedef char S[];
+    const S a = "ab", b = "abcd";
+    EXPECT("typedef unsized array", 35, sizeof(a) * 10 + sizeof(b));
+  }
+
   {
     int size;
     typedef struct {int x;} S;
@@ -1937,6 +1977,15 @@ static inline bool inline_even(int x);
 static inline bool inline_odd(int x)  { return x == 0 ? false : inline_even(x - 1); }
 static inline bool inline_even(int x)  { return x == 0 ? true : inline_odd(x - 1); }
 static inline MoreParamsReturnsStruct inline_returns_struct(int x, int y) { return (MoreParamsReturnsStruct){-x, ~y}; }
+static inline int inline_loop_sum(int n) { int s = 0; for (int i = 1; i <= n; ++i) { if (i == 3) continue; s += i; } return s; }
+static inline int inline_from_global(int x) { return x + 1; }
+static int (*const inline_func_table[])(int) = {inline_from_global};
+static inline int inline_used_before_def(int x);
+int call_inline_used_before_def(int x) { return inline_used_before_def(x); }
+static inline int inline_used_before_def(int x) { return x * 2; }
+static inline int inline_ref_taken_before_def(int x);
+int (*inline_ref_taken_before_def_ptr)(int) = inline_ref_taken_before_def;
+static inline int inline_ref_taken_before_def(int x) { return x * 3; }
 
 typedef struct {short x;} SmallStruct;
 SmallStruct small_struct_param_and_result(int a, SmallStruct s1, int b, SmallStruct s2) {
@@ -2057,6 +2106,18 @@ TEST(function) {
   EXPECT_TRUE(inline_odd(9));
   EXPECT_TRUE(inline_even(8));
   EXPECT_FALSE(inline_odd(8));
+  {
+    int total = 0;
+    for (int i = 0; i < 3; ++i) {
+      if (i == 1)
+        continue;
+      total += inline_loop_sum(5);  // First reference in a loop.
+    }
+    EXPECT("inline in loop", 24, total);
+  }
+  EXPECT("inline referred from global", 43, inline_func_table[0](42));
+  EXPECT("inline used before definition", 6, call_inline_used_before_def(3));
+  EXPECT("inline ref taken before definition", 15, inline_ref_taken_before_def_ptr(5));
   {
     MoreParamsReturnsStruct r = inline_returns_struct(1234, 5678);
     EXPECT("inline return struct 1", -1234, r.x);